@@ -0,0 +1,274 @@
+/*----------------------------------------------------------------------------------------------------------
+ *  Copyright (c) Peter Bjorklund. All rights reserved. https://github.com/piot/conclave-client-cli
+ *  Licensed under the MIT License. See LICENSE in the project root for license information.
+ *--------------------------------------------------------------------------------------------------------*/
+#define _POSIX_C_SOURCE 200809L
+#include <clog/clog.h>
+#include <clog/console.h>
+#include <conclave-client-cli/clock.h>
+#include <conclave-client-cli/swarm.h>
+#include <dirent.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/resource.h>
+#include <tiny-libc/tiny_libc.h>
+#include <unistd.h>
+
+clog_config g_clog;
+
+typedef struct FootprintOptions {
+    const char* host;
+    uint16_t guisePort;
+    uint16_t conclavePort;
+    size_t firstSecretIndex;
+    size_t startCount;
+    size_t maxCount;
+    size_t imprintOctetsPerClient;
+    MonotonicTimeMs loginTimeoutMs;
+    size_t maxBytesPerClient; // zero for no threshold
+} FootprintOptions;
+
+/// Memory of one step, with the same number of clients all the way through
+typedef struct FootprintStep {
+    size_t clientCount;
+    size_t loggedInCount;
+    MonotonicTimeMs loginMs;
+    size_t rssOctets; // growth of the resident set from before the swarm was created
+    size_t staticOctetsPerClient;
+    ClvCliImprintReport imprint;
+    size_t leakedFileCount; // still open after the swarm was destroyed
+} FootprintStep;
+
+static int parseArguments(FootprintOptions* options, int argc, char** argv)
+{
+    options->host = "127.0.0.1";
+    options->guisePort = 27004;
+    options->conclavePort = 27003;
+    options->firstSecretIndex = 0;
+    options->startCount = 64;
+    options->maxCount = 4096;
+    options->imprintOctetsPerClient = 16 * 1024;
+    options->loginTimeoutMs = 10000;
+    options->maxBytesPerClient = 0;
+
+    for (int i = 1; i < argc; ++i) {
+        const char* arg = argv[i];
+        if (i + 1 >= argc) {
+            printf("missing value for '%s'\n", arg);
+            return -1;
+        }
+        const char* text = argv[++i];
+        if (tc_str_equal(arg, "--host")) {
+            options->host = text;
+            continue;
+        }
+        long value = atol(text);
+        if (value < 0) {
+            printf("negative value for '%s'\n", arg);
+            return -1;
+        }
+        if (tc_str_equal(arg, "--guise-port")) {
+            options->guisePort = (uint16_t)value;
+        } else if (tc_str_equal(arg, "--conclave-port")) {
+            options->conclavePort = (uint16_t)value;
+        } else if (tc_str_equal(arg, "--secret")) {
+            options->firstSecretIndex = (size_t)value;
+        } else if (tc_str_equal(arg, "--start")) {
+            options->startCount = (size_t)value;
+        } else if (tc_str_equal(arg, "--max")) {
+            options->maxCount = (size_t)value;
+        } else if (tc_str_equal(arg, "--imprint")) {
+            options->imprintOctetsPerClient = (size_t)value * 1024;
+        } else if (tc_str_equal(arg, "--timeout")) {
+            options->loginTimeoutMs = (MonotonicTimeMs)value;
+        } else if (tc_str_equal(arg, "--max-bytes-per-client")) {
+            options->maxBytesPerClient = (size_t)value;
+        } else {
+            printf("unknown option '%s'\n", arg);
+            return -1;
+        }
+    }
+
+    if (options->startCount == 0 || options->maxCount < options->startCount) {
+        printf("--start must be at least 1 and at most --max\n");
+        return -1;
+    }
+
+    return 0;
+}
+
+/// Resident set size of the process, from /proc/self/statm
+/// @return octet count, zero if it could not be read
+static size_t residentOctets(void)
+{
+    FILE* file = fopen("/proc/self/statm", "r");
+    if (file == 0) {
+        return 0;
+    }
+    unsigned long totalPages;
+    unsigned long residentPages;
+    int matchCount = fscanf(file, "%lu %lu", &totalPages, &residentPages);
+    fclose(file);
+    if (matchCount != 2) {
+        return 0;
+    }
+
+    return (size_t)residentPages * (size_t)sysconf(_SC_PAGESIZE);
+}
+
+/// Open file descriptors of the process, from /proc/self/fd
+/// @return file count, zero if it could not be read
+static size_t openFileCount(void)
+{
+    DIR* directory = opendir("/proc/self/fd");
+    if (directory == 0) {
+        return 0;
+    }
+    size_t count = 0;
+    while (readdir(directory) != 0) {
+        count++;
+    }
+    closedir(directory);
+
+    return count;
+}
+
+/// Every client has a guise and a conclave socket. The swarm of a step is destroyed, with its
+/// sockets, before the next step, so the limit only has to fit the largest step.
+static void raiseFileLimit(size_t clientCount, Clog* log)
+{
+    struct rlimit limit;
+    if (getrlimit(RLIMIT_NOFILE, &limit) < 0) {
+        return;
+    }
+    limit.rlim_cur = limit.rlim_max;
+    if (setrlimit(RLIMIT_NOFILE, &limit) < 0 || limit.rlim_cur < clientCount * 2 + 16) {
+        CLOG_C_WARN(log, "file limit %lu is too low for %zu clients",
+            (unsigned long)limit.rlim_cur, clientCount)
+    }
+}
+
+/// Creates a swarm, updates it until every client is logged in and measures it before it is
+/// destroyed again
+static int measureStep(
+    FootprintStep* step, size_t clientCount, const FootprintOptions* options, Clog log)
+{
+    static ClvCliSwarm swarm;
+
+    size_t fileCountBefore = openFileCount();
+    size_t rssBefore = residentOctets();
+    if (clvCliSwarmInit(&swarm, clientCount, options->firstSecretIndex, options->host,
+            options->guisePort, options->host, options->conclavePort,
+            options->imprintOctetsPerClient, log)
+        < 0) {
+        return -1;
+    }
+
+    MonotonicTimeMs startedAt = monotonicTimeMsNow();
+    MonotonicTimeMs now = startedAt;
+    while (now - startedAt < options->loginTimeoutMs) {
+        if (clvCliSwarmUpdate(&swarm, now) < 0) {
+            break;
+        }
+        if (clvCliSwarmIsLoggedIn(&swarm) && swarm.loggedInCount == clientCount) {
+            break;
+        }
+        clvCliSleepMs(1);
+        now = monotonicTimeMsNow();
+    }
+
+    size_t rssAfter = residentOctets();
+    step->clientCount = clientCount;
+    step->loggedInCount = swarm.loggedInCount;
+    step->loginMs = now - startedAt;
+    step->rssOctets = rssAfter > rssBefore ? rssAfter - rssBefore : 0;
+    step->staticOctetsPerClient = clvCliSwarmBytesPerClient();
+    step->imprint = swarm.imprintCounter.report;
+
+    clvCliSwarmDestroy(&swarm);
+    size_t fileCountAfter = openFileCount();
+    step->leakedFileCount = fileCountAfter > fileCountBefore ? fileCountAfter - fileCountBefore : 0;
+
+    return 0;
+}
+
+/// Doubles the client count, but always ends with the maximum count
+/// @return client count of the next step, above the maximum count after the last step
+static size_t nextCount(size_t count, const FootprintOptions* options)
+{
+    if (count == options->maxCount) {
+        return count + 1;
+    }
+
+    return count * 2 > options->maxCount ? options->maxCount : count * 2;
+}
+
+static void printStep(const FootprintStep* step)
+{
+    size_t count = step->clientCount;
+    printf("%7zu %7zu %7lu %9zu %9zu %9zu %9zu %9zu %9.1f\n", count, step->loggedInCount,
+        (unsigned long)step->loginMs, step->rssOctets / 1024, step->rssOctets / count,
+        step->staticOctetsPerClient, step->imprint.peakLiveOctets / count,
+        step->imprint.liveOctets / count, (double)step->imprint.allocationCount / (double)count);
+}
+
+int main(int argc, char** argv)
+{
+    g_clog.log = clog_console;
+    g_clog.level = CLOG_TYPE_WARN;
+
+    FootprintOptions options;
+    if (parseArguments(&options, argc, argv) < 0) {
+        printf("usage: conclave-client-cli-footprint [--host 127.0.0.1] [--guise-port 27004] "
+               "[--conclave-port 27003] [--secret index] [--start 64] [--max 4096] "
+               "[--imprint KiB] [--timeout ms] [--max-bytes-per-client octets]\n");
+        return -1;
+    }
+
+    Clog log;
+    log.config = &g_clog;
+    log.constantPrefix = "footprint";
+
+    raiseFileLimit(options.maxCount, &log);
+
+    printf("%7s %7s %7s %9s %9s %9s %9s %9s %9s\n", "clients", "login", "ms", "rssKiB", "rss/cl",
+        "static/cl", "peak/cl", "live/cl", "allocs/cl");
+
+    FootprintStep step;
+    tc_mem_clear_type(&step);
+    bool isComplete = true;
+    for (size_t count = options.startCount; count <= options.maxCount;
+         count = nextCount(count, &options)) {
+        if (measureStep(&step, count, &options, log) < 0) {
+            CLOG_C_SOFT_ERROR(&log, "could not create %zu clients", count)
+            return -1;
+        }
+        printStep(&step);
+        if (step.leakedFileCount > 0) {
+            // The later steps would run out of files and measure the memory of this one
+            printf("%zu files are still open after destroying %zu clients\n",
+                step.leakedFileCount, count);
+            return 1;
+        }
+        if (step.loggedInCount != count) {
+            isComplete = false;
+        }
+    }
+
+    // The largest step has the least fixed process overhead in each client
+    size_t bytesPerClient = step.rssOctets / step.clientCount;
+    if (!isComplete) {
+        printf("not all clients logged in, is conclave-stub-server running?\n");
+        return 1;
+    }
+    if (options.maxBytesPerClient > 0 && bytesPerClient > options.maxBytesPerClient) {
+        printf("regression: %zu octets per client is above the threshold of %zu\n",
+            bytesPerClient, options.maxBytesPerClient);
+        return 1;
+    }
+
+    printf("%zu octets per client\n", bytesPerClient);
+
+    return 0;
+}
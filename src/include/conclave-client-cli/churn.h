@@ -0,0 +1,100 @@
+/*----------------------------------------------------------------------------------------------------------
+ *  Copyright (c) Peter Bjorklund. All rights reserved. https://github.com/piot/conclave-client-cli
+ *  Licensed under the MIT License. See LICENSE in the project root for license information.
+ *--------------------------------------------------------------------------------------------------------*/
+#ifndef CONCLAVE_CLIENT_CLI_CHURN_H
+#define CONCLAVE_CLIENT_CLI_CHURN_H
+
+#include <conclave-client-cli/clock.h>
+#include <conclave-client-cli/histogram.h>
+#include <conclave-serialize/types.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+typedef struct ClvCliChurnOptions {
+    double joinRatePerClient; // room joins per second
+    uint32_t dwellMs; // time in each room before moving on
+    uint32_t pingIntervalMs; // pings while in a room
+    uint32_t timeoutMs; // a join without a response in this time has failed
+    ClvSerializeListRoomsOptions roomList;
+} ClvCliChurnOptions;
+
+/// Outcome of a churn run, can be merged from many swarms
+typedef struct ClvCliChurnReport {
+    double targetRate; // joins per second for all clients
+    ClvCliTimeNs elapsed;
+    uint64_t listCount;
+    uint64_t emptyListCount; // room lists without a room to join
+    uint64_t joinCount;
+    uint64_t joinedCount;
+    uint64_t failedCount; // no response in time, or put in another room
+    uint64_t leaveCount;
+    uint64_t convergedCount; // saw itself in the members of the room
+    uint64_t notConvergedCount; // left the room before it saw itself
+    ClvCliHistogram joinLatencies; // microseconds from join sent until answered
+    ClvCliHistogram convergenceLatencies; // microseconds from join sent until in the members
+} ClvCliChurnReport;
+
+typedef enum ClvCliChurnPhase {
+    ClvCliChurnPhaseIdle, // lists the rooms when due
+    ClvCliChurnPhaseListing,
+    ClvCliChurnPhaseReady, // has picked a room, waits for the join rate to allow a join
+    ClvCliChurnPhaseJoining,
+    ClvCliChurnPhaseDwelling,
+} ClvCliChurnPhase;
+
+/// The requests that the churn sends from a client, each returns false if the client can not send
+typedef struct ClvCliChurnClients {
+    void* self;
+    bool (*listRooms)(void* self, size_t index, const ClvSerializeListRoomsOptions* options);
+    bool (*joinRoom)(void* self, size_t index, ClvSerializeRoomId roomId);
+    bool (*ping)(void* self, size_t index);
+    const ClvSerializeListRoomsResponseOptions* (*lastRoomList)(void* self, size_t index);
+} ClvCliChurnClients;
+
+/// Room join and leave churn
+/// Every client lists the rooms, joins a random one of them, pings while it stays in the room
+/// for the dwell time and then moves on to another room from the same list. Joins are spread out
+/// to the configured rate for all clients together. Conclave has no leave request, a client
+/// leaves its room by joining the next one. Convergence is when a client first sees itself in
+/// the members of the ping response.
+typedef struct ClvCliChurn {
+    size_t clientCount;
+    ClvCliChurnOptions options;
+    bool isRunning;
+    ClvCliTimeNs startedAt;
+    ClvCliTimeNs stoppedAt;
+    uint8_t* phases; // ClvCliChurnPhase
+    ClvCliTimeNs* dueAt; // next list, ping or join timeout
+    ClvCliTimeNs* joinSentAt;
+    ClvCliTimeNs* leaveAt;
+    ClvSerializeRoomId* roomIds; // picked or joined room
+    bool* hasConverged;
+    double joinCredit; // joins that can be sent without going over the rate
+    ClvCliTimeNs creditUpdatedAt;
+    size_t nextReadyIndex; // first client to get join credit, so no client is starved
+    ClvCliTimeNs nextUpdateAt;
+    uint64_t random;
+    ClvCliChurnReport report;
+} ClvCliChurn;
+
+int clvCliChurnInit(ClvCliChurn* self, size_t clientCount);
+void clvCliChurnDestroy(ClvCliChurn* self);
+void clvCliChurnStart(ClvCliChurn* self, const ClvCliChurnOptions* options, ClvCliTimeNs now);
+void clvCliChurnStop(ClvCliChurn* self, ClvCliTimeNs now);
+void clvCliChurnUpdate(ClvCliChurn* self, ClvCliTimeNs now, const ClvCliChurnClients* clients);
+void clvCliChurnRoomListReceived(ClvCliChurn* self, size_t index,
+    const ClvSerializeListRoomsResponseOptions* roomList, ClvCliTimeNs now);
+void clvCliChurnJoinReceived(
+    ClvCliChurn* self, size_t index, ClvSerializeRoomId roomId, ClvCliTimeNs now);
+void clvCliChurnPingReceived(ClvCliChurn* self, size_t index,
+    const ClvSerializeRoomInfoInPing* roomInfo, ClvSerializeUserId userId, ClvCliTimeNs now);
+size_t clvCliChurnTimeUntilUpdate(const ClvCliChurn* self, ClvCliTimeNs now);
+void clvCliChurnReportGet(const ClvCliChurn* self, ClvCliChurnReport* report, ClvCliTimeNs now);
+size_t clvCliChurnBytesPerClient(void);
+
+void clvCliChurnReportInit(ClvCliChurnReport* self);
+void clvCliChurnReportMerge(ClvCliChurnReport* self, const ClvCliChurnReport* other);
+
+#endif
@@ -0,0 +1,18 @@
+/*----------------------------------------------------------------------------------------------------------
+ *  Copyright (c) Peter Bjorklund. All rights reserved. https://github.com/piot/conclave-client-cli
+ *  Licensed under the MIT License. See LICENSE in the project root for license information.
+ *--------------------------------------------------------------------------------------------------------*/
+#ifndef CONCLAVE_CLIENT_CLI_CLOCK_H
+#define CONCLAVE_CLIENT_CLI_CLOCK_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+typedef uint64_t ClvCliTimeNs;
+
+ClvCliTimeNs clvCliClockNowNs(void);
+ClvCliTimeNs clvCliClockThreadCpuNs(void);
+ClvCliTimeNs clvCliClockRealtimeNs(void);
+void clvCliSleepMs(size_t milliseconds);
+
+#endif
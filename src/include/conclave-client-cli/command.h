@@ -0,0 +1,65 @@
+/*----------------------------------------------------------------------------------------------------------
+ *  Copyright (c) Peter Bjorklund. All rights reserved. https://github.com/piot/conclave-client-cli
+ *  Licensed under the MIT License. See LICENSE in the project root for license information.
+ *--------------------------------------------------------------------------------------------------------*/
+#ifndef CONCLAVE_CLIENT_CLI_COMMAND_H
+#define CONCLAVE_CLIENT_CLI_COMMAND_H
+
+#include <conclave-client-cli/churn.h>
+#include <conclave-client-cli/clock.h>
+#include <conclave-client-cli/load.h>
+#include <conclave-client-cli/simulate.h>
+#include <conclave-serialize/types.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+typedef enum ClvCliCommandType {
+    ClvCliCommandTypePing,
+    ClvCliCommandTypeRoomCreate,
+    ClvCliCommandTypeRoomJoin,
+    ClvCliCommandTypeRoomList,
+    ClvCliCommandTypeRoomWatch,
+    ClvCliCommandTypeRoomUnwatch,
+    ClvCliCommandTypeState,
+    ClvCliCommandTypeStats,
+    ClvCliCommandTypeLoadStart,
+    ClvCliCommandTypeLoadStop,
+    ClvCliCommandTypePerf,
+    ClvCliCommandTypeMem,
+    ClvCliCommandTypeChurnStart,
+    ClvCliCommandTypeChurnStop,
+    ClvCliCommandTypeChurnReport,
+    ClvCliCommandTypeSimulateStart,
+    ClvCliCommandTypeSimulateStop,
+    ClvCliCommandTypeSimulateInject,
+    ClvCliCommandTypeSimulateReport,
+} ClvCliCommandType;
+
+/// Sent from the REPL thread to the network thread, and on to the swarm shards
+typedef struct ClvCliCommand {
+    ClvCliCommandType type;
+    uint64_t sequence;
+    union {
+        struct {
+            uint64_t knowledge;
+            bool hasConnectionToOwner;
+        } ping;
+        ClvSerializeRoomCreateOptions roomCreate;
+        ClvSerializeRoomJoinOptions roomJoin;
+        ClvSerializeListRoomsOptions roomList;
+        struct {
+            ClvSerializeListRoomsOptions roomList;
+            uint32_t intervalMs;
+        } roomWatch;
+        ClvCliLoadOptions load;
+        ClvCliChurnOptions churn;
+        ClvCliSimulateOptions simulate;
+        ClvCliSimulateInjectOptions simulateInject;
+        struct {
+            bool shouldSetBudget;
+            ClvCliTimeNs budget;
+        } perf;
+    } data;
+} ClvCliCommand;
+
+#endif
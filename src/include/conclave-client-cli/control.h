@@ -0,0 +1,70 @@
+/*----------------------------------------------------------------------------------------------------------
+ *  Copyright (c) Peter Bjorklund. All rights reserved. https://github.com/piot/conclave-client-cli
+ *  Licensed under the MIT License. See LICENSE in the project root for license information.
+ *--------------------------------------------------------------------------------------------------------*/
+#ifndef CONCLAVE_CLIENT_CLI_CONTROL_H
+#define CONCLAVE_CLIENT_CLI_CONTROL_H
+
+#include <clog/clog.h>
+#include <conclave-client-cli/json_writer.h>
+#include <conclave-client-cli/network.h>
+#include <conclave-client-cli/out_chain.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define CLV_CLI_CONTROL_MAX_CONNECTION_COUNT (8)
+#define CLV_CLI_CONTROL_LINE_CAPACITY (1024)
+/// Output that a connection has not read yet, before it is closed
+#define CLV_CLI_CONTROL_MAX_PENDING_OCTETS (1024 * 1024)
+
+struct ClvCliEventLoop;
+
+/// The application that the control connections are driving
+typedef struct ClvCliControlHost {
+    void* self;
+    /// Executes a command line and adds the text output to the chain
+    /// Returns negative if the command is unknown and 1 if the application should quit.
+    /// correlationId is set if the command sent a request, zero otherwise.
+    int (*execute)(void* self, const char* line, ClvCliOutChain* output, uint64_t* correlationId);
+} ClvCliControlHost;
+
+typedef struct ClvCliControlConnection {
+    int handle; // negative when not connected, non-blocking
+    ClvCliJsonWriter json;
+    uint8_t* pending; // output that the socket did not take, CLV_CLI_CONTROL_MAX_PENDING_OCTETS
+    size_t pendingStart;
+    size_t pendingCount; // from pendingStart
+    bool isWaitingForWrite;
+    bool isOverflowing; // the pending output did not fit, closed on the next flush
+    bool hasFailed; // closed on the next flush
+    char line[CLV_CLI_CONTROL_LINE_CAPACITY];
+    size_t lineLength;
+    bool isDiscardingLine; // the line did not fit, skipped until the next newline
+} ClvCliControlConnection;
+
+/// Local Unix domain socket that accepts the same commands as the prompt
+/// Each line is a request id followed by a command line. The command output is sent back as
+/// a JSON Lines `response` object with the id, and with the correlation id of the conclave
+/// request that the command sent, which is also in its `requestDone` event. Every event from
+/// the network thread is sent to all connections in the same format as `--json`. Many requests
+/// can be sent without waiting for the responses. The output is never waited for, a connection
+/// that does not read it is closed.
+typedef struct ClvCliControl {
+    int listenHandle;
+    const char* path;
+    ClvCliControlConnection connections[CLV_CLI_CONTROL_MAX_CONNECTION_COUNT];
+    size_t connectionCount;
+    ClvCliOutChain output; // of the request that is executed
+    struct ClvCliEventLoop* eventLoop; // zero when polling
+    Clog log;
+} ClvCliControl;
+
+int clvCliControlInit(ClvCliControl* self, const char* path, Clog log);
+void clvCliControlDestroy(ClvCliControl* self);
+int clvCliControlAddToEventLoop(ClvCliControl* self, struct ClvCliEventLoop* eventLoop);
+int clvCliControlUpdate(ClvCliControl* self, const ClvCliControlHost* host);
+void clvCliControlWriteEvent(ClvCliControl* self, const ClvCliEvent* event);
+void clvCliControlFlush(ClvCliControl* self);
+
+#endif
@@ -0,0 +1,13 @@
+/*----------------------------------------------------------------------------------------------------------
+ *  Copyright (c) Peter Bjorklund. All rights reserved. https://github.com/piot/conclave-client-cli
+ *  Licensed under the MIT License. See LICENSE in the project root for license information.
+ *--------------------------------------------------------------------------------------------------------*/
+#ifndef CONCLAVE_CLIENT_CLI_EVENT_JSON_H
+#define CONCLAVE_CLIENT_CLI_EVENT_JSON_H
+
+#include <conclave-client-cli/json_writer.h>
+#include <conclave-client-cli/network.h>
+
+void clvCliEventJsonWrite(ClvCliJsonWriter* writer, const ClvCliEvent* event);
+
+#endif
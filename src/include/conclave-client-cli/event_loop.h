@@ -0,0 +1,66 @@
+/*----------------------------------------------------------------------------------------------------------
+ *  Copyright (c) Peter Bjorklund. All rights reserved. https://github.com/piot/conclave-client-cli
+ *  Licensed under the MIT License. See LICENSE in the project root for license information.
+ *--------------------------------------------------------------------------------------------------------*/
+#ifndef CONCLAVE_CLIENT_CLI_EVENT_LOOP_H
+#define CONCLAVE_CLIENT_CLI_EVENT_LOOP_H
+
+#include <conclave-client-cli/clock.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+typedef enum ClvCliEventLoopSource {
+    ClvCliEventLoopSourceSocket = 0x01,
+    ClvCliEventLoopSourceInput = 0x02,
+    ClvCliEventLoopSourceTimer = 0x04,
+    ClvCliEventLoopSourceWakeup = 0x08,
+    ClvCliEventLoopSourceControl = 0x10,
+} ClvCliEventLoopSource;
+
+#define CLV_CLI_EVENT_LOOP_MAX_READY (256)
+
+/// From clvCliEventLoopAdd() for a handle that epoll can not wait for, e.g. a regular file
+#define CLV_CLI_EVENT_LOOP_NOT_WAITABLE (-2)
+
+typedef struct ClvCliEventLoop {
+    int epollHandle;
+    int timerHandle;
+    uint32_t readySocketIndices[CLV_CLI_EVENT_LOOP_MAX_READY];
+    size_t readySocketCount;
+} ClvCliEventLoop;
+
+int clvCliEventLoopInit(ClvCliEventLoop* self);
+void clvCliEventLoopDestroy(ClvCliEventLoop* self);
+int clvCliEventLoopAdd(
+    ClvCliEventLoop* self, int handle, ClvCliEventLoopSource source, uint32_t userIndex);
+int clvCliEventLoopWaitForWrite(ClvCliEventLoop* self, int handle, ClvCliEventLoopSource source,
+    uint32_t userIndex, bool isWaitingForWrite);
+int clvCliEventLoopArmTimer(ClvCliEventLoop* self, size_t milliseconds);
+int clvCliEventLoopWait(ClvCliEventLoop* self);
+
+int clvCliWakeupCreate(void);
+void clvCliWakeupDestroy(int handle);
+void clvCliWakeupSignal(int handle);
+void clvCliWakeupClear(int handle);
+
+int clvCliSocketEnableArrivalTime(int handle);
+bool clvCliSocketArrivalTime(int handle, ClvCliTimeNs* arrivedAt);
+
+/// Wakes of a loop, and the time from the kernel receiving each datagram until it was handled
+typedef struct ClvCliWakeLatency {
+    size_t wakeCount;
+    size_t handledCount; // datagrams
+    ClvCliTimeNs sum;
+    ClvCliTimeNs min;
+    ClvCliTimeNs max;
+    ClvCliTimeNs startedAt;
+} ClvCliWakeLatency;
+
+void clvCliWakeLatencyInit(ClvCliWakeLatency* self, ClvCliTimeNs now);
+void clvCliWakeLatencyAdd(
+    ClvCliWakeLatency* self, ClvCliTimeNs arrivedAt, ClvCliTimeNs handledAt);
+int clvCliWakeLatencyFormat(const ClvCliWakeLatency* self, const char* description,
+    ClvCliTimeNs now, char* target, size_t maxOctetCount);
+void clvCliWakeLatencyReport(ClvCliWakeLatency* self, const char* description, ClvCliTimeNs now);
+
+#endif
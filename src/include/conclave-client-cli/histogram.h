@@ -0,0 +1,35 @@
+/*----------------------------------------------------------------------------------------------------------
+ *  Copyright (c) Peter Bjorklund. All rights reserved. https://github.com/piot/conclave-client-cli
+ *  Licensed under the MIT License. See LICENSE in the project root for license information.
+ *--------------------------------------------------------------------------------------------------------*/
+#ifndef CONCLAVE_CLIENT_CLI_HISTOGRAM_H
+#define CONCLAVE_CLIENT_CLI_HISTOGRAM_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define CLV_CLI_HISTOGRAM_SUB_BUCKET_BITS (6)
+#define CLV_CLI_HISTOGRAM_SUB_BUCKET_COUNT (1 << CLV_CLI_HISTOGRAM_SUB_BUCKET_BITS)
+#define CLV_CLI_HISTOGRAM_MAGNITUDE_COUNT (40)
+#define CLV_CLI_HISTOGRAM_BUCKET_COUNT                                                             \
+    (CLV_CLI_HISTOGRAM_SUB_BUCKET_COUNT                                                            \
+        + CLV_CLI_HISTOGRAM_MAGNITUDE_COUNT * (CLV_CLI_HISTOGRAM_SUB_BUCKET_COUNT / 2))
+
+/// Log-bucketed histogram in the style of HdrHistogram
+/// Each power of two is split into linear sub buckets, so every recorded value is kept with
+/// a relative error of less than 1/32, using a fixed amount of memory.
+typedef struct ClvCliHistogram {
+    uint64_t counts[CLV_CLI_HISTOGRAM_BUCKET_COUNT];
+    uint64_t count;
+    uint64_t sum;
+    uint64_t min;
+    uint64_t max;
+} ClvCliHistogram;
+
+void clvCliHistogramInit(ClvCliHistogram* self);
+void clvCliHistogramAdd(ClvCliHistogram* self, uint64_t value);
+void clvCliHistogramMerge(ClvCliHistogram* self, const ClvCliHistogram* other);
+uint64_t clvCliHistogramPercentile(const ClvCliHistogram* self, double percentile);
+uint64_t clvCliHistogramMean(const ClvCliHistogram* self);
+
+#endif
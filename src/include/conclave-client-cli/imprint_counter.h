@@ -0,0 +1,61 @@
+/*----------------------------------------------------------------------------------------------------------
+ *  Copyright (c) Peter Bjorklund. All rights reserved. https://github.com/piot/conclave-client-cli
+ *  Licensed under the MIT License. See LICENSE in the project root for license information.
+ *--------------------------------------------------------------------------------------------------------*/
+#ifndef CONCLAVE_CLIENT_CLI_IMPRINT_COUNTER_H
+#define CONCLAVE_CLIENT_CLI_IMPRINT_COUNTER_H
+
+#include <imprint/allocator.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/// Power of two size classes, from 8 octets up to 256 KiB and larger
+#define CLV_CLI_IMPRINT_SIZE_CLASS_COUNT (16)
+#define CLV_CLI_IMPRINT_SMALLEST_SIZE_CLASS_SHIFT (3)
+
+typedef struct ClvCliImprintSizeClass {
+    uint64_t allocationCount;
+    uint64_t freeCount;
+    size_t liveCount;
+    size_t peakLiveCount;
+} ClvCliImprintSizeClass;
+
+/// Allocations through one or more counters
+/// When merged, the peaks are the sum of the peaks of each counter, so an upper bound.
+typedef struct ClvCliImprintReport {
+    size_t clientCount; // conclave clients that share the budget
+    size_t budgetOctets;
+    uint64_t allocationCount;
+    uint64_t freeCount;
+    uint64_t failedCount; // the allocator returned NULL
+    uint64_t untrackedFreeCount; // pointers that were not allocated through the counter
+    size_t requestedOctets; // live, as asked for
+    size_t liveOctets; // live, rounded up to the size class
+    size_t peakLiveOctets;
+    ClvCliImprintSizeClass sizeClasses[CLV_CLI_IMPRINT_SIZE_CLASS_COUNT];
+} ClvCliImprintReport;
+
+/// An allocator that counts the allocations of the conclave clients and passes them on
+/// The conclave clients are given the counter instead of the slab allocator of the imprint setup,
+/// so the allocations per size class, the live octets and the high-water mark can be shown. The
+/// size of each live allocation is kept in an open addressing table on the pointer, since a free
+/// only has the pointer. Only used by the thread that owns the clients.
+typedef struct ClvCliImprintCounter {
+    ImprintAllocatorWithFree info; // handed to the clients
+    ImprintAllocatorWithFree* target;
+    uintptr_t* pointers; // zero if the slot is free
+    uint32_t* sizes;
+    size_t capacity; // power of two
+    size_t count;
+    ClvCliImprintReport report;
+} ClvCliImprintCounter;
+
+int clvCliImprintCounterInit(ClvCliImprintCounter* self, ImprintAllocatorWithFree* target,
+    size_t budgetOctets, size_t clientCount);
+void clvCliImprintCounterDestroy(ClvCliImprintCounter* self);
+
+void clvCliImprintReportInit(ClvCliImprintReport* self);
+void clvCliImprintReportMerge(ClvCliImprintReport* self, const ClvCliImprintReport* other);
+size_t clvCliImprintSizeClassOctets(size_t sizeClass);
+
+#endif
@@ -0,0 +1,53 @@
+/*----------------------------------------------------------------------------------------------------------
+ *  Copyright (c) Peter Bjorklund. All rights reserved. https://github.com/piot/conclave-client-cli
+ *  Licensed under the MIT License. See LICENSE in the project root for license information.
+ *--------------------------------------------------------------------------------------------------------*/
+#ifndef CONCLAVE_CLIENT_CLI_IN_FLIGHT_H
+#define CONCLAVE_CLIENT_CLI_IN_FLIGHT_H
+
+#include <conclave-client-cli/clock.h>
+#include <conclave-client-cli/histogram.h>
+#include <conclave-client-cli/request_latency.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define CLV_CLI_IN_FLIGHT_CAPACITY (4096)
+
+/// A request issued from the REPL, identified by its correlation id
+typedef struct ClvCliInFlightRequest {
+    uint64_t correlationId;
+    ClvCliTimeNs issuedAt;
+    ClvCliTimeNs latency; // valid when done
+    uint8_t type; // ClvCliRequestType
+    bool isDone;
+    bool isLost; // done without a response
+} ClvCliInFlightRequest;
+
+/// The requests issued from the REPL thread, in correlation id order
+/// The correlation id is the command sequence number, so it increases with every request and
+/// a request can be found with a binary search. The most recent requests are remembered after
+/// they are done, so their latency can be shown by `await`. A request that is too old to be
+/// remembered is considered done.
+typedef struct ClvCliInFlight {
+    ClvCliInFlightRequest requests[CLV_CLI_IN_FLIGHT_CAPACITY];
+    size_t readIndex;
+    size_t count;
+    size_t pendingCount;
+    uint64_t forgottenCount; // pushed out while still pending
+    uint64_t lostCount; // not answered within the timeout of the network thread
+    uint64_t lastCorrelationId;
+    ClvCliHistogram latencies[ClvCliRequestTypeCount]; // microseconds
+} ClvCliInFlight;
+
+void clvCliInFlightInit(ClvCliInFlight* self);
+void clvCliInFlightIssued(
+    ClvCliInFlight* self, uint64_t correlationId, ClvCliRequestType type, ClvCliTimeNs now);
+void clvCliInFlightDone(ClvCliInFlight* self, uint64_t correlationId, ClvCliTimeNs latency);
+void clvCliInFlightLost(ClvCliInFlight* self, uint64_t correlationId);
+void clvCliInFlightDoneUpTo(
+    ClvCliInFlight* self, ClvCliRequestType type, uint64_t correlationId, ClvCliTimeNs now);
+const ClvCliInFlightRequest* clvCliInFlightFind(const ClvCliInFlight* self, uint64_t correlationId);
+bool clvCliInFlightIsDone(const ClvCliInFlight* self, uint64_t correlationId);
+
+#endif
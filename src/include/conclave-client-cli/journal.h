@@ -0,0 +1,53 @@
+/*----------------------------------------------------------------------------------------------------------
+ *  Copyright (c) Peter Bjorklund. All rights reserved. https://github.com/piot/conclave-client-cli
+ *  Licensed under the MIT License. See LICENSE in the project root for license information.
+ *--------------------------------------------------------------------------------------------------------*/
+#ifndef CONCLAVE_CLIENT_CLI_JOURNAL_H
+#define CONCLAVE_CLIENT_CLI_JOURNAL_H
+
+#include <conclave-client-cli/clock.h>
+#include <conclave-serialize/types.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define CLV_CLI_JOURNAL_CHUNK_ENTRY_COUNT (4096)
+#define CLV_CLI_JOURNAL_MAX_CHUNK_COUNT (256)
+
+typedef enum ClvCliJournalEntryType {
+    ClvCliJournalEntryTypePingResponse,
+    ClvCliJournalEntryTypeRoomCreated,
+    ClvCliJournalEntryTypeRoomList,
+} ClvCliJournalEntryType;
+
+/// A response as it was when the client had handled exactly that datagram
+typedef struct ClvCliJournalEntry {
+    ClvCliTimeNs time;
+    uint8_t type; // ClvCliJournalEntryType
+    uint8_t version; // the version counter of the client after the response
+    uint8_t count; // members in the room, or rooms in the list
+    uint8_t index; // owner in the room, or connection index of a created room
+    ClvSerializeRoomId roomId;
+    ClvSerializeTerm term;
+    uint64_t roomVersion;
+} ClvCliJournalEntry;
+
+/// Append-only log of every conclave response
+/// Written by the network thread only. Entries are never changed or moved after they have been
+/// added, so other threads can read every entry below clvCliJournalCount() without locking.
+/// Sequence numbers start at one, so the last sequence number is the count.
+typedef struct ClvCliJournal {
+    ClvCliJournalEntry* chunks[CLV_CLI_JOURNAL_MAX_CHUNK_COUNT];
+    size_t chunkCount;
+    uint64_t count; // atomic, written by the network thread
+    uint64_t droppedCount; // entries that did not fit
+} ClvCliJournal;
+
+void clvCliJournalInit(ClvCliJournal* self);
+void clvCliJournalDestroy(ClvCliJournal* self);
+ClvCliJournalEntry* clvCliJournalAppendBegin(ClvCliJournal* self);
+uint64_t clvCliJournalAppendEnd(ClvCliJournal* self);
+uint64_t clvCliJournalCount(const ClvCliJournal* self);
+const ClvCliJournalEntry* clvCliJournalGet(const ClvCliJournal* self, uint64_t sequence);
+
+#endif
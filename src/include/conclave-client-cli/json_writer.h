@@ -0,0 +1,56 @@
+/*----------------------------------------------------------------------------------------------------------
+ *  Copyright (c) Peter Bjorklund. All rights reserved. https://github.com/piot/conclave-client-cli
+ *  Licensed under the MIT License. See LICENSE in the project root for license information.
+ *--------------------------------------------------------------------------------------------------------*/
+#ifndef CONCLAVE_CLIENT_CLI_JSON_WRITER_H
+#define CONCLAVE_CLIENT_CLI_JSON_WRITER_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#define CLV_CLI_JSON_WRITER_CAPACITY (64 * 1024)
+#define CLV_CLI_JSON_WRITER_MAX_DEPTH (8)
+
+/// Takes the buffered lines when the writer does not write to a file
+typedef struct ClvCliJsonWriterOutput {
+    void* self;
+    void (*write)(void* self, const char* octets, size_t count);
+} ClvCliJsonWriterOutput;
+
+/// Writes JSON Lines into a buffer that is written to the file in large chunks
+/// Values are formatted directly into the buffer, so thousands of objects per second cost
+/// a few write calls instead of a printf for every field.
+typedef struct ClvCliJsonWriter {
+    char* octets;
+    size_t pos;
+    size_t capacity;
+    FILE* fp; // zero when written to output
+    ClvCliJsonWriterOutput output;
+    size_t depth;
+    bool hasValue[CLV_CLI_JSON_WRITER_MAX_DEPTH]; // a comma is needed before the next value
+    uint64_t lineCount;
+} ClvCliJsonWriter;
+
+int clvCliJsonWriterInit(ClvCliJsonWriter* self, FILE* fp);
+int clvCliJsonWriterInitOutput(ClvCliJsonWriter* self, const ClvCliJsonWriterOutput* output);
+void clvCliJsonWriterDestroy(ClvCliJsonWriter* self);
+void clvCliJsonWriterFlush(ClvCliJsonWriter* self);
+
+void clvCliJsonWriterObjectBegin(ClvCliJsonWriter* self, const char* key);
+void clvCliJsonWriterObjectEnd(ClvCliJsonWriter* self);
+void clvCliJsonWriterArrayBegin(ClvCliJsonWriter* self, const char* key);
+void clvCliJsonWriterArrayEnd(ClvCliJsonWriter* self);
+void clvCliJsonWriterLineEnd(ClvCliJsonWriter* self);
+
+void clvCliJsonWriterString(ClvCliJsonWriter* self, const char* key, const char* value);
+void clvCliJsonWriterStringBegin(ClvCliJsonWriter* self, const char* key);
+void clvCliJsonWriterStringAppend(ClvCliJsonWriter* self, const char* octets, size_t count);
+void clvCliJsonWriterStringEnd(ClvCliJsonWriter* self);
+void clvCliJsonWriterUInt64(ClvCliJsonWriter* self, const char* key, uint64_t value);
+void clvCliJsonWriterInt64(ClvCliJsonWriter* self, const char* key, int64_t value);
+void clvCliJsonWriterDouble(ClvCliJsonWriter* self, const char* key, double value);
+void clvCliJsonWriterBool(ClvCliJsonWriter* self, const char* key, bool value);
+
+#endif
@@ -0,0 +1,84 @@
+/*----------------------------------------------------------------------------------------------------------
+ *  Copyright (c) Peter Bjorklund. All rights reserved. https://github.com/piot/conclave-client-cli
+ *  Licensed under the MIT License. See LICENSE in the project root for license information.
+ *--------------------------------------------------------------------------------------------------------*/
+#ifndef CONCLAVE_CLIENT_CLI_LOAD_H
+#define CONCLAVE_CLIENT_CLI_LOAD_H
+
+#include <conclave-client-cli/clock.h>
+#include <conclave-client-cli/histogram.h>
+#include <conclave-client-cli/request_latency.h>
+#include <conclave-serialize/types.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define CLV_CLI_LOAD_WHEEL_SLOT_COUNT (1024)
+#define CLV_CLI_LOAD_MAX_OUTSTANDING (8)
+#define CLV_CLI_LOAD_NO_CLIENT (UINT32_MAX)
+
+typedef struct ClvCliLoadOptions {
+    ClvCliRequestType type; // ping, room join or room list
+    double ratePerClient; // requests per second
+    uint64_t durationMs; // zero to run until stopped
+    ClvSerializeRoomJoinOptions roomJoin;
+    ClvSerializeListRoomsOptions roomList;
+} ClvCliLoadOptions;
+
+/// Outcome of a load run, can be merged from many generators
+typedef struct ClvCliLoadReport {
+    ClvCliRequestType type;
+    double targetRate; // requests per second for all clients
+    ClvCliTimeNs elapsed;
+    uint64_t intendedCount;
+    uint64_t sentCount;
+    uint64_t receivedCount;
+    uint64_t skippedCount; // too many requests without a response
+    ClvCliHistogram latencies; // microseconds from the intended send time
+} ClvCliLoadReport;
+
+/// Intended send times of the requests from one client that have not been answered yet
+typedef struct ClvCliLoadOutstanding {
+    ClvCliTimeNs intendedAt[CLV_CLI_LOAD_MAX_OUTSTANDING];
+    uint8_t readIndex;
+    uint8_t count;
+} ClvCliLoadOutstanding;
+
+/// Sends a request from a client, returns false if the client can not send
+typedef bool (*ClvCliLoadSendFn)(void* self, size_t clientIndex, const ClvCliLoadOptions* options);
+
+/// Open loop load generator
+/// Sends are scheduled on a timer wheel with millisecond slots, at fixed intervals from the
+/// start time, no matter how long the responses take. Latency is measured from the time a
+/// request should have been sent, so a slow server can not hide behind delayed sends
+/// (coordinated omission).
+typedef struct ClvCliLoad {
+    size_t clientCount;
+    ClvCliLoadOptions options;
+    bool isSending;
+    ClvCliTimeNs interval;
+    ClvCliTimeNs startedAt;
+    ClvCliTimeNs stoppedAt;
+    ClvCliTimeNs* dueAt; // intended time of the next send for each client
+    uint32_t* nextInSlot; // linked list of clients in each wheel slot
+    uint32_t slotHeads[CLV_CLI_LOAD_WHEEL_SLOT_COUNT];
+    uint64_t lastTick; // all slots up to and including this tick have been handled
+    ClvCliLoadOutstanding* outstanding;
+    ClvCliLoadReport report;
+} ClvCliLoad;
+
+int clvCliLoadInit(ClvCliLoad* self, size_t clientCount);
+void clvCliLoadDestroy(ClvCliLoad* self);
+void clvCliLoadStart(ClvCliLoad* self, const ClvCliLoadOptions* options, ClvCliTimeNs now);
+void clvCliLoadStop(ClvCliLoad* self, ClvCliTimeNs now);
+void clvCliLoadUpdate(ClvCliLoad* self, ClvCliTimeNs now, ClvCliLoadSendFn send, void* sendSelf);
+bool clvCliLoadIsMeasuring(const ClvCliLoad* self, ClvCliRequestType type);
+void clvCliLoadReceived(ClvCliLoad* self, size_t clientIndex, ClvCliTimeNs now);
+size_t clvCliLoadTimeUntilUpdate(const ClvCliLoad* self, ClvCliTimeNs now);
+void clvCliLoadReportGet(const ClvCliLoad* self, ClvCliLoadReport* report, ClvCliTimeNs now);
+size_t clvCliLoadBytesPerClient(void);
+
+void clvCliLoadReportInit(ClvCliLoadReport* self);
+void clvCliLoadReportMerge(ClvCliLoadReport* self, const ClvCliLoadReport* other);
+
+#endif
@@ -0,0 +1,192 @@
+/*----------------------------------------------------------------------------------------------------------
+ *  Copyright (c) Peter Bjorklund. All rights reserved. https://github.com/piot/conclave-client-cli
+ *  Licensed under the MIT License. See LICENSE in the project root for license information.
+ *--------------------------------------------------------------------------------------------------------*/
+#ifndef CONCLAVE_CLIENT_CLI_NETWORK_H
+#define CONCLAVE_CLIENT_CLI_NETWORK_H
+
+#include <clog/clog.h>
+#include <conclave-client-cli/command.h>
+#include <conclave-client-cli/event_loop.h>
+#include <conclave-client-cli/imprint_counter.h>
+#include <conclave-client-cli/journal.h>
+#include <conclave-client-cli/owner_convergence.h>
+#include <conclave-client-cli/perf.h>
+#include <conclave-client-cli/request_latency.h>
+#include <conclave-client-cli/spsc_ring.h>
+#include <conclave-client-cli/swarm_shards.h>
+#include <conclave-client-cli/trace.h>
+#include <conclave-client/client.h>
+#include <guise-client-udp/client.h>
+#include <guise-client-udp/read_secret.h>
+#include <imprint/default_setup.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <udp-client/udp_client.h>
+
+typedef struct ClvCliNetworkOptions {
+    size_t secretIndex;
+    const char* host;
+    uint16_t guisePort;
+    uint16_t conclavePort;
+    size_t swarmCount;
+    size_t shardCount; // zero for one shard for each core that the shards can run on
+    bool shouldPinShards;
+    bool usePolling;
+    bool reportLatency;
+    size_t resendIntervalMs; // longest time between client updates when nothing is received
+    ClvCliTimeNs frameBudget; // zero to never warn about slow frames
+    size_t imprintOctetsPerClient; // zero for the default
+    ClvCliTrace* trace; // zero when not tracing
+} ClvCliNetworkOptions;
+
+typedef enum ClvCliEventType {
+    ClvCliEventTypePingResponse,
+    ClvCliEventTypeRoomCreated,
+    ClvCliEventTypeRoomList,
+    ClvCliEventTypeState,
+    ClvCliEventTypeStats,
+    ClvCliEventTypeStatus,
+    ClvCliEventTypeWakeLatency,
+    ClvCliEventTypeLoadReport,
+    ClvCliEventTypePerf,
+    ClvCliEventTypeFrameOverBudget,
+    ClvCliEventTypeRequestDone,
+    ClvCliEventTypeChurnReport,
+    ClvCliEventTypeSimulateReport,
+    ClvCliEventTypeMemReport,
+} ClvCliEventType;
+
+/// What the REPL thread needs to know to decide if a script `wait` is done
+typedef struct ClvCliNetworkStatus {
+    uint64_t commandSequence; // the last command that has been executed
+    bool hasStartedConclave;
+    bool isLoggedIn;
+    uint8_t pendingMask; // bit for each ClvCliRequestType with requests in flight
+} ClvCliNetworkStatus;
+
+typedef struct ClvCliNetworkState {
+    bool hasStartedConclave;
+    uint8_t clientState; // ClvClientState
+    size_t swarmClientCount;
+    size_t swarmPhaseCounts[3];
+    size_t pingResponseCount;
+    size_t roomCreateCount;
+    size_t roomListCount;
+} ClvCliNetworkState;
+
+typedef struct ClvCliNetworkStats {
+    size_t swarmClientCount;
+    ClvCliHistogram histograms[ClvCliRequestTypeCount];
+    size_t unmatchedCount;
+    size_t lostCount; // requests that were not answered within the timeout
+    uint64_t journalCount;
+    uint64_t journalDroppedCount;
+    uint64_t coalescedCount; // responses that were overwritten before they were seen
+    size_t droppedEventCount; // the REPL thread did not keep up
+    ClvCliOwnerConvergenceReport ownerConvergence; // swarm only
+} ClvCliNetworkStats;
+
+/// Published by the network thread, consumed by the REPL thread
+/// Large payloads are allocated by the network thread and freed with tc_free() by the consumer.
+typedef struct ClvCliEvent {
+    ClvCliEventType type;
+    ClvCliTimeNs time;
+    uint64_t journalSequence; // responses only, zero otherwise
+    union {
+        ClvSerializePingResponseOptions pingResponse;
+        struct {
+            ClvSerializeRoomId roomId;
+            ClvSerializeRoomConnectionIndex roomConnectionIndex;
+        } roomCreated;
+        ClvSerializeListRoomsResponseOptions* roomList;
+        ClvCliNetworkState state;
+        ClvCliNetworkStats* stats;
+        ClvCliNetworkStatus status;
+        ClvCliWakeLatency wakeLatency;
+        ClvCliLoadReport* loadReport;
+        ClvCliChurnReport* churnReport;
+        ClvCliSimulateReport* simulateReport;
+        ClvCliImprintReport* memReport;
+        ClvCliPerfReport* perf;
+        ClvCliPerfWarning frameOverBudget;
+        struct {
+            uint64_t correlationId; // sequence of the command that sent the request
+            ClvCliTimeNs roundTrip; // time until it was lost, for lost requests
+            uint8_t type; // ClvCliRequestType
+            bool isLost; // not answered within the timeout
+        } requestDone;
+    } data;
+} ClvCliEvent;
+
+#define CLV_CLI_NETWORK_MAX_ARRIVALS (64)
+
+/// Owns the guise and conclave clients (or the swarm) and updates them on a thread of its own,
+/// so that terminal output never delays the network handling
+typedef struct ClvCliNetwork {
+    ClvCliNetworkOptions options;
+    GuiseClientUdpSecret guiseSecret;
+    GuiseClientUdp guiseClient;
+    UdpClientSocket conclaveSocket;
+    ClvClient conclaveClient; // reads and writes conclaveSocket through the network
+    ClvCliSwarmShards swarm;
+    ClvCliSwarmReport swarmReport; // merged from the shards once a second
+    ClvCliOwnerConvergence ownerConvergence; // swarm only
+    MonotonicTimeMs lastSwarmMergeAt;
+    uint64_t lastForwardedCommandSequence;
+    bool hasStartedConclave;
+    bool hasAddedConclaveToEventLoop;
+    uint8_t lastPublishedPingResponseVersion;
+    uint8_t lastPublishedRoomCreateVersion;
+    uint8_t lastPublishedRoomListVersion;
+    ImprintDefaultSetup imprint;
+    ClvCliImprintCounter imprintCounter; // when not in swarm mode
+    ClvCliRequestLatency requestLatency;
+    ClvCliWakeLatency wakeLatency;
+    ClvCliTimeNs arrivals[CLV_CLI_NETWORK_MAX_ARRIVALS]; // of the datagrams since the frame began
+    size_t arrivalCount;
+    ClvCliPerf perf; // frames of the network thread
+    ClvCliLoad load; // when not in swarm mode
+    ClvCliJournal journal; // when not in swarm mode
+    uint64_t coalescedCount;
+    bool isLoadReportPending;
+    bool isWatchingRooms; // lists the rooms at an interval, when not in swarm mode
+    ClvSerializeListRoomsOptions roomWatch;
+    MonotonicTimeMs roomWatchIntervalMs;
+    MonotonicTimeMs nextRoomWatchAt;
+    MonotonicTimeMs loadReportAt;
+
+    ClvCliEventLoop eventLoop;
+    bool hasEventLoop;
+    int commandWakeupHandle; // also signalled by the swarm shards
+    int eventWakeupHandle;
+    ClvCliSpscRing commands;
+    ClvCliSpscRing events;
+    uint64_t lastExecutedCommandSequence;
+    uint64_t nextCommandSequence; // only used by the REPL thread
+    ClvCliNetworkStatus lastPublishedStatus;
+    size_t droppedEventCount;
+
+    int shouldQuit;
+    int hasStopped; // set by the network thread when it returns, after stoppedResult
+    int stoppedResult;
+    pthread_t thread;
+    ClvCliTraceRing* traceRing; // of the network thread
+    Clog conclaveClientLog;
+    Clog log;
+} ClvCliNetwork;
+
+int clvCliNetworkInit(ClvCliNetwork* self, const ClvCliNetworkOptions* options, Clog log);
+void clvCliNetworkDestroy(ClvCliNetwork* self);
+int clvCliNetworkStart(ClvCliNetwork* self);
+void clvCliNetworkStop(ClvCliNetwork* self);
+
+ClvCliCommand* clvCliNetworkCommandBegin(ClvCliNetwork* self, ClvCliCommandType type);
+uint64_t clvCliNetworkCommandEnd(ClvCliNetwork* self);
+const ClvCliEvent* clvCliNetworkEventBegin(ClvCliNetwork* self);
+void clvCliNetworkEventEnd(ClvCliNetwork* self);
+void clvCliEventFreePayload(const ClvCliEvent* event);
+int clvCliNetworkEventWakeupHandle(const ClvCliNetwork* self);
+bool clvCliNetworkHasStopped(const ClvCliNetwork* self, int* result);
+
+#endif
@@ -0,0 +1,45 @@
+/*----------------------------------------------------------------------------------------------------------
+ *  Copyright (c) Peter Bjorklund. All rights reserved. https://github.com/piot/conclave-client-cli
+ *  Licensed under the MIT License. See LICENSE in the project root for license information.
+ *--------------------------------------------------------------------------------------------------------*/
+#ifndef CONCLAVE_CLIENT_CLI_OUT_CHAIN_H
+#define CONCLAVE_CLIENT_CLI_OUT_CHAIN_H
+
+#include <flood/out_stream.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+/// Chunks double from 4 KiB up to 1 MiB, and are then added 1 MiB at a time
+#define CLV_CLI_OUT_CHAIN_FIRST_CHUNK_OCTETS (4 * 1024)
+#define CLV_CLI_OUT_CHAIN_MAX_CHUNK_OCTETS (1024 * 1024)
+
+typedef struct ClvCliOutChunk {
+    struct ClvCliOutChunk* next;
+    uint8_t* octets;
+    size_t capacity;
+    size_t count; // octets of the current output
+} ClvCliOutChunk;
+
+/// Growable output of a command, as a chain of chunks that is reused from one command to the next
+/// Clash writes to a FldOutStream, which is one contiguous buffer. A stream is reserved on the
+/// free end of a chunk and committed when written, and the next stream continues in the same or
+/// a following chunk, so the written output is never moved or copied. An output is cleared by
+/// rewinding the chunks, which are kept for the next output.
+typedef struct ClvCliOutChain {
+    ClvCliOutChunk* first;
+    ClvCliOutChunk* current; // zero before anything has been reserved
+    size_t chunkCount;
+    size_t octetCount; // of the current output
+    size_t peakOctets; // largest output
+} ClvCliOutChain;
+
+void clvCliOutChainInit(ClvCliOutChain* self);
+void clvCliOutChainDestroy(ClvCliOutChain* self);
+void clvCliOutChainClear(ClvCliOutChain* self);
+int clvCliOutChainReserve(ClvCliOutChain* self, FldOutStream* stream, size_t minimumOctets);
+void clvCliOutChainCommit(ClvCliOutChain* self, const FldOutStream* stream);
+void clvCliOutChainWrite(const ClvCliOutChain* self, FILE* fp);
+size_t clvCliOutChainCapacity(const ClvCliOutChain* self);
+
+#endif
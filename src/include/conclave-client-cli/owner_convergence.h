@@ -0,0 +1,69 @@
+/*----------------------------------------------------------------------------------------------------------
+ *  Copyright (c) Peter Bjorklund. All rights reserved. https://github.com/piot/conclave-client-cli
+ *  Licensed under the MIT License. See LICENSE in the project root for license information.
+ *--------------------------------------------------------------------------------------------------------*/
+#ifndef CONCLAVE_CLIENT_CLI_OWNER_CONVERGENCE_H
+#define CONCLAVE_CLIENT_CLI_OWNER_CONVERGENCE_H
+
+#include <conclave-client-cli/clock.h>
+#include <conclave-client-cli/histogram.h>
+#include <conclave-serialize/types.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define CLV_CLI_OWNER_CONVERGENCE_ROOM_CAPACITY (8192)
+
+/// A swarm client has seen a new term or owner for its room in a ping response
+typedef struct ClvCliOwnerObservation {
+    ClvCliTimeNs time;
+    ClvSerializeTerm term;
+    ClvSerializeUserId owner;
+    ClvSerializeRoomId roomId;
+    uint8_t memberCount;
+} ClvCliOwnerObservation;
+
+/// The latest term and owner of a room, and how many of its members have seen them
+typedef struct ClvCliOwnerConvergenceRoom {
+    ClvSerializeRoomId roomId; // zero if the slot is free
+    ClvSerializeTerm term;
+    ClvSerializeUserId owner;
+    ClvCliTimeNs firstSeenAt; // earliest observation of the term and owner
+    ClvCliTimeNs lastSeenAt; // latest observation of the term and owner
+    uint8_t memberCount;
+    uint8_t observedCount;
+    bool isMigration; // the room had another term or owner before
+    bool isConverged;
+} ClvCliOwnerConvergenceRoom;
+
+typedef struct ClvCliOwnerConvergenceReport {
+    size_t roomCount;
+    uint64_t migrationCount;
+    uint64_t convergedCount;
+    uint64_t supersededCount; // a newer term or owner was seen before all members agreed
+    uint64_t staleCount; // observations of an older term
+    uint64_t droppedCount; // observations that did not fit, in the shards or in the room table
+    size_t pendingCount; // migrations that not all members have seen yet
+    ClvCliHistogram convergenceLatencies; // microseconds from first seen until all members agree
+} ClvCliOwnerConvergenceReport;
+
+/// Owner migration convergence across the swarm clients in each room
+/// The clients of a room can be in different shards, so each shard passes on the changes that its
+/// clients see, and they are combined here in the coordinator thread. The convergence time of a
+/// migration is from the first client seeing the new term or owner until as many clients as the
+/// room has members have seen the same. The shards are drained one at a time, so observations
+/// are not added in time order, and the earliest and latest time of each term and owner are kept
+/// instead of the time of the first and last observation added.
+typedef struct ClvCliOwnerConvergence {
+    ClvCliOwnerConvergenceRoom* rooms; // open addressing on the room id
+    ClvCliOwnerConvergenceReport report;
+} ClvCliOwnerConvergence;
+
+int clvCliOwnerConvergenceInit(ClvCliOwnerConvergence* self);
+void clvCliOwnerConvergenceDestroy(ClvCliOwnerConvergence* self);
+void clvCliOwnerConvergenceAdd(
+    ClvCliOwnerConvergence* self, const ClvCliOwnerObservation* observation);
+void clvCliOwnerConvergenceReportGet(
+    const ClvCliOwnerConvergence* self, ClvCliOwnerConvergenceReport* report);
+
+#endif
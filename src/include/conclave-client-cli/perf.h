@@ -0,0 +1,87 @@
+/*----------------------------------------------------------------------------------------------------------
+ *  Copyright (c) Peter Bjorklund. All rights reserved. https://github.com/piot/conclave-client-cli
+ *  Licensed under the MIT License. See LICENSE in the project root for license information.
+ *--------------------------------------------------------------------------------------------------------*/
+#ifndef CONCLAVE_CLIENT_CLI_PERF_H
+#define CONCLAVE_CLIENT_CLI_PERF_H
+
+#include <conclave-client-cli/clock.h>
+#include <conclave-client-cli/histogram.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/// Phases of a network thread frame, the time between waking up and waiting again
+typedef enum ClvCliPerfPhase {
+    ClvCliPerfPhaseCommands,
+    ClvCliPerfPhaseGuiseUpdate,
+    ClvCliPerfPhaseConclaveUpdate,
+    ClvCliPerfPhasePublish,
+    ClvCliPerfPhaseLoad,
+    ClvCliPerfPhaseSwarmMerge,
+    ClvCliPerfPhaseCount,
+} ClvCliPerfPhase;
+
+/// Index of the whole frame in the histograms of ClvCliPerfWindow
+#define CLV_CLI_PERF_FRAME (ClvCliPerfPhaseCount)
+
+typedef struct ClvCliPerfMark {
+    ClvCliTimeNs wall;
+    ClvCliTimeNs cpu;
+} ClvCliPerfMark;
+
+/// Wall and thread CPU time spent in each phase during one frame
+typedef struct ClvCliPerfFrame {
+    ClvCliPerfMark startedAt;
+    ClvCliTimeNs wall[ClvCliPerfPhaseCount + 1];
+    ClvCliTimeNs cpu[ClvCliPerfPhaseCount + 1];
+} ClvCliPerfFrame;
+
+/// Microsecond histograms of the frames during a time window
+typedef struct ClvCliPerfWindow {
+    ClvCliHistogram wall[ClvCliPerfPhaseCount + 1];
+    ClvCliHistogram cpu[ClvCliPerfPhaseCount + 1];
+    uint64_t frameCount;
+    uint64_t overBudgetCount;
+} ClvCliPerfWindow;
+
+/// Published when a frame takes longer than the budget
+typedef struct ClvCliPerfWarning {
+    ClvCliPerfFrame frame; // the frame that caused the warning
+    ClvCliTimeNs budget;
+    uint64_t overBudgetCount; // frames over budget since the last warning, including this one
+} ClvCliPerfWarning;
+
+typedef struct ClvCliPerfReport {
+    ClvCliPerfWindow window;
+    ClvCliTimeNs windowDuration; // how far back the histograms go
+    ClvCliTimeNs budget;
+    uint64_t totalFrameCount;
+    uint64_t totalOverBudgetCount;
+} ClvCliPerfReport;
+
+/// Continuous per phase frame timing, for catching updates that start taking milliseconds
+/// The histograms are rolling: two windows are kept and the oldest is cleared when the
+/// current one is full, so a report covers between one and two window lengths.
+typedef struct ClvCliPerf {
+    ClvCliPerfFrame frame;
+    ClvCliPerfWindow* windows; // two
+    size_t currentWindow;
+    ClvCliTimeNs windowStartedAt[2];
+    ClvCliTimeNs budget; // zero to never warn
+    ClvCliTimeNs lastWarningAt;
+    uint64_t overBudgetSinceWarning;
+    uint64_t totalFrameCount;
+    uint64_t totalOverBudgetCount;
+} ClvCliPerf;
+
+int clvCliPerfInit(ClvCliPerf* self, ClvCliTimeNs budget, ClvCliTimeNs now);
+void clvCliPerfDestroy(ClvCliPerf* self);
+ClvCliPerfMark clvCliPerfMarkNow(void);
+void clvCliPerfFrameBegin(ClvCliPerf* self);
+ClvCliTimeNs clvCliPerfPhaseEnd(ClvCliPerf* self, ClvCliPerfPhase phase, ClvCliPerfMark startedAt);
+bool clvCliPerfFrameEnd(ClvCliPerf* self, ClvCliPerfWarning* warning);
+void clvCliPerfReportGet(const ClvCliPerf* self, ClvCliPerfReport* report, ClvCliTimeNs now);
+const char* clvCliPerfPhaseToString(ClvCliPerfPhase phase);
+
+#endif
@@ -0,0 +1,52 @@
+/*----------------------------------------------------------------------------------------------------------
+ *  Copyright (c) Peter Bjorklund. All rights reserved. https://github.com/piot/conclave-client-cli
+ *  Licensed under the MIT License. See LICENSE in the project root for license information.
+ *--------------------------------------------------------------------------------------------------------*/
+#ifndef CONCLAVE_CLIENT_CLI_RENDER_H
+#define CONCLAVE_CLIENT_CLI_RENDER_H
+
+#include <conclave-client-cli/clock.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#define CLV_CLI_RENDER_CAPACITY (256 * 1024)
+#define CLV_CLI_RENDER_MAX_ENTRY_OCTETS (32 * 1024)
+#define CLV_CLI_RENDER_MAX_ENTRY_COUNT (256)
+
+/// The text of one update, and how many identical updates followed it
+typedef struct ClvCliRenderEntry {
+    size_t offset;
+    size_t octetCount;
+    size_t repeatCount;
+} ClvCliRenderEntry;
+
+/// Collects the terminal output of the updates during a frame and writes it all at once
+/// An update that is identical to the one before it is only counted, and shown as "x37" after
+/// the first line. The frames are written at most framesPerSecond times a second, so a flood of
+/// responses costs a few redraws of the prompt instead of one per response.
+typedef struct ClvCliRender {
+    char* octets;
+    size_t pos;
+    ClvCliRenderEntry entries[CLV_CLI_RENDER_MAX_ENTRY_COUNT];
+    size_t entryCount;
+    size_t entryStart; // of the entry that is being written
+    ClvCliTimeNs frameInterval; // zero to write after every batch of updates
+    ClvCliTimeNs lastFlushAt;
+    FILE* fp;
+    uint64_t frameCount;
+    uint64_t coalescedCount;
+} ClvCliRender;
+
+int clvCliRenderInit(ClvCliRender* self, FILE* fp, size_t framesPerSecond);
+void clvCliRenderDestroy(ClvCliRender* self);
+void clvCliRenderEntryBegin(ClvCliRender* self);
+void clvCliRenderWritef(ClvCliRender* self, const char* format, ...);
+void clvCliRenderWrite(ClvCliRender* self, const char* text);
+void clvCliRenderEntryEnd(ClvCliRender* self);
+bool clvCliRenderIsDue(const ClvCliRender* self, ClvCliTimeNs now);
+size_t clvCliRenderTimeUntilDue(const ClvCliRender* self, ClvCliTimeNs now);
+void clvCliRenderFlush(ClvCliRender* self, ClvCliTimeNs now);
+
+#endif
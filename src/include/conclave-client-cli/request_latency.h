@@ -0,0 +1,58 @@
+/*----------------------------------------------------------------------------------------------------------
+ *  Copyright (c) Peter Bjorklund. All rights reserved. https://github.com/piot/conclave-client-cli
+ *  Licensed under the MIT License. See LICENSE in the project root for license information.
+ *--------------------------------------------------------------------------------------------------------*/
+#ifndef CONCLAVE_CLIENT_CLI_REQUEST_LATENCY_H
+#define CONCLAVE_CLIENT_CLI_REQUEST_LATENCY_H
+
+#include <conclave-client-cli/clock.h>
+#include <conclave-client-cli/histogram.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+typedef enum ClvCliRequestType {
+    ClvCliRequestTypePing,
+    ClvCliRequestTypeRoomCreate,
+    ClvCliRequestTypeRoomJoin,
+    ClvCliRequestTypeRoomList,
+    ClvCliRequestTypeCount,
+} ClvCliRequestType;
+
+#define CLV_CLI_REQUEST_LATENCY_MAX_PENDING (256)
+
+/// A request that has not been answered in this time is counted as lost
+#define CLV_CLI_REQUEST_LATENCY_TIMEOUT_MS (5000)
+
+/// Send times of the requests of one type that have not been answered yet
+typedef struct ClvCliPendingRequests {
+    ClvCliTimeNs sentAt[CLV_CLI_REQUEST_LATENCY_MAX_PENDING];
+    uint64_t correlationIds[CLV_CLI_REQUEST_LATENCY_MAX_PENDING];
+    size_t readIndex;
+    size_t count;
+} ClvCliPendingRequests;
+
+/// Round trip times, in microseconds, for each request type
+typedef struct ClvCliRequestLatency {
+    ClvCliPendingRequests pending[ClvCliRequestTypeCount];
+    ClvCliHistogram histograms[ClvCliRequestTypeCount];
+    size_t unmatchedCount;
+    size_t lostCount; // not answered within the timeout
+} ClvCliRequestLatency;
+
+void clvCliRequestLatencyInit(ClvCliRequestLatency* self);
+void clvCliRequestLatencySent(ClvCliRequestLatency* self, ClvCliRequestType type, ClvCliTimeNs now,
+    uint64_t correlationId);
+bool clvCliRequestLatencyIsPending(const ClvCliRequestLatency* self, ClvCliRequestType type);
+uint64_t clvCliRequestLatencyReceived(ClvCliRequestLatency* self, ClvCliRequestType type,
+    ClvCliTimeNs now, ClvCliTimeNs* roundTrip);
+bool clvCliRequestLatencyExpire(ClvCliRequestLatency* self, ClvCliRequestType type,
+    ClvCliTimeNs now, ClvCliTimeNs timeout, uint64_t* correlationId);
+
+const char* clvCliRequestTypeToString(ClvCliRequestType type);
+int clvCliRequestTypeFromString(const char* name, ClvCliRequestType* type);
+int clvCliHistogramFormat(
+    const ClvCliHistogram* histogram, const char* name, char* target, size_t maxOctetCount);
+
+#endif
@@ -0,0 +1,65 @@
+/*----------------------------------------------------------------------------------------------------------
+ *  Copyright (c) Peter Bjorklund. All rights reserved. https://github.com/piot/conclave-client-cli
+ *  Licensed under the MIT License. See LICENSE in the project root for license information.
+ *--------------------------------------------------------------------------------------------------------*/
+#ifndef CONCLAVE_CLIENT_CLI_ROOM_CACHE_H
+#define CONCLAVE_CLIENT_CLI_ROOM_CACHE_H
+
+#include <conclave-client-cli/clock.h>
+#include <conclave-serialize/types.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define CLV_CLI_ROOM_CACHE_CAPACITY (4096)
+
+/// A room from a room list response
+typedef struct ClvCliRoomCacheEntry {
+    ClvSerializeRoomInfo roomInfo;
+    ClvCliTimeNs firstSeenAt;
+    ClvCliTimeNs lastSeenAt; // in the latest room list response that had the room
+} ClvCliRoomCacheEntry;
+
+typedef enum ClvCliRoomCacheIndex {
+    ClvCliRoomCacheIndexRoomId,
+    ClvCliRoomCacheIndexApplicationId, // then room id
+    ClvCliRoomCacheIndexFreeSlots, // most free slots first, then room id
+    ClvCliRoomCacheIndexName, // then room id
+    ClvCliRoomCacheIndexCount,
+} ClvCliRoomCacheIndex;
+
+/// What rooms to find, every part is optional
+typedef struct ClvCliRoomCacheQuery {
+    const char* namePrefix; // NULL or empty for any name
+    bool hasApplicationId;
+    ClvSerializeApplicationId applicationId;
+    uint8_t minimumFreeSlots;
+    ClvCliTimeNs maximumAge; // since last seen, zero for any age
+} ClvCliRoomCacheQuery;
+
+/// The rooms from all room list responses, kept on the REPL thread
+/// A room list response only has some of the rooms, so each response is merged into the cache
+/// instead of replacing it, and every room remembers when it was last seen so stale rooms can be
+/// told apart. Each index is an array of entry indices sorted on its own key, so a room, an
+/// application, a name prefix or the rooms with the most free slots are found with a binary
+/// search. When the cache is full, the room that was seen longest ago is evicted.
+typedef struct ClvCliRoomCache {
+    ClvCliRoomCacheEntry* entries; // in no particular order
+    uint16_t* indexes[ClvCliRoomCacheIndexCount];
+    size_t count;
+    uint64_t mergeCount; // room list responses
+    uint64_t evictedCount;
+} ClvCliRoomCache;
+
+int clvCliRoomCacheInit(ClvCliRoomCache* self);
+void clvCliRoomCacheDestroy(ClvCliRoomCache* self);
+void clvCliRoomCacheMerge(
+    ClvCliRoomCache* self, const ClvSerializeListRoomsResponseOptions* roomList, ClvCliTimeNs now);
+const ClvCliRoomCacheEntry* clvCliRoomCacheFind(
+    const ClvCliRoomCache* self, ClvSerializeRoomId roomId);
+size_t clvCliRoomCacheQuery(const ClvCliRoomCache* self, const ClvCliRoomCacheQuery* query,
+    ClvCliRoomCacheIndex order, ClvCliTimeNs now, const ClvCliRoomCacheEntry** results,
+    size_t maxCount);
+uint8_t clvCliRoomCacheFreeSlots(const ClvSerializeRoomInfo* roomInfo);
+
+#endif
@@ -0,0 +1,45 @@
+/*----------------------------------------------------------------------------------------------------------
+ *  Copyright (c) Peter Bjorklund. All rights reserved. https://github.com/piot/conclave-client-cli
+ *  Licensed under the MIT License. See LICENSE in the project root for license information.
+ *--------------------------------------------------------------------------------------------------------*/
+#ifndef CONCLAVE_CLIENT_CLI_ROOM_LIST_DIFF_H
+#define CONCLAVE_CLIENT_CLI_ROOM_LIST_DIFF_H
+
+#include <conclave-serialize/types.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define CLV_CLI_ROOM_LIST_DIFF_CAPACITY (64)
+
+typedef enum ClvCliRoomChangeType {
+    ClvCliRoomChangeTypeAdded,
+    ClvCliRoomChangeTypeRemoved,
+    ClvCliRoomChangeTypeChanged,
+} ClvCliRoomChangeType;
+
+#define CLV_CLI_ROOM_CHANGED_MEMBERS (0x01)
+#define CLV_CLI_ROOM_CHANGED_OWNER (0x02)
+#define CLV_CLI_ROOM_CHANGED_STATE (0x04)
+#define CLV_CLI_ROOM_CHANGED_OTHER (0x08) // name, application or maximum member count
+
+typedef struct ClvCliRoomChange {
+    ClvCliRoomChangeType type;
+    uint8_t changedMask; // CLV_CLI_ROOM_CHANGED_*, for changed rooms
+    ClvSerializeRoomInfo roomInfo; // as last listed for removed rooms
+    ClvSerializeRoomInfo previous; // for changed rooms
+} ClvCliRoomChange;
+
+/// Finds the rooms that were added, removed or changed since the previous room list
+/// The previous room list is kept sorted on room id, so the new list is sorted and both are
+/// walked once.
+typedef struct ClvCliRoomListDiff {
+    ClvSerializeRoomInfo rooms[CLV_CLI_ROOM_LIST_DIFF_CAPACITY]; // sorted on room id
+    size_t count;
+} ClvCliRoomListDiff;
+
+void clvCliRoomListDiffInit(ClvCliRoomListDiff* self);
+size_t clvCliRoomListDiffUpdate(ClvCliRoomListDiff* self,
+    const ClvSerializeListRoomsResponseOptions* roomList, ClvCliRoomChange* changes,
+    size_t maxChanges);
+
+#endif
@@ -0,0 +1,70 @@
+/*----------------------------------------------------------------------------------------------------------
+ *  Copyright (c) Peter Bjorklund. All rights reserved. https://github.com/piot/conclave-client-cli
+ *  Licensed under the MIT License. See LICENSE in the project root for license information.
+ *--------------------------------------------------------------------------------------------------------*/
+#ifndef CONCLAVE_CLIENT_CLI_SCRIPT_H
+#define CONCLAVE_CLIENT_CLI_SCRIPT_H
+
+#include <clog/clog.h>
+#include <conclave-client-cli/request_latency.h>
+#include <monotonic-time/monotonic_time.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+typedef enum ClvCliScriptOp {
+    ClvCliScriptOpCommand,
+    ClvCliScriptOpSleep,
+    ClvCliScriptOpWaitResponse,
+    ClvCliScriptOpWaitLogin,
+    ClvCliScriptOpAwait,
+    ClvCliScriptOpRepeat,
+    ClvCliScriptOpEnd,
+} ClvCliScriptOp;
+
+typedef struct ClvCliScriptInstruction {
+    ClvCliScriptOp op;
+    const char* line;
+    size_t lineNumber;
+    size_t value; // milliseconds, repeat count, ClvCliRequestType or correlation id
+    size_t timeoutMs;
+    size_t jumpIndex; // instruction after the matching '}' for repeat, the repeat for '}'
+} ClvCliScriptInstruction;
+
+/// Correlation ids for `await all` and `await last`
+#define CLV_CLI_SCRIPT_AWAIT_ALL (0)
+#define CLV_CLI_SCRIPT_AWAIT_LAST (SIZE_MAX)
+
+/// The application that the script is driving
+typedef struct ClvCliScriptHost {
+    void* self;
+    bool (*execute)(void* self, const char* line); // returns true if the script should stop
+    bool (*isPending)(void* self, ClvCliRequestType type);
+    bool (*isLoggedIn)(void* self);
+    bool (*isAwaiting)(void* self, size_t correlationId);
+    void (*awaited)(void* self, size_t correlationId); // the await is done
+} ClvCliScriptHost;
+
+#define CLV_CLI_SCRIPT_MAX_DEPTH (8)
+
+/// Non-interactive list of commands, with `sleep`, `wait` and `repeat` directives
+typedef struct ClvCliScript {
+    char* text;
+    ClvCliScriptInstruction* instructions;
+    size_t instructionCount;
+    size_t programCounter;
+    size_t repeatsLeft[CLV_CLI_SCRIPT_MAX_DEPTH];
+    size_t depth;
+    bool isBlocked;
+    MonotonicTimeMs blockedUntil;
+    Clog log;
+} ClvCliScript;
+
+int clvCliScriptInit(ClvCliScript* self, char* text, Clog log);
+int clvCliScriptInitFromFile(ClvCliScript* self, FILE* file, Clog log);
+void clvCliScriptDestroy(ClvCliScript* self);
+int clvCliScriptUpdate(ClvCliScript* self, const ClvCliScriptHost* host, MonotonicTimeMs now);
+size_t clvCliScriptTimeUntilUpdate(const ClvCliScript* self, MonotonicTimeMs now);
+
+#endif
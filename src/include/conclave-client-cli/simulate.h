@@ -0,0 +1,107 @@
+/*----------------------------------------------------------------------------------------------------------
+ *  Copyright (c) Peter Bjorklund. All rights reserved. https://github.com/piot/conclave-client-cli
+ *  Licensed under the MIT License. See LICENSE in the project root for license information.
+ *--------------------------------------------------------------------------------------------------------*/
+#ifndef CONCLAVE_CLIENT_CLI_SIMULATE_H
+#define CONCLAVE_CLIENT_CLI_SIMULATE_H
+
+#include <conclave-client-cli/clock.h>
+#include <conclave-client-cli/histogram.h>
+#include <conclave-serialize/types.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+typedef struct ClvCliSimulateOptions {
+    uint32_t ticksPerSecond; // simulation rate, the knowledge of a client that keeps up
+    uint32_t pingIntervalMs;
+} ClvCliSimulateOptions;
+
+typedef enum ClvCliSimulateFault {
+    ClvCliSimulateFaultLag, // the simulation runs slower, so the knowledge falls behind
+    ClvCliSimulateFaultDisconnect, // pings without a connection to the room owner
+    ClvCliSimulateFaultSilent, // stops pinging, as if the process was gone
+    ClvCliSimulateFaultHeal, // removes all faults
+} ClvCliSimulateFault;
+
+typedef struct ClvCliSimulateInjectOptions {
+    ClvCliSimulateFault fault;
+    uint8_t percent; // of the clients (or owners) that get the fault
+    bool ownersOnly; // only clients that own their room
+    uint8_t speedPercent; // lag, how fast the simulation of a lagging client runs
+} ClvCliSimulateInjectOptions;
+
+/// Outcome of a simulation, can be merged from many swarms
+typedef struct ClvCliSimulateReport {
+    uint32_t ticksPerSecond;
+    ClvCliTimeNs elapsed;
+    uint64_t pingCount;
+    uint64_t responseCount;
+    uint64_t termChangeCount;
+    uint64_t ownerChangeCount;
+    size_t laggingCount;
+    size_t disconnectedCount;
+    size_t silentCount;
+    size_t ownerCount; // clients that owned their room in the last ping response
+    size_t awaitingMigrationCount; // have not seen a new owner since the last fault
+    ClvCliHistogram migrationLatencies; // microseconds from the fault until a new owner is seen
+} ClvCliSimulateReport;
+
+#define CLV_CLI_SIMULATE_LAGGING (0x01)
+#define CLV_CLI_SIMULATE_DISCONNECTED (0x02)
+#define CLV_CLI_SIMULATE_SILENT (0x04)
+#define CLV_CLI_SIMULATE_OWNER (0x08)
+#define CLV_CLI_SIMULATE_AWAITING_MIGRATION (0x10)
+#define CLV_CLI_SIMULATE_HAS_ROOM_INFO (0x20)
+
+/// Sends a ping from a client, returns false if the client can not send
+typedef bool (*ClvCliSimulatePingFn)(
+    void* self, size_t clientIndex, uint64_t knowledge, bool hasConnectionToOwner);
+
+/// Game tick simulation of the swarm clients
+/// Every client runs a simulation at the same tick rate and pings with the tick it has reached as
+/// its knowledge, like a game client would. Faults can be injected: lagging clients simulate
+/// slower and fall behind, disconnected clients have lost the connection to the room owner and
+/// silent clients stop pinging. When a fault is injected, the time until each client in a room
+/// sees a new term or owner in its ping response is measured, which is how fast the owner
+/// migrates.
+typedef struct ClvCliSimulate {
+    size_t clientCount;
+    ClvCliSimulateOptions options;
+    bool isRunning;
+    ClvCliTimeNs startedAt;
+    ClvCliTimeNs stoppedAt;
+    ClvCliTimeNs faultAt;
+    uint8_t speedPercent;
+    uint8_t* flags; // CLV_CLI_SIMULATE_*
+    ClvCliTimeNs* dueAt; // next ping
+    uint64_t* lagStartTicks; // the tick when the client started to lag
+    ClvSerializeTerm* terms; // from the last ping response
+    ClvSerializeUserId* owners; // from the last ping response
+    ClvCliTimeNs nextUpdateAt;
+    uint64_t random;
+    ClvCliSimulateReport report;
+} ClvCliSimulate;
+
+int clvCliSimulateInit(ClvCliSimulate* self, size_t clientCount);
+void clvCliSimulateDestroy(ClvCliSimulate* self);
+void clvCliSimulateStart(
+    ClvCliSimulate* self, const ClvCliSimulateOptions* options, ClvCliTimeNs now);
+void clvCliSimulateStop(ClvCliSimulate* self, ClvCliTimeNs now);
+void clvCliSimulateInject(
+    ClvCliSimulate* self, const ClvCliSimulateInjectOptions* options, ClvCliTimeNs now);
+void clvCliSimulateUpdate(
+    ClvCliSimulate* self, ClvCliTimeNs now, ClvCliSimulatePingFn ping, void* pingSelf);
+void clvCliSimulatePingReceived(ClvCliSimulate* self, size_t index,
+    const ClvSerializePingResponseOptions* pingResponse, ClvSerializeUserId userId,
+    ClvCliTimeNs now);
+size_t clvCliSimulateTimeUntilUpdate(const ClvCliSimulate* self, ClvCliTimeNs now);
+void clvCliSimulateReportGet(
+    const ClvCliSimulate* self, ClvCliSimulateReport* report, ClvCliTimeNs now);
+size_t clvCliSimulateBytesPerClient(void);
+const char* clvCliSimulateFaultToString(ClvCliSimulateFault fault);
+
+void clvCliSimulateReportInit(ClvCliSimulateReport* self);
+void clvCliSimulateReportMerge(ClvCliSimulateReport* self, const ClvCliSimulateReport* other);
+
+#endif
@@ -0,0 +1,38 @@
+/*----------------------------------------------------------------------------------------------------------
+ *  Copyright (c) Peter Bjorklund. All rights reserved. https://github.com/piot/conclave-client-cli
+ *  Licensed under the MIT License. See LICENSE in the project root for license information.
+ *--------------------------------------------------------------------------------------------------------*/
+#ifndef CONCLAVE_CLIENT_CLI_SPSC_RING_H
+#define CONCLAVE_CLIENT_CLI_SPSC_RING_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define CLV_CLI_CACHE_LINE_OCTETS (64)
+
+/// Lock-free ring buffer for exactly one producer thread and one consumer thread
+/// The producer and consumer indices are kept on separate cache lines.
+typedef struct ClvCliSpscRing {
+    uint8_t* slots;
+    size_t slotOctetCount;
+    size_t capacity;
+    size_t mask;
+    uint8_t paddingBeforeWrite[CLV_CLI_CACHE_LINE_OCTETS];
+
+    size_t writeIndex; // written by producer
+    size_t cachedReadIndex; // only used by producer
+    uint8_t paddingBeforeRead[CLV_CLI_CACHE_LINE_OCTETS];
+
+    size_t readIndex; // written by consumer
+    size_t cachedWriteIndex; // only used by consumer
+    uint8_t paddingAfterRead[CLV_CLI_CACHE_LINE_OCTETS];
+} ClvCliSpscRing;
+
+int clvCliSpscRingInit(ClvCliSpscRing* self, size_t slotOctetCount, size_t capacity);
+void clvCliSpscRingDestroy(ClvCliSpscRing* self);
+void* clvCliSpscRingWriteBegin(ClvCliSpscRing* self);
+void clvCliSpscRingWriteEnd(ClvCliSpscRing* self);
+const void* clvCliSpscRingReadBegin(ClvCliSpscRing* self);
+void clvCliSpscRingReadEnd(ClvCliSpscRing* self);
+
+#endif
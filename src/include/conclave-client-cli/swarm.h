@@ -0,0 +1,124 @@
+/*----------------------------------------------------------------------------------------------------------
+ *  Copyright (c) Peter Bjorklund. All rights reserved. https://github.com/piot/conclave-client-cli
+ *  Licensed under the MIT License. See LICENSE in the project root for license information.
+ *--------------------------------------------------------------------------------------------------------*/
+#ifndef CONCLAVE_CLIENT_CLI_SWARM_H
+#define CONCLAVE_CLIENT_CLI_SWARM_H
+
+#include <clog/clog.h>
+#include <conclave-client-cli/churn.h>
+#include <conclave-client-cli/imprint_counter.h>
+#include <conclave-client-cli/load.h>
+#include <conclave-client-cli/owner_convergence.h>
+#include <conclave-client-cli/request_latency.h>
+#include <conclave-client-cli/simulate.h>
+#include <conclave-client-cli/spsc_ring.h>
+#include <conclave-client-udp/client.h>
+#include <guise-client-udp/client.h>
+#include <guise-client-udp/read_secret.h>
+#include <imprint/default_setup.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+struct ClvCliEventLoop;
+
+typedef enum ClvCliSwarmPhase {
+    ClvCliSwarmPhaseLoggingIn,
+    ClvCliSwarmPhaseConclave,
+    ClvCliSwarmPhaseFailed,
+} ClvCliSwarmPhase;
+
+/// Many simulated users driven from one process
+/// The small per client state is kept as struct-of-arrays, so a pass over all clients only
+/// touches the (large) client structs when something has changed.
+typedef struct ClvCliSwarm {
+    size_t clientCount;
+    GuiseClientUdpSecret* secrets;
+    GuiseClientUdp* guiseClients;
+    ClvClientUdp* clvClients;
+
+    uint8_t* phases; // ClvCliSwarmPhase
+    uint8_t* clientStates; // ClvClientState, last seen
+    uint8_t* lastPingResponseVersions;
+    uint8_t* lastRoomCreateVersions;
+    uint8_t* lastRoomListVersions;
+    ClvCliTimeNs* sentAt[ClvCliRequestTypeCount]; // zero if no request is in flight
+    ClvSerializeRoomId* observedRoomIds; // room, term and owner in the last ping response
+    ClvSerializeTerm* observedTerms;
+    ClvSerializeUserId* observedOwners;
+
+    size_t phaseCounts[3];
+    size_t pingResponseCount;
+    size_t roomCreateCount;
+    size_t roomListCount;
+    uint64_t coalescedCount; // responses that were overwritten before they were seen
+    ClvCliHistogram latencies[ClvCliRequestTypeCount];
+    size_t pendingCounts[ClvCliRequestTypeCount];
+    size_t loggedInCount; // clients in conclave phase that are logged in
+    ClvCliSpscRing* ownerObservations; // to the coordinator, zero if not observed
+    uint64_t droppedOwnerObservationCount;
+
+    const char* conclaveHost;
+    uint16_t conclavePort;
+    ClvCliLoad load;
+    ClvCliChurn churn;
+    ClvCliSimulate simulate;
+    ImprintDefaultSetup imprint;
+    bool hasImprint; // imprint is set up and is destroyed with the swarm
+    ClvCliImprintCounter imprintCounter; // in front of the imprint slab allocator
+    struct ClvCliEventLoop* eventLoop;
+    Clog clvClientUdpLog;
+    Clog log;
+} ClvCliSwarm;
+
+/// Counters and round trip times of one or more swarms
+typedef struct ClvCliSwarmReport {
+    size_t clientCount;
+    size_t phaseCounts[3];
+    size_t pingResponseCount;
+    size_t roomCreateCount;
+    size_t roomListCount;
+    uint64_t coalescedCount;
+    uint64_t droppedOwnerObservationCount;
+    ClvCliHistogram latencies[ClvCliRequestTypeCount];
+    ClvCliLoadReport load;
+    ClvCliChurnReport churn;
+    ClvCliSimulateReport simulate;
+    ClvCliImprintReport imprint;
+} ClvCliSwarmReport;
+
+int clvCliSwarmInit(ClvCliSwarm* self, size_t clientCount, size_t firstSecretIndex,
+    const char* guiseHost, uint16_t guisePort, const char* conclaveHost, uint16_t conclavePort,
+    size_t imprintOctetsPerClient, Clog log);
+void clvCliSwarmDestroy(ClvCliSwarm* self);
+int clvCliSwarmAddToEventLoop(ClvCliSwarm* self, struct ClvCliEventLoop* eventLoop);
+int clvCliSwarmUpdateClient(ClvCliSwarm* self, size_t index, MonotonicTimeMs now);
+int clvCliSwarmUpdate(ClvCliSwarm* self, MonotonicTimeMs now);
+size_t clvCliSwarmBytesPerClient(void);
+
+size_t clvCliSwarmPing(ClvCliSwarm* self, uint64_t knowledge, bool hasConnectionToOwner);
+size_t clvCliSwarmCreateRoom(ClvCliSwarm* self, const ClvSerializeRoomCreateOptions* options);
+size_t clvCliSwarmJoinRoom(ClvCliSwarm* self, const ClvSerializeRoomJoinOptions* options);
+size_t clvCliSwarmListRooms(ClvCliSwarm* self, const ClvSerializeListRoomsOptions* options);
+bool clvCliSwarmIsPending(const ClvCliSwarm* self, ClvCliRequestType type);
+bool clvCliSwarmIsLoggedIn(const ClvCliSwarm* self);
+void clvCliSwarmLoadStart(ClvCliSwarm* self, const ClvCliLoadOptions* options);
+void clvCliSwarmLoadStop(ClvCliSwarm* self);
+void clvCliSwarmLoadUpdate(ClvCliSwarm* self);
+size_t clvCliSwarmLoadTimeUntilUpdate(const ClvCliSwarm* self);
+void clvCliSwarmChurnStart(ClvCliSwarm* self, const ClvCliChurnOptions* options);
+void clvCliSwarmChurnStop(ClvCliSwarm* self);
+void clvCliSwarmChurnUpdate(ClvCliSwarm* self);
+size_t clvCliSwarmChurnTimeUntilUpdate(const ClvCliSwarm* self);
+void clvCliSwarmSimulateStart(ClvCliSwarm* self, const ClvCliSimulateOptions* options);
+void clvCliSwarmSimulateStop(ClvCliSwarm* self);
+void clvCliSwarmSimulateInject(ClvCliSwarm* self, const ClvCliSimulateInjectOptions* options);
+void clvCliSwarmSimulateUpdate(ClvCliSwarm* self);
+size_t clvCliSwarmSimulateTimeUntilUpdate(const ClvCliSwarm* self);
+
+void clvCliSwarmReportInit(ClvCliSwarmReport* self);
+void clvCliSwarmReportAdd(ClvCliSwarmReport* self, const ClvCliSwarm* swarm);
+void clvCliSwarmReportMerge(ClvCliSwarmReport* self, const ClvCliSwarmReport* other);
+
+#endif
@@ -0,0 +1,96 @@
+/*----------------------------------------------------------------------------------------------------------
+ *  Copyright (c) Peter Bjorklund. All rights reserved. https://github.com/piot/conclave-client-cli
+ *  Licensed under the MIT License. See LICENSE in the project root for license information.
+ *--------------------------------------------------------------------------------------------------------*/
+#ifndef CONCLAVE_CLIENT_CLI_SWARM_SHARDS_H
+#define CONCLAVE_CLIENT_CLI_SWARM_SHARDS_H
+
+#include <clog/clog.h>
+#include <conclave-client-cli/command.h>
+#include <conclave-client-cli/event_loop.h>
+#include <conclave-client-cli/owner_convergence.h>
+#include <conclave-client-cli/spsc_ring.h>
+#include <conclave-client-cli/swarm.h>
+#include <conclave-client-cli/trace.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/// A part of the swarm that is updated by a worker thread of its own
+/// Every shard is a separate allocation with its own clients, sockets and slab allocator,
+/// so the workers never write to the same cache lines.
+typedef struct ClvCliSwarmShard {
+    uint8_t paddingBefore[CLV_CLI_CACHE_LINE_OCTETS];
+    size_t index;
+    int cpuIndex; // negative if not pinned
+    ClvCliSwarm swarm;
+    ClvCliEventLoop eventLoop;
+    bool hasEventLoop;
+    size_t resendIntervalMs;
+    MonotonicTimeMs lastFullUpdateAt;
+    MonotonicTimeMs lastReportAt;
+    ClvCliSpscRing commands; // from the coordinator
+    ClvCliSpscRing ownerObservations; // to the coordinator
+    int commandWakeupHandle;
+    int coordinatorWakeupHandle;
+
+    uint64_t executedCommandSequence; // atomic, read by the coordinator
+    uint8_t status; // atomic, pending request type bits and CLV_CLI_SWARM_SHARD_LOGGED_IN
+
+    pthread_mutex_t reportMutex;
+    ClvCliSwarmReport report; // copy of the counters, updated once a second
+
+    int shouldQuit;
+    int result;
+    bool hasStarted;
+    pthread_t thread;
+    ClvCliTrace* trace;
+    ClvCliTraceRing* traceRing;
+    Clog log;
+    uint8_t paddingAfter[CLV_CLI_CACHE_LINE_OCTETS];
+} ClvCliSwarmShard;
+
+#define CLV_CLI_SWARM_SHARD_LOGGED_IN (0x80)
+
+/// Most CPUs that the shard threads are spread over
+#define CLV_CLI_SWARM_SHARDS_MAX_CPU_COUNT (1024)
+
+typedef struct ClvCliSwarmShardsOptions {
+    size_t shardCount; // zero to use one shard for each core that the shards can run on
+    bool shouldPin;
+    size_t clientCount;
+    size_t firstSecretIndex;
+    const char* guiseHost;
+    uint16_t guisePort;
+    const char* conclaveHost;
+    uint16_t conclavePort;
+    bool usePolling;
+    size_t resendIntervalMs; // longest time between full updates
+    size_t imprintOctetsPerClient; // zero for the default
+    ClvCliTrace* trace; // zero when not tracing
+} ClvCliSwarmShardsOptions;
+
+/// The swarm split into shards, driven by the coordinator (network) thread
+typedef struct ClvCliSwarmShards {
+    ClvCliSwarmShard** shards;
+    size_t shardCount;
+    size_t clientCount;
+    Clog log;
+} ClvCliSwarmShards;
+
+int clvCliSwarmShardsInit(ClvCliSwarmShards* self, const ClvCliSwarmShardsOptions* options,
+    int coordinatorWakeupHandle, Clog log);
+void clvCliSwarmShardsDestroy(ClvCliSwarmShards* self);
+int clvCliSwarmShardsStart(ClvCliSwarmShards* self);
+void clvCliSwarmShardsStop(ClvCliSwarmShards* self);
+
+bool clvCliSwarmShardsHasRoom(ClvCliSwarmShards* self);
+size_t clvCliSwarmShardsSend(ClvCliSwarmShards* self, const ClvCliCommand* command);
+void clvCliSwarmShardsMerge(const ClvCliSwarmShards* self, ClvCliSwarmReport* target);
+void clvCliSwarmShardsDrainOwnerObservations(
+    ClvCliSwarmShards* self, ClvCliOwnerConvergence* target);
+int clvCliSwarmShardsStatus(const ClvCliSwarmShards* self, uint64_t* executedCommandSequence,
+    uint8_t* pendingMask, bool* isLoggedIn);
+
+#endif
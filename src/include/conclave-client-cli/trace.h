@@ -0,0 +1,82 @@
+/*----------------------------------------------------------------------------------------------------------
+ *  Copyright (c) Peter Bjorklund. All rights reserved. https://github.com/piot/conclave-client-cli
+ *  Licensed under the MIT License. See LICENSE in the project root for license information.
+ *--------------------------------------------------------------------------------------------------------*/
+#ifndef CONCLAVE_CLIENT_CLI_TRACE_H
+#define CONCLAVE_CLIENT_CLI_TRACE_H
+
+#include <conclave-client-cli/clock.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define CLV_CLI_TRACE_RING_CAPACITY (64 * 1024)
+#define CLV_CLI_TRACE_MAX_THREAD_COUNT (128)
+#define CLV_CLI_TRACE_THREAD_NAME_OCTETS (32)
+
+/// A completed call, the name must be a string literal
+typedef struct ClvCliTraceSpan {
+    const char* name;
+    ClvCliTimeNs startedAt;
+    ClvCliTimeNs duration;
+} ClvCliTraceSpan;
+
+/// The spans of one thread, only written by that thread
+/// When full the oldest spans are overwritten, so a long session keeps its last seconds.
+typedef struct ClvCliTraceRing {
+    ClvCliTraceSpan* spans;
+    uint64_t writeCount;
+    uint32_t threadId;
+    char threadName[CLV_CLI_TRACE_THREAD_NAME_OCTETS];
+} ClvCliTraceRing;
+
+/// Records spans of the main loop phases of all threads, written as Chrome trace events at exit
+typedef struct ClvCliTrace {
+    pthread_mutex_t mutex; // only for adding threads
+    ClvCliTraceRing* rings[CLV_CLI_TRACE_MAX_THREAD_COUNT];
+    size_t ringCount;
+} ClvCliTrace;
+
+int clvCliTraceInit(ClvCliTrace* self);
+void clvCliTraceDestroy(ClvCliTrace* self);
+ClvCliTraceRing* clvCliTraceAddThread(ClvCliTrace* self, const char* threadName);
+int clvCliTraceWrite(const ClvCliTrace* self, const char* filename);
+
+/// Starts a span, a zero ring (tracing disabled) costs a single branch
+static inline ClvCliTimeNs clvCliTraceBegin(const ClvCliTraceRing* ring)
+{
+    return ring == 0 ? 0 : clvCliClockNowNs();
+}
+
+/// Adds a span that was timed by the caller
+/// @param ring ring of the calling thread, or zero
+/// @param name name of the span, must be a string literal
+/// @param startedAt monotonic time when the span started
+/// @param endedAt monotonic time when the span ended
+static inline void clvCliTraceAdd(
+    ClvCliTraceRing* ring, const char* name, ClvCliTimeNs startedAt, ClvCliTimeNs endedAt)
+{
+    if (ring == 0) {
+        return;
+    }
+    ClvCliTraceSpan* span = &ring->spans[ring->writeCount % CLV_CLI_TRACE_RING_CAPACITY];
+    span->name = name;
+    span->startedAt = startedAt;
+    span->duration = endedAt - startedAt;
+    ring->writeCount++;
+}
+
+/// Ends a span that was started with clvCliTraceBegin()
+/// @param ring ring of the calling thread, or zero
+/// @param name name of the span, must be a string literal
+/// @param startedAt returned from clvCliTraceBegin()
+static inline void clvCliTraceEnd(ClvCliTraceRing* ring, const char* name, ClvCliTimeNs startedAt)
+{
+    if (ring == 0) {
+        return;
+    }
+    clvCliTraceAdd(ring, name, startedAt, clvCliClockNowNs());
+}
+
+#endif
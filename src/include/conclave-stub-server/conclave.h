@@ -0,0 +1,57 @@
+/*----------------------------------------------------------------------------------------------------------
+ *  Copyright (c) Peter Bjorklund. All rights reserved. https://github.com/piot/conclave-client-cli
+ *  Licensed under the MIT License. See LICENSE in the project root for license information.
+ *--------------------------------------------------------------------------------------------------------*/
+#ifndef CONCLAVE_STUB_SERVER_CONCLAVE_H
+#define CONCLAVE_STUB_SERVER_CONCLAVE_H
+
+#include <clog/clog.h>
+#include <conclave-serialize/types.h>
+#include <flood/out_stream.h>
+#include <monotonic-time/monotonic_time.h>
+#include <stddef.h>
+#include <stdint.h>
+
+struct ClvStubGuise;
+
+#define CLV_STUB_ROOM_MAX_MEMBERS (16)
+
+typedef struct ClvStubMember {
+    size_t userIndex;
+    ClvSerializeKnowledge knowledge;
+    bool hasConnectionToOwner;
+    MonotonicTimeMs lastPingAt;
+} ClvStubMember;
+
+typedef struct ClvStubRoom {
+    ClvSerializeRoomId id;
+    char name[64];
+    ClvSerializeApplicationId applicationId;
+    ClvSerializeVersion applicationVersion;
+    uint8_t maxMemberCount;
+    ClvStubMember members[CLV_STUB_ROOM_MAX_MEMBERS];
+    size_t memberCount;
+    size_t indexOfOwner;
+    ClvSerializeTerm term;
+    uint64_t version;
+} ClvStubRoom;
+
+/// Rooms and user sessions for the conclave port
+/// Conclave user sessions are the same as the guise user sessions.
+typedef struct ClvStubConclave {
+    ClvStubRoom* rooms;
+    size_t roomCount;
+    size_t roomCapacity;
+    size_t* userRoomIndex; // room index + 1 for each guise user, zero if not in a room
+    const struct ClvStubGuise* guise;
+    MonotonicTimeMs ownerTimeoutMs;
+    Clog log;
+} ClvStubConclave;
+
+int clvStubConclaveInit(ClvStubConclave* self, const struct ClvStubGuise* guise,
+    size_t roomCapacity, MonotonicTimeMs ownerTimeoutMs, Clog log);
+void clvStubConclaveDestroy(ClvStubConclave* self);
+int clvStubConclaveFeed(ClvStubConclave* self, const uint8_t* data, size_t octetCount,
+    MonotonicTimeMs now, FldOutStream* response);
+
+#endif
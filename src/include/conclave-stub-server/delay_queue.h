@@ -0,0 +1,38 @@
+/*----------------------------------------------------------------------------------------------------------
+ *  Copyright (c) Peter Bjorklund. All rights reserved. https://github.com/piot/conclave-client-cli
+ *  Licensed under the MIT License. See LICENSE in the project root for license information.
+ *--------------------------------------------------------------------------------------------------------*/
+#ifndef CONCLAVE_STUB_SERVER_DELAY_QUEUE_H
+#define CONCLAVE_STUB_SERVER_DELAY_QUEUE_H
+
+#include <conclave-client-cli/clock.h>
+#include <netinet/in.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define CLV_STUB_DATAGRAM_MAX_OCTETS (1200)
+
+typedef struct ClvStubDelayedDatagram {
+    ClvCliTimeNs sendAt;
+    int socketHandle;
+    struct sockaddr_in address;
+    uint8_t octets[CLV_STUB_DATAGRAM_MAX_OCTETS];
+    size_t octetCount;
+} ClvStubDelayedDatagram;
+
+/// Responses waiting to be sent, as a binary min-heap on send time
+typedef struct ClvStubDelayQueue {
+    ClvStubDelayedDatagram* datagrams;
+    size_t count;
+    size_t capacity;
+    size_t overflowCount;
+} ClvStubDelayQueue;
+
+int clvStubDelayQueueInit(ClvStubDelayQueue* self, size_t capacity);
+void clvStubDelayQueueDestroy(ClvStubDelayQueue* self);
+ClvStubDelayedDatagram* clvStubDelayQueuePush(ClvStubDelayQueue* self, ClvCliTimeNs sendAt);
+const ClvStubDelayedDatagram* clvStubDelayQueuePeek(const ClvStubDelayQueue* self);
+void clvStubDelayQueuePop(ClvStubDelayQueue* self);
+
+#endif
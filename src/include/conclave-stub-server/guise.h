@@ -0,0 +1,37 @@
+/*----------------------------------------------------------------------------------------------------------
+ *  Copyright (c) Peter Bjorklund. All rights reserved. https://github.com/piot/conclave-client-cli
+ *  Licensed under the MIT License. See LICENSE in the project root for license information.
+ *--------------------------------------------------------------------------------------------------------*/
+#ifndef CONCLAVE_STUB_SERVER_GUISE_H
+#define CONCLAVE_STUB_SERVER_GUISE_H
+
+#include <clog/clog.h>
+#include <flood/out_stream.h>
+#include <guise-serialize/types.h>
+#include <stddef.h>
+#include <stdint.h>
+
+typedef struct ClvStubGuiseUser {
+    GuiseSerializeUserId userId;
+    GuiseSerializeUserSessionId userSessionId;
+} ClvStubGuiseUser;
+
+/// Accepts every login and hands out a user session
+/// The index of the user is stored in the upper half of the user session ID, so sessions are
+/// looked up without searching.
+typedef struct ClvStubGuise {
+    ClvStubGuiseUser* users;
+    size_t userCount;
+    size_t userCapacity;
+    uint32_t* userIndexLookup; // open addressing hash from user ID to index + 1
+    size_t lookupCapacity;
+    Clog log;
+} ClvStubGuise;
+
+int clvStubGuiseInit(ClvStubGuise* self, size_t userCapacity, Clog log);
+void clvStubGuiseDestroy(ClvStubGuise* self);
+int clvStubGuiseFeed(
+    ClvStubGuise* self, const uint8_t* data, size_t octetCount, FldOutStream* response);
+int clvStubGuiseFindUser(const ClvStubGuise* self, GuiseSerializeUserSessionId userSessionId);
+
+#endif
@@ -0,0 +1,422 @@
+/*----------------------------------------------------------------------------------------------------------
+ *  Copyright (c) Peter Bjorklund. All rights reserved. https://github.com/piot/conclave-client-cli
+ *  Licensed under the MIT License. See LICENSE in the project root for license information.
+ *--------------------------------------------------------------------------------------------------------*/
+#include <clog/clog.h>
+#include <conclave-client-cli/churn.h>
+#include <tiny-libc/tiny_libc.h>
+
+static const ClvCliTimeNs nanosecondsPerMs = 1000000;
+
+/// The clients are checked at most this often
+static const ClvCliTimeNs tickDuration = 10000000;
+
+/// The first room lists are spread out over this time
+static const ClvCliTimeNs startSpread = 1000000000;
+
+/// Join credit that can be saved up, in seconds of the join rate
+static const double burstSeconds = 0.1;
+
+int clvCliChurnInit(ClvCliChurn* self, size_t clientCount)
+{
+    self->clientCount = clientCount;
+    self->isRunning = false;
+    self->startedAt = 0;
+    self->stoppedAt = 0;
+    self->phases = tc_malloc_type_count(uint8_t, clientCount);
+    self->dueAt = tc_malloc_type_count(ClvCliTimeNs, clientCount);
+    self->joinSentAt = tc_malloc_type_count(ClvCliTimeNs, clientCount);
+    self->leaveAt = tc_malloc_type_count(ClvCliTimeNs, clientCount);
+    self->roomIds = tc_malloc_type_count(ClvSerializeRoomId, clientCount);
+    self->hasConverged = tc_malloc_type_count(bool, clientCount);
+    if (!self->phases || !self->dueAt || !self->joinSentAt || !self->leaveAt || !self->roomIds
+        || !self->hasConverged) {
+        CLOG_SOFT_ERROR("could not allocate churn for %zu clients", clientCount)
+        clvCliChurnDestroy(self);
+        return -1;
+    }
+    tc_mem_clear_type_n(self->phases, clientCount);
+    clvCliChurnReportInit(&self->report);
+
+    return 0;
+}
+
+void clvCliChurnDestroy(ClvCliChurn* self)
+{
+    tc_free(self->phases);
+    tc_free(self->dueAt);
+    tc_free(self->joinSentAt);
+    tc_free(self->leaveAt);
+    tc_free(self->roomIds);
+    tc_free(self->hasConverged);
+    self->phases = 0;
+    self->dueAt = 0;
+    self->joinSentAt = 0;
+    self->leaveAt = 0;
+    self->roomIds = 0;
+    self->hasConverged = 0;
+    self->clientCount = 0;
+}
+
+/// xorshift64*
+static uint64_t nextRandom(ClvCliChurn* self)
+{
+    uint64_t x = self->random;
+    x ^= x >> 12;
+    x ^= x << 25;
+    x ^= x >> 27;
+    self->random = x;
+
+    return x * 0x2545F4914F6CDD1Dull;
+}
+
+/// Starts to list, join and leave rooms from all clients
+/// @param self churn
+/// @param options join rate, dwell time and which rooms to list
+/// @param now current time
+void clvCliChurnStart(ClvCliChurn* self, const ClvCliChurnOptions* options, ClvCliTimeNs now)
+{
+    if (options->joinRatePerClient <= 0.0 || self->clientCount == 0) {
+        return;
+    }
+
+    self->options = *options;
+    self->startedAt = now;
+    self->stoppedAt = 0;
+    self->isRunning = true;
+    self->joinCredit = 0.0;
+    self->creditUpdatedAt = now;
+    self->nextReadyIndex = 0;
+    self->nextUpdateAt = now;
+    self->random = (now ^ 0x9E3779B97F4A7C15ull) | 1;
+
+    clvCliChurnReportInit(&self->report);
+    self->report.targetRate = options->joinRatePerClient * (double)self->clientCount;
+
+    for (size_t i = 0; i < self->clientCount; ++i) {
+        self->phases[i] = ClvCliChurnPhaseIdle;
+        self->dueAt[i] = now + startSpread * i / self->clientCount;
+        self->roomIds[i] = 0;
+        self->hasConverged[i] = false;
+    }
+}
+
+/// Stops sending, responses to the joins that have been sent are still measured
+/// @param self churn
+/// @param now current time
+void clvCliChurnStop(ClvCliChurn* self, ClvCliTimeNs now)
+{
+    if (!self->isRunning) {
+        return;
+    }
+    self->isRunning = false;
+    self->stoppedAt = now;
+}
+
+static bool isCandidate(const ClvCliChurn* self, size_t index, const ClvSerializeRoomInfo* room,
+    bool allowCurrentRoom)
+{
+    if (room->memberCount >= room->maxMemberCount) {
+        return false;
+    }
+
+    return allowCurrentRoom || room->roomId != self->roomIds[index];
+}
+
+/// Picks a random room that is not full, another room than the current one if there is any
+/// @return false if there is no room to join
+static bool pickRoom(
+    ClvCliChurn* self, size_t index, const ClvSerializeListRoomsResponseOptions* roomList)
+{
+    for (int pass = 0; pass < 2; ++pass) {
+        bool allowCurrentRoom = pass == 1;
+        size_t candidateCount = 0;
+        for (size_t i = 0; i < roomList->roomInfoCount; ++i) {
+            if (isCandidate(self, index, &roomList->roomInfos[i], allowCurrentRoom)) {
+                candidateCount++;
+            }
+        }
+        if (candidateCount == 0) {
+            continue;
+        }
+
+        size_t pick = (size_t)(nextRandom(self) % candidateCount);
+        for (size_t i = 0; i < roomList->roomInfoCount; ++i) {
+            const ClvSerializeRoomInfo* room = &roomList->roomInfos[i];
+            if (!isCandidate(self, index, room, allowCurrentRoom)) {
+                continue;
+            }
+            if (pick == 0) {
+                self->roomIds[index] = room->roomId;
+                return true;
+            }
+            pick--;
+        }
+    }
+
+    return false;
+}
+
+/// Moves on to another room from the list, or lists the rooms again at retryAt
+static void moveOn(ClvCliChurn* self, size_t index,
+    const ClvSerializeListRoomsResponseOptions* roomList, ClvCliTimeNs retryAt)
+{
+    if (roomList != 0 && pickRoom(self, index, roomList)) {
+        self->phases[index] = ClvCliChurnPhaseReady;
+        return;
+    }
+    self->phases[index] = ClvCliChurnPhaseIdle;
+    self->dueAt[index] = retryAt;
+}
+
+static void addCredit(ClvCliChurn* self, ClvCliTimeNs now)
+{
+    double rate = self->report.targetRate;
+    self->joinCredit += (double)(now - self->creditUpdatedAt) / 1000000000.0 * rate;
+    self->creditUpdatedAt = now;
+
+    double maxCredit = rate * burstSeconds;
+    if (maxCredit < 1.0) {
+        maxCredit = 1.0;
+    }
+    if (self->joinCredit > maxCredit) {
+        self->joinCredit = maxCredit;
+    }
+}
+
+static void leave(
+    ClvCliChurn* self, size_t index, ClvCliTimeNs now, const ClvCliChurnClients* clients)
+{
+    self->report.leaveCount++;
+    if (!self->hasConverged[index]) {
+        self->report.notConvergedCount++;
+    }
+    moveOn(self, index, clients->lastRoomList(clients->self, index), now);
+}
+
+static void updateClient(ClvCliChurn* self, size_t index, ClvCliTimeNs now,
+    const ClvCliChurnClients* clients, size_t* firstStarvedIndex)
+{
+    ClvCliTimeNs timeout = self->options.timeoutMs * nanosecondsPerMs;
+
+    switch ((ClvCliChurnPhase)self->phases[index]) {
+        case ClvCliChurnPhaseIdle:
+            if (now < self->dueAt[index]) {
+                break;
+            }
+            if (!clients->listRooms(clients->self, index, &self->options.roomList)) {
+                self->dueAt[index] = now + timeout;
+                break;
+            }
+            self->report.listCount++;
+            self->phases[index] = ClvCliChurnPhaseListing;
+            self->dueAt[index] = now + timeout;
+            break;
+        case ClvCliChurnPhaseListing:
+            if (now >= self->dueAt[index]) {
+                self->phases[index] = ClvCliChurnPhaseIdle;
+                self->dueAt[index] = now;
+            }
+            break;
+        case ClvCliChurnPhaseReady:
+            if (self->joinCredit < 1.0) {
+                if (*firstStarvedIndex == SIZE_MAX) {
+                    *firstStarvedIndex = index;
+                }
+                break;
+            }
+            if (!clients->joinRoom(clients->self, index, self->roomIds[index])) {
+                self->phases[index] = ClvCliChurnPhaseIdle;
+                self->dueAt[index] = now + timeout;
+                break;
+            }
+            self->joinCredit -= 1.0;
+            self->report.joinCount++;
+            self->phases[index] = ClvCliChurnPhaseJoining;
+            self->joinSentAt[index] = now;
+            self->dueAt[index] = now + timeout;
+            break;
+        case ClvCliChurnPhaseJoining:
+            if (now >= self->dueAt[index]) {
+                self->report.failedCount++;
+                self->phases[index] = ClvCliChurnPhaseIdle;
+                self->dueAt[index] = now;
+            }
+            break;
+        case ClvCliChurnPhaseDwelling:
+            if (now >= self->leaveAt[index]) {
+                leave(self, index, now, clients);
+                break;
+            }
+            if (now >= self->dueAt[index]) {
+                clients->ping(clients->self, index);
+                self->dueAt[index] = now + self->options.pingIntervalMs * nanosecondsPerMs;
+            }
+            break;
+    }
+}
+
+/// Sends the room lists, joins and pings that are due
+/// The clients are checked at most once every tick. Clients that have a room to join get the
+/// join credit in turn, starting with the first one that did not get any last time.
+/// @param self churn
+/// @param now current time
+/// @param clients sends the requests
+void clvCliChurnUpdate(ClvCliChurn* self, ClvCliTimeNs now, const ClvCliChurnClients* clients)
+{
+    if (!self->isRunning || now < self->nextUpdateAt) {
+        return;
+    }
+    self->nextUpdateAt = now + tickDuration;
+    addCredit(self, now);
+
+    size_t firstStarvedIndex = SIZE_MAX;
+    for (size_t i = 0; i < self->clientCount; ++i) {
+        size_t index = (self->nextReadyIndex + i) % self->clientCount;
+        updateClient(self, index, now, clients, &firstStarvedIndex);
+    }
+    if (firstStarvedIndex != SIZE_MAX) {
+        self->nextReadyIndex = firstStarvedIndex;
+    }
+}
+
+/// Picks a room to join from the received room list
+/// @param self churn
+/// @param index client index
+/// @param roomList the room list of the client
+/// @param now current time
+void clvCliChurnRoomListReceived(ClvCliChurn* self, size_t index,
+    const ClvSerializeListRoomsResponseOptions* roomList, ClvCliTimeNs now)
+{
+    if (self->phases[index] != ClvCliChurnPhaseListing) {
+        return;
+    }
+    if (!pickRoom(self, index, roomList)) {
+        self->report.emptyListCount++;
+        self->phases[index] = ClvCliChurnPhaseIdle;
+        self->dueAt[index] = now + self->options.dwellMs * nanosecondsPerMs;
+        return;
+    }
+    self->phases[index] = ClvCliChurnPhaseReady;
+}
+
+/// Records the answer to a join and stays in the room for the dwell time
+/// @param self churn
+/// @param index client index
+/// @param roomId the room that the client is now in
+/// @param now current time
+void clvCliChurnJoinReceived(
+    ClvCliChurn* self, size_t index, ClvSerializeRoomId roomId, ClvCliTimeNs now)
+{
+    if (self->phases[index] != ClvCliChurnPhaseJoining) {
+        return;
+    }
+    if (roomId != self->roomIds[index]) {
+        self->report.failedCount++;
+        self->phases[index] = ClvCliChurnPhaseIdle;
+        self->dueAt[index] = now;
+        return;
+    }
+
+    self->report.joinedCount++;
+    clvCliHistogramAdd(&self->report.joinLatencies, (now - self->joinSentAt[index]) / 1000);
+    self->phases[index] = ClvCliChurnPhaseDwelling;
+    self->hasConverged[index] = false;
+    self->leaveAt[index] = now + self->options.dwellMs * nanosecondsPerMs;
+    self->dueAt[index] = now;
+}
+
+/// Checks if the client has converged, i.e. is one of the members of the room
+/// @param self churn
+/// @param index client index
+/// @param roomInfo room info from the last ping response
+/// @param userId user id of the client
+/// @param now current time
+void clvCliChurnPingReceived(ClvCliChurn* self, size_t index,
+    const ClvSerializeRoomInfoInPing* roomInfo, ClvSerializeUserId userId, ClvCliTimeNs now)
+{
+    if (self->phases[index] != ClvCliChurnPhaseDwelling || self->hasConverged[index]) {
+        return;
+    }
+    for (size_t i = 0; i < roomInfo->memberCount; ++i) {
+        if (roomInfo->members[i] == userId) {
+            self->hasConverged[index] = true;
+            self->report.convergedCount++;
+            clvCliHistogramAdd(
+                &self->report.convergenceLatencies, (now - self->joinSentAt[index]) / 1000);
+            return;
+        }
+    }
+}
+
+/// Milliseconds until the clients should be checked again
+/// @param self churn
+/// @param now current time
+/// @return milliseconds, SIZE_MAX if not running
+size_t clvCliChurnTimeUntilUpdate(const ClvCliChurn* self, ClvCliTimeNs now)
+{
+    if (!self->isRunning) {
+        return SIZE_MAX;
+    }
+    if (self->nextUpdateAt <= now) {
+        return 0;
+    }
+
+    return (size_t)((self->nextUpdateAt - now + nanosecondsPerMs - 1) / nanosecondsPerMs);
+}
+
+/// Gets the result so far
+/// @param self churn
+/// @param report target report
+/// @param now current time
+void clvCliChurnReportGet(const ClvCliChurn* self, ClvCliChurnReport* report, ClvCliTimeNs now)
+{
+    *report = self->report;
+    if (self->startedAt == 0) {
+        report->elapsed = 0;
+        return;
+    }
+    report->elapsed = (self->isRunning ? now : self->stoppedAt) - self->startedAt;
+}
+
+size_t clvCliChurnBytesPerClient(void)
+{
+    return sizeof(uint8_t) + 3 * sizeof(ClvCliTimeNs) + sizeof(ClvSerializeRoomId) + sizeof(bool);
+}
+
+void clvCliChurnReportInit(ClvCliChurnReport* self)
+{
+    self->targetRate = 0.0;
+    self->elapsed = 0;
+    self->listCount = 0;
+    self->emptyListCount = 0;
+    self->joinCount = 0;
+    self->joinedCount = 0;
+    self->failedCount = 0;
+    self->leaveCount = 0;
+    self->convergedCount = 0;
+    self->notConvergedCount = 0;
+    clvCliHistogramInit(&self->joinLatencies);
+    clvCliHistogramInit(&self->convergenceLatencies);
+}
+
+void clvCliChurnReportMerge(ClvCliChurnReport* self, const ClvCliChurnReport* other)
+{
+    if (other->targetRate <= 0.0) {
+        return;
+    }
+    self->targetRate += other->targetRate;
+    if (other->elapsed > self->elapsed) {
+        self->elapsed = other->elapsed;
+    }
+    self->listCount += other->listCount;
+    self->emptyListCount += other->emptyListCount;
+    self->joinCount += other->joinCount;
+    self->joinedCount += other->joinedCount;
+    self->failedCount += other->failedCount;
+    self->leaveCount += other->leaveCount;
+    self->convergedCount += other->convergedCount;
+    self->notConvergedCount += other->notConvergedCount;
+    clvCliHistogramMerge(&self->joinLatencies, &other->joinLatencies);
+    clvCliHistogramMerge(&self->convergenceLatencies, &other->convergenceLatencies);
+}
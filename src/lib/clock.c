@@ -0,0 +1,55 @@
+/*----------------------------------------------------------------------------------------------------------
+ *  Copyright (c) Peter Bjorklund. All rights reserved. https://github.com/piot/conclave-client-cli
+ *  Licensed under the MIT License. See LICENSE in the project root for license information.
+ *--------------------------------------------------------------------------------------------------------*/
+#define _POSIX_C_SOURCE 200809L
+#include <clog/clog.h>
+#include <conclave-client-cli/clock.h>
+#include <errno.h>
+#include <time.h>
+
+/// Monotonic clock with nanosecond resolution
+/// monotonicTimeMsNow() is too coarse for measuring loopback round trips and loop latencies.
+/// @return nanoseconds since an unspecified starting point
+ClvCliTimeNs clvCliClockNowNs(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return (ClvCliTimeNs)ts.tv_sec * 1000000000u + (ClvCliTimeNs)ts.tv_nsec;
+}
+
+/// CPU time used by the calling thread
+/// Compared with the wall time of the same code, it tells if a slow frame was busy or was
+/// waiting for the kernel (or was preempted).
+/// @return nanoseconds of CPU time since the thread started
+ClvCliTimeNs clvCliClockThreadCpuNs(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+
+    return (ClvCliTimeNs)ts.tv_sec * 1000000000u + (ClvCliTimeNs)ts.tv_nsec;
+}
+
+/// Wall clock, which the kernel uses for the receive time of a datagram
+/// It can jump, so it is only used for comparing with a receive time.
+/// @return nanoseconds since the epoch
+ClvCliTimeNs clvCliClockRealtimeNs(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+
+    return (ClvCliTimeNs)ts.tv_sec * 1000000000u + (ClvCliTimeNs)ts.tv_nsec;
+}
+
+void clvCliSleepMs(size_t milliseconds)
+{
+    struct timespec ts;
+    ts.tv_sec = (time_t)(milliseconds / 1000);
+    ts.tv_nsec = (long)(milliseconds % 1000) * 1000000;
+
+    int err = nanosleep(&ts, &ts);
+    if (err != 0 && errno != EINTR) {
+        CLOG_ERROR("NOT WORKING:%d", errno)
+    }
+}
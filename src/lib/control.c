@@ -0,0 +1,428 @@
+/*----------------------------------------------------------------------------------------------------------
+ *  Copyright (c) Peter Bjorklund. All rights reserved. https://github.com/piot/conclave-client-cli
+ *  Licensed under the MIT License. See LICENSE in the project root for license information.
+ *--------------------------------------------------------------------------------------------------------*/
+#define _POSIX_C_SOURCE 200809L
+#include <conclave-client-cli/control.h>
+#include <conclave-client-cli/event_json.h>
+#include <conclave-client-cli/event_loop.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+/// Creates the socket file and starts to listen for connections
+/// A socket file left behind by an earlier process is removed.
+/// @param self control
+/// @param path file name of the socket
+/// @param log logging
+/// @return negative on error
+int clvCliControlInit(ClvCliControl* self, const char* path, Clog log)
+{
+    self->log = log;
+    self->path = path;
+    self->connectionCount = 0;
+    self->eventLoop = 0;
+    for (size_t i = 0; i < CLV_CLI_CONTROL_MAX_CONNECTION_COUNT; ++i) {
+        self->connections[i].handle = -1;
+        self->connections[i].pending = 0;
+    }
+    clvCliOutChainInit(&self->output);
+
+    struct sockaddr_un address;
+    tc_mem_clear_type(&address);
+    address.sun_family = AF_UNIX;
+    if (tc_strlen(path) >= sizeof(address.sun_path)) {
+        CLOG_C_SOFT_ERROR(&self->log, "control socket path '%s' is too long", path)
+        return -1;
+    }
+    tc_strcpy(address.sun_path, sizeof(address.sun_path), path);
+
+    self->listenHandle = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (self->listenHandle < 0) {
+        CLOG_C_SOFT_ERROR(&self->log, "could not create control socket: %d", errno)
+        return -1;
+    }
+
+    unlink(path);
+    if (fcntl(self->listenHandle, F_SETFL, O_NONBLOCK) < 0
+        || bind(self->listenHandle, (const struct sockaddr*)&address, sizeof(address)) < 0
+        || listen(self->listenHandle, CLV_CLI_CONTROL_MAX_CONNECTION_COUNT) < 0) {
+        CLOG_C_SOFT_ERROR(&self->log, "could not listen on control socket '%s': %d", path, errno)
+        close(self->listenHandle);
+        self->listenHandle = -1;
+        return -1;
+    }
+
+    return 0;
+}
+
+static void closeConnection(ClvCliControl* self, ClvCliControlConnection* connection)
+{
+    clvCliJsonWriterDestroy(&connection->json);
+    close(connection->handle);
+    tc_free(connection->pending);
+    connection->pending = 0;
+    connection->handle = -1;
+    self->connectionCount--;
+    CLOG_C_INFO(&self->log, "control connection closed (%zu left)", self->connectionCount)
+}
+
+void clvCliControlDestroy(ClvCliControl* self)
+{
+    for (size_t i = 0; i < CLV_CLI_CONTROL_MAX_CONNECTION_COUNT; ++i) {
+        if (self->connections[i].handle >= 0) {
+            closeConnection(self, &self->connections[i]);
+        }
+    }
+    if (self->listenHandle >= 0) {
+        close(self->listenHandle);
+        unlink(self->path);
+        self->listenHandle = -1;
+    }
+    clvCliOutChainDestroy(&self->output);
+}
+
+/// Wakes up the event loop when a connection is made or a request is received
+/// @param self control
+/// @param eventLoop the REPL event loop
+/// @return negative on error
+int clvCliControlAddToEventLoop(ClvCliControl* self, struct ClvCliEventLoop* eventLoop)
+{
+    self->eventLoop = eventLoop;
+
+    return clvCliEventLoopAdd(eventLoop, self->listenHandle, ClvCliEventLoopSourceControl, 0);
+}
+
+/// Sends as much of the octets as the socket takes without blocking
+/// @return octets sent, negative on error
+static ssize_t sendOctets(ClvCliControlConnection* connection, const uint8_t* octets, size_t count)
+{
+    size_t sentCount = 0;
+    while (sentCount < count) {
+        ssize_t result = send(connection->handle, octets + sentCount, count - sentCount,
+            MSG_DONTWAIT | MSG_NOSIGNAL);
+        if (result < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                break;
+            }
+            return -1;
+        }
+        sentCount += (size_t)result;
+    }
+
+    return (ssize_t)sentCount;
+}
+
+/// Takes the lines from the JSON writer of a connection
+/// They are sent directly if nothing is pending, and the rest is kept until the socket is
+/// writable again.
+static void writeOutput(void* _self, const char* octets, size_t count)
+{
+    ClvCliControlConnection* connection = (ClvCliControlConnection*)_self;
+    if (connection->isOverflowing || connection->hasFailed) {
+        return;
+    }
+
+    const uint8_t* source = (const uint8_t*)octets;
+    if (connection->pendingCount == 0) {
+        ssize_t sentCount = sendOctets(connection, source, count);
+        if (sentCount < 0) {
+            connection->hasFailed = true;
+            return;
+        }
+        source += sentCount;
+        count -= (size_t)sentCount;
+        connection->pendingStart = 0;
+    }
+    if (count == 0) {
+        return;
+    }
+
+    if (connection->pendingCount + count > CLV_CLI_CONTROL_MAX_PENDING_OCTETS) {
+        connection->isOverflowing = true;
+        return;
+    }
+    if (connection->pendingStart + connection->pendingCount + count
+        > CLV_CLI_CONTROL_MAX_PENDING_OCTETS) {
+        memmove(connection->pending, connection->pending + connection->pendingStart,
+            connection->pendingCount);
+        connection->pendingStart = 0;
+    }
+    tc_memcpy_octets(
+        connection->pending + connection->pendingStart + connection->pendingCount, source, count);
+    connection->pendingCount += count;
+}
+
+/// Sends the pending output, and waits for the socket to become writable if it is not all taken
+/// @return negative if the connection should be closed
+static int sendPending(ClvCliControl* self, ClvCliControlConnection* connection)
+{
+    if (connection->pendingCount > 0) {
+        ssize_t sentCount = sendOctets(
+            connection, connection->pending + connection->pendingStart, connection->pendingCount);
+        if (sentCount < 0) {
+            return -1;
+        }
+        connection->pendingStart += (size_t)sentCount;
+        connection->pendingCount -= (size_t)sentCount;
+        if (connection->pendingCount == 0) {
+            connection->pendingStart = 0;
+        }
+    }
+
+    bool shouldWaitForWrite = connection->pendingCount > 0;
+    if (self->eventLoop != 0 && shouldWaitForWrite != connection->isWaitingForWrite) {
+        if (clvCliEventLoopWaitForWrite(self->eventLoop, connection->handle,
+                ClvCliEventLoopSourceControl, 0, shouldWaitForWrite)
+            < 0) {
+            return -1;
+        }
+        connection->isWaitingForWrite = shouldWaitForWrite;
+    }
+
+    return 0;
+}
+
+static void acceptConnections(ClvCliControl* self)
+{
+    while (true) {
+        int handle = accept(self->listenHandle, 0, 0);
+        if (handle < 0) {
+            if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) {
+                CLOG_C_WARN(&self->log, "could not accept control connection: %d", errno)
+            }
+            return;
+        }
+
+        ClvCliControlConnection* connection = 0;
+        for (size_t i = 0; i < CLV_CLI_CONTROL_MAX_CONNECTION_COUNT; ++i) {
+            if (self->connections[i].handle < 0) {
+                connection = &self->connections[i];
+                break;
+            }
+        }
+        if (connection == 0 || fcntl(handle, F_SETFL, O_NONBLOCK) < 0) {
+            CLOG_C_WARN(&self->log, "control connection refused")
+            close(handle);
+            continue;
+        }
+        connection->pending = tc_malloc_type_count(uint8_t, CLV_CLI_CONTROL_MAX_PENDING_OCTETS);
+        ClvCliJsonWriterOutput output;
+        output.self = connection;
+        output.write = writeOutput;
+        if (connection->pending == 0
+            || clvCliJsonWriterInitOutput(&connection->json, &output) < 0) {
+            CLOG_C_WARN(&self->log, "control connection refused")
+            tc_free(connection->pending);
+            connection->pending = 0;
+            close(handle);
+            continue;
+        }
+        connection->handle = handle;
+        connection->pendingStart = 0;
+        connection->pendingCount = 0;
+        connection->isWaitingForWrite = false;
+        connection->isOverflowing = false;
+        connection->hasFailed = false;
+        connection->lineLength = 0;
+        connection->isDiscardingLine = false;
+        self->connectionCount++;
+
+        if (self->eventLoop != 0
+            && clvCliEventLoopAdd(self->eventLoop, handle, ClvCliEventLoopSourceControl, 0) < 0) {
+            closeConnection(self, connection);
+            continue;
+        }
+        CLOG_C_INFO(&self->log, "control connection accepted (%zu)", self->connectionCount)
+    }
+}
+
+/// Removes the terminal color escape sequences that the command responses are written with
+/// A sequence is written at once, so it is never split between two chunks.
+/// @return octet count without the sequences
+static size_t removeColors(uint8_t* text, size_t count)
+{
+    const uint8_t* end = text + count;
+    uint8_t* target = text;
+    for (const uint8_t* p = text; p < end; ++p) {
+        if (*p == '\x1b' && p + 1 < end && p[1] == '[') {
+            p += 2;
+            while (p < end && (*p < '@' || *p > '~')) {
+                ++p;
+            }
+            if (p == end) {
+                break;
+            }
+            continue;
+        }
+        *target++ = *p;
+    }
+
+    return (size_t)(target - text);
+}
+
+/// Executes one request line, `<id> <command line>`
+/// @return 1 if the application should quit
+static int executeRequest(ClvCliControl* self, ClvCliControlConnection* connection,
+    const ClvCliControlHost* host, char* line)
+{
+    while (*line == ' ' || *line == '\t') {
+        ++line;
+    }
+    if (*line == 0) {
+        return 0;
+    }
+
+    char* commandLine = line;
+    while (*commandLine != 0 && *commandLine != ' ' && *commandLine != '\t') {
+        ++commandLine;
+    }
+    if (*commandLine != 0) {
+        *commandLine++ = 0;
+    }
+    while (*commandLine == ' ' || *commandLine == '\t') {
+        ++commandLine;
+    }
+
+    ClvCliOutChain* output = &self->output;
+    clvCliOutChainClear(output);
+    uint64_t correlationId = 0;
+    int result
+        = *commandLine == 0 ? -1 : host->execute(host->self, commandLine, output, &correlationId);
+
+    ClvCliJsonWriter* json = &connection->json;
+    clvCliJsonWriterObjectBegin(json, 0);
+    clvCliJsonWriterString(json, "event", "response");
+    clvCliJsonWriterUInt64(json, "timeNs", clvCliClockNowNs());
+    clvCliJsonWriterString(json, "id", line);
+    clvCliJsonWriterBool(json, "ok", result >= 0);
+    if (correlationId != 0) {
+        clvCliJsonWriterUInt64(json, "correlationId", correlationId);
+    }
+    if (result < 0 && output->octetCount == 0) {
+        clvCliJsonWriterString(json, "output", "unknown command");
+    } else {
+        clvCliJsonWriterStringBegin(json, "output");
+        for (ClvCliOutChunk* chunk = output->first; chunk != 0; chunk = chunk->next) {
+            size_t count = removeColors(chunk->octets, chunk->count);
+            clvCliJsonWriterStringAppend(json, (const char*)chunk->octets, count);
+        }
+        clvCliJsonWriterStringEnd(json);
+    }
+    clvCliJsonWriterObjectEnd(json);
+    clvCliJsonWriterLineEnd(json);
+
+    return result > 0 ? 1 : 0;
+}
+
+/// Reads what has been received on a connection and executes the complete lines
+/// @return 1 if the application should quit, negative if the connection should be closed
+static int readConnection(
+    ClvCliControl* self, ClvCliControlConnection* connection, const ClvCliControlHost* host)
+{
+    char buf[4096];
+    while (true) {
+        ssize_t octetCount = recv(connection->handle, buf, sizeof(buf), MSG_DONTWAIT);
+        if (octetCount == 0) {
+            return -1;
+        }
+        if (octetCount < 0) {
+            if (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR) {
+                return 0;
+            }
+            return -1;
+        }
+
+        for (size_t i = 0; i < (size_t)octetCount; ++i) {
+            char ch = buf[i];
+            if (ch == '\n') {
+                if (!connection->isDiscardingLine) {
+                    connection->line[connection->lineLength] = 0;
+                    if (executeRequest(self, connection, host, connection->line) != 0) {
+                        return 1;
+                    }
+                }
+                connection->lineLength = 0;
+                connection->isDiscardingLine = false;
+            } else if (ch == '\r' || connection->isDiscardingLine) {
+                continue;
+            } else if (connection->lineLength + 1 >= CLV_CLI_CONTROL_LINE_CAPACITY) {
+                CLOG_C_WARN(&self->log, "control request line is too long, ignored")
+                connection->isDiscardingLine = true;
+            } else {
+                connection->line[connection->lineLength++] = ch;
+            }
+        }
+    }
+}
+
+/// Accepts new connections and executes the received requests
+/// Called when the event loop reports activity on the control sockets, or every frame when
+/// polling.
+/// @param self control
+/// @param host executes the command lines
+/// @return 1 if a request asked the application to quit, 0 otherwise
+int clvCliControlUpdate(ClvCliControl* self, const ClvCliControlHost* host)
+{
+    acceptConnections(self);
+
+    int result = 0;
+    for (size_t i = 0; i < CLV_CLI_CONTROL_MAX_CONNECTION_COUNT && result == 0; ++i) {
+        ClvCliControlConnection* connection = &self->connections[i];
+        if (connection->handle < 0) {
+            continue;
+        }
+        int readResult = readConnection(self, connection, host);
+        if (readResult < 0) {
+            closeConnection(self, connection);
+        } else {
+            result = readResult;
+        }
+    }
+
+    clvCliControlFlush(self);
+
+    return result;
+}
+
+/// Sends an event from the network thread to all connections
+/// @param self control
+/// @param event event, status events are not sent
+void clvCliControlWriteEvent(ClvCliControl* self, const ClvCliEvent* event)
+{
+    if (self->connectionCount == 0) {
+        return;
+    }
+    for (size_t i = 0; i < CLV_CLI_CONTROL_MAX_CONNECTION_COUNT; ++i) {
+        if (self->connections[i].handle >= 0) {
+            clvCliEventJsonWrite(&self->connections[i].json, event);
+        }
+    }
+}
+
+/// Writes the buffered responses and events, and closes the connections that have gone away
+/// A connection that has more than CLV_CLI_CONTROL_MAX_PENDING_OCTETS of output that it has not
+/// read is closed, so a stalled reader never blocks the REPL thread.
+/// @param self control
+void clvCliControlFlush(ClvCliControl* self)
+{
+    for (size_t i = 0; i < CLV_CLI_CONTROL_MAX_CONNECTION_COUNT; ++i) {
+        ClvCliControlConnection* connection = &self->connections[i];
+        if (connection->handle < 0) {
+            continue;
+        }
+        clvCliJsonWriterFlush(&connection->json);
+        if (connection->isOverflowing) {
+            CLOG_C_WARN(&self->log, "control connection did not read %zu octets of output, closed",
+                connection->pendingCount)
+            closeConnection(self, connection);
+        } else if (connection->hasFailed || sendPending(self, connection) < 0) {
+            closeConnection(self, connection);
+        }
+    }
+}
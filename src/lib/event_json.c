@@ -0,0 +1,355 @@
+/*----------------------------------------------------------------------------------------------------------
+ *  Copyright (c) Peter Bjorklund. All rights reserved. https://github.com/piot/conclave-client-cli
+ *  Licensed under the MIT License. See LICENSE in the project root for license information.
+ *--------------------------------------------------------------------------------------------------------*/
+#include <conclave-client-cli/event_json.h>
+#include <conclave-client/debug.h>
+
+/// Keys of the request types, without the spaces of clvCliRequestTypeToString()
+static const char* requestTypeKeys[ClvCliRequestTypeCount]
+    = { "ping", "roomCreate", "roomJoin", "roomList" };
+
+/// Keys of the frame phases, the last is the whole frame
+static const char* perfPhaseKeys[ClvCliPerfPhaseCount + 1]
+    = { "commands", "guiseUpdate", "conclaveUpdate", "publish", "load", "swarmMerge", "frame" };
+
+static void writeVersion(
+    ClvCliJsonWriter* writer, const char* key, const ClvSerializeVersion* version)
+{
+    clvCliJsonWriterObjectBegin(writer, key);
+    clvCliJsonWriterUInt64(writer, "major", version->major);
+    clvCliJsonWriterUInt64(writer, "minor", version->minor);
+    clvCliJsonWriterUInt64(writer, "patch", version->patch);
+    clvCliJsonWriterObjectEnd(writer);
+}
+
+/// Writes count and percentiles in microseconds
+static void writeHistogram(
+    ClvCliJsonWriter* writer, const char* key, const ClvCliHistogram* histogram)
+{
+    clvCliJsonWriterObjectBegin(writer, key);
+    clvCliJsonWriterUInt64(writer, "count", histogram->count);
+    if (histogram->count > 0) {
+        clvCliJsonWriterUInt64(writer, "p50", clvCliHistogramPercentile(histogram, 50.0));
+        clvCliJsonWriterUInt64(writer, "p90", clvCliHistogramPercentile(histogram, 90.0));
+        clvCliJsonWriterUInt64(writer, "p99", clvCliHistogramPercentile(histogram, 99.0));
+        clvCliJsonWriterUInt64(writer, "p999", clvCliHistogramPercentile(histogram, 99.9));
+        clvCliJsonWriterUInt64(writer, "max", histogram->max);
+    }
+    clvCliJsonWriterObjectEnd(writer);
+}
+
+static void writePingResponse(
+    ClvCliJsonWriter* writer, const ClvSerializePingResponseOptions* pingResponse)
+{
+    clvCliJsonWriterUInt64(writer, "term", pingResponse->term);
+    clvCliJsonWriterUInt64(writer, "version", pingResponse->version);
+    clvCliJsonWriterUInt64(writer, "indexOfOwner", pingResponse->roomInfo.indexOfOwner);
+    clvCliJsonWriterArrayBegin(writer, "members");
+    for (size_t i = 0; i < pingResponse->roomInfo.memberCount; ++i) {
+        clvCliJsonWriterUInt64(writer, 0, pingResponse->roomInfo.members[i]);
+    }
+    clvCliJsonWriterArrayEnd(writer);
+}
+
+static void writeRoomList(
+    ClvCliJsonWriter* writer, const ClvSerializeListRoomsResponseOptions* roomList)
+{
+    clvCliJsonWriterArrayBegin(writer, "rooms");
+    for (size_t i = 0; i < roomList->roomInfoCount; ++i) {
+        const ClvSerializeRoomInfo* roomInfo = &roomList->roomInfos[i];
+        clvCliJsonWriterObjectBegin(writer, 0);
+        clvCliJsonWriterUInt64(writer, "roomId", roomInfo->roomId);
+        clvCliJsonWriterString(writer, "name", roomInfo->roomName);
+        clvCliJsonWriterUInt64(writer, "ownerUserId", roomInfo->ownerUserId);
+        clvCliJsonWriterUInt64(writer, "memberCount", roomInfo->memberCount);
+        clvCliJsonWriterUInt64(writer, "maxMemberCount", roomInfo->maxMemberCount);
+        clvCliJsonWriterUInt64(writer, "stateOctetCount", roomInfo->externalStateOctetCount);
+        clvCliJsonWriterUInt64(writer, "applicationId", roomInfo->applicationId);
+        writeVersion(writer, "applicationVersion", &roomInfo->applicationVersion);
+        clvCliJsonWriterObjectEnd(writer);
+    }
+    clvCliJsonWriterArrayEnd(writer);
+}
+
+static void writeState(ClvCliJsonWriter* writer, const ClvCliNetworkState* state)
+{
+    if (state->swarmClientCount > 0) {
+        clvCliJsonWriterUInt64(writer, "swarmClientCount", state->swarmClientCount);
+        clvCliJsonWriterUInt64(
+            writer, "loggingIn", state->swarmPhaseCounts[ClvCliSwarmPhaseLoggingIn]);
+        clvCliJsonWriterUInt64(
+            writer, "conclave", state->swarmPhaseCounts[ClvCliSwarmPhaseConclave]);
+        clvCliJsonWriterUInt64(writer, "failed", state->swarmPhaseCounts[ClvCliSwarmPhaseFailed]);
+        clvCliJsonWriterUInt64(writer, "pingResponseCount", state->pingResponseCount);
+        clvCliJsonWriterUInt64(writer, "roomCreateCount", state->roomCreateCount);
+        clvCliJsonWriterUInt64(writer, "roomListCount", state->roomListCount);
+        return;
+    }
+    clvCliJsonWriterBool(writer, "hasStartedConclave", state->hasStartedConclave);
+    if (state->hasStartedConclave) {
+        clvCliJsonWriterString(
+            writer, "clientState", clvClientStateToString((ClvClientState)state->clientState));
+    }
+}
+
+static void writeStats(ClvCliJsonWriter* writer, const ClvCliNetworkStats* stats)
+{
+    clvCliJsonWriterUInt64(writer, "swarmClientCount", stats->swarmClientCount);
+    clvCliJsonWriterObjectBegin(writer, "roundTripUs");
+    for (size_t i = 0; i < ClvCliRequestTypeCount; ++i) {
+        writeHistogram(writer, requestTypeKeys[i], &stats->histograms[i]);
+    }
+    clvCliJsonWriterObjectEnd(writer);
+    clvCliJsonWriterUInt64(writer, "unmatchedCount", stats->unmatchedCount);
+    clvCliJsonWriterUInt64(writer, "lostCount", stats->lostCount);
+    clvCliJsonWriterUInt64(writer, "journalCount", stats->journalCount);
+    clvCliJsonWriterUInt64(writer, "journalDroppedCount", stats->journalDroppedCount);
+    clvCliJsonWriterUInt64(writer, "coalescedCount", stats->coalescedCount);
+    clvCliJsonWriterUInt64(writer, "droppedEventCount", stats->droppedEventCount);
+    if (stats->swarmClientCount > 0) {
+        const ClvCliOwnerConvergenceReport* owner = &stats->ownerConvergence;
+        clvCliJsonWriterObjectBegin(writer, "ownerConvergence");
+        clvCliJsonWriterUInt64(writer, "roomCount", owner->roomCount);
+        clvCliJsonWriterUInt64(writer, "migrationCount", owner->migrationCount);
+        clvCliJsonWriterUInt64(writer, "convergedCount", owner->convergedCount);
+        clvCliJsonWriterUInt64(writer, "pendingCount", owner->pendingCount);
+        clvCliJsonWriterUInt64(writer, "supersededCount", owner->supersededCount);
+        clvCliJsonWriterUInt64(writer, "staleCount", owner->staleCount);
+        clvCliJsonWriterUInt64(writer, "droppedCount", owner->droppedCount);
+        writeHistogram(writer, "convergenceUs", &owner->convergenceLatencies);
+        clvCliJsonWriterObjectEnd(writer);
+    }
+}
+
+static void writeLoadReport(ClvCliJsonWriter* writer, const ClvCliLoadReport* report)
+{
+    clvCliJsonWriterString(writer, "requestType", requestTypeKeys[report->type]);
+    clvCliJsonWriterDouble(writer, "targetRate", report->targetRate);
+    clvCliJsonWriterUInt64(writer, "elapsedNs", report->elapsed);
+    clvCliJsonWriterUInt64(writer, "intendedCount", report->intendedCount);
+    clvCliJsonWriterUInt64(writer, "sentCount", report->sentCount);
+    clvCliJsonWriterUInt64(writer, "receivedCount", report->receivedCount);
+    clvCliJsonWriterUInt64(writer, "skippedCount", report->skippedCount);
+    writeHistogram(writer, "latencyUs", &report->latencies);
+}
+
+static void writeChurnReport(ClvCliJsonWriter* writer, const ClvCliChurnReport* report)
+{
+    clvCliJsonWriterDouble(writer, "targetRate", report->targetRate);
+    clvCliJsonWriterUInt64(writer, "elapsedNs", report->elapsed);
+    clvCliJsonWriterUInt64(writer, "listCount", report->listCount);
+    clvCliJsonWriterUInt64(writer, "emptyListCount", report->emptyListCount);
+    clvCliJsonWriterUInt64(writer, "joinCount", report->joinCount);
+    clvCliJsonWriterUInt64(writer, "joinedCount", report->joinedCount);
+    clvCliJsonWriterUInt64(writer, "failedCount", report->failedCount);
+    clvCliJsonWriterUInt64(writer, "leaveCount", report->leaveCount);
+    clvCliJsonWriterUInt64(writer, "convergedCount", report->convergedCount);
+    clvCliJsonWriterUInt64(writer, "notConvergedCount", report->notConvergedCount);
+    writeHistogram(writer, "joinLatencyUs", &report->joinLatencies);
+    writeHistogram(writer, "convergenceUs", &report->convergenceLatencies);
+}
+
+static void writeSimulateReport(ClvCliJsonWriter* writer, const ClvCliSimulateReport* report)
+{
+    clvCliJsonWriterUInt64(writer, "ticksPerSecond", report->ticksPerSecond);
+    clvCliJsonWriterUInt64(writer, "elapsedNs", report->elapsed);
+    clvCliJsonWriterUInt64(writer, "pingCount", report->pingCount);
+    clvCliJsonWriterUInt64(writer, "responseCount", report->responseCount);
+    clvCliJsonWriterUInt64(writer, "termChangeCount", report->termChangeCount);
+    clvCliJsonWriterUInt64(writer, "ownerChangeCount", report->ownerChangeCount);
+    clvCliJsonWriterUInt64(writer, "laggingCount", report->laggingCount);
+    clvCliJsonWriterUInt64(writer, "disconnectedCount", report->disconnectedCount);
+    clvCliJsonWriterUInt64(writer, "silentCount", report->silentCount);
+    clvCliJsonWriterUInt64(writer, "ownerCount", report->ownerCount);
+    clvCliJsonWriterUInt64(writer, "awaitingMigrationCount", report->awaitingMigrationCount);
+    writeHistogram(writer, "migrationUs", &report->migrationLatencies);
+}
+
+static void writeMemReport(ClvCliJsonWriter* writer, const ClvCliImprintReport* report)
+{
+    clvCliJsonWriterUInt64(writer, "clientCount", report->clientCount);
+    clvCliJsonWriterUInt64(writer, "budgetOctets", report->budgetOctets);
+    clvCliJsonWriterUInt64(writer, "allocationCount", report->allocationCount);
+    clvCliJsonWriterUInt64(writer, "freeCount", report->freeCount);
+    clvCliJsonWriterUInt64(writer, "failedCount", report->failedCount);
+    clvCliJsonWriterUInt64(writer, "untrackedFreeCount", report->untrackedFreeCount);
+    clvCliJsonWriterUInt64(writer, "requestedOctets", report->requestedOctets);
+    clvCliJsonWriterUInt64(writer, "liveOctets", report->liveOctets);
+    clvCliJsonWriterUInt64(writer, "peakLiveOctets", report->peakLiveOctets);
+    clvCliJsonWriterArrayBegin(writer, "sizeClasses");
+    for (size_t i = 0; i < CLV_CLI_IMPRINT_SIZE_CLASS_COUNT; ++i) {
+        const ClvCliImprintSizeClass* sizeClass = &report->sizeClasses[i];
+        if (sizeClass->allocationCount == 0) {
+            continue;
+        }
+        clvCliJsonWriterObjectBegin(writer, 0);
+        clvCliJsonWriterUInt64(writer, "octets", clvCliImprintSizeClassOctets(i));
+        clvCliJsonWriterUInt64(writer, "allocationCount", sizeClass->allocationCount);
+        clvCliJsonWriterUInt64(writer, "freeCount", sizeClass->freeCount);
+        clvCliJsonWriterUInt64(writer, "liveCount", sizeClass->liveCount);
+        clvCliJsonWriterUInt64(writer, "peakLiveCount", sizeClass->peakLiveCount);
+        clvCliJsonWriterObjectEnd(writer);
+    }
+    clvCliJsonWriterArrayEnd(writer);
+}
+
+static void writeWakeLatency(ClvCliJsonWriter* writer, const ClvCliWakeLatency* wakeLatency)
+{
+    clvCliJsonWriterUInt64(writer, "wakeCount", wakeLatency->wakeCount);
+    clvCliJsonWriterUInt64(writer, "handledCount", wakeLatency->handledCount);
+    if (wakeLatency->handledCount > 0) {
+        clvCliJsonWriterUInt64(writer, "minNs", wakeLatency->min);
+        clvCliJsonWriterUInt64(writer, "avgNs", wakeLatency->sum / wakeLatency->handledCount);
+        clvCliJsonWriterUInt64(writer, "maxNs", wakeLatency->max);
+    }
+}
+
+static void writePerf(ClvCliJsonWriter* writer, const ClvCliPerfReport* report)
+{
+    clvCliJsonWriterUInt64(writer, "windowNs", report->windowDuration);
+    clvCliJsonWriterUInt64(writer, "budgetNs", report->budget);
+    clvCliJsonWriterUInt64(writer, "frameCount", report->window.frameCount);
+    clvCliJsonWriterUInt64(writer, "overBudgetCount", report->window.overBudgetCount);
+    clvCliJsonWriterUInt64(writer, "totalFrameCount", report->totalFrameCount);
+    clvCliJsonWriterUInt64(writer, "totalOverBudgetCount", report->totalOverBudgetCount);
+    clvCliJsonWriterObjectBegin(writer, "wallUs");
+    for (size_t i = 0; i <= ClvCliPerfPhaseCount; ++i) {
+        writeHistogram(writer, perfPhaseKeys[i], &report->window.wall[i]);
+    }
+    clvCliJsonWriterObjectEnd(writer);
+    clvCliJsonWriterObjectBegin(writer, "cpuUs");
+    for (size_t i = 0; i <= ClvCliPerfPhaseCount; ++i) {
+        writeHistogram(writer, perfPhaseKeys[i], &report->window.cpu[i]);
+    }
+    clvCliJsonWriterObjectEnd(writer);
+}
+
+static void writeFrameOverBudget(ClvCliJsonWriter* writer, const ClvCliPerfWarning* warning)
+{
+    clvCliJsonWriterUInt64(writer, "budgetNs", warning->budget);
+    clvCliJsonWriterUInt64(writer, "overBudgetCount", warning->overBudgetCount);
+    clvCliJsonWriterObjectBegin(writer, "wallNs");
+    for (size_t i = 0; i <= ClvCliPerfPhaseCount; ++i) {
+        clvCliJsonWriterUInt64(writer, perfPhaseKeys[i], warning->frame.wall[i]);
+    }
+    clvCliJsonWriterObjectEnd(writer);
+    clvCliJsonWriterObjectBegin(writer, "cpuNs");
+    for (size_t i = 0; i <= ClvCliPerfPhaseCount; ++i) {
+        clvCliJsonWriterUInt64(writer, perfPhaseKeys[i], warning->frame.cpu[i]);
+    }
+    clvCliJsonWriterObjectEnd(writer);
+}
+
+/// Writes an event from the network thread as one JSON line
+/// Every line has the event name and the monotonic time in nanoseconds when it was published.
+/// @param writer writer
+/// @param event event, status events are not written
+void clvCliEventJsonWrite(ClvCliJsonWriter* writer, const ClvCliEvent* event)
+{
+    const char* name = 0;
+    switch (event->type) {
+        case ClvCliEventTypePingResponse:
+            name = "pingResponse";
+            break;
+        case ClvCliEventTypeRoomCreated:
+            name = "roomCreated";
+            break;
+        case ClvCliEventTypeRoomList:
+            name = "roomList";
+            break;
+        case ClvCliEventTypeState:
+            name = "state";
+            break;
+        case ClvCliEventTypeStats:
+            name = "stats";
+            break;
+        case ClvCliEventTypeLoadReport:
+            name = "loadReport";
+            break;
+        case ClvCliEventTypeWakeLatency:
+            name = "wakeLatency";
+            break;
+        case ClvCliEventTypePerf:
+            name = "perf";
+            break;
+        case ClvCliEventTypeFrameOverBudget:
+            name = "frameOverBudget";
+            break;
+        case ClvCliEventTypeRequestDone:
+            name = "requestDone";
+            break;
+        case ClvCliEventTypeChurnReport:
+            name = "churnReport";
+            break;
+        case ClvCliEventTypeSimulateReport:
+            name = "simulateReport";
+            break;
+        case ClvCliEventTypeMemReport:
+            name = "memReport";
+            break;
+        case ClvCliEventTypeStatus:
+            return;
+    }
+
+    clvCliJsonWriterObjectBegin(writer, 0);
+    clvCliJsonWriterString(writer, "event", name);
+    clvCliJsonWriterUInt64(writer, "timeNs", event->time);
+    if (event->journalSequence != 0) {
+        clvCliJsonWriterUInt64(writer, "sequence", event->journalSequence);
+    }
+
+    switch (event->type) {
+        case ClvCliEventTypePingResponse:
+            writePingResponse(writer, &event->data.pingResponse);
+            break;
+        case ClvCliEventTypeRoomCreated:
+            clvCliJsonWriterUInt64(writer, "roomId", event->data.roomCreated.roomId);
+            clvCliJsonWriterUInt64(
+                writer, "roomConnectionIndex", event->data.roomCreated.roomConnectionIndex);
+            break;
+        case ClvCliEventTypeRoomList:
+            writeRoomList(writer, event->data.roomList);
+            break;
+        case ClvCliEventTypeState:
+            writeState(writer, &event->data.state);
+            break;
+        case ClvCliEventTypeStats:
+            writeStats(writer, event->data.stats);
+            break;
+        case ClvCliEventTypeLoadReport:
+            writeLoadReport(writer, event->data.loadReport);
+            break;
+        case ClvCliEventTypeWakeLatency:
+            writeWakeLatency(writer, &event->data.wakeLatency);
+            break;
+        case ClvCliEventTypePerf:
+            writePerf(writer, event->data.perf);
+            break;
+        case ClvCliEventTypeFrameOverBudget:
+            writeFrameOverBudget(writer, &event->data.frameOverBudget);
+            break;
+        case ClvCliEventTypeRequestDone:
+            clvCliJsonWriterUInt64(
+                writer, "correlationId", event->data.requestDone.correlationId);
+            clvCliJsonWriterString(
+                writer, "requestType", requestTypeKeys[event->data.requestDone.type]);
+            clvCliJsonWriterUInt64(writer, "roundTripNs", event->data.requestDone.roundTrip);
+            clvCliJsonWriterBool(writer, "isLost", event->data.requestDone.isLost);
+            break;
+        case ClvCliEventTypeChurnReport:
+            writeChurnReport(writer, event->data.churnReport);
+            break;
+        case ClvCliEventTypeSimulateReport:
+            writeSimulateReport(writer, event->data.simulateReport);
+            break;
+        case ClvCliEventTypeMemReport:
+            writeMemReport(writer, event->data.memReport);
+            break;
+        case ClvCliEventTypeStatus:
+            break;
+    }
+
+    clvCliJsonWriterObjectEnd(writer);
+    clvCliJsonWriterLineEnd(writer);
+}
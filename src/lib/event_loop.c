@@ -0,0 +1,353 @@
+/*----------------------------------------------------------------------------------------------------------
+ *  Copyright (c) Peter Bjorklund. All rights reserved. https://github.com/piot/conclave-client-cli
+ *  Licensed under the MIT License. See LICENSE in the project root for license information.
+ *--------------------------------------------------------------------------------------------------------*/
+#define _POSIX_C_SOURCE 200809L
+#include <clog/clog.h>
+#include <conclave-client-cli/event_loop.h>
+#include <errno.h>
+#include <inttypes.h>
+#include <stdio.h>
+
+#if defined TORNADO_OS_LINUX
+#include <linux/sockios.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/ioctl.h>
+#include <sys/timerfd.h>
+#include <unistd.h>
+#endif
+
+/// Initializes an epoll based event loop with a one-shot timer
+/// On other platforms than Linux it fails, and the caller should fall back to polling.
+/// @param self event loop
+/// @return negative on error
+int clvCliEventLoopInit(ClvCliEventLoop* self)
+{
+#if defined TORNADO_OS_LINUX
+    self->epollHandle = epoll_create1(0);
+    if (self->epollHandle < 0) {
+        CLOG_SOFT_ERROR("could not create epoll: %d", errno)
+        return -1;
+    }
+
+    self->timerHandle = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK);
+    if (self->timerHandle < 0) {
+        CLOG_SOFT_ERROR("could not create timer: %d", errno)
+        close(self->epollHandle);
+        return -2;
+    }
+
+    self->readySocketCount = 0;
+
+    return clvCliEventLoopAdd(self, self->timerHandle, ClvCliEventLoopSourceTimer, 0);
+#else
+    self->epollHandle = -1;
+    self->timerHandle = -1;
+    self->readySocketCount = 0;
+    return -1;
+#endif
+}
+
+void clvCliEventLoopDestroy(ClvCliEventLoop* self)
+{
+#if defined TORNADO_OS_LINUX
+    close(self->timerHandle);
+    close(self->epollHandle);
+#endif
+    self->timerHandle = -1;
+    self->epollHandle = -1;
+}
+
+/// Adds a file handle to wait for
+/// @param self event loop
+/// @param handle socket or file handle that is checked for readability
+/// @param source reported from clvCliEventLoopWait() when the handle is readable
+/// @param userIndex reported in readySocketIndices for sockets, e.g. the index of the swarm client
+/// @return CLV_CLI_EVENT_LOOP_NOT_WAITABLE if the handle is always readable, negative on error
+int clvCliEventLoopAdd(
+    ClvCliEventLoop* self, int handle, ClvCliEventLoopSource source, uint32_t userIndex)
+{
+#if defined TORNADO_OS_LINUX
+    struct epoll_event event;
+    event.events = EPOLLIN;
+    event.data.u64 = ((uint64_t)userIndex << 32) | (uint64_t)source;
+
+    if (epoll_ctl(self->epollHandle, EPOLL_CTL_ADD, handle, &event) < 0) {
+        if (errno == EPERM) {
+            return CLV_CLI_EVENT_LOOP_NOT_WAITABLE;
+        }
+        CLOG_SOFT_ERROR("could not add handle %d to epoll: %d", handle, errno)
+        return -1;
+    }
+    return 0;
+#else
+    (void)self;
+    (void)handle;
+    (void)source;
+    (void)userIndex;
+    return -1;
+#endif
+}
+
+/// Also waits for an added handle to become writable, or stops waiting for it
+/// Only needed while there is output that the handle did not take.
+/// @param self event loop
+/// @param handle handle that has been added with clvCliEventLoopAdd()
+/// @param source same as when the handle was added
+/// @param userIndex same as when the handle was added
+/// @param isWaitingForWrite true to be woken up when the handle is writable
+/// @return negative on error
+int clvCliEventLoopWaitForWrite(ClvCliEventLoop* self, int handle, ClvCliEventLoopSource source,
+    uint32_t userIndex, bool isWaitingForWrite)
+{
+#if defined TORNADO_OS_LINUX
+    struct epoll_event event;
+    event.events = isWaitingForWrite ? EPOLLIN | EPOLLOUT : EPOLLIN;
+    event.data.u64 = ((uint64_t)userIndex << 32) | (uint64_t)source;
+
+    if (epoll_ctl(self->epollHandle, EPOLL_CTL_MOD, handle, &event) < 0) {
+        CLOG_SOFT_ERROR("could not change handle %d in epoll: %d", handle, errno)
+        return -1;
+    }
+    return 0;
+#else
+    (void)self;
+    (void)handle;
+    (void)source;
+    (void)userIndex;
+    (void)isWaitingForWrite;
+    return -1;
+#endif
+}
+
+/// Arms (or re-arms) the one-shot timer
+/// @param self event loop
+/// @param milliseconds time until the timer wakes up the loop
+/// @return negative on error
+int clvCliEventLoopArmTimer(ClvCliEventLoop* self, size_t milliseconds)
+{
+#if defined TORNADO_OS_LINUX
+    struct itimerspec spec;
+    spec.it_interval.tv_sec = 0;
+    spec.it_interval.tv_nsec = 0;
+    spec.it_value.tv_sec = (time_t)(milliseconds / 1000);
+    spec.it_value.tv_nsec = (long)(milliseconds % 1000) * 1000000;
+    if (milliseconds == 0) {
+        spec.it_value.tv_nsec = 1;
+    }
+
+    return timerfd_settime(self->timerHandle, 0, &spec, 0);
+#else
+    (void)self;
+    (void)milliseconds;
+    return -1;
+#endif
+}
+
+/// Blocks until at least one of the added handles or the timer is readable
+/// @param self event loop
+/// The user indices of the readable sockets are stored in readySocketIndices.
+/// @return bitmask of ClvCliEventLoopSource, zero if interrupted by a signal, negative on error
+int clvCliEventLoopWait(ClvCliEventLoop* self)
+{
+#if defined TORNADO_OS_LINUX
+    struct epoll_event events[CLV_CLI_EVENT_LOOP_MAX_READY];
+
+    self->readySocketCount = 0;
+    int count = epoll_wait(self->epollHandle, events, CLV_CLI_EVENT_LOOP_MAX_READY, -1);
+    if (count < 0) {
+        if (errno == EINTR) {
+            return 0;
+        }
+        CLOG_SOFT_ERROR("epoll wait failed: %d", errno)
+        return -1;
+    }
+
+    int sources = 0;
+    for (int i = 0; i < count; ++i) {
+        int source = (int)(events[i].data.u64 & 0xff);
+        sources |= source;
+        if (source == ClvCliEventLoopSourceSocket) {
+            self->readySocketIndices[self->readySocketCount++] = (uint32_t)(events[i].data.u64 >> 32);
+        }
+    }
+
+    if (sources & ClvCliEventLoopSourceTimer) {
+        uint64_t expirations;
+        ssize_t octetsRead = read(self->timerHandle, &expirations, sizeof(expirations));
+        (void)octetsRead;
+    }
+
+    return sources;
+#else
+    (void)self;
+    return -1;
+#endif
+}
+
+/// Creates a handle that another thread can use to wake up an event loop
+/// @return handle, or negative if not supported
+int clvCliWakeupCreate(void)
+{
+#if defined TORNADO_OS_LINUX
+    int handle = eventfd(0, EFD_NONBLOCK);
+    if (handle < 0) {
+        CLOG_SOFT_ERROR("could not create eventfd: %d", errno)
+    }
+    return handle;
+#else
+    return -1;
+#endif
+}
+
+void clvCliWakeupDestroy(int handle)
+{
+#if defined TORNADO_OS_LINUX
+    if (handle >= 0) {
+        close(handle);
+    }
+#else
+    (void)handle;
+#endif
+}
+
+/// Wakes up the event loop that waits for the handle (any thread)
+void clvCliWakeupSignal(int handle)
+{
+#if defined TORNADO_OS_LINUX
+    if (handle < 0) {
+        return;
+    }
+    uint64_t one = 1;
+    ssize_t octetsWritten = write(handle, &one, sizeof(one));
+    (void)octetsWritten;
+#else
+    (void)handle;
+#endif
+}
+
+/// Resets the handle after the event loop has woken up
+void clvCliWakeupClear(int handle)
+{
+#if defined TORNADO_OS_LINUX
+    uint64_t count;
+    ssize_t octetsRead = read(handle, &count, sizeof(count));
+    (void)octetsRead;
+#else
+    (void)handle;
+#endif
+}
+
+/// Makes the kernel stamp every datagram that the socket receives with its arrival time
+/// The first SIOCGSTAMPNS turns the stamping on, and fails as nothing has been received yet.
+/// (SO_TIMESTAMPNS would instead need recvmsg() to get the stamp as a control message.)
+/// @param handle UDP socket
+/// @return negative if not supported
+int clvCliSocketEnableArrivalTime(int handle)
+{
+#if defined TORNADO_OS_LINUX
+    struct timespec ts;
+    if (ioctl(handle, SIOCGSTAMPNS, &ts) < 0 && errno != ENOENT) {
+        CLOG_SOFT_ERROR("could not enable receive timestamps: %d", errno)
+        return -1;
+    }
+    return 0;
+#else
+    (void)handle;
+    return -1;
+#endif
+}
+
+/// Gets when the kernel received the datagram that was read last from the socket
+/// @param handle socket, from clvCliSocketEnableArrivalTime()
+/// @param arrivedAt set to the arrival time, in clvCliClockRealtimeNs() time
+/// @return false if there is no arrival time
+bool clvCliSocketArrivalTime(int handle, ClvCliTimeNs* arrivedAt)
+{
+#if defined TORNADO_OS_LINUX
+    struct timespec ts;
+    if (ioctl(handle, SIOCGSTAMPNS, &ts) < 0) {
+        return false;
+    }
+    *arrivedAt = (ClvCliTimeNs)ts.tv_sec * 1000000000u + (ClvCliTimeNs)ts.tv_nsec;
+    return true;
+#else
+    (void)handle;
+    (void)arrivedAt;
+    return false;
+#endif
+}
+
+void clvCliWakeLatencyInit(ClvCliWakeLatency* self, ClvCliTimeNs now)
+{
+    self->wakeCount = 0;
+    self->handledCount = 0;
+    self->sum = 0;
+    self->min = UINT64_MAX;
+    self->max = 0;
+    self->startedAt = now;
+}
+
+/// Records the time from the kernel receiving a datagram until it was handled
+/// This includes the time the datagram waited in the socket before the loop woke up, which is
+/// what differs between waiting on the socket and sleeping between updates.
+/// @param self latency statistics
+/// @param arrivedAt when the kernel received the datagram, from clvCliSocketArrivalTime()
+/// @param handledAt when the clients had been updated and the changes were published, in the
+/// same clock
+void clvCliWakeLatencyAdd(
+    ClvCliWakeLatency* self, ClvCliTimeNs arrivedAt, ClvCliTimeNs handledAt)
+{
+    if (handledAt < arrivedAt) {
+        // The wall clock was set back
+        return;
+    }
+    ClvCliTimeNs latency = handledAt - arrivedAt;
+    self->handledCount++;
+    self->sum += latency;
+    if (latency < self->min) {
+        self->min = latency;
+    }
+    if (latency > self->max) {
+        self->max = latency;
+    }
+}
+
+/// Formats the statistics gathered since the period started
+/// @param self latency statistics
+/// @param description name of the loop
+/// @param now current time
+/// @param target where to write the line
+/// @param maxOctetCount size of target
+/// @return same as snprintf()
+int clvCliWakeLatencyFormat(const ClvCliWakeLatency* self, const char* description,
+    ClvCliTimeNs now, char* target, size_t maxOctetCount)
+{
+    ClvCliTimeNs period = now - self->startedAt;
+    uint64_t wakesPerSecond = period == 0 ? 0 : self->wakeCount * 1000000000u / period;
+
+    if (self->handledCount == 0) {
+        return snprintf(target, maxOctetCount, "%s: wakes/s:%" PRIu64 " no datagrams handled\n",
+            description, wakesPerSecond);
+    }
+
+    return snprintf(target, maxOctetCount,
+        "%s: wakes/s:%" PRIu64 " handled:%zu arrival-to-handled us min:%" PRIu64 " avg:%" PRIu64
+        " max:%" PRIu64 "\n",
+        description, wakesPerSecond, self->handledCount, self->min / 1000,
+        self->sum / self->handledCount / 1000, self->max / 1000);
+}
+
+/// Prints the statistics gathered since last report and starts a new period
+/// @param self latency statistics
+/// @param description name of the loop
+/// @param now current time
+void clvCliWakeLatencyReport(ClvCliWakeLatency* self, const char* description, ClvCliTimeNs now)
+{
+    char line[256];
+    clvCliWakeLatencyFormat(self, description, now, line, sizeof(line));
+    fputs(line, stdout);
+
+    clvCliWakeLatencyInit(self, now);
+}
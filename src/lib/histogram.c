@@ -0,0 +1,113 @@
+/*----------------------------------------------------------------------------------------------------------
+ *  Copyright (c) Peter Bjorklund. All rights reserved. https://github.com/piot/conclave-client-cli
+ *  Licensed under the MIT License. See LICENSE in the project root for license information.
+ *--------------------------------------------------------------------------------------------------------*/
+#include <conclave-client-cli/histogram.h>
+#include <tiny-libc/tiny_libc.h>
+
+#define HALF_SUB_BUCKET_COUNT (CLV_CLI_HISTOGRAM_SUB_BUCKET_COUNT / 2)
+
+static size_t bucketIndex(uint64_t value)
+{
+    if (value < CLV_CLI_HISTOGRAM_SUB_BUCKET_COUNT) {
+        return (size_t)value;
+    }
+
+    size_t mostSignificantBit = 63;
+    while (!(value & ((uint64_t)1 << mostSignificantBit))) {
+        mostSignificantBit--;
+    }
+
+    size_t shift = mostSignificantBit - (CLV_CLI_HISTOGRAM_SUB_BUCKET_BITS - 1);
+    size_t subBucket = (size_t)(value >> shift);
+    size_t index = CLV_CLI_HISTOGRAM_SUB_BUCKET_COUNT + (shift - 1) * HALF_SUB_BUCKET_COUNT
+        + (subBucket - HALF_SUB_BUCKET_COUNT);
+    if (index >= CLV_CLI_HISTOGRAM_BUCKET_COUNT) {
+        return CLV_CLI_HISTOGRAM_BUCKET_COUNT - 1;
+    }
+
+    return index;
+}
+
+/// Returns the highest value that is stored in the bucket
+static uint64_t bucketValue(size_t index)
+{
+    if (index < CLV_CLI_HISTOGRAM_SUB_BUCKET_COUNT) {
+        return index;
+    }
+
+    size_t offset = index - CLV_CLI_HISTOGRAM_SUB_BUCKET_COUNT;
+    size_t shift = offset / HALF_SUB_BUCKET_COUNT + 1;
+    uint64_t subBucket = offset % HALF_SUB_BUCKET_COUNT + HALF_SUB_BUCKET_COUNT;
+
+    return ((subBucket + 1) << shift) - 1;
+}
+
+void clvCliHistogramInit(ClvCliHistogram* self)
+{
+    tc_mem_clear_type(self);
+    self->min = UINT64_MAX;
+}
+
+void clvCliHistogramAdd(ClvCliHistogram* self, uint64_t value)
+{
+    self->counts[bucketIndex(value)]++;
+    self->count++;
+    self->sum += value;
+    if (value < self->min) {
+        self->min = value;
+    }
+    if (value > self->max) {
+        self->max = value;
+    }
+}
+
+/// Adds all the values recorded in other to self
+/// @param self target histogram
+/// @param other histogram to add
+void clvCliHistogramMerge(ClvCliHistogram* self, const ClvCliHistogram* other)
+{
+    for (size_t i = 0; i < CLV_CLI_HISTOGRAM_BUCKET_COUNT; ++i) {
+        self->counts[i] += other->counts[i];
+    }
+    self->count += other->count;
+    self->sum += other->sum;
+    if (other->min < self->min) {
+        self->min = other->min;
+    }
+    if (other->max > self->max) {
+        self->max = other->max;
+    }
+}
+
+/// Finds the value that the given percentage of all recorded values are less than or equal to
+/// @param self histogram
+/// @param percentile percentile, e.g. 99.9
+/// @return value, or zero if nothing has been recorded
+uint64_t clvCliHistogramPercentile(const ClvCliHistogram* self, double percentile)
+{
+    if (self->count == 0) {
+        return 0;
+    }
+
+    uint64_t target = (uint64_t)(percentile / 100.0 * (double)self->count + 0.5);
+    if (target == 0) {
+        target = 1;
+    }
+
+    uint64_t accumulated = 0;
+    for (size_t i = 0; i < CLV_CLI_HISTOGRAM_BUCKET_COUNT; ++i) {
+        accumulated += self->counts[i];
+        if (accumulated >= target) {
+            uint64_t value = bucketValue(i);
+            return value > self->max ? self->max : value;
+        }
+    }
+
+    return self->max;
+}
+
+uint64_t clvCliHistogramMean(const ClvCliHistogram* self)
+{
+    return self->count == 0 ? 0 : self->sum / self->count;
+}
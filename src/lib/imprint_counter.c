@@ -0,0 +1,250 @@
+/*----------------------------------------------------------------------------------------------------------
+ *  Copyright (c) Peter Bjorklund. All rights reserved. https://github.com/piot/conclave-client-cli
+ *  Licensed under the MIT License. See LICENSE in the project root for license information.
+ *--------------------------------------------------------------------------------------------------------*/
+#include <clog/clog.h>
+#include <conclave-client-cli/imprint_counter.h>
+#include <stdbool.h>
+#include <tiny-libc/tiny_libc.h>
+
+static const size_t initialCapacity = 1024;
+
+size_t clvCliImprintSizeClassOctets(size_t sizeClass)
+{
+    return (size_t)1 << (sizeClass + CLV_CLI_IMPRINT_SMALLEST_SIZE_CLASS_SHIFT);
+}
+
+static size_t sizeClassOf(size_t size)
+{
+    size_t sizeClass = 0;
+    while (sizeClass < CLV_CLI_IMPRINT_SIZE_CLASS_COUNT - 1
+        && clvCliImprintSizeClassOctets(sizeClass) < size) {
+        sizeClass++;
+    }
+
+    return sizeClass;
+}
+
+static size_t slotOf(const ClvCliImprintCounter* self, uintptr_t pointer)
+{
+    // The low bits are the same for aligned pointers
+    return (size_t)((pointer >> 4) * 11400714819323198485u) & (self->capacity - 1);
+}
+
+static int allocateTable(ClvCliImprintCounter* self, size_t capacity)
+{
+    uintptr_t* pointers = tc_malloc_type_count(uintptr_t, capacity);
+    uint32_t* sizes = tc_malloc_type_count(uint32_t, capacity);
+    if (pointers == 0 || sizes == 0) {
+        tc_free(pointers);
+        tc_free(sizes);
+        return -1;
+    }
+    tc_mem_clear_type_n(pointers, capacity);
+
+    uintptr_t* oldPointers = self->pointers;
+    uint32_t* oldSizes = self->sizes;
+    size_t oldCapacity = self->capacity;
+    self->pointers = pointers;
+    self->sizes = sizes;
+    self->capacity = capacity;
+    for (size_t i = 0; i < oldCapacity; ++i) {
+        if (oldPointers[i] == 0) {
+            continue;
+        }
+        size_t slot = slotOf(self, oldPointers[i]);
+        while (pointers[slot] != 0) {
+            slot = (slot + 1) & (capacity - 1);
+        }
+        pointers[slot] = oldPointers[i];
+        sizes[slot] = oldSizes[i];
+    }
+    tc_free(oldPointers);
+    tc_free(oldSizes);
+
+    return 0;
+}
+
+/// Remembers the size of a live allocation
+/// @return false if the table could not grow, the allocation is then not tracked
+static bool track(ClvCliImprintCounter* self, uintptr_t pointer, size_t size)
+{
+    if (self->count * 2 >= self->capacity && allocateTable(self, self->capacity * 2) < 0) {
+        return false;
+    }
+    size_t slot = slotOf(self, pointer);
+    while (self->pointers[slot] != 0) {
+        slot = (slot + 1) & (self->capacity - 1);
+    }
+    self->pointers[slot] = pointer;
+    self->sizes[slot] = (uint32_t)size;
+    self->count++;
+
+    return true;
+}
+
+/// Forgets a live allocation, moving back later entries of the same probe sequence
+/// @return false if the pointer was not tracked
+static bool untrack(ClvCliImprintCounter* self, uintptr_t pointer, size_t* size)
+{
+    size_t mask = self->capacity - 1;
+    size_t slot = slotOf(self, pointer);
+    while (self->pointers[slot] != pointer) {
+        if (self->pointers[slot] == 0) {
+            return false;
+        }
+        slot = (slot + 1) & mask;
+    }
+    *size = self->sizes[slot];
+    self->count--;
+
+    size_t hole = slot;
+    for (size_t next = (hole + 1) & mask; self->pointers[next] != 0; next = (next + 1) & mask) {
+        size_t home = slotOf(self, self->pointers[next]);
+        // An entry can fill the hole if its home slot is not between the hole and itself
+        if (((next - home) & mask) >= ((next - hole) & mask)) {
+            self->pointers[hole] = self->pointers[next];
+            self->sizes[hole] = self->sizes[next];
+            hole = next;
+        }
+    }
+    self->pointers[hole] = 0;
+
+    return true;
+}
+
+static void counted(ClvCliImprintCounter* self, void* pointer, size_t size)
+{
+    ClvCliImprintReport* report = &self->report;
+    if (pointer == 0) {
+        report->failedCount++;
+        return;
+    }
+    report->allocationCount++;
+    if (!track(self, (uintptr_t)pointer, size)) {
+        return;
+    }
+
+    size_t sizeClass = sizeClassOf(size);
+    ClvCliImprintSizeClass* counts = &report->sizeClasses[sizeClass];
+    counts->allocationCount++;
+    counts->liveCount++;
+    if (counts->liveCount > counts->peakLiveCount) {
+        counts->peakLiveCount = counts->liveCount;
+    }
+    report->requestedOctets += size;
+    report->liveOctets += clvCliImprintSizeClassOctets(sizeClass);
+    if (report->liveOctets > report->peakLiveOctets) {
+        report->peakLiveOctets = report->liveOctets;
+    }
+}
+
+static void* countedAlloc(
+    void* _self, size_t size, const char* sourceFile, size_t line, const char* description)
+{
+    ClvCliImprintCounter* self = (ClvCliImprintCounter*)_self;
+    void* pointer = self->target->allocator.allocDebugFn(
+        self->target, size, sourceFile, line, description);
+    counted(self, pointer, size);
+
+    return pointer;
+}
+
+static void* countedCalloc(
+    void* _self, size_t size, const char* sourceFile, size_t line, const char* description)
+{
+    ClvCliImprintCounter* self = (ClvCliImprintCounter*)_self;
+    void* pointer = self->target->allocator.callocDebugFn(
+        self->target, size, sourceFile, line, description);
+    counted(self, pointer, size);
+
+    return pointer;
+}
+
+static void countedFree(
+    void* _self, void* pointer, const char* sourceFile, size_t line, const char* description)
+{
+    ClvCliImprintCounter* self = (ClvCliImprintCounter*)_self;
+    self->target->freeDebugFn(self->target, pointer, sourceFile, line, description);
+    if (pointer == 0) {
+        return;
+    }
+
+    ClvCliImprintReport* report = &self->report;
+    report->freeCount++;
+    size_t size;
+    if (!untrack(self, (uintptr_t)pointer, &size)) {
+        report->untrackedFreeCount++;
+        return;
+    }
+    size_t sizeClass = sizeClassOf(size);
+    report->sizeClasses[sizeClass].freeCount++;
+    report->sizeClasses[sizeClass].liveCount--;
+    report->requestedOctets -= size;
+    report->liveOctets -= clvCliImprintSizeClassOctets(sizeClass);
+}
+
+/// Initializes a counter in front of an allocator
+/// @param self counter
+/// @param target allocator that does the allocations
+/// @param budgetOctets octets that the target was set up with, only reported
+/// @param clientCount conclave clients that will use the counter, only reported
+/// @return negative on error
+int clvCliImprintCounterInit(ClvCliImprintCounter* self, ImprintAllocatorWithFree* target,
+    size_t budgetOctets, size_t clientCount)
+{
+    self->info.allocator.allocDebugFn = countedAlloc;
+    self->info.allocator.callocDebugFn = countedCalloc;
+    self->info.freeDebugFn = countedFree;
+    self->target = target;
+    self->pointers = 0;
+    self->sizes = 0;
+    self->capacity = 0;
+    self->count = 0;
+    clvCliImprintReportInit(&self->report);
+    self->report.clientCount = clientCount;
+    self->report.budgetOctets = budgetOctets;
+
+    if (allocateTable(self, initialCapacity) < 0) {
+        CLOG_SOFT_ERROR("could not allocate imprint counter")
+        return -1;
+    }
+
+    return 0;
+}
+
+void clvCliImprintCounterDestroy(ClvCliImprintCounter* self)
+{
+    tc_free(self->pointers);
+    tc_free(self->sizes);
+    self->pointers = 0;
+    self->sizes = 0;
+    self->capacity = 0;
+    self->count = 0;
+}
+
+void clvCliImprintReportInit(ClvCliImprintReport* self)
+{
+    tc_mem_clear_type(self);
+}
+
+void clvCliImprintReportMerge(ClvCliImprintReport* self, const ClvCliImprintReport* other)
+{
+    self->clientCount += other->clientCount;
+    self->budgetOctets += other->budgetOctets;
+    self->allocationCount += other->allocationCount;
+    self->freeCount += other->freeCount;
+    self->failedCount += other->failedCount;
+    self->untrackedFreeCount += other->untrackedFreeCount;
+    self->requestedOctets += other->requestedOctets;
+    self->liveOctets += other->liveOctets;
+    self->peakLiveOctets += other->peakLiveOctets;
+    for (size_t i = 0; i < CLV_CLI_IMPRINT_SIZE_CLASS_COUNT; ++i) {
+        ClvCliImprintSizeClass* target = &self->sizeClasses[i];
+        const ClvCliImprintSizeClass* source = &other->sizeClasses[i];
+        target->allocationCount += source->allocationCount;
+        target->freeCount += source->freeCount;
+        target->liveCount += source->liveCount;
+        target->peakLiveCount += source->peakLiveCount;
+    }
+}
@@ -0,0 +1,169 @@
+/*----------------------------------------------------------------------------------------------------------
+ *  Copyright (c) Peter Bjorklund. All rights reserved. https://github.com/piot/conclave-client-cli
+ *  Licensed under the MIT License. See LICENSE in the project root for license information.
+ *--------------------------------------------------------------------------------------------------------*/
+#include <conclave-client-cli/in_flight.h>
+
+void clvCliInFlightInit(ClvCliInFlight* self)
+{
+    self->readIndex = 0;
+    self->count = 0;
+    self->pendingCount = 0;
+    self->forgottenCount = 0;
+    self->lostCount = 0;
+    self->lastCorrelationId = 0;
+    for (size_t i = 0; i < ClvCliRequestTypeCount; ++i) {
+        clvCliHistogramInit(&self->latencies[i]);
+    }
+}
+
+static ClvCliInFlightRequest* requestAt(ClvCliInFlight* self, size_t index)
+{
+    return &self->requests[(self->readIndex + index) % CLV_CLI_IN_FLIGHT_CAPACITY];
+}
+
+static void markDone(ClvCliInFlight* self, ClvCliInFlightRequest* request, ClvCliTimeNs latency)
+{
+    request->isDone = true;
+    request->latency = latency;
+    self->pendingCount--;
+    clvCliHistogramAdd(&self->latencies[request->type], latency / 1000);
+}
+
+/// Remembers a request that was sent to the network thread
+/// If too many requests are remembered, the oldest one is forgotten.
+/// @param self in flight requests
+/// @param correlationId command sequence, higher than for any earlier request
+/// @param type request type
+/// @param now time when the request was issued
+void clvCliInFlightIssued(
+    ClvCliInFlight* self, uint64_t correlationId, ClvCliRequestType type, ClvCliTimeNs now)
+{
+    if (self->count == CLV_CLI_IN_FLIGHT_CAPACITY) {
+        ClvCliInFlightRequest* oldest = requestAt(self, 0);
+        if (!oldest->isDone) {
+            self->pendingCount--;
+            self->forgottenCount++;
+        }
+        self->readIndex = (self->readIndex + 1) % CLV_CLI_IN_FLIGHT_CAPACITY;
+        self->count--;
+    }
+
+    ClvCliInFlightRequest* request = requestAt(self, self->count);
+    request->correlationId = correlationId;
+    request->issuedAt = now;
+    request->latency = 0;
+    request->type = (uint8_t)type;
+    request->isDone = false;
+    request->isLost = false;
+    self->count++;
+    self->pendingCount++;
+    self->lastCorrelationId = correlationId;
+}
+
+static bool findIndex(const ClvCliInFlight* self, uint64_t correlationId, size_t* index)
+{
+    size_t low = 0;
+    size_t high = self->count;
+    while (low < high) {
+        size_t middle = low + (high - low) / 2;
+        uint64_t middleId
+            = self->requests[(self->readIndex + middle) % CLV_CLI_IN_FLIGHT_CAPACITY].correlationId;
+        if (middleId == correlationId) {
+            *index = middle;
+            return true;
+        }
+        if (middleId < correlationId) {
+            low = middle + 1;
+        } else {
+            high = middle;
+        }
+    }
+
+    return false;
+}
+
+/// Finds a remembered request
+/// @param self in flight requests
+/// @param correlationId correlation id
+/// @return the request, or NULL if it was never issued or has been forgotten
+const ClvCliInFlightRequest* clvCliInFlightFind(const ClvCliInFlight* self, uint64_t correlationId)
+{
+    size_t index;
+    if (!findIndex(self, correlationId, &index)) {
+        return 0;
+    }
+
+    return &self->requests[(self->readIndex + index) % CLV_CLI_IN_FLIGHT_CAPACITY];
+}
+
+/// Marks a request as done, when the network thread has matched its response
+/// @param self in flight requests
+/// @param correlationId correlation id
+/// @param latency round trip time measured by the network thread
+void clvCliInFlightDone(ClvCliInFlight* self, uint64_t correlationId, ClvCliTimeNs latency)
+{
+    size_t index;
+    if (!findIndex(self, correlationId, &index)) {
+        return;
+    }
+    ClvCliInFlightRequest* request = requestAt(self, index);
+    if (!request->isDone) {
+        markDone(self, request, latency);
+    }
+}
+
+/// Marks a request as done without a response, when the network thread has given up on it
+/// The latency is not recorded.
+/// @param self in flight requests
+/// @param correlationId correlation id
+void clvCliInFlightLost(ClvCliInFlight* self, uint64_t correlationId)
+{
+    size_t index;
+    if (!findIndex(self, correlationId, &index)) {
+        return;
+    }
+    ClvCliInFlightRequest* request = requestAt(self, index);
+    if (request->isDone) {
+        return;
+    }
+    request->isDone = true;
+    request->isLost = true;
+    self->pendingCount--;
+    self->lostCount++;
+}
+
+/// Marks all requests of a type up to a correlation id as done
+/// Used when the network thread reports that nothing of the type is pending, e.g. for the swarm
+/// that does not report each response. The latency is measured from when it was issued.
+/// @param self in flight requests
+/// @param type request type
+/// @param correlationId the last command that the network thread has executed
+/// @param now time when the status was received
+void clvCliInFlightDoneUpTo(
+    ClvCliInFlight* self, ClvCliRequestType type, uint64_t correlationId, ClvCliTimeNs now)
+{
+    for (size_t i = 0; i < self->count && self->pendingCount > 0; ++i) {
+        ClvCliInFlightRequest* request = requestAt(self, i);
+        if (request->correlationId > correlationId) {
+            break;
+        }
+        if (!request->isDone && request->type == type) {
+            markDone(self, request, now - request->issuedAt);
+        }
+    }
+}
+
+/// Checks if a request is done
+/// @param self in flight requests
+/// @param correlationId correlation id, zero for all requests
+/// @return true if done, or if it is not remembered
+bool clvCliInFlightIsDone(const ClvCliInFlight* self, uint64_t correlationId)
+{
+    if (correlationId == 0) {
+        return self->pendingCount == 0;
+    }
+    const ClvCliInFlightRequest* request = clvCliInFlightFind(self, correlationId);
+
+    return request == 0 || request->isDone;
+}
@@ -0,0 +1,76 @@
+/*----------------------------------------------------------------------------------------------------------
+ *  Copyright (c) Peter Bjorklund. All rights reserved. https://github.com/piot/conclave-client-cli
+ *  Licensed under the MIT License. See LICENSE in the project root for license information.
+ *--------------------------------------------------------------------------------------------------------*/
+#include <clog/clog.h>
+#include <conclave-client-cli/journal.h>
+#include <inttypes.h>
+#include <tiny-libc/tiny_libc.h>
+
+void clvCliJournalInit(ClvCliJournal* self)
+{
+    self->chunkCount = 0;
+    self->count = 0;
+    self->droppedCount = 0;
+}
+
+void clvCliJournalDestroy(ClvCliJournal* self)
+{
+    for (size_t i = 0; i < self->chunkCount; ++i) {
+        tc_free(self->chunks[i]);
+    }
+    self->chunkCount = 0;
+    self->count = 0;
+}
+
+/// Reserves the next entry (network thread only)
+/// Chunks are allocated as the journal grows, when all of them are used the entry is dropped.
+/// @param self journal
+/// @return entry to fill in, or zero if dropped
+ClvCliJournalEntry* clvCliJournalAppendBegin(ClvCliJournal* self)
+{
+    uint64_t count = self->count;
+    size_t chunkIndex = (size_t)(count / CLV_CLI_JOURNAL_CHUNK_ENTRY_COUNT);
+    if (chunkIndex == self->chunkCount) {
+        if (chunkIndex == CLV_CLI_JOURNAL_MAX_CHUNK_COUNT) {
+            self->droppedCount++;
+            return 0;
+        }
+        ClvCliJournalEntry* chunk
+            = tc_malloc_type_count(ClvCliJournalEntry, CLV_CLI_JOURNAL_CHUNK_ENTRY_COUNT);
+        if (chunk == 0) {
+            CLOG_SOFT_ERROR("journal: out of memory after %" PRIu64 " entries", count)
+            self->droppedCount++;
+            return 0;
+        }
+        self->chunks[chunkIndex] = chunk;
+        self->chunkCount++;
+    }
+
+    return &self->chunks[chunkIndex][count % CLV_CLI_JOURNAL_CHUNK_ENTRY_COUNT];
+}
+
+/// Publishes the entry from clvCliJournalAppendBegin() to the readers
+/// @param self journal
+/// @return sequence number of the entry
+uint64_t clvCliJournalAppendEnd(ClvCliJournal* self)
+{
+    uint64_t sequence = self->count + 1;
+    __atomic_store_n(&self->count, sequence, __ATOMIC_RELEASE);
+
+    return sequence;
+}
+
+/// Number of entries that can be read (any thread)
+uint64_t clvCliJournalCount(const ClvCliJournal* self)
+{
+    return __atomic_load_n(&self->count, __ATOMIC_ACQUIRE);
+}
+
+/// Gets an entry, the sequence must be from one up to clvCliJournalCount()
+const ClvCliJournalEntry* clvCliJournalGet(const ClvCliJournal* self, uint64_t sequence)
+{
+    uint64_t index = sequence - 1;
+    return &self->chunks[index / CLV_CLI_JOURNAL_CHUNK_ENTRY_COUNT]
+                        [index % CLV_CLI_JOURNAL_CHUNK_ENTRY_COUNT];
+}
@@ -0,0 +1,265 @@
+/*----------------------------------------------------------------------------------------------------------
+ *  Copyright (c) Peter Bjorklund. All rights reserved. https://github.com/piot/conclave-client-cli
+ *  Licensed under the MIT License. See LICENSE in the project root for license information.
+ *--------------------------------------------------------------------------------------------------------*/
+#include <clog/clog.h>
+#include <conclave-client-cli/json_writer.h>
+#include <tiny-libc/tiny_libc.h>
+
+static const char hexDigits[] = "0123456789abcdef";
+
+/// Initializes a writer
+/// @param self writer
+/// @param fp file that the lines are written to, usually stdout
+/// @return negative on error
+int clvCliJsonWriterInit(ClvCliJsonWriter* self, FILE* fp)
+{
+    self->octets = tc_malloc_type_count(char, CLV_CLI_JSON_WRITER_CAPACITY);
+    if (self->octets == 0) {
+        return -1;
+    }
+    self->capacity = CLV_CLI_JSON_WRITER_CAPACITY;
+    self->pos = 0;
+    self->fp = fp;
+    self->output.self = 0;
+    self->output.write = 0;
+    self->depth = 0;
+    self->hasValue[0] = false;
+    self->lineCount = 0;
+
+    return 0;
+}
+
+/// Initializes a writer that hands the buffered lines to a function instead of a file
+/// @param self writer
+/// @param output takes the octets when the writer is flushed
+/// @return negative on error
+int clvCliJsonWriterInitOutput(ClvCliJsonWriter* self, const ClvCliJsonWriterOutput* output)
+{
+    if (clvCliJsonWriterInit(self, 0) < 0) {
+        return -1;
+    }
+    self->output = *output;
+
+    return 0;
+}
+
+void clvCliJsonWriterDestroy(ClvCliJsonWriter* self)
+{
+    clvCliJsonWriterFlush(self);
+    tc_free(self->octets);
+    self->octets = 0;
+}
+
+/// Writes the buffered lines to the file
+/// Called when the buffer is full and after each batch of events, a partially written line is
+/// completed by later writes.
+/// @param self writer
+void clvCliJsonWriterFlush(ClvCliJsonWriter* self)
+{
+    if (self->pos == 0) {
+        return;
+    }
+    if (self->fp == 0) {
+        self->output.write(self->output.self, self->octets, self->pos);
+        self->pos = 0;
+        return;
+    }
+    size_t written = fwrite(self->octets, 1, self->pos, self->fp);
+    if (written != self->pos) {
+        CLOG_SOFT_ERROR("json output: could only write %zu of %zu octets", written, self->pos)
+    }
+    fflush(self->fp);
+    self->pos = 0;
+}
+
+static void reserve(ClvCliJsonWriter* self, size_t octetCount)
+{
+    if (self->pos + octetCount > self->capacity) {
+        clvCliJsonWriterFlush(self);
+    }
+}
+
+static void writeChar(ClvCliJsonWriter* self, char ch)
+{
+    reserve(self, 1);
+    self->octets[self->pos++] = ch;
+}
+
+static void writeEscapedOctets(ClvCliJsonWriter* self, const char* octets, size_t count)
+{
+    for (size_t i = 0; i < count; ++i) {
+        unsigned char ch = (unsigned char)octets[i];
+        reserve(self, 6);
+        if (ch == '"' || ch == '\\') {
+            self->octets[self->pos++] = '\\';
+            self->octets[self->pos++] = (char)ch;
+        } else if (ch < 0x20) {
+            self->octets[self->pos++] = '\\';
+            self->octets[self->pos++] = 'u';
+            self->octets[self->pos++] = '0';
+            self->octets[self->pos++] = '0';
+            self->octets[self->pos++] = hexDigits[ch >> 4];
+            self->octets[self->pos++] = hexDigits[ch & 0xf];
+        } else {
+            self->octets[self->pos++] = (char)ch;
+        }
+    }
+}
+
+static void writeEscaped(ClvCliJsonWriter* self, const char* value)
+{
+    writeChar(self, '"');
+    writeEscapedOctets(self, value, tc_strlen(value));
+    writeChar(self, '"');
+}
+
+static void writeDigits(ClvCliJsonWriter* self, uint64_t value)
+{
+    char digits[20];
+    size_t count = 0;
+    do {
+        digits[count++] = (char)('0' + value % 10);
+        value /= 10;
+    } while (value != 0);
+
+    reserve(self, count);
+    while (count > 0) {
+        self->octets[self->pos++] = digits[--count];
+    }
+}
+
+/// Writes the comma and key that come before every value
+static void beginValue(ClvCliJsonWriter* self, const char* key)
+{
+    if (self->hasValue[self->depth]) {
+        writeChar(self, ',');
+    }
+    self->hasValue[self->depth] = true;
+    if (key != 0) {
+        writeEscaped(self, key);
+        writeChar(self, ':');
+    }
+}
+
+static void beginContainer(ClvCliJsonWriter* self, const char* key, char ch)
+{
+    beginValue(self, key);
+    writeChar(self, ch);
+    if (self->depth + 1 >= CLV_CLI_JSON_WRITER_MAX_DEPTH) {
+        CLOG_ERROR("json output nested too deep")
+    }
+    self->depth++;
+    self->hasValue[self->depth] = false;
+}
+
+static void endContainer(ClvCliJsonWriter* self, char ch)
+{
+    writeChar(self, ch);
+    self->depth--;
+}
+
+/// Starts an object
+/// @param self writer
+/// @param key name of the object in the enclosing object, zero at the top level or in arrays
+void clvCliJsonWriterObjectBegin(ClvCliJsonWriter* self, const char* key)
+{
+    beginContainer(self, key, '{');
+}
+
+void clvCliJsonWriterObjectEnd(ClvCliJsonWriter* self)
+{
+    endContainer(self, '}');
+}
+
+void clvCliJsonWriterArrayBegin(ClvCliJsonWriter* self, const char* key)
+{
+    beginContainer(self, key, '[');
+}
+
+void clvCliJsonWriterArrayEnd(ClvCliJsonWriter* self)
+{
+    endContainer(self, ']');
+}
+
+/// Ends the line after a top level object
+/// @param self writer
+void clvCliJsonWriterLineEnd(ClvCliJsonWriter* self)
+{
+    writeChar(self, '\n');
+    self->hasValue[0] = false;
+    self->lineCount++;
+}
+
+void clvCliJsonWriterString(ClvCliJsonWriter* self, const char* key, const char* value)
+{
+    beginValue(self, key);
+    writeEscaped(self, value);
+}
+
+/// Starts a string value that is written in parts, for text that is not in one buffer
+/// @param self writer
+/// @param key name of the value
+void clvCliJsonWriterStringBegin(ClvCliJsonWriter* self, const char* key)
+{
+    beginValue(self, key);
+    writeChar(self, '"');
+}
+
+void clvCliJsonWriterStringAppend(ClvCliJsonWriter* self, const char* octets, size_t count)
+{
+    writeEscapedOctets(self, octets, count);
+}
+
+void clvCliJsonWriterStringEnd(ClvCliJsonWriter* self)
+{
+    writeChar(self, '"');
+}
+
+void clvCliJsonWriterUInt64(ClvCliJsonWriter* self, const char* key, uint64_t value)
+{
+    beginValue(self, key);
+    writeDigits(self, value);
+}
+
+void clvCliJsonWriterInt64(ClvCliJsonWriter* self, const char* key, int64_t value)
+{
+    beginValue(self, key);
+    if (value < 0) {
+        writeChar(self, '-');
+        writeDigits(self, (uint64_t)0 - (uint64_t)value);
+    } else {
+        writeDigits(self, (uint64_t)value);
+    }
+}
+
+/// Writes a number with three decimals
+/// @param self writer
+/// @param key name of the value
+/// @param value must be finite
+void clvCliJsonWriterDouble(ClvCliJsonWriter* self, const char* key, double value)
+{
+    beginValue(self, key);
+    if (value < 0.0) {
+        writeChar(self, '-');
+        value = -value;
+    }
+    uint64_t thousandths = (uint64_t)(value * 1000.0 + 0.5);
+    writeDigits(self, thousandths / 1000);
+    writeChar(self, '.');
+    uint64_t fraction = thousandths % 1000;
+    reserve(self, 3);
+    self->octets[self->pos++] = (char)('0' + fraction / 100);
+    self->octets[self->pos++] = (char)('0' + fraction / 10 % 10);
+    self->octets[self->pos++] = (char)('0' + fraction % 10);
+}
+
+void clvCliJsonWriterBool(ClvCliJsonWriter* self, const char* key, bool value)
+{
+    beginValue(self, key);
+    const char* text = value ? "true" : "false";
+    size_t length = value ? 4 : 5;
+    reserve(self, length);
+    tc_memcpy_octets(self->octets + self->pos, text, length);
+    self->pos += length;
+}
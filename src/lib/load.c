@@ -0,0 +1,276 @@
+/*----------------------------------------------------------------------------------------------------------
+ *  Copyright (c) Peter Bjorklund. All rights reserved. https://github.com/piot/conclave-client-cli
+ *  Licensed under the MIT License. See LICENSE in the project root for license information.
+ *--------------------------------------------------------------------------------------------------------*/
+#include <clog/clog.h>
+#include <conclave-client-cli/load.h>
+#include <tiny-libc/tiny_libc.h>
+
+static const ClvCliTimeNs nanosecondsPerTick = 1000000;
+
+int clvCliLoadInit(ClvCliLoad* self, size_t clientCount)
+{
+    self->clientCount = clientCount;
+    self->isSending = false;
+    self->startedAt = 0;
+    self->stoppedAt = 0;
+    self->dueAt = tc_malloc_type_count(ClvCliTimeNs, clientCount);
+    self->nextInSlot = tc_malloc_type_count(uint32_t, clientCount);
+    self->outstanding = tc_malloc_type_count(ClvCliLoadOutstanding, clientCount);
+    if (!self->dueAt || !self->nextInSlot || !self->outstanding) {
+        CLOG_SOFT_ERROR("could not allocate load generator for %zu clients", clientCount)
+        clvCliLoadDestroy(self);
+        return -1;
+    }
+    clvCliLoadReportInit(&self->report);
+
+    return 0;
+}
+
+void clvCliLoadDestroy(ClvCliLoad* self)
+{
+    tc_free(self->dueAt);
+    tc_free(self->nextInSlot);
+    tc_free(self->outstanding);
+    self->dueAt = 0;
+    self->nextInSlot = 0;
+    self->outstanding = 0;
+    self->clientCount = 0;
+}
+
+static uint64_t tickFromTime(const ClvCliLoad* self, ClvCliTimeNs time)
+{
+    return time <= self->startedAt ? 0 : (time - self->startedAt) / nanosecondsPerTick;
+}
+
+static void insert(ClvCliLoad* self, size_t clientIndex)
+{
+    uint64_t tick = tickFromTime(self, self->dueAt[clientIndex]);
+    if (tick <= self->lastTick) {
+        tick = self->lastTick + 1;
+    }
+    size_t slot = (size_t)(tick % CLV_CLI_LOAD_WHEEL_SLOT_COUNT);
+    self->nextInSlot[clientIndex] = self->slotHeads[slot];
+    self->slotHeads[slot] = (uint32_t)clientIndex;
+}
+
+/// Starts to send requests from all clients
+/// The first sends are spread out over one interval, so the clients do not send in bursts.
+/// @param self load generator
+/// @param options what and how often to send
+/// @param now current time
+void clvCliLoadStart(ClvCliLoad* self, const ClvCliLoadOptions* options, ClvCliTimeNs now)
+{
+    if (options->ratePerClient <= 0.0 || self->clientCount == 0) {
+        return;
+    }
+
+    self->options = *options;
+    self->interval = (ClvCliTimeNs)(1000000000.0 / options->ratePerClient);
+    if (self->interval == 0) {
+        self->interval = 1;
+    }
+    self->startedAt = now;
+    self->stoppedAt = 0;
+    self->lastTick = 0;
+    self->isSending = true;
+
+    clvCliLoadReportInit(&self->report);
+    self->report.type = options->type;
+    self->report.targetRate = options->ratePerClient * (double)self->clientCount;
+
+    for (size_t i = 0; i < CLV_CLI_LOAD_WHEEL_SLOT_COUNT; ++i) {
+        self->slotHeads[i] = CLV_CLI_LOAD_NO_CLIENT;
+    }
+    tc_mem_clear_type_n(self->outstanding, self->clientCount);
+    for (size_t i = 0; i < self->clientCount; ++i) {
+        self->dueAt[i] = now + self->interval * i / self->clientCount;
+        insert(self, i);
+    }
+}
+
+/// Stops sending, responses to the requests that have been sent are still measured
+/// @param self load generator
+/// @param now current time
+void clvCliLoadStop(ClvCliLoad* self, ClvCliTimeNs now)
+{
+    if (!self->isSending) {
+        return;
+    }
+    self->isSending = false;
+    self->stoppedAt = now;
+}
+
+static void fire(ClvCliLoad* self, size_t clientIndex, ClvCliTimeNs intendedAt,
+    ClvCliLoadSendFn send, void* sendSelf)
+{
+    ClvCliLoadOutstanding* outstanding = &self->outstanding[clientIndex];
+    if (outstanding->count == CLV_CLI_LOAD_MAX_OUTSTANDING) {
+        self->report.intendedCount++;
+        self->report.skippedCount++;
+        return;
+    }
+
+    if (!send(sendSelf, clientIndex, &self->options)) {
+        return;
+    }
+
+    self->report.intendedCount++;
+    self->report.sentCount++;
+    size_t writeIndex
+        = (outstanding->readIndex + outstanding->count) % CLV_CLI_LOAD_MAX_OUTSTANDING;
+    outstanding->intendedAt[writeIndex] = intendedAt;
+    outstanding->count++;
+}
+
+/// Sends the requests that are due
+/// A client that is late, e.g. because the thread was busy, catches up on all missed sends.
+/// @param self load generator
+/// @param now current time
+/// @param send sends a request from a client
+/// @param sendSelf passed to send
+void clvCliLoadUpdate(ClvCliLoad* self, ClvCliTimeNs now, ClvCliLoadSendFn send, void* sendSelf)
+{
+    if (!self->isSending) {
+        return;
+    }
+
+    ClvCliTimeNs endsAt = 0;
+    if (self->options.durationMs > 0) {
+        endsAt = self->startedAt + self->options.durationMs * nanosecondsPerTick;
+    }
+
+    uint64_t nowTick = tickFromTime(self, now);
+    uint64_t tickCount = nowTick - self->lastTick;
+    if (tickCount > CLV_CLI_LOAD_WHEEL_SLOT_COUNT) {
+        tickCount = CLV_CLI_LOAD_WHEEL_SLOT_COUNT;
+    }
+    uint64_t firstTick = self->lastTick + 1;
+    self->lastTick = nowTick;
+
+    for (uint64_t tick = firstTick; tick < firstTick + tickCount; ++tick) {
+        size_t slot = (size_t)(tick % CLV_CLI_LOAD_WHEEL_SLOT_COUNT);
+        uint32_t clientIndex = self->slotHeads[slot];
+        self->slotHeads[slot] = CLV_CLI_LOAD_NO_CLIENT;
+
+        while (clientIndex != CLV_CLI_LOAD_NO_CLIENT) {
+            uint32_t next = self->nextInSlot[clientIndex];
+            bool hasEnded = false;
+            while (self->dueAt[clientIndex] <= now) {
+                if (endsAt != 0 && self->dueAt[clientIndex] >= endsAt) {
+                    hasEnded = true;
+                    break;
+                }
+                fire(self, clientIndex, self->dueAt[clientIndex], send, sendSelf);
+                self->dueAt[clientIndex] += self->interval;
+            }
+            if (!hasEnded) {
+                insert(self, clientIndex);
+            }
+            clientIndex = next;
+        }
+    }
+
+    if (endsAt != 0 && now >= endsAt) {
+        self->isSending = false;
+        self->stoppedAt = endsAt;
+    }
+}
+
+/// Checks if responses of the type should be measured by the load generator
+/// @param self load generator
+/// @param type request type
+/// @return true if the load generator has sent requests of that type
+bool clvCliLoadIsMeasuring(const ClvCliLoad* self, ClvCliRequestType type)
+{
+    return self->startedAt != 0 && self->options.type == type;
+}
+
+/// Matches a response to the oldest request from the client
+/// @param self load generator
+/// @param clientIndex client that received the response
+/// @param now current time
+void clvCliLoadReceived(ClvCliLoad* self, size_t clientIndex, ClvCliTimeNs now)
+{
+    ClvCliLoadOutstanding* outstanding = &self->outstanding[clientIndex];
+    if (outstanding->count == 0) {
+        return;
+    }
+
+    ClvCliTimeNs intendedAt = outstanding->intendedAt[outstanding->readIndex];
+    outstanding->readIndex = (uint8_t)((outstanding->readIndex + 1) % CLV_CLI_LOAD_MAX_OUTSTANDING);
+    outstanding->count--;
+
+    self->report.receivedCount++;
+    clvCliHistogramAdd(&self->report.latencies, (now - intendedAt) / 1000);
+}
+
+/// Milliseconds until the next wheel slot with clients in it
+/// @param self load generator
+/// @param now current time
+/// @return milliseconds, SIZE_MAX if not sending
+size_t clvCliLoadTimeUntilUpdate(const ClvCliLoad* self, ClvCliTimeNs now)
+{
+    if (!self->isSending) {
+        return SIZE_MAX;
+    }
+
+    for (uint64_t tick = self->lastTick + 1; tick <= self->lastTick + CLV_CLI_LOAD_WHEEL_SLOT_COUNT;
+         ++tick) {
+        if (self->slotHeads[tick % CLV_CLI_LOAD_WHEEL_SLOT_COUNT] == CLV_CLI_LOAD_NO_CLIENT) {
+            continue;
+        }
+        ClvCliTimeNs tickAt = self->startedAt + tick * nanosecondsPerTick;
+        return tickAt <= now ? 0 : (size_t)((tickAt - now) / nanosecondsPerTick);
+    }
+
+    return CLV_CLI_LOAD_WHEEL_SLOT_COUNT;
+}
+
+/// Gets the result so far
+/// @param self load generator
+/// @param report target report
+/// @param now current time
+void clvCliLoadReportGet(const ClvCliLoad* self, ClvCliLoadReport* report, ClvCliTimeNs now)
+{
+    *report = self->report;
+    if (self->startedAt == 0) {
+        report->elapsed = 0;
+        return;
+    }
+    report->elapsed = (self->isSending ? now : self->stoppedAt) - self->startedAt;
+}
+
+size_t clvCliLoadBytesPerClient(void)
+{
+    return sizeof(ClvCliTimeNs) + sizeof(uint32_t) + sizeof(ClvCliLoadOutstanding);
+}
+
+void clvCliLoadReportInit(ClvCliLoadReport* self)
+{
+    self->type = ClvCliRequestTypePing;
+    self->targetRate = 0.0;
+    self->elapsed = 0;
+    self->intendedCount = 0;
+    self->sentCount = 0;
+    self->receivedCount = 0;
+    self->skippedCount = 0;
+    clvCliHistogramInit(&self->latencies);
+}
+
+void clvCliLoadReportMerge(ClvCliLoadReport* self, const ClvCliLoadReport* other)
+{
+    if (other->targetRate <= 0.0) {
+        return;
+    }
+    self->type = other->type;
+    self->targetRate += other->targetRate;
+    if (other->elapsed > self->elapsed) {
+        self->elapsed = other->elapsed;
+    }
+    self->intendedCount += other->intendedCount;
+    self->sentCount += other->sentCount;
+    self->receivedCount += other->receivedCount;
+    self->skippedCount += other->skippedCount;
+    clvCliHistogramMerge(&self->latencies, &other->latencies);
+}
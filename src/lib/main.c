@@ -6,16 +6,26 @@
 #include <clash/response.h>
 #include <clog/clog.h>
 #include <clog/console.h>
-#include <conclave-client-udp/client.h>
+#include <conclave-client-cli/clock.h>
+#include <conclave-client-cli/control.h>
+#include <conclave-client-cli/event_json.h>
+#include <conclave-client-cli/event_loop.h>
+#include <conclave-client-cli/in_flight.h>
+#include <conclave-client-cli/json_writer.h>
+#include <conclave-client-cli/network.h>
+#include <conclave-client-cli/out_chain.h>
+#include <conclave-client-cli/render.h>
+#include <conclave-client-cli/room_cache.h>
+#include <conclave-client-cli/room_list_diff.h>
+#include <conclave-client-cli/script.h>
+#include <conclave-client-cli/trace.h>
 #include <conclave-client/debug.h>
-#include <errno.h>
 #include <flood/out_stream.h>
-#include <guise-client-udp/client.h>
-#include <guise-client-udp/read_secret.h>
-#include <imprint/default_setup.h>
 #include <inttypes.h>
 #include <redline/edit.h>
 #include <signal.h>
+#include <string.h>
+#include <unistd.h>
 
 clog_config g_clog;
 
@@ -28,31 +38,83 @@ static void interruptHandler(int sig)
     g_quit = 1;
 }
 
-#include <time.h>
-static void sleepMs(size_t milliseconds)
-{
-    struct timespec ts;
-    ts.tv_sec = milliseconds / 1000;
-    ts.tv_nsec = (milliseconds % 1000) * 1000000;
-
-    int err = nanosleep(&ts, &ts);
-    if (err != 0) {
-        CLOG_ERROR("NOT WORKING:%d", errno)
-    }
-}
-
 static void drawPrompt(RedlineEdit* edit)
 {
     redlineEditPrompt(edit, "conclave> ");
 }
 
+/// A `room list --all` in progress
+/// A room list request has no offset, so the same list is requested again and each response is
+/// merged into the room cache. Identical requests in flight at the same time would only get
+/// identical responses, so the next request is sent when the previous one has been answered.
+/// It is complete when a response has fewer rooms than asked for (the server had no more to
+/// give). A full response that adds no rooms that were not cached already also ends it, but
+/// without an offset that only means the server sent the same page again, not that every room
+/// has been seen.
+typedef struct RoomListAll {
+    bool isActive;
+    bool isComplete; // a response had fewer rooms than asked for
+    bool isSamePage; // a full response had no new rooms
+    ClvSerializeListRoomsOptions options;
+    size_t maximumPageCount;
+    size_t sentCount;
+    size_t receivedCount;
+    size_t lostCount; // requests that ended without a response
+    size_t roomCount; // in all responses
+    size_t newRoomCount; // not in the cache before
+    uint64_t pendingCorrelationId; // of the request in flight, zero if none
+    bool isPageNext; // the request was answered, the next room list event is its response
+    ClvCliTimeNs startedAt;
+} RoomListAll;
+
+typedef struct AppOptions {
+    size_t secretIndex;
+    const char* host;
+    uint16_t guisePort;
+    uint16_t conclavePort;
+    size_t swarmCount;
+    size_t shardCount;
+    bool shouldPinShards;
+    const char* scriptFilename;
+    bool useStdinScript;
+    bool usePolling;
+    bool reportLatency;
+    size_t resendIntervalMs;
+    bool useJson;
+    size_t framesPerSecond;
+    size_t frameBudgetUs;
+    size_t imprintKib; // for each conclave client, zero for the default
+    const char* traceFilename;
+    const char* controlPath;
+} AppOptions;
+
+/// The REPL thread
+/// The clients are owned and updated by the network thread, see ClvCliNetwork.
 typedef struct App {
     const char* secret;
-    ClvClientUdp clvClient;
-    bool hasStartedConclave;
-    uint8_t lastShownPingResponseVersion;
-    uint8_t lastShownRoomCreateVersion;
-    uint8_t lastShownRoomListVersion;
+    ClvCliNetwork network;
+    ClvCliNetworkStatus status;
+    uint64_t lastCommandSequence;
+    ClvCliInFlight inFlight;
+    ClvCliRoomCache roomCache; // from the room list responses
+    ClvCliRoomListDiff roomListDiff; // the last room list, to show only the changes when watching
+    bool isWatchingRooms;
+    RoomListAll roomListAll;
+    bool isInteractive;
+    bool hasScript;
+    RedlineEdit edit;
+    ClvCliScript script;
+    ClvCliControl control;
+    ClvCliOutChain output; // of the typed and scripted commands
+    ClvCliOutChain* commandOutput; // of the command that is executing, zero otherwise
+    FldOutStream* commandStream; // that clash writes the response of the command to
+    size_t usageOctets; // of the help, the most that clash writes for a command by itself
+    FILE* textOut; // command output, stderr when stdout has the JSON lines
+    ClvCliJsonWriter json;
+    ClvCliRender render;
+    ClvCliTrace trace;
+    ClvCliTraceRing* traceRing; // of the REPL thread, zero when not tracing
+    AppOptions options;
     Clog log;
 } App;
 
@@ -69,14 +131,108 @@ typedef struct RoomJoinCmd {
 typedef struct RoomListCmd {
     uint64_t applicationId;
     int maximumCount;
+    int all;
+    int maximumPageCount;
 } RoomListCmd;
 
+typedef struct RoomWatchCmd {
+    int interval;
+    uint64_t applicationId;
+    int maximumCount;
+} RoomWatchCmd;
+
+typedef struct RoomFindCmd {
+    const char* namePrefix;
+    uint64_t roomId;
+    uint64_t applicationId;
+    int minimumFreeSlots;
+    int maximumAge;
+    int count;
+} RoomFindCmd;
+
+typedef struct RoomTopCmd {
+    int count;
+    uint64_t applicationId;
+    int maximumAge;
+} RoomTopCmd;
+
 typedef struct PingCmd {
     int verbose;
     int knowledge;
     bool hasConnectionToOwner;
 } PingCmd;
 
+typedef struct JournalCmd {
+    int count;
+} JournalCmd;
+
+typedef struct PerfCmd {
+    int budget;
+} PerfCmd;
+
+typedef struct LoadStartCmd {
+    const char* type;
+    int rate;
+    int duration;
+    int perClient;
+    uint64_t roomId;
+    uint64_t applicationId;
+    int maximumCount;
+} LoadStartCmd;
+
+typedef struct ChurnStartCmd {
+    int rate;
+    int perClient;
+    int dwell;
+    int pingInterval;
+    int timeout;
+    uint64_t applicationId;
+} ChurnStartCmd;
+
+typedef struct SimulateStartCmd {
+    int ticksPerSecond;
+    int pingInterval;
+} SimulateStartCmd;
+
+typedef struct SimulateInjectCmd {
+    int percent;
+    int ownersOnly;
+    int speed;
+} SimulateInjectCmd;
+
+/// Writes how a command that was sent to the network thread is handled
+static void writeCommandSent(const App* self, ClashResponse* response)
+{
+    if (self->options.swarmCount > 0) {
+        clashResponseWritecf(response, 4, "sent to %zu swarm clients\n", self->options.swarmCount);
+    }
+}
+
+static ClvCliCommand* beginCommand(App* self, ClvCliCommandType type, ClashResponse* response)
+{
+    ClvCliCommand* command = clvCliNetworkCommandBegin(&self->network, type);
+    if (command == 0) {
+        clashResponseWritecf(response, 1, "network thread is busy, try again\n");
+    }
+
+    return command;
+}
+
+static void endCommand(App* self)
+{
+    self->lastCommandSequence = clvCliNetworkCommandEnd(&self->network);
+}
+
+/// Sends a command that sends a conclave request, and remembers it until it is answered
+/// The command sequence is the correlation id that `await` uses.
+static void endRequestCommand(App* self, ClvCliRequestType type, ClashResponse* response)
+{
+    endCommand(self);
+    clvCliInFlightIssued(&self->inFlight, self->lastCommandSequence, type, clvCliClockNowNs());
+    clashResponseWritecf(response, 4, "request #%" PRIu64 "\n", self->lastCommandSequence);
+    writeCommandSent(self, response);
+}
+
 static void onRoomCreate(void* _self, const void* _data, ClashResponse* response)
 {
     App* self = (App*)_self;
@@ -87,287 +243,2038 @@ static void onRoomCreate(void* _self, const void* _data, ClashResponse* response
     clashResponseWritef(response, "'");
     clashResponseWritecf(response, 18, " verbose:%d\n", data->verbose);
 
-    ClvSerializeRoomCreateOptions createRoom;
-    createRoom.applicationId = 1;
-    createRoom.applicationVersion.major = 1;
-    createRoom.applicationVersion.minor = 2;
-    createRoom.applicationVersion.patch = 3;
+    ClvCliCommand* command = beginCommand(self, ClvCliCommandTypeRoomCreate, response);
+    if (command == 0) {
+        return;
+    }
+
+    ClvSerializeRoomCreateOptions* createRoom = &command->data.roomCreate;
+    createRoom->applicationId = 1;
+    createRoom->applicationVersion.major = 1;
+    createRoom->applicationVersion.minor = 2;
+    createRoom->applicationVersion.patch = 3;
 
-    createRoom.maxNumberOfPlayers = 8;
-    createRoom.flags = 0;
-    tc_strcpy(createRoom.name, 64, data->name);
+    createRoom->maxNumberOfPlayers = 8;
+    createRoom->flags = 0;
+    tc_strcpy(createRoom->name, 64, data->name);
 
-    clvClientUdpCreateRoom(&self->clvClient, &createRoom);
+    endRequestCommand(self, ClvCliRequestTypeRoomCreate, response);
 }
 
 static void onRoomJoin(void* _self, const void* _data, ClashResponse* response)
 {
     App* self = (App*)_self;
-    (void)self;
     const RoomJoinCmd* data = (const RoomJoinCmd*)_data;
     clashResponseWritecf(response, 3, "room join: %" PRIX64 "\n", data->roomId);
 
-    ClvSerializeRoomJoinOptions request;
+    ClvCliCommand* command = beginCommand(self, ClvCliCommandTypeRoomJoin, response);
+    if (command == 0) {
+        return;
+    }
+
+    command->data.roomJoin.roomIdToJoin = (ClvSerializeRoomId)data->roomId;
+
+    endRequestCommand(self, ClvCliRequestTypeRoomJoin, response);
+}
+
+static bool isValidMaximumRoomCount(int maximumCount, ClashResponse* response)
+{
+    if (maximumCount < 1 || maximumCount > UINT8_MAX) {
+        clashResponseWritecf(response, 1, "the maximum count must be from 1 to %d, not %d\n",
+            UINT8_MAX, maximumCount);
+        return false;
+    }
+
+    return true;
+}
+
+static bool isValidMinimumFreeSlots(int minimumFreeSlots, ClashResponse* response)
+{
+    if (minimumFreeSlots < 0 || minimumFreeSlots > UINT8_MAX) {
+        clashResponseWritecf(response, 1,
+            "the minimum number of free slots must be from 0 to %d, not %d\n", UINT8_MAX,
+            minimumFreeSlots);
+        return false;
+    }
+
+    return true;
+}
+
+/// Sends the next `room list --all` request, if the network thread can take it
+static bool sendRoomListPage(App* self)
+{
+    RoomListAll* all = &self->roomListAll;
+    ClvCliCommand* command = clvCliNetworkCommandBegin(&self->network, ClvCliCommandTypeRoomList);
+    if (command == 0) {
+        return false;
+    }
+    command->data.roomList = all->options;
+    endCommand(self);
+    clvCliInFlightIssued(&self->inFlight, self->lastCommandSequence, ClvCliRequestTypeRoomList,
+        clvCliClockNowNs());
+    all->pendingCorrelationId = self->lastCommandSequence;
+    all->sentCount++;
 
-    request.roomIdToJoin = (ClvSerializeRoomId)data->roomId;
+    return true;
+}
 
-    clvClientJoinRoom(&self->clvClient.conclaveClient, &request);
+static void startRoomListAll(App* self, const RoomListCmd* data, ClashResponse* response)
+{
+    if (self->options.swarmCount > 0) {
+        clashResponseWritecf(response, 4, "room list --all is only for a single client\n");
+        return;
+    }
+    if (self->roomListAll.isActive) {
+        clashResponseWritecf(response, 4, "room list --all is already running\n");
+        return;
+    }
+    RoomListAll* all = &self->roomListAll;
+    tc_mem_clear_type(all);
+    all->isActive = true;
+    all->options.applicationId = data->applicationId;
+    all->options.maximumCount = (uint8_t)data->maximumCount;
+    all->maximumPageCount = data->maximumPageCount > 0 ? (size_t)data->maximumPageCount : 1;
+    all->startedAt = clvCliClockNowNs();
+    if (!sendRoomListPage(self)) {
+        clashResponseWritecf(response, 1, "network thread is busy, try again\n");
+        all->isActive = false;
+        return;
+    }
+    clashResponseWritecf(response, 4, "listing all rooms, request #%" PRIu64 "\n",
+        all->pendingCorrelationId);
 }
 
 static void onRoomList(void* _self, const void* _data, ClashResponse* response)
 {
     App* self = (App*)_self;
-    (void)self;
     const RoomListCmd* data = (const RoomListCmd*)_data;
-    (void)data;
+    if (!isValidMaximumRoomCount(data->maximumCount, response)) {
+        return;
+    }
+    if (data->all) {
+        startRoomListAll(self, data, response);
+        return;
+    }
     clashResponseWritecf(response, 4, "room list requested\n");
 
-    ClvSerializeListRoomsOptions request;
+    ClvCliCommand* command = beginCommand(self, ClvCliCommandTypeRoomList, response);
+    if (command == 0) {
+        return;
+    }
 
-    request.applicationId = data->applicationId;
-    request.maximumCount = (uint8_t)data->maximumCount;
+    command->data.roomList.applicationId = data->applicationId;
+    command->data.roomList.maximumCount = (uint8_t)data->maximumCount;
 
-    clvClientListRooms(&self->clvClient.conclaveClient, &request);
+    endRequestCommand(self, ClvCliRequestTypeRoomList, response);
 }
 
-static void onState(void* _self, const void* data, ClashResponse* response)
+/// Lists the rooms at an interval and shows only the rooms that were added, removed or changed
+static void onRoomWatch(void* _self, const void* _data, ClashResponse* response)
 {
-    (void)data;
-    (void)response;
-
     App* self = (App*)_self;
-    if (!self->hasStartedConclave) {
-        clashResponseWritecf(response, 4, "conclave not started yet\n");
+    const RoomWatchCmd* data = (const RoomWatchCmd*)_data;
+
+    if (self->options.swarmCount > 0) {
+        clashResponseWritecf(response, 4, "rooms can only be watched by a single client\n");
+        return;
+    }
+    if (data->interval <= 0) {
+        clashResponseWritecf(response, 1, "the interval must be at least one millisecond\n");
+        return;
+    }
+    if (!isValidMaximumRoomCount(data->maximumCount, response)) {
+        return;
+    }
+
+    ClvCliCommand* command = beginCommand(self, ClvCliCommandTypeRoomWatch, response);
+    if (command == 0) {
         return;
     }
-    printf("state: %s\n", clvClientStateToString(self->clvClient.conclaveClient.state));
+    command->data.roomWatch.roomList.applicationId = data->applicationId;
+    command->data.roomWatch.roomList.maximumCount = (uint8_t)data->maximumCount;
+    command->data.roomWatch.intervalMs = (uint32_t)data->interval;
+    endCommand(self);
+
+    // The first room list shows all rooms as added
+    clvCliRoomListDiffInit(&self->roomListDiff);
+    self->isWatchingRooms = true;
+    clashResponseWritecf(response, 4, "watching rooms every %d ms\n", data->interval);
 }
 
-static void onPing(void* _self, const void* _data, ClashResponse* response)
+static void onRoomUnwatch(void* _self, const void* data, ClashResponse* response)
 {
-    const PingCmd* data = (const PingCmd*)_data;
-    (void)response;
+    (void)data;
 
     App* self = (App*)_self;
-    if (!self->hasStartedConclave) {
-        clashResponseWritecf(response, 4, "conclave not started yet\n");
+    if (beginCommand(self, ClvCliCommandTypeRoomUnwatch, response) == 0) {
+        return;
+    }
+    endCommand(self);
+    self->isWatchingRooms = false;
+}
+
+/// Room that the stream of a command keeps for one more line of its response
+static const size_t lineReserveOctets = 512;
+
+/// Makes room for another line in the response of the executing command
+/// Commands with long responses call this before each line, so the response continues in a new
+/// stream instead of being cut when the reserved stream is full.
+/// @param app app
+static void reserveResponseLine(const App* app)
+{
+    FldOutStream* stream = app->commandStream;
+    if (stream == 0 || stream->size - stream->pos >= lineReserveOctets) {
         return;
     }
 
-    clvClientPing(
-        &self->clvClient.conclaveClient, (uint64_t)data->knowledge, data->hasConnectionToOwner);
+    clvCliOutChainCommit(app->commandOutput, stream);
+    if (clvCliOutChainReserve(app->commandOutput, stream, lineReserveOctets) < 0) {
+        // Continues with what is left of the committed stream
+        fldOutStreamInit(stream, stream->octets + stream->pos, stream->size - stream->pos);
+    }
 }
 
-static ClashOption roomCreateOptions[]
-    = { { "name", 'n', "the name of the room", ClashTypeString | ClashTypeArg, "secretRoom",
-            offsetof(RoomCreateCmd, name) },
-          { "verbose", 'v', "enable detailed output", ClashTypeFlag, "",
-              offsetof(RoomCreateCmd, verbose) } };
+static void writeCachedRoom(
+    ClashResponse* response, const ClvCliRoomCacheEntry* entry, ClvCliTimeNs now)
+{
+    const ClvSerializeRoomInfo* roomInfo = &entry->roomInfo;
+    ClvCliTimeNs age = now - entry->lastSeenAt;
+    clashResponseWritef(response,
+        "roomId: %d, name: '%s', owner: %" PRIX64 " members:%d/%d free:%d application:%" PRIx64
+        " seen %" PRIu64 ".%03" PRIu64 "s ago\n",
+        roomInfo->roomId, roomInfo->roomName, roomInfo->ownerUserId, roomInfo->memberCount,
+        roomInfo->maxMemberCount, clvCliRoomCacheFreeSlots(roomInfo), roomInfo->applicationId,
+        age / 1000000000u, age / 1000000u % 1000u);
+}
 
-static ClashOption roomJoinOptions[] = {
-    { "id", 'i', "the id of the room to join", ClashTypeUInt64 | ClashTypeArg, "",
-        offsetof(RoomJoinCmd, roomId) },
-    { "verbose", 'v', "enable detailed output", ClashTypeFlag, "", offsetof(RoomJoinCmd, verbose) }
-};
+static void writeCachedRooms(const App* self, ClashResponse* response,
+    const ClvCliRoomCacheEntry** entries, size_t count, ClvCliTimeNs now)
+{
+    for (size_t i = 0; i < count; ++i) {
+        reserveResponseLine(self);
+        writeCachedRoom(response, entries[i], now);
+    }
+    reserveResponseLine(self);
+    clashResponseWritecf(response, 4, "%zu of %zu cached rooms, from %" PRIu64 " room lists\n",
+        count, self->roomCache.count, self->roomCache.mergeCount);
+}
 
-static ClashOption roomListOptions[]
-    = { { "applicationId", 'i', "the application ID", ClashTypeUInt64 | ClashTypeArg, "42",
-            offsetof(RoomListCmd, applicationId) },
-          { "maximumCount", 'c', "enable detailed output", ClashTypeInt, "8",
-              offsetof(RoomListCmd, maximumCount) } };
+/// Finds rooms in the cache of received room lists, without asking the server
+static void onRoomFind(void* _self, const void* _data, ClashResponse* response)
+{
+    App* self = (App*)_self;
+    const RoomFindCmd* data = (const RoomFindCmd*)_data;
+    ClvCliTimeNs now = clvCliClockNowNs();
 
-static ClashCommand roomCommands[] = {
-    { "create", "Create a room", sizeof(struct RoomCreateCmd), roomCreateOptions,
-        sizeof(roomCreateOptions) / sizeof(roomCreateOptions[0]), 0, 0, (ClashFn)onRoomCreate },
-    { "join", "Join a room", sizeof(struct RoomJoinCmd), roomJoinOptions,
-        sizeof(roomJoinOptions) / sizeof(roomJoinOptions[0]), 0, 0, (ClashFn)onRoomJoin },
-    { "list", "list rooms", sizeof(struct RoomListCmd), roomListOptions,
-        sizeof(roomListOptions) / sizeof(roomListOptions[0]), 0, 0, (ClashFn)onRoomList },
-};
+    if (data->roomId != 0) {
+        const ClvCliRoomCacheEntry* entry
+            = clvCliRoomCacheFind(&self->roomCache, (ClvSerializeRoomId)data->roomId);
+        if (entry == 0) {
+            clashResponseWritecf(response, 1, "room %" PRIu64 " is not cached\n", data->roomId);
+            return;
+        }
+        writeCachedRoom(response, entry, now);
+        return;
+    }
 
-static ClashOption pingOptions[] = {
-    { "knowledge", 'k', "how much knowledge (simulation tick ID) that the client has",
-        (ClashOptionType)ClashTypeInt | ClashTypeArg, "0", offsetof(PingCmd, knowledge) },
-    { "isconnected", 'c', "has connection to room owner", ClashTypeBool, "",
-        offsetof(PingCmd, hasConnectionToOwner) },
-    { "verbose", 'v', "enable detailed output", ClashTypeFlag, "", offsetof(PingCmd, verbose) }
-};
+    if (!isValidMinimumFreeSlots(data->minimumFreeSlots, response)) {
+        return;
+    }
 
-static ClashCommand mainCommands[] = {
-    { "room", "room commands", 0, 0, 0, roomCommands,
-        sizeof(roomCommands) / sizeof(roomCommands[0]), 0 },
-    { "state", "show state on conclave client", 0, 0, 0, 0, 0, onState },
-    { "ping", "ping the conclave server", sizeof(PingCmd), pingOptions,
-        sizeof(pingOptions) / sizeof(pingOptions[0]), 0, 0, onPing },
-};
+    ClvCliRoomCacheQuery query;
+    query.namePrefix = data->namePrefix;
+    query.hasApplicationId = data->applicationId != 0;
+    query.applicationId = data->applicationId;
+    query.minimumFreeSlots = (uint8_t)data->minimumFreeSlots;
+    query.maximumAge = data->maximumAge > 0 ? (ClvCliTimeNs)data->maximumAge * 1000000u : 0;
 
-static ClashDefinition commands = { mainCommands, sizeof(mainCommands) / sizeof(mainCommands[0]) };
+    ClvCliRoomCacheIndex order = ClvCliRoomCacheIndexFreeSlots;
+    if (data->namePrefix != 0 && data->namePrefix[0] != 0) {
+        order = ClvCliRoomCacheIndexName;
+    } else if (query.hasApplicationId) {
+        order = ClvCliRoomCacheIndexApplicationId;
+    }
+
+    const ClvCliRoomCacheEntry* entries[64];
+    size_t maxCount = data->count > 0 && (size_t)data->count < 64 ? (size_t)data->count : 64;
+    size_t count = clvCliRoomCacheQuery(&self->roomCache, &query, order, now, entries, maxCount);
+    writeCachedRooms(self, response, entries, count, now);
+}
 
-static void printHouse(void)
+/// Shows the cached rooms with the most free slots
+static void onRoomTop(void* _self, const void* _data, ClashResponse* response)
 {
-    printf("\xF0\x9F\x8F\xA0");
+    App* self = (App*)_self;
+    const RoomTopCmd* data = (const RoomTopCmd*)_data;
+    ClvCliTimeNs now = clvCliClockNowNs();
+
+    ClvCliRoomCacheQuery query;
+    query.namePrefix = 0;
+    query.hasApplicationId = data->applicationId != 0;
+    query.applicationId = data->applicationId;
+    query.minimumFreeSlots = 1;
+    query.maximumAge = data->maximumAge > 0 ? (ClvCliTimeNs)data->maximumAge * 1000000u : 0;
+
+    const ClvCliRoomCacheEntry* entries[64];
+    size_t maxCount = data->count > 0 && (size_t)data->count < 64 ? (size_t)data->count : 64;
+    size_t count = clvCliRoomCacheQuery(
+        &self->roomCache, &query, ClvCliRoomCacheIndexFreeSlots, now, entries, maxCount);
+    writeCachedRooms(self, response, entries, count, now);
 }
 
-static void outputChangesIfAny(App* app, RedlineEdit* edit)
+static void onState(void* _self, const void* data, ClashResponse* response)
 {
-    ClvClient* conclaveClient = &app->clvClient.conclaveClient;
-    //ClvClient* conclaveClient = &conclaveClientRealize->client;
+    (void)data;
 
-    if (conclaveClient->pingResponseOptionsVersion != app->lastShownPingResponseVersion) {
-        redlineEditRemove(edit);
-        app->lastShownPingResponseVersion = conclaveClient->pingResponseOptionsVersion;
-        const ClvSerializePingResponseOptions* pingResponse = &conclaveClient->pingResponseOptions;
-        printf("--- room info updated ---\n");
-        printf(
-            "term: %" PRIx64 ", version:%" PRIx64 "\n", pingResponse->term, pingResponse->version);
+    App* self = (App*)_self;
+    if (beginCommand(self, ClvCliCommandTypeState, response) == 0) {
+        return;
+    }
+    endCommand(self);
+}
 
-        for (size_t i = 0; i < pingResponse->roomInfo.memberCount; ++i) {
-            if (i == pingResponse->roomInfo.indexOfOwner) {
-                printf("\xF0\x9F\x91\x91"); // Crown
-            } else {
-                printf(" ");
-            }
+static void onPing(void* _self, const void* _data, ClashResponse* response)
+{
+    const PingCmd* data = (const PingCmd*)_data;
 
-            printf("\xF0\x9F\x91\xA4"); // Bust
+    App* self = (App*)_self;
+    if (!self->status.hasStartedConclave) {
+        clashResponseWritecf(response, 4, "conclave not started yet\n");
+        return;
+    }
 
-            printf(" userID: %" PRIX64 "\n", pingResponse->roomInfo.members[i]);
-        }
-        drawPrompt(edit);
-        redlineEditBringback(edit);
+    ClvCliCommand* command = beginCommand(self, ClvCliCommandTypePing, response);
+    if (command == 0) {
+        return;
     }
 
-    if (conclaveClient->roomCreateVersion != app->lastShownRoomCreateVersion) {
-        app->lastShownRoomCreateVersion = conclaveClient->roomCreateVersion;
-        redlineEditRemove(edit);
-        printf("--- Room Create Done ---\n");
-        printHouse();
-        printf(" roomID: %d, connectionToRoom: %d\n", conclaveClient->mainRoomId,
-            conclaveClient->roomConnectionIndex);
-        drawPrompt(edit);
-        redlineEditBringback(edit);
-    }
-
-    if (conclaveClient->listRoomsOptionsVersion != app->lastShownRoomListVersion) {
-        app->lastShownRoomListVersion = conclaveClient->listRoomsOptionsVersion;
-        redlineEditRemove(edit);
-        printf("--- Room list received ---\n");
-        for (size_t i = 0; i < conclaveClient->listRoomsResponseOptions.roomInfoCount; ++i) {
-            const ClvSerializeRoomInfo* roomInfo
-                = &conclaveClient->listRoomsResponseOptions.roomInfos[i];
-            printHouse();
-            printf(" roomId: %d, name: '%s', owner: %" PRIX64
-                   " members:%d/%d stateOctetCount: %hu, application:%" PRIx64
-                   " version:%d.%d.%d\n",
-                roomInfo->roomId, roomInfo->roomName, roomInfo->ownerUserId, roomInfo->memberCount,
-                roomInfo->maxMemberCount, roomInfo->externalStateOctetCount,
-                roomInfo->applicationId, roomInfo->applicationVersion.major,
-                roomInfo->applicationVersion.minor, roomInfo->applicationVersion.patch);
-        }
-        drawPrompt(edit);
-        redlineEditBringback(edit);
+    command->data.ping.knowledge = (uint64_t)data->knowledge;
+    command->data.ping.hasConnectionToOwner = data->hasConnectionToOwner;
+
+    endRequestCommand(self, ClvCliRequestTypePing, response);
+}
+
+static void onStats(void* _self, const void* data, ClashResponse* response)
+{
+    (void)data;
+
+    App* self = (App*)_self;
+    if (beginCommand(self, ClvCliCommandTypeStats, response) == 0) {
+        return;
     }
+    endCommand(self);
 }
 
-int main(int argc, char** argv)
+static void onPerf(void* _self, const void* _data, ClashResponse* response)
 {
-    g_clog.log = clog_console;
-    g_clog.level = CLOG_TYPE_VERBOSE;
+    App* self = (App*)_self;
+    const PerfCmd* data = (const PerfCmd*)_data;
 
-    signal(SIGINT, interruptHandler);
+    ClvCliCommand* command = beginCommand(self, ClvCliCommandTypePerf, response);
+    if (command == 0) {
+        return;
+    }
+    command->data.perf.shouldSetBudget = data->budget >= 0;
+    command->data.perf.budget = data->budget >= 0 ? (ClvCliTimeNs)data->budget * 1000u : 0;
+    endCommand(self);
+}
 
-    GuiseClientUdpSecret guiseSecret;
+static void onMem(void* _self, const void* data, ClashResponse* response)
+{
+    (void)data;
+
+    App* self = (App*)_self;
+    if (beginCommand(self, ClvCliCommandTypeMem, response) == 0) {
+        return;
+    }
+    endCommand(self);
+}
+
+static void onLoadStart(void* _self, const void* _data, ClashResponse* response)
+{
+    App* self = (App*)_self;
+    const LoadStartCmd* data = (const LoadStartCmd*)_data;
 
-    size_t indexToRead = 0;
-    if (argc > 1) {
-        indexToRead = (size_t)atoi(argv[1]);
+    ClvCliRequestType type;
+    if (clvCliRequestTypeFromString(data->type, &type) < 0 || type == ClvCliRequestTypeRoomCreate) {
+        clashResponseWritecf(response, 1, "unknown load type '%s' (ping, roomjoin or roomlist)\n",
+            data->type);
+        return;
+    }
+    if (data->rate <= 0 || data->duration < 0) {
+        clashResponseWritecf(response, 1, "rate must be positive and duration not negative\n");
+        return;
+    }
+    if (type == ClvCliRequestTypeRoomList
+        && !isValidMaximumRoomCount(data->maximumCount, response)) {
+        return;
+    }
+    if (!self->status.hasStartedConclave) {
+        clashResponseWritecf(response, 4, "conclave not started yet\n");
+        return;
     }
 
-    guiseClientUdpReadSecret(&guiseSecret, indexToRead);
+    ClvCliCommand* command = beginCommand(self, ClvCliCommandTypeLoadStart, response);
+    if (command == 0) {
+        return;
+    }
 
-    ImprintDefaultSetup imprint;
-    imprintDefaultSetupInit(&imprint, 128 * 1024);
+    size_t clientCount = self->options.swarmCount > 0 ? self->options.swarmCount : 1;
+    ClvCliLoadOptions* load = &command->data.load;
+    load->type = type;
+    load->ratePerClient
+        = data->perClient ? (double)data->rate : (double)data->rate / (double)clientCount;
+    load->durationMs = (uint64_t)data->duration * 1000u;
+    load->roomJoin.roomIdToJoin = (ClvSerializeRoomId)data->roomId;
+    load->roomList.applicationId = data->applicationId;
+    load->roomList.maximumCount = (uint8_t)data->maximumCount;
 
-    GuiseClientUdp guiseClient;
-    guiseClientUdpInit(&guiseClient, 0, "127.0.0.1", 27004, &guiseSecret);
+    endCommand(self);
+    clashResponseWritecf(response, 3, "load: %s at %.1f requests/s from %zu clients", data->type,
+        load->ratePerClient * (double)clientCount, clientCount);
+    if (data->duration > 0) {
+        clashResponseWritecf(response, 3, " for %d s", data->duration);
+    }
+    clashResponseWritef(response, "\n");
+}
 
-    RedlineEdit edit;
+static void onLoadStop(void* _self, const void* data, ClashResponse* response)
+{
+    (void)data;
 
-    redlineEditInit(&edit);
+    App* self = (App*)_self;
+    if (beginCommand(self, ClvCliCommandTypeLoadStop, response) == 0) {
+        return;
+    }
+    endCommand(self);
+    clashResponseWritecf(response, 4, "load stopped, waiting for the last responses\n");
+}
 
-    drawPrompt(&edit);
+static void onChurnStart(void* _self, const void* _data, ClashResponse* response)
+{
+    App* self = (App*)_self;
+    const ChurnStartCmd* data = (const ChurnStartCmd*)_data;
 
-    FldOutStream outStream;
-    uint8_t buf[1024];
-    fldOutStreamInit(&outStream, buf, 1024);
+    if (self->options.swarmCount == 0) {
+        clashResponseWritecf(response, 4, "churn needs a swarm (--swarm <count>)\n");
+        return;
+    }
+    if (data->rate <= 0 || data->dwell < 0 || data->pingInterval <= 0 || data->timeout <= 0) {
+        clashResponseWritecf(
+            response, 1, "rate, ping and timeout must be positive and dwell not negative\n");
+        return;
+    }
 
-    Clog clvClientUdpLog;
-    clvClientUdpLog.config = &g_clog;
-    clvClientUdpLog.constantPrefix = "clvClientUdp";
+    ClvCliCommand* command = beginCommand(self, ClvCliCommandTypeChurnStart, response);
+    if (command == 0) {
+        return;
+    }
 
-    const char* conclaveHost = "127.0.0.1";
-    const uint16_t conclavePort = 27003;
+    size_t clientCount = self->options.swarmCount;
+    ClvCliChurnOptions* churn = &command->data.churn;
+    churn->joinRatePerClient
+        = data->perClient ? (double)data->rate : (double)data->rate / (double)clientCount;
+    churn->dwellMs = (uint32_t)data->dwell;
+    churn->pingIntervalMs = (uint32_t)data->pingInterval;
+    churn->timeoutMs = (uint32_t)data->timeout;
+    churn->roomList.applicationId = data->applicationId;
+    churn->roomList.maximumCount = 64;
 
-    App app;
-    app.secret = "working";
-    app.hasStartedConclave = false;
-    app.lastShownPingResponseVersion = 0;
-    app.lastShownRoomCreateVersion = 0;
-    app.lastShownRoomListVersion = 0;
-    app.log.config = &g_clog;
-    app.log.constantPrefix = "app";
+    endCommand(self);
+    clashResponseWritecf(response, 3,
+        "churn: %.1f joins/s from %zu clients, %d ms in each room, ping every %d ms\n",
+        churn->joinRatePerClient * (double)clientCount, clientCount, data->dwell,
+        data->pingInterval);
+}
 
-    while (!g_quit) {
-        MonotonicTimeMs now = monotonicTimeMsNow();
-        guiseClientUdpUpdate(&guiseClient, now);
-        if (!app.hasStartedConclave && guiseClient.guiseClient.state == GuiseClientStateLoggedIn) {
-            CLOG_INFO("conclave init")
-            clvClientUdpInit(&app.clvClient, conclaveHost, conclavePort,
-                guiseClient.guiseClient.mainUserSessionId, monotonicTimeMsNow(),
-                &imprint.slabAllocator.info, clvClientUdpLog);
-            app.hasStartedConclave = true;
-        }
-        if (app.hasStartedConclave) {
-            int updateResult = clvClientUdpUpdate(&app.clvClient, now);
-            if (updateResult < 0) {
-                return updateResult;
-            }
-            outputChangesIfAny(&app, &edit);
-        }
-        int result = redlineEditUpdate(&edit);
-        if (result == -1) {
-            printf("\n");
-            const char* textInput = redlineEditLine(&edit);
-            if (tc_str_equal(textInput, "quit")) {
-                break;
-            } else if (tc_str_equal(textInput, "help")) {
-                outStream.p = outStream.octets;
-                outStream.pos = 0;
-                clashUsageToStream(&commands, &outStream);
-                puts((const char*)outStream.octets);
-                outStream.p = outStream.octets;
-                outStream.pos = 0;
-            } else {
-                outStream.p = outStream.octets;
-                outStream.pos = 0;
-                int parseResult = clashParseString(&commands, textInput, &app, &outStream);
-                if (parseResult < 0) {
-                    printf("unknown command %d\n", parseResult);
-                }
-
-                if (outStream.pos > 0) {
-                    fputs((const char*)outStream.octets, stdout);
-                }
-                outStream.p = outStream.octets;
-                outStream.pos = 0;
-            }
-            redlineEditClear(&edit);
-            drawPrompt(&edit);
-            redlineEditReset(&edit);
-        }
-        sleepMs(16);
+static void onChurnStop(void* _self, const void* data, ClashResponse* response)
+{
+    (void)data;
+
+    App* self = (App*)_self;
+    if (beginCommand(self, ClvCliCommandTypeChurnStop, response) == 0) {
+        return;
     }
+    endCommand(self);
+    clashResponseWritecf(response, 4, "churn stopped, `churn report` shows the result\n");
+}
+
+static void onChurnReport(void* _self, const void* data, ClashResponse* response)
+{
+    (void)data;
 
-    redlineEditClose(&edit);
+    App* self = (App*)_self;
+    if (beginCommand(self, ClvCliCommandTypeChurnReport, response) == 0) {
+        return;
+    }
+    endCommand(self);
+}
 
-    return 0;
+static void onSimulateStart(void* _self, const void* _data, ClashResponse* response)
+{
+    App* self = (App*)_self;
+    const SimulateStartCmd* data = (const SimulateStartCmd*)_data;
+
+    if (self->options.swarmCount == 0) {
+        clashResponseWritecf(response, 4, "simulate needs a swarm (--swarm <count>)\n");
+        return;
+    }
+    if (data->ticksPerSecond <= 0 || data->pingInterval <= 0) {
+        clashResponseWritecf(response, 1, "tick rate and ping interval must be positive\n");
+        return;
+    }
+
+    ClvCliCommand* command = beginCommand(self, ClvCliCommandTypeSimulateStart, response);
+    if (command == 0) {
+        return;
+    }
+    command->data.simulate.ticksPerSecond = (uint32_t)data->ticksPerSecond;
+    command->data.simulate.pingIntervalMs = (uint32_t)data->pingInterval;
+    endCommand(self);
+
+    clashResponseWritecf(response, 3, "simulate: %d ticks/s, ping every %d ms from %zu clients\n",
+        data->ticksPerSecond, data->pingInterval, self->options.swarmCount);
+}
+
+static void onSimulateStop(void* _self, const void* data, ClashResponse* response)
+{
+    (void)data;
+
+    App* self = (App*)_self;
+    if (beginCommand(self, ClvCliCommandTypeSimulateStop, response) == 0) {
+        return;
+    }
+    endCommand(self);
+    clashResponseWritecf(response, 4, "simulation stopped, `simulate report` shows the result\n");
+}
+
+static void sendSimulateInject(App* self, ClvCliSimulateFault fault, const SimulateInjectCmd* data,
+    ClashResponse* response)
+{
+    if (data->percent < 0 || data->percent > 100 || data->speed < 0 || data->speed > 100) {
+        clashResponseWritecf(response, 1, "percent and speed must be 0 to 100\n");
+        return;
+    }
+
+    ClvCliCommand* command = beginCommand(self, ClvCliCommandTypeSimulateInject, response);
+    if (command == 0) {
+        return;
+    }
+    ClvCliSimulateInjectOptions* inject = &command->data.simulateInject;
+    inject->fault = fault;
+    inject->percent = (uint8_t)data->percent;
+    inject->ownersOnly = data->ownersOnly != 0;
+    inject->speedPercent = (uint8_t)data->speed;
+    endCommand(self);
+
+    if (fault == ClvCliSimulateFaultHeal) {
+        clashResponseWritecf(response, 3, "simulate: all clients healed\n");
+        return;
+    }
+    clashResponseWritecf(response, 3, "simulate: %s in %d%% of the %s\n",
+        clvCliSimulateFaultToString(fault), data->percent, data->ownersOnly ? "owners" : "clients");
+}
+
+static void onSimulateLag(void* _self, const void* data, ClashResponse* response)
+{
+    sendSimulateInject(
+        (App*)_self, ClvCliSimulateFaultLag, (const SimulateInjectCmd*)data, response);
+}
+
+static void onSimulateDisconnect(void* _self, const void* data, ClashResponse* response)
+{
+    sendSimulateInject(
+        (App*)_self, ClvCliSimulateFaultDisconnect, (const SimulateInjectCmd*)data, response);
+}
+
+static void onSimulateSilent(void* _self, const void* data, ClashResponse* response)
+{
+    sendSimulateInject(
+        (App*)_self, ClvCliSimulateFaultSilent, (const SimulateInjectCmd*)data, response);
+}
+
+static void onSimulateHeal(void* _self, const void* data, ClashResponse* response)
+{
+    (void)data;
+
+    SimulateInjectCmd heal;
+    heal.percent = 100;
+    heal.ownersOnly = 0;
+    heal.speed = 100;
+    sendSimulateInject((App*)_self, ClvCliSimulateFaultHeal, &heal, response);
+}
+
+static void onSimulateReport(void* _self, const void* data, ClashResponse* response)
+{
+    (void)data;
+
+    App* self = (App*)_self;
+    if (beginCommand(self, ClvCliCommandTypeSimulateReport, response) == 0) {
+        return;
+    }
+    endCommand(self);
+}
+
+static void writeJournalEntry(
+    ClashResponse* response, uint64_t sequence, const ClvCliJournalEntry* entry)
+{
+    clashResponseWritef(response, "#%" PRIu64 " %" PRIu64 ".%06" PRIu64 " ", sequence,
+        entry->time / 1000000000u, entry->time / 1000u % 1000000u);
+    switch ((ClvCliJournalEntryType)entry->type) {
+        case ClvCliJournalEntryTypePingResponse:
+            clashResponseWritef(response,
+                "ping response term:%" PRIx64 " version:%" PRIx64 " members:%d owner:%d\n",
+                entry->term, entry->roomVersion, entry->count, entry->index);
+            break;
+        case ClvCliJournalEntryTypeRoomCreated:
+            clashResponseWritef(response, "room created roomID:%u connectionToRoom:%d\n",
+                entry->roomId, entry->index);
+            break;
+        case ClvCliJournalEntryTypeRoomList:
+            clashResponseWritef(response, "room list rooms:%d\n", entry->count);
+            break;
+    }
+}
+
+/// Shows the last responses from the journal
+/// The journal is append-only, so the entries can be read while the network thread adds more.
+static void onJournal(void* _self, const void* _data, ClashResponse* response)
+{
+    App* self = (App*)_self;
+    const JournalCmd* data = (const JournalCmd*)_data;
+
+    if (self->options.swarmCount > 0) {
+        clashResponseWritecf(response, 4, "the journal is only kept for a single client\n");
+        return;
+    }
+
+    const ClvCliJournal* journal = &self->network.journal;
+    uint64_t last = clvCliJournalCount(journal);
+    uint64_t count = data->count > 0 ? (uint64_t)data->count : 0;
+    uint64_t first = last > count ? last - count + 1 : 1;
+    for (uint64_t sequence = first; sequence <= last; ++sequence) {
+        reserveResponseLine(self);
+        writeJournalEntry(response, sequence, clvCliJournalGet(journal, sequence));
+    }
+    reserveResponseLine(self);
+    clashResponseWritecf(response, 4, "%" PRIu64 " responses journaled\n", last);
+}
+
+static ClashOption roomCreateOptions[]
+    = { { "name", 'n', "the name of the room", ClashTypeString | ClashTypeArg, "secretRoom",
+            offsetof(RoomCreateCmd, name) },
+          { "verbose", 'v', "enable detailed output", ClashTypeFlag, "",
+              offsetof(RoomCreateCmd, verbose) } };
+
+static ClashOption roomJoinOptions[] = {
+    { "id", 'i', "the id of the room to join", ClashTypeUInt64 | ClashTypeArg, "",
+        offsetof(RoomJoinCmd, roomId) },
+    { "verbose", 'v', "enable detailed output", ClashTypeFlag, "", offsetof(RoomJoinCmd, verbose) }
+};
+
+static ClashOption roomListOptions[]
+    = { { "applicationId", 'i', "the application ID", ClashTypeUInt64 | ClashTypeArg, "42",
+            offsetof(RoomListCmd, applicationId) },
+          { "maximumCount", 'c', "maximum number of rooms in each list (1-255)", ClashTypeInt, "8",
+              offsetof(RoomListCmd, maximumCount) },
+          { "all", 'a', "list until no more rooms are found, into the room cache", ClashTypeFlag,
+              "", offsetof(RoomListCmd, all) },
+          { "pages", 'n', "all, maximum number of requests", ClashTypeInt, "256",
+              offsetof(RoomListCmd, maximumPageCount) } };
+
+static ClashOption roomWatchOptions[] = {
+    { "interval", 'i', "milliseconds between room lists", ClashTypeInt | ClashTypeArg, "1000",
+        offsetof(RoomWatchCmd, interval) },
+    { "applicationId", 'a', "the application ID", ClashTypeUInt64, "42",
+        offsetof(RoomWatchCmd, applicationId) },
+    { "maximumCount", 'c', "maximum number of rooms in each list", ClashTypeInt, "64",
+        offsetof(RoomWatchCmd, maximumCount) },
+};
+
+static ClashOption roomFindOptions[] = {
+    { "name", 'n', "the start of the room name", ClashTypeString | ClashTypeArg, "",
+        offsetof(RoomFindCmd, namePrefix) },
+    { "id", 'i', "the id of the room, 0 for any", ClashTypeUInt64, "0",
+        offsetof(RoomFindCmd, roomId) },
+    { "applicationId", 'a', "the application ID, 0 for any", ClashTypeUInt64, "0",
+        offsetof(RoomFindCmd, applicationId) },
+    { "free", 'f', "minimum number of free member slots", ClashTypeInt, "0",
+        offsetof(RoomFindCmd, minimumFreeSlots) },
+    { "max-age", 'm', "milliseconds since the room was last listed, 0 for any", ClashTypeInt, "0",
+        offsetof(RoomFindCmd, maximumAge) },
+    { "count", 'c', "maximum number of rooms to show", ClashTypeInt, "16",
+        offsetof(RoomFindCmd, count) },
+};
+
+static ClashOption roomTopOptions[] = {
+    { "count", 'c', "number of rooms to show", ClashTypeInt | ClashTypeArg, "10",
+        offsetof(RoomTopCmd, count) },
+    { "applicationId", 'a', "the application ID, 0 for any", ClashTypeUInt64, "0",
+        offsetof(RoomTopCmd, applicationId) },
+    { "max-age", 'm', "milliseconds since the room was last listed, 0 for any", ClashTypeInt, "0",
+        offsetof(RoomTopCmd, maximumAge) },
+};
+
+static ClashCommand roomCommands[] = {
+    { "create", "Create a room", sizeof(struct RoomCreateCmd), roomCreateOptions,
+        sizeof(roomCreateOptions) / sizeof(roomCreateOptions[0]), 0, 0, (ClashFn)onRoomCreate },
+    { "join", "Join a room", sizeof(struct RoomJoinCmd), roomJoinOptions,
+        sizeof(roomJoinOptions) / sizeof(roomJoinOptions[0]), 0, 0, (ClashFn)onRoomJoin },
+    { "list", "list rooms", sizeof(struct RoomListCmd), roomListOptions,
+        sizeof(roomListOptions) / sizeof(roomListOptions[0]), 0, 0, (ClashFn)onRoomList },
+    { "watch", "list rooms at an interval and show the changes", sizeof(struct RoomWatchCmd),
+        roomWatchOptions, sizeof(roomWatchOptions) / sizeof(roomWatchOptions[0]), 0, 0,
+        (ClashFn)onRoomWatch },
+    { "unwatch", "stop watching rooms", 0, 0, 0, 0, 0, onRoomUnwatch },
+    { "find", "find rooms in the received room lists", sizeof(struct RoomFindCmd),
+        roomFindOptions, sizeof(roomFindOptions) / sizeof(roomFindOptions[0]), 0, 0,
+        (ClashFn)onRoomFind },
+    { "top", "received rooms with the most free slots", sizeof(struct RoomTopCmd), roomTopOptions,
+        sizeof(roomTopOptions) / sizeof(roomTopOptions[0]), 0, 0, (ClashFn)onRoomTop },
+};
+
+static ClashOption pingOptions[] = {
+    { "knowledge", 'k', "how much knowledge (simulation tick ID) that the client has",
+        (ClashOptionType)ClashTypeInt | ClashTypeArg, "0", offsetof(PingCmd, knowledge) },
+    { "isconnected", 'c', "has connection to room owner", ClashTypeBool, "",
+        offsetof(PingCmd, hasConnectionToOwner) },
+    { "verbose", 'v', "enable detailed output", ClashTypeFlag, "", offsetof(PingCmd, verbose) }
+};
+
+static ClashOption journalOptions[] = {
+    { "count", 'c', "number of responses to show", ClashTypeInt | ClashTypeArg, "10",
+        offsetof(JournalCmd, count) },
+};
+
+static ClashOption perfOptions[] = {
+    { "budget", 'b', "warn about frames slower than this (us), 0 to never warn", ClashTypeInt,
+        "-1", offsetof(PerfCmd, budget) },
+};
+
+static ClashOption loadStartOptions[] = {
+    { "type", 't', "request to send: ping, roomjoin or roomlist", ClashTypeString | ClashTypeArg,
+        "ping", offsetof(LoadStartCmd, type) },
+    { "rate", 'r', "requests per second, for all clients together", ClashTypeInt, "100",
+        offsetof(LoadStartCmd, rate) },
+    { "duration", 'd', "seconds to run, 0 to run until stopped", ClashTypeInt, "10",
+        offsetof(LoadStartCmd, duration) },
+    { "per-client", 'p', "the rate is for each client", ClashTypeFlag, "",
+        offsetof(LoadStartCmd, perClient) },
+    { "room", 'i', "the id of the room to join", ClashTypeUInt64, "0",
+        offsetof(LoadStartCmd, roomId) },
+    { "applicationId", 'a', "the application ID of the rooms to list", ClashTypeUInt64, "42",
+        offsetof(LoadStartCmd, applicationId) },
+    { "maximumCount", 'c', "maximum number of rooms in each list", ClashTypeInt, "8",
+        offsetof(LoadStartCmd, maximumCount) },
+};
+
+static ClashCommand loadCommands[] = {
+    { "start", "send requests at a fixed rate", sizeof(struct LoadStartCmd), loadStartOptions,
+        sizeof(loadStartOptions) / sizeof(loadStartOptions[0]), 0, 0, (ClashFn)onLoadStart },
+    { "stop", "stop sending and report", 0, 0, 0, 0, 0, onLoadStop },
+};
+
+static ClashOption churnStartOptions[] = {
+    { "rate", 'r', "room joins per second, for all clients together", ClashTypeInt | ClashTypeArg,
+        "10", offsetof(ChurnStartCmd, rate) },
+    { "per-client", 'p', "the rate is for each client", ClashTypeFlag, "",
+        offsetof(ChurnStartCmd, perClient) },
+    { "dwell", 'd', "milliseconds to stay in each room", ClashTypeInt, "5000",
+        offsetof(ChurnStartCmd, dwell) },
+    { "ping", 'i', "milliseconds between pings while in a room", ClashTypeInt, "500",
+        offsetof(ChurnStartCmd, pingInterval) },
+    { "timeout", 't', "milliseconds until a join without a response has failed", ClashTypeInt,
+        "2000", offsetof(ChurnStartCmd, timeout) },
+    { "applicationId", 'a', "the application ID of the rooms to list", ClashTypeUInt64, "42",
+        offsetof(ChurnStartCmd, applicationId) },
+};
+
+static ClashCommand churnCommands[] = {
+    { "start", "move the swarm clients between rooms", sizeof(struct ChurnStartCmd),
+        churnStartOptions, sizeof(churnStartOptions) / sizeof(churnStartOptions[0]), 0, 0,
+        (ClashFn)onChurnStart },
+    { "stop", "stop joining rooms", 0, 0, 0, 0, 0, onChurnStop },
+    { "report", "show join latency, failures and convergence", 0, 0, 0, 0, 0, onChurnReport },
+};
+
+static ClashOption simulateStartOptions[] = {
+    { "hz", 'z', "simulation ticks per second", ClashTypeInt, "60",
+        offsetof(SimulateStartCmd, ticksPerSecond) },
+    { "ping", 'i', "milliseconds between pings", ClashTypeInt, "100",
+        offsetof(SimulateStartCmd, pingInterval) },
+};
+
+static ClashOption simulateInjectOptions[] = {
+    { "percent", 'p', "percent of the clients", ClashTypeInt | ClashTypeArg, "10",
+        offsetof(SimulateInjectCmd, percent) },
+    { "owners", 'o', "only clients that own their room", ClashTypeFlag, "",
+        offsetof(SimulateInjectCmd, ownersOnly) },
+    { "speed", 's', "lag, percent of the tick rate that a lagging client simulates at",
+        ClashTypeInt, "50", offsetof(SimulateInjectCmd, speed) },
+};
+
+static ClashCommand simulateCommands[] = {
+    { "start", "run a game tick simulation on the swarm clients", sizeof(SimulateStartCmd),
+        simulateStartOptions, sizeof(simulateStartOptions) / sizeof(simulateStartOptions[0]), 0,
+        0, onSimulateStart },
+    { "stop", "stop pinging", 0, 0, 0, 0, 0, onSimulateStop },
+    { "lag", "clients fall behind in knowledge", sizeof(SimulateInjectCmd), simulateInjectOptions,
+        sizeof(simulateInjectOptions) / sizeof(simulateInjectOptions[0]), 0, 0, onSimulateLag },
+    { "disconnect", "clients lose the connection to the room owner", sizeof(SimulateInjectCmd),
+        simulateInjectOptions, sizeof(simulateInjectOptions) / sizeof(simulateInjectOptions[0]),
+        0, 0, onSimulateDisconnect },
+    { "silent", "clients stop pinging", sizeof(SimulateInjectCmd), simulateInjectOptions,
+        sizeof(simulateInjectOptions) / sizeof(simulateInjectOptions[0]), 0, 0,
+        onSimulateSilent },
+    { "heal", "remove all faults", 0, 0, 0, 0, 0, onSimulateHeal },
+    { "report", "show owner migration times", 0, 0, 0, 0, 0, onSimulateReport },
+};
+
+static ClashCommand mainCommands[] = {
+    { "room", "room commands", 0, 0, 0, roomCommands,
+        sizeof(roomCommands) / sizeof(roomCommands[0]), 0 },
+    { "state", "show state on conclave client", 0, 0, 0, 0, 0, onState },
+    { "ping", "ping the conclave server", sizeof(PingCmd), pingOptions,
+        sizeof(pingOptions) / sizeof(pingOptions[0]), 0, 0, onPing },
+    { "stats", "show round trip time percentiles", 0, 0, 0, 0, 0, onStats },
+    { "perf", "show network thread frame times", sizeof(PerfCmd), perfOptions,
+        sizeof(perfOptions) / sizeof(perfOptions[0]), 0, 0, onPerf },
+    { "mem", "show the imprint allocations of the conclave clients", 0, 0, 0, 0, 0, onMem },
+    { "load", "open loop load generator", 0, 0, 0, loadCommands,
+        sizeof(loadCommands) / sizeof(loadCommands[0]), 0 },
+    { "churn", "room join and leave churn of the swarm", 0, 0, 0, churnCommands,
+        sizeof(churnCommands) / sizeof(churnCommands[0]), 0 },
+    { "simulate", "game tick simulation with injected faults", 0, 0, 0, simulateCommands,
+        sizeof(simulateCommands) / sizeof(simulateCommands[0]), 0 },
+    { "journal", "show the last received responses", sizeof(JournalCmd), journalOptions,
+        sizeof(journalOptions) / sizeof(journalOptions[0]), 0, 0, onJournal },
+};
+
+static ClashDefinition commands = { mainCommands, sizeof(mainCommands) / sizeof(mainCommands[0]) };
+
+static void printHouse(ClvCliRender* render)
+{
+    clvCliRenderWrite(render, "\xF0\x9F\x8F\xA0");
+}
+
+/// Removes the prompt and the half typed line before printing, if interactive
+static void beginOutput(App* app)
+{
+    if (app->isInteractive) {
+        redlineEditRemove(&app->edit);
+    }
+}
+
+static void endOutput(App* app)
+{
+    if (app->isInteractive) {
+        drawPrompt(&app->edit);
+        redlineEditBringback(&app->edit);
+    }
+}
+
+static void printPingResponse(
+    ClvCliRender* render, const ClvSerializePingResponseOptions* pingResponse)
+{
+    clvCliRenderWrite(render, "--- room info updated ---\n");
+    clvCliRenderWritef(render, "term: %" PRIx64 ", version:%" PRIx64 "\n", pingResponse->term,
+        pingResponse->version);
+
+    for (size_t i = 0; i < pingResponse->roomInfo.memberCount; ++i) {
+        if (i == pingResponse->roomInfo.indexOfOwner) {
+            clvCliRenderWrite(render, "\xF0\x9F\x91\x91"); // Crown
+        } else {
+            clvCliRenderWrite(render, " ");
+        }
+
+        clvCliRenderWrite(render, "\xF0\x9F\x91\xA4"); // Bust
+
+        clvCliRenderWritef(render, " userID: %" PRIX64 "\n", pingResponse->roomInfo.members[i]);
+    }
+}
+
+static void printRoomList(
+    ClvCliRender* render, const ClvSerializeListRoomsResponseOptions* roomList)
+{
+    clvCliRenderWrite(render, "--- Room list received ---\n");
+    for (size_t i = 0; i < roomList->roomInfoCount; ++i) {
+        const ClvSerializeRoomInfo* roomInfo = &roomList->roomInfos[i];
+        printHouse(render);
+        clvCliRenderWritef(render,
+            " roomId: %d, name: '%s', owner: %" PRIX64
+            " members:%d/%d stateOctetCount: %hu, application:%" PRIx64 " version:%d.%d.%d\n",
+            roomInfo->roomId, roomInfo->roomName, roomInfo->ownerUserId, roomInfo->memberCount,
+            roomInfo->maxMemberCount, roomInfo->externalStateOctetCount, roomInfo->applicationId,
+            roomInfo->applicationVersion.major, roomInfo->applicationVersion.minor,
+            roomInfo->applicationVersion.patch);
+    }
+}
+
+static void printRoomInfoChange(ClvCliRender* render, const ClvCliRoomChange* change)
+{
+    const ClvSerializeRoomInfo* roomInfo = &change->roomInfo;
+    const ClvSerializeRoomInfo* previous = &change->previous;
+    if (change->changedMask & CLV_CLI_ROOM_CHANGED_MEMBERS) {
+        clvCliRenderWritef(
+            render, " members:%d->%d", previous->memberCount, roomInfo->memberCount);
+    }
+    if (change->changedMask & CLV_CLI_ROOM_CHANGED_OWNER) {
+        clvCliRenderWritef(render, " owner:%" PRIX64 "->%" PRIX64, previous->ownerUserId,
+            roomInfo->ownerUserId);
+    }
+    if (change->changedMask & CLV_CLI_ROOM_CHANGED_STATE) {
+        clvCliRenderWritef(render, " stateOctetCount:%hu->%hu",
+            previous->externalStateOctetCount, roomInfo->externalStateOctetCount);
+    }
+    if (change->changedMask & CLV_CLI_ROOM_CHANGED_OTHER) {
+        clvCliRenderWritef(render, " name: '%s' maxMembers:%d application:%" PRIx64,
+            roomInfo->roomName, roomInfo->maxMemberCount, roomInfo->applicationId);
+    }
+}
+
+/// Prints only the rooms that were added, removed or changed since the last room list
+static void printRoomListChanges(ClvCliRender* render, ClvCliRoomListDiff* diff,
+    const ClvSerializeListRoomsResponseOptions* roomList)
+{
+    ClvCliRoomChange changes[2 * CLV_CLI_ROOM_LIST_DIFF_CAPACITY];
+    size_t changeCount = clvCliRoomListDiffUpdate(
+        diff, roomList, changes, sizeof(changes) / sizeof(changes[0]));
+    for (size_t i = 0; i < changeCount; ++i) {
+        const ClvCliRoomChange* change = &changes[i];
+        const ClvSerializeRoomInfo* roomInfo = &change->roomInfo;
+        switch (change->type) {
+            case ClvCliRoomChangeTypeAdded:
+                clvCliRenderWritef(render,
+                    "+ roomId: %d, name: '%s', owner: %" PRIX64 " members:%d/%d\n",
+                    roomInfo->roomId, roomInfo->roomName, roomInfo->ownerUserId,
+                    roomInfo->memberCount, roomInfo->maxMemberCount);
+                break;
+            case ClvCliRoomChangeTypeRemoved:
+                clvCliRenderWritef(
+                    render, "- roomId: %d, name: '%s'\n", roomInfo->roomId, roomInfo->roomName);
+                break;
+            case ClvCliRoomChangeTypeChanged:
+                clvCliRenderWritef(render, "~ roomId: %d", roomInfo->roomId);
+                printRoomInfoChange(render, change);
+                clvCliRenderWrite(render, "\n");
+                break;
+        }
+    }
+}
+
+static void printState(ClvCliRender* render, const ClvCliNetworkState* state)
+{
+    if (state->swarmClientCount > 0) {
+        clvCliRenderWritef(render, "swarm: %zu clients, logging in:%zu conclave:%zu failed:%zu\n",
+            state->swarmClientCount, state->swarmPhaseCounts[ClvCliSwarmPhaseLoggingIn],
+            state->swarmPhaseCounts[ClvCliSwarmPhaseConclave],
+            state->swarmPhaseCounts[ClvCliSwarmPhaseFailed]);
+        clvCliRenderWritef(render, "responses: ping:%zu room create:%zu room list:%zu\n",
+            state->pingResponseCount, state->roomCreateCount, state->roomListCount);
+        return;
+    }
+    if (!state->hasStartedConclave) {
+        clvCliRenderWrite(render, "conclave not started yet\n");
+        return;
+    }
+    clvCliRenderWritef(
+        render, "state: %s\n", clvClientStateToString((ClvClientState)state->clientState));
+}
+
+static void printHistogram(ClvCliRender* render, const ClvCliHistogram* histogram, const char* name)
+{
+    char line[128];
+    clvCliHistogramFormat(histogram, name, line, sizeof(line));
+    clvCliRenderWrite(render, line);
+}
+
+static void printStats(ClvCliRender* render, const ClvCliNetworkStats* stats)
+{
+    if (stats->swarmClientCount > 0) {
+        clvCliRenderWritef(
+            render, "round trip times for %zu swarm clients:\n", stats->swarmClientCount);
+    } else {
+        clvCliRenderWrite(render, "round trip times:\n");
+    }
+    for (size_t i = 0; i < ClvCliRequestTypeCount; ++i) {
+        printHistogram(
+            render, &stats->histograms[i], clvCliRequestTypeToString((ClvCliRequestType)i));
+    }
+    if (stats->unmatchedCount > 0) {
+        clvCliRenderWritef(render, "unmatched: %zu\n", stats->unmatchedCount);
+    }
+    if (stats->lostCount > 0) {
+        clvCliRenderWritef(render, "lost: %zu\n", stats->lostCount);
+    }
+    if (stats->swarmClientCount == 0) {
+        clvCliRenderWritef(render, "journal: %" PRIu64 " responses", stats->journalCount);
+        if (stats->journalDroppedCount > 0) {
+            clvCliRenderWritef(render, " (%" PRIu64 " did not fit)", stats->journalDroppedCount);
+        }
+        clvCliRenderWrite(render, "\n");
+    }
+    clvCliRenderWritef(render, "coalesced: %" PRIu64 " dropped events: %zu\n",
+        stats->coalescedCount, stats->droppedEventCount);
+    if (stats->swarmClientCount > 0) {
+        const ClvCliOwnerConvergenceReport* owner = &stats->ownerConvergence;
+        clvCliRenderWritef(render,
+            "owner migrations: %" PRIu64 " in %zu rooms, converged:%" PRIu64
+            " pending:%zu superseded:%" PRIu64 " stale:%" PRIu64 " dropped:%" PRIu64 "\n",
+            owner->migrationCount, owner->roomCount, owner->convergedCount, owner->pendingCount,
+            owner->supersededCount, owner->staleCount, owner->droppedCount);
+        printHistogram(render, &owner->convergenceLatencies, "convergence");
+    }
+}
+
+static void printOutChainStats(ClvCliRender* render, const ClvCliOutChain* output)
+{
+    clvCliRenderWritef(render, "command output: peak %zu octets, %zu chunks with %zu octets\n",
+        output->peakOctets, output->chunkCount, clvCliOutChainCapacity(output));
+}
+
+static void printLoadReport(ClvCliRender* render, const ClvCliLoadReport* report)
+{
+    double seconds = (double)report->elapsed / 1000000000.0;
+    clvCliRenderWritef(render, "load %s: target %.1f/s achieved %.1f/s over %.1f s\n",
+        clvCliRequestTypeToString(report->type), report->targetRate,
+        seconds > 0.0 ? (double)report->sentCount / seconds : 0.0, seconds);
+    clvCliRenderWritef(render,
+        "intended:%" PRIu64 " sent:%" PRIu64 " received:%" PRIu64 " skipped:%" PRIu64 "\n",
+        report->intendedCount, report->sentCount, report->receivedCount, report->skippedCount);
+    printHistogram(render, &report->latencies, "latency");
+}
+
+static void printChurnReport(ClvCliRender* render, const ClvCliChurnReport* report)
+{
+    double seconds = (double)report->elapsed / 1000000000.0;
+    clvCliRenderWritef(render, "churn: target %.1f joins/s achieved %.1f/s over %.1f s\n",
+        report->targetRate, seconds > 0.0 ? (double)report->joinCount / seconds : 0.0, seconds);
+    clvCliRenderWritef(render,
+        "lists:%" PRIu64 " (%" PRIu64 " without a room) joins:%" PRIu64 " joined:%" PRIu64
+        " failed:%" PRIu64 " left:%" PRIu64 "\n",
+        report->listCount, report->emptyListCount, report->joinCount, report->joinedCount,
+        report->failedCount, report->leaveCount);
+    clvCliRenderWritef(render, "converged:%" PRIu64 " left before converged:%" PRIu64 "\n",
+        report->convergedCount, report->notConvergedCount);
+    printHistogram(render, &report->joinLatencies, "join");
+    printHistogram(render, &report->convergenceLatencies, "convergence");
+}
+
+static void printSimulateReport(ClvCliRender* render, const ClvCliSimulateReport* report)
+{
+    clvCliRenderWritef(render,
+        "simulate: %u ticks/s over %.1f s, pings:%" PRIu64 " responses:%" PRIu64 "\n",
+        report->ticksPerSecond, (double)report->elapsed / 1000000000.0, report->pingCount,
+        report->responseCount);
+    clvCliRenderWritef(render,
+        "owners:%zu lagging:%zu disconnected:%zu silent:%zu\n", report->ownerCount,
+        report->laggingCount, report->disconnectedCount, report->silentCount);
+    clvCliRenderWritef(render,
+        "term changes:%" PRIu64 " owner changes:%" PRIu64 " waiting for a new owner:%zu\n",
+        report->termChangeCount, report->ownerChangeCount, report->awaitingMigrationCount);
+    printHistogram(render, &report->migrationLatencies, "migration");
+}
+
+static void printMemReport(ClvCliRender* render, const ClvCliImprintReport* report)
+{
+    size_t budgetPerClient
+        = report->clientCount > 0 ? report->budgetOctets / report->clientCount : 0;
+    clvCliRenderWritef(render,
+        "imprint: %zu clients, budget %zu KiB (%zu KiB each), live %zu KiB (%zu requested), "
+        "peak %zu KiB\n",
+        report->clientCount, report->budgetOctets / 1024, budgetPerClient / 1024,
+        report->liveOctets / 1024, report->requestedOctets / 1024, report->peakLiveOctets / 1024);
+    clvCliRenderWritef(render,
+        "allocations:%" PRIu64 " frees:%" PRIu64 " failed:%" PRIu64 " untracked frees:%" PRIu64
+        "\n",
+        report->allocationCount, report->freeCount, report->failedCount,
+        report->untrackedFreeCount);
+    for (size_t i = 0; i < CLV_CLI_IMPRINT_SIZE_CLASS_COUNT; ++i) {
+        const ClvCliImprintSizeClass* sizeClass = &report->sizeClasses[i];
+        if (sizeClass->allocationCount == 0) {
+            continue;
+        }
+        clvCliRenderWritef(render,
+            " %7zu%s octets: allocations:%" PRIu64 " frees:%" PRIu64 " live:%zu peak:%zu\n",
+            clvCliImprintSizeClassOctets(i), i == CLV_CLI_IMPRINT_SIZE_CLASS_COUNT - 1 ? "+" : " ",
+            sizeClass->allocationCount, sizeClass->freeCount, sizeClass->liveCount,
+            sizeClass->peakLiveCount);
+    }
+    if (report->clientCount > 0) {
+        clvCliRenderWritef(render, "peak for each client: %zu octets\n",
+            report->peakLiveOctets / report->clientCount);
+    }
+}
+
+static void printPerfReport(ClvCliRender* render, const ClvCliPerfReport* report)
+{
+    const ClvCliPerfWindow* window = &report->window;
+    clvCliRenderWritef(render,
+        "frames: %" PRIu64 " in the last %.1f s, %" PRIu64 " over budget (%" PRIu64
+        " of %" PRIu64 " in total)\n",
+        window->frameCount, (double)report->windowDuration / 1000000000.0,
+        window->overBudgetCount, report->totalOverBudgetCount, report->totalFrameCount);
+    if (report->budget == 0) {
+        clvCliRenderWrite(render, "budget: none\n");
+    } else {
+        clvCliRenderWritef(render, "budget: %.3f ms\n", (double)report->budget / 1000000.0);
+    }
+    clvCliRenderWrite(render, "wall time:\n");
+    for (size_t i = 0; i <= ClvCliPerfPhaseCount; ++i) {
+        printHistogram(render, &window->wall[i], clvCliPerfPhaseToString((ClvCliPerfPhase)i));
+    }
+    clvCliRenderWrite(render, "cpu time:\n");
+    for (size_t i = 0; i <= ClvCliPerfPhaseCount; ++i) {
+        printHistogram(render, &window->cpu[i], clvCliPerfPhaseToString((ClvCliPerfPhase)i));
+    }
+}
+
+/// Names the loop of a latency report, with the resend interval that keeps an idle epoll loop
+/// waking up (the polling loop wakes up every frame anyway)
+static void formatLatencyDescription(
+    const App* app, const char* name, char* target, size_t maxOctetCount)
+{
+    if (app->options.usePolling) {
+        snprintf(target, maxOctetCount, "%s", name);
+        return;
+    }
+    snprintf(target, maxOctetCount, "%s (idle wake every %zu ms, --resend)", name,
+        app->options.resendIntervalMs);
+}
+
+static void printFrameOverBudget(ClvCliRender* render, const ClvCliPerfWarning* warning)
+{
+    const ClvCliPerfFrame* frame = &warning->frame;
+    clvCliRenderWritef(render, "slow frame: %.3f ms (cpu %.3f ms), budget %.3f ms",
+        (double)frame->wall[CLV_CLI_PERF_FRAME] / 1000000.0,
+        (double)frame->cpu[CLV_CLI_PERF_FRAME] / 1000000.0,
+        (double)warning->budget / 1000000.0);
+    if (warning->overBudgetCount > 1) {
+        clvCliRenderWritef(render, ", %" PRIu64 " slow frames since last warning",
+            warning->overBudgetCount);
+    }
+    clvCliRenderWrite(render, "\n");
+    for (size_t i = 0; i < ClvCliPerfPhaseCount; ++i) {
+        if (frame->wall[i] == 0) {
+            continue;
+        }
+        clvCliRenderWritef(render, "%12s: %.3f ms (cpu %.3f ms)\n",
+            clvCliPerfPhaseToString((ClvCliPerfPhase)i), (double)frame->wall[i] / 1000000.0,
+            (double)frame->cpu[i] / 1000000.0);
+    }
+}
+
+/// The status from the network thread is only used when all sent commands have been executed,
+/// so that a `wait` directly after a command does not finish before the request is sent.
+static bool isStatusCurrent(const App* self)
+{
+    return self->status.commandSequence >= self->lastCommandSequence;
+}
+
+/// Requests of a type that is no longer pending in the network thread are done, even if
+/// their responses were not reported one by one (swarm, or events that did not fit)
+static void completeNotPendingRequests(App* app)
+{
+    if (app->inFlight.pendingCount == 0) {
+        return;
+    }
+    ClvCliTimeNs now = clvCliClockNowNs();
+    for (size_t i = 0; i < ClvCliRequestTypeCount; ++i) {
+        if ((app->status.pendingMask & (1 << i)) == 0) {
+            clvCliInFlightDoneUpTo(
+                &app->inFlight, (ClvCliRequestType)i, app->status.commandSequence, now);
+        }
+    }
+}
+
+/// Notes that the request of a `room list --all` was answered
+/// The network thread publishes the room list right after the request done event.
+/// @param app app
+/// @param correlationId the answered request
+static void roomListAllAnswered(App* app, uint64_t correlationId)
+{
+    RoomListAll* all = &app->roomListAll;
+    if (!all->isActive || correlationId != all->pendingCorrelationId) {
+        return;
+    }
+    all->pendingCorrelationId = 0;
+    all->isPageNext = true;
+}
+
+/// Counts a room list response for a `room list --all`
+/// @param app app
+/// @param roomList the response
+/// @param newRoomCount rooms in the response that were not cached before
+static void roomListAllReceived(
+    App* app, const ClvSerializeListRoomsResponseOptions* roomList, size_t newRoomCount)
+{
+    RoomListAll* all = &app->roomListAll;
+    all->isPageNext = false;
+    all->receivedCount++;
+    all->roomCount += roomList->roomInfoCount;
+    all->newRoomCount += newRoomCount;
+    if (roomList->roomInfoCount < all->options.maximumCount) {
+        all->isComplete = true;
+    } else if (newRoomCount == 0) {
+        all->isSamePage = true;
+    }
+}
+
+/// Why a `room list --all` stopped
+/// @return "complete", "samePage" or "pageLimit"
+static const char* roomListAllStopReason(const RoomListAll* all)
+{
+    if (all->isComplete) {
+        return "complete";
+    }
+
+    return all->isSamePage ? "samePage" : "pageLimit";
+}
+
+static void writeRoomListAllReport(App* app, const RoomListAll* all, ClvCliTimeNs now)
+{
+    ClvCliTimeNs elapsed = now - all->startedAt;
+    double seconds = (double)elapsed / 1000000000.0;
+    double newRoomsPerSecond = seconds > 0.0 ? (double)all->newRoomCount / seconds : 0.0;
+    if (app->options.useJson) {
+        ClvCliJsonWriter* json = &app->json;
+        clvCliJsonWriterObjectBegin(json, 0);
+        clvCliJsonWriterString(json, "event", "roomListAll");
+        clvCliJsonWriterUInt64(json, "timeNs", now);
+        clvCliJsonWriterUInt64(json, "pageCount", all->sentCount);
+        clvCliJsonWriterUInt64(json, "answeredCount", all->receivedCount);
+        clvCliJsonWriterUInt64(json, "lostCount", all->lostCount);
+        clvCliJsonWriterUInt64(json, "roomCount", all->roomCount);
+        clvCliJsonWriterUInt64(json, "newRoomCount", all->newRoomCount);
+        clvCliJsonWriterUInt64(json, "cachedCount", app->roomCache.count);
+        clvCliJsonWriterUInt64(json, "elapsedNs", elapsed);
+        clvCliJsonWriterDouble(json, "newRoomsPerSecond", newRoomsPerSecond);
+        clvCliJsonWriterBool(json, "isComplete", all->isComplete);
+        clvCliJsonWriterString(json, "stopReason", roomListAllStopReason(all));
+        clvCliJsonWriterObjectEnd(json);
+        clvCliJsonWriterLineEnd(json);
+        return;
+    }
+
+    const char* suffix = "";
+    if (all->isSamePage) {
+        suffix = ", not exhaustive: the server returned the same page, the protocol has no offset";
+    } else if (!all->isComplete) {
+        suffix = ", stopped at the page limit";
+    }
+    clvCliRenderEntryBegin(&app->render);
+    clvCliRenderWritef(&app->render,
+        "room list --all: %zu pages (%zu answered, %zu lost), %zu rooms, %zu new, %zu cached in "
+        "%.3f s (%.0f new rooms/s)%s\n",
+        all->sentCount, all->receivedCount, all->lostCount, all->roomCount, all->newRoomCount,
+        app->roomCache.count, seconds, newRoomsPerSecond, suffix);
+    clvCliRenderEntryEnd(&app->render);
+}
+
+/// Sends the next `room list --all` request when the previous one has been answered, or reports
+/// when the listing is complete
+static void updateRoomListAll(App* app)
+{
+    RoomListAll* all = &app->roomListAll;
+    if (!all->isActive || all->isPageNext) {
+        return;
+    }
+    if (all->pendingCorrelationId != 0) {
+        if (!clvCliInFlightIsDone(&app->inFlight, all->pendingCorrelationId)) {
+            return;
+        }
+        // Ended without a response, so the same request is sent again
+        all->pendingCorrelationId = 0;
+        all->lostCount++;
+    }
+    if (!all->isComplete && !all->isSamePage && all->sentCount < all->maximumPageCount) {
+        sendRoomListPage(app);
+        return;
+    }
+    all->isActive = false;
+    writeRoomListAllReport(app, all, clvCliClockNowNs());
+}
+
+/// Adds an event published by the network thread to the next frame (or writes it as JSON)
+/// The payload of the event is freed by the caller.
+/// @param app app
+/// @param event event
+static void handleEvent(App* app, const ClvCliEvent* event)
+{
+    if (app->roomListAll.isPageNext && event->type != ClvCliEventTypeRoomList) {
+        // The room list was not published, the event queue was full
+        app->roomListAll.isPageNext = false;
+        app->roomListAll.lostCount++;
+    }
+    if (event->type == ClvCliEventTypeStatus) {
+        app->status = event->data.status;
+        completeNotPendingRequests(app);
+        return;
+    }
+    if (event->type == ClvCliEventTypeRequestDone) {
+        if (event->data.requestDone.isLost) {
+            // A lost room list --all page is sent again, since its request is done
+            clvCliInFlightLost(&app->inFlight, event->data.requestDone.correlationId);
+        } else {
+            clvCliInFlightDone(&app->inFlight, event->data.requestDone.correlationId,
+                event->data.requestDone.roundTrip);
+            roomListAllAnswered(app, event->data.requestDone.correlationId);
+        }
+    }
+
+    if (app->options.controlPath != 0) {
+        clvCliControlWriteEvent(&app->control, event);
+    }
+
+    // Room lists of watches and other room list commands go to the cache, but are not pages
+    bool isRoomListAllPage = event->type == ClvCliEventTypeRoomList && app->roomListAll.isPageNext;
+    if (event->type == ClvCliEventTypeRoomList) {
+        uint64_t cachedCount = app->roomCache.count + app->roomCache.evictedCount;
+        clvCliRoomCacheMerge(&app->roomCache, event->data.roomList, event->time);
+        if (isRoomListAllPage) {
+            roomListAllReceived(app, event->data.roomList,
+                (size_t)(app->roomCache.count + app->roomCache.evictedCount - cachedCount));
+        }
+    }
+
+    if (app->options.useJson) {
+        clvCliEventJsonWrite(&app->json, event);
+        return;
+    }
+
+    if (event->type == ClvCliEventTypeRequestDone) {
+        return;
+    }
+
+    ClvCliRender* render = &app->render;
+    clvCliRenderEntryBegin(render);
+    switch (event->type) {
+        case ClvCliEventTypePingResponse:
+            printPingResponse(render, &event->data.pingResponse);
+            break;
+        case ClvCliEventTypeRoomCreated:
+            clvCliRenderWrite(render, "--- Room Create Done ---\n");
+            printHouse(render);
+            clvCliRenderWritef(render, " roomID: %d, connectionToRoom: %d\n",
+                event->data.roomCreated.roomId, event->data.roomCreated.roomConnectionIndex);
+            break;
+        case ClvCliEventTypeRoomList:
+            if (isRoomListAllPage) {
+                // Only the total is shown, when all pages have been received
+            } else if (app->isWatchingRooms) {
+                printRoomListChanges(render, &app->roomListDiff, event->data.roomList);
+            } else {
+                printRoomList(render, event->data.roomList);
+            }
+            break;
+        case ClvCliEventTypeState:
+            printState(render, &event->data.state);
+            break;
+        case ClvCliEventTypeStats:
+            printStats(render, event->data.stats);
+            printOutChainStats(render, &app->output);
+            break;
+        case ClvCliEventTypeLoadReport:
+            printLoadReport(render, event->data.loadReport);
+            break;
+        case ClvCliEventTypeWakeLatency: {
+            char description[64];
+            formatLatencyDescription(app, app->options.usePolling ? "poll" : "epoll", description,
+                sizeof(description));
+            char line[256];
+            clvCliWakeLatencyFormat(
+                &event->data.wakeLatency, description, event->time, line, sizeof(line));
+            clvCliRenderWrite(render, line);
+        } break;
+        case ClvCliEventTypePerf:
+            printPerfReport(render, event->data.perf);
+            break;
+        case ClvCliEventTypeFrameOverBudget:
+            printFrameOverBudget(render, &event->data.frameOverBudget);
+            break;
+        case ClvCliEventTypeChurnReport:
+            printChurnReport(render, event->data.churnReport);
+            break;
+        case ClvCliEventTypeSimulateReport:
+            printSimulateReport(render, event->data.simulateReport);
+            break;
+        case ClvCliEventTypeMemReport:
+            printMemReport(render, event->data.memReport);
+            break;
+        case ClvCliEventTypeStatus:
+        case ClvCliEventTypeRequestDone:
+            break;
+    }
+    clvCliRenderEntryEnd(render);
+}
+
+/// Writes the collected frame to the terminal
+static void renderFrame(App* app, ClvCliTimeNs now)
+{
+    ClvCliTimeNs startedAt = clvCliTraceBegin(app->traceRing);
+    beginOutput(app);
+    clvCliRenderFlush(&app->render, now);
+    endOutput(app);
+    clvCliTraceEnd(app->traceRing, "renderFrame", startedAt);
+}
+
+/// Writes the collected frame, if the frame interval has passed since the last one
+static void renderFrameIfDue(App* app)
+{
+    ClvCliTimeNs now = clvCliClockNowNs();
+    if (clvCliRenderIsDue(&app->render, now)) {
+        renderFrame(app, now);
+    }
+}
+
+/// Handles all events that the network thread has published since last time
+/// @param app app
+/// @return 1 if the network thread has stopped, negative if it stopped with an error, 0 otherwise
+static int handleEvents(App* app)
+{
+    ClvCliTimeNs startedAt = clvCliTraceBegin(app->traceRing);
+    // Checked before the events are drained, so the events published before the stop are
+    // handled first
+    int stoppedResult = 0;
+    bool hasStopped = clvCliNetworkHasStopped(&app->network, &stoppedResult);
+    const ClvCliEvent* event;
+    while ((event = clvCliNetworkEventBegin(&app->network)) != 0) {
+        handleEvent(app, event);
+        clvCliEventFreePayload(event);
+        clvCliNetworkEventEnd(&app->network);
+    }
+    int result = 0;
+    if (hasStopped) {
+        result = stoppedResult < 0 ? stoppedResult : 1;
+    }
+    updateRoomListAll(app);
+    clvCliTraceEnd(app->traceRing, "handleEvents", startedAt);
+
+    if (app->options.controlPath != 0) {
+        clvCliControlFlush(&app->control);
+    }
+    if (app->options.useJson) {
+        beginOutput(app);
+        clvCliJsonWriterFlush(&app->json);
+        endOutput(app);
+    } else {
+        renderFrameIfDue(app);
+    }
+
+    return result;
+}
+
+static int parseArguments(AppOptions* options, int argc, char** argv)
+{
+    options->secretIndex = 0;
+    options->host = "127.0.0.1";
+    options->guisePort = 27004;
+    options->conclavePort = 27003;
+    options->swarmCount = 0;
+    options->shardCount = 0;
+    options->shouldPinShards = true;
+    options->scriptFilename = 0;
+    options->useStdinScript = false;
+    options->usePolling = false;
+    options->reportLatency = false;
+    // The clients are updated now and then, even when nothing is received, to resend the
+    // requests that have not been answered. It is also how often an idle process wakes up.
+    options->resendIntervalMs = 100;
+    options->useJson = false;
+    options->framesPerSecond = 30;
+    options->frameBudgetUs = 1000;
+    options->imprintKib = 0;
+    options->traceFilename = 0;
+    options->controlPath = 0;
+
+    for (int i = 1; i < argc; ++i) {
+        const char* arg = argv[i];
+        if (tc_str_equal(arg, "--poll")) {
+            options->usePolling = true;
+        } else if (tc_str_equal(arg, "--latency")) {
+            options->reportLatency = true;
+        } else if (tc_str_equal(arg, "--resend") && i + 1 < argc) {
+            int resendIntervalMs = atoi(argv[++i]);
+            if (resendIntervalMs <= 0) {
+                printf("resend interval must be at least one millisecond\n");
+                return -1;
+            }
+            options->resendIntervalMs = (size_t)resendIntervalMs;
+        } else if (tc_str_equal(arg, "--json")) {
+            options->useJson = true;
+        } else if (tc_str_equal(arg, "--trace") && i + 1 < argc) {
+            options->traceFilename = argv[++i];
+        } else if (tc_str_equal(arg, "--control") && i + 1 < argc) {
+            options->controlPath = argv[++i];
+        } else if (tc_str_equal(arg, "--fps") && i + 1 < argc) {
+            int framesPerSecond = atoi(argv[++i]);
+            options->framesPerSecond = framesPerSecond > 0 ? (size_t)framesPerSecond : 0;
+        } else if (tc_str_equal(arg, "--frame-budget") && i + 1 < argc) {
+            int frameBudgetUs = atoi(argv[++i]);
+            options->frameBudgetUs = frameBudgetUs > 0 ? (size_t)frameBudgetUs : 0;
+        } else if (tc_str_equal(arg, "--imprint") && i + 1 < argc) {
+            int imprintKib = atoi(argv[++i]);
+            if (imprintKib <= 0) {
+                printf("imprint needs at least one KiB for each client\n");
+                return -1;
+            }
+            options->imprintKib = (size_t)imprintKib;
+        } else if (tc_str_equal(arg, "--host") && i + 1 < argc) {
+            options->host = argv[++i];
+        } else if (tc_str_equal(arg, "--guise-port") && i + 1 < argc) {
+            options->guisePort = (uint16_t)atoi(argv[++i]);
+        } else if (tc_str_equal(arg, "--conclave-port") && i + 1 < argc) {
+            options->conclavePort = (uint16_t)atoi(argv[++i]);
+        } else if (tc_str_equal(arg, "--script") && i + 1 < argc) {
+            options->scriptFilename = argv[++i];
+        } else if (tc_str_equal(arg, "--stdin")) {
+            options->useStdinScript = true;
+        } else if (tc_str_equal(arg, "--swarm") && i + 1 < argc) {
+            int count = atoi(argv[++i]);
+            if (count <= 0) {
+                printf("swarm needs at least one client\n");
+                return -1;
+            }
+            options->swarmCount = (size_t)count;
+        } else if (tc_str_equal(arg, "--shards") && i + 1 < argc) {
+            int count = atoi(argv[++i]);
+            if (count <= 0) {
+                printf("swarm needs at least one shard\n");
+                return -1;
+            }
+            options->shardCount = (size_t)count;
+        } else if (tc_str_equal(arg, "--no-pin")) {
+            options->shouldPinShards = false;
+        } else if (arg[0] == '-') {
+            printf("unknown option '%s'\n", arg);
+            return -1;
+        } else {
+            options->secretIndex = (size_t)atoi(arg);
+        }
+    }
+
+    return 0;
+}
+
+/// @return true if the command line is `help`, with or without arguments
+static bool isHelp(const char* textInput)
+{
+    while (*textInput == ' ' || *textInput == '\t') {
+        ++textInput;
+    }
+    if (strncmp(textInput, "help", 4) != 0) {
+        return false;
+    }
+
+    return textInput[4] == 0 || textInput[4] == ' ' || textInput[4] == '\t';
+}
+
+/// Writes the usage of all commands
+/// Clash writes it to a single stream, so it is written again to a larger stream until it fits,
+/// which is fine as it has no side effects.
+/// @param app app
+/// @param output target output
+/// @return negative on error
+static int writeUsage(App* app, ClvCliOutChain* output)
+{
+    size_t minimumOctets = app->usageOctets + lineReserveOctets;
+    while (true) {
+        FldOutStream outStream;
+        if (clvCliOutChainReserve(output, &outStream, minimumOctets) < 0) {
+            return -1;
+        }
+        clashUsageToStream(&commands, &outStream);
+        if (outStream.pos + lineReserveOctets <= outStream.size) {
+            clvCliOutChainCommit(output, &outStream);
+            if (outStream.pos > app->usageOctets) {
+                app->usageOctets = outStream.pos;
+            }
+            return 0;
+        }
+        minimumOctets = outStream.size * 2;
+    }
+}
+
+/// Executes a single command line, typed, from a script or from a control connection
+/// The stream that clash writes to has room for the usage of all commands, which is the most
+/// that clash writes by itself, and the commands with long responses reserve more as they go.
+/// @param app app
+/// @param textInput the command line
+/// @param output where the output of the command is added
+/// @return 1 if the user requested to quit, negative if the command is unknown, 0 otherwise
+static int executeCommandLine(App* app, const char* textInput, ClvCliOutChain* output)
+{
+    // The updates that came before the command are shown before its output
+    if (!app->options.useJson) {
+        clvCliRenderFlush(&app->render, clvCliClockNowNs());
+    }
+
+    if (tc_str_equal(textInput, "quit")) {
+        return 1;
+    }
+    if (isHelp(textInput)) {
+        if (writeUsage(app, output) < 0) {
+            CLOG_C_SOFT_ERROR(&app->log, "no memory for the help")
+        }
+        return 0;
+    }
+
+    FldOutStream outStream;
+    if (clvCliOutChainReserve(output, &outStream, app->usageOctets + lineReserveOctets) < 0) {
+        CLOG_C_SOFT_ERROR(&app->log, "no memory for the command output")
+        return 0;
+    }
+    app->commandOutput = output;
+    app->commandStream = &outStream;
+
+    ClvCliTimeNs parseStartedAt = clvCliTraceBegin(app->traceRing);
+    int parseResult = clashParseString(&commands, textInput, app, &outStream);
+    clvCliTraceEnd(app->traceRing, "clashParseString", parseStartedAt);
+
+    clvCliOutChainCommit(output, &outStream);
+    app->commandOutput = 0;
+    app->commandStream = 0;
+
+    return parseResult < 0 ? parseResult : 0;
+}
+
+/// Executes a single command line, typed or from a script, and prints the output
+/// @param app app
+/// @param textInput the command line
+/// @return true if the user requested to quit
+static bool executeLine(App* app, const char* textInput)
+{
+    clvCliOutChainClear(&app->output);
+    int result = executeCommandLine(app, textInput, &app->output);
+    if (result < 0) {
+        fprintf(app->textOut, "unknown command %d\n", result);
+    }
+    clvCliOutChainWrite(&app->output, app->textOut);
+
+    return result > 0;
+}
+
+static int controlExecute(
+    void* _self, const char* line, ClvCliOutChain* output, uint64_t* correlationId)
+{
+    App* self = (App*)_self;
+
+    uint64_t lastCorrelationId = self->inFlight.lastCorrelationId;
+    int result = executeCommandLine(self, line, output);
+    if (self->inFlight.lastCorrelationId != lastCorrelationId) {
+        *correlationId = self->inFlight.lastCorrelationId;
+    }
+
+    return result;
+}
+
+/// Executes the requests that have been received on the control socket
+/// @param app app
+/// @return 1 if a request asked to quit, 0 otherwise
+static int handleControl(App* app)
+{
+    ClvCliControlHost host;
+    host.self = app;
+    host.execute = controlExecute;
+
+    ClvCliTimeNs startedAt = clvCliTraceBegin(app->traceRing);
+    int result = clvCliControlUpdate(&app->control, &host);
+    clvCliTraceEnd(app->traceRing, "clvCliControlUpdate", startedAt);
+
+    return result;
+}
+
+/// Reads the pending input from the terminal and executes the line if it is complete
+/// @param app app
+/// @return true if the user requested to quit
+static bool handleInput(App* app)
+{
+    RedlineEdit* edit = &app->edit;
+
+    ClvCliTimeNs startedAt = clvCliTraceBegin(app->traceRing);
+    int result = redlineEditUpdate(edit);
+    clvCliTraceEnd(app->traceRing, "redlineEditUpdate", startedAt);
+    if (result == -1) {
+        printf("\n");
+        if (executeLine(app, redlineEditLine(edit))) {
+            return true;
+        }
+        redlineEditClear(edit);
+        drawPrompt(edit);
+        redlineEditReset(edit);
+    }
+
+    return false;
+}
+
+static bool scriptExecute(void* _self, const char* line)
+{
+    App* self = (App*)_self;
+    fprintf(self->textOut, "> %s\n", line);
+
+    return executeLine(self, line);
+}
+
+static bool scriptIsPending(void* _self, ClvCliRequestType type)
+{
+    const App* self = (const App*)_self;
+    if (!isStatusCurrent(self)) {
+        return true;
+    }
+
+    return (self->status.pendingMask & (1 << type)) != 0;
+}
+
+static bool scriptIsLoggedIn(void* _self)
+{
+    const App* self = (const App*)_self;
+
+    return self->status.isLoggedIn;
+}
+
+static uint64_t awaitedCorrelationId(const App* self, size_t correlationId)
+{
+    return correlationId == CLV_CLI_SCRIPT_AWAIT_LAST ? self->inFlight.lastCorrelationId
+                                                      : (uint64_t)correlationId;
+}
+
+static bool scriptIsAwaiting(void* _self, size_t correlationId)
+{
+    const App* self = (const App*)_self;
+
+    return !clvCliInFlightIsDone(&self->inFlight, awaitedCorrelationId(self, correlationId));
+}
+
+/// Shows the latency of the awaited request, or of all requests so far for `await all`
+static void scriptAwaited(void* _self, size_t correlationId)
+{
+    App* self = (App*)_self;
+    const ClvCliInFlight* inFlight = &self->inFlight;
+
+    // The responses are shown before the result of the await
+    if (!self->options.useJson) {
+        clvCliRenderFlush(&self->render, clvCliClockNowNs());
+    }
+
+    if (correlationId == CLV_CLI_SCRIPT_AWAIT_ALL) {
+        fprintf(self->textOut, "all requests done:\n");
+        for (size_t i = 0; i < ClvCliRequestTypeCount; ++i) {
+            if (inFlight->latencies[i].count == 0) {
+                continue;
+            }
+            char line[128];
+            clvCliHistogramFormat(&inFlight->latencies[i],
+                clvCliRequestTypeToString((ClvCliRequestType)i), line, sizeof(line));
+            fputs(line, self->textOut);
+        }
+        if (inFlight->forgottenCount > 0) {
+            fprintf(self->textOut, "forgotten: %" PRIu64 "\n", inFlight->forgottenCount);
+        }
+        if (inFlight->lostCount > 0) {
+            fprintf(self->textOut, "lost: %" PRIu64 "\n", inFlight->lostCount);
+        }
+        return;
+    }
+
+    uint64_t id = awaitedCorrelationId(self, correlationId);
+    const ClvCliInFlightRequest* request = clvCliInFlightFind(inFlight, id);
+    if (request == 0) {
+        fprintf(self->textOut, "request #%" PRIu64 " is not known\n", id);
+        return;
+    }
+    if (request->isLost) {
+        fprintf(self->textOut, "request #%" PRIu64 " %s lost\n", id,
+            clvCliRequestTypeToString((ClvCliRequestType)request->type));
+        return;
+    }
+    fprintf(self->textOut, "request #%" PRIu64 " %s done in %.3f ms\n", id,
+        clvCliRequestTypeToString((ClvCliRequestType)request->type),
+        (double)request->latency / 1000000.0);
+}
+
+/// Executes the script, or the typed line when interactive
+/// @param app app
+/// @return 1 if done, 0 to continue and negative on error
+static int handleInputOrScript(App* app)
+{
+    if (app->isInteractive) {
+        return handleInput(app) ? 1 : 0;
+    }
+    if (!app->hasScript) {
+        return 0;
+    }
+
+    ClvCliScriptHost host;
+    host.self = app;
+    host.execute = scriptExecute;
+    host.isPending = scriptIsPending;
+    host.isLoggedIn = scriptIsLoggedIn;
+    host.isAwaiting = scriptIsAwaiting;
+    host.awaited = scriptAwaited;
+
+    ClvCliTimeNs startedAt = clvCliTraceBegin(app->traceRing);
+    int result = clvCliScriptUpdate(&app->script, &host, monotonicTimeMsNow());
+    clvCliTraceEnd(app->traceRing, "clvCliScriptUpdate", startedAt);
+
+    return result;
+}
+
+/// Prints events and reads the terminal with a fixed sleep in between
+/// Used on platforms without epoll, or for comparing against the event loop (`--poll`).
+static int runPollingLoop(App* app)
+{
+    while (!g_quit) {
+        int eventResult = handleEvents(app);
+        if (eventResult != 0) {
+            return eventResult < 0 ? eventResult : 0;
+        }
+
+        int inputResult = handleInputOrScript(app);
+        if (inputResult != 0) {
+            return inputResult < 0 ? inputResult : 0;
+        }
+        if (app->options.controlPath != 0 && handleControl(app) != 0) {
+            return 0;
+        }
+        ClvCliTimeNs sleepStartedAt = clvCliTraceBegin(app->traceRing);
+        clvCliSleepMs(16);
+        clvCliTraceEnd(app->traceRing, "sleep", sleepStartedAt);
+    }
+
+    return 0;
+}
+
+/// Blocks until the network thread publishes events, a key is pressed or the script is due
+/// @return CLV_CLI_EVENT_LOOP_NOT_WAITABLE before it has started if stdin can not be waited for
+static int runEventLoop(App* app, ClvCliEventLoop* loop)
+{
+    if (clvCliEventLoopAdd(loop, clvCliNetworkEventWakeupHandle(&app->network),
+            ClvCliEventLoopSourceWakeup, 0)
+        < 0) {
+        return -1;
+    }
+    if (app->isInteractive) {
+        // CLV_CLI_EVENT_LOOP_NOT_WAITABLE when stdin is redirected from a file or /dev/null
+        int addResult = clvCliEventLoopAdd(loop, STDIN_FILENO, ClvCliEventLoopSourceInput, 0);
+        if (addResult < 0) {
+            return addResult;
+        }
+    }
+    if (app->options.controlPath != 0 && clvCliControlAddToEventLoop(&app->control, loop) < 0) {
+        return -1;
+    }
+
+    clvCliEventLoopArmTimer(loop, 0);
+
+    while (!g_quit) {
+        ClvCliTimeNs waitStartedAt = clvCliTraceBegin(app->traceRing);
+        int sources = clvCliEventLoopWait(loop);
+        clvCliTraceEnd(app->traceRing, "wait", waitStartedAt);
+        if (sources < 0) {
+            return sources;
+        }
+
+        if (sources & ClvCliEventLoopSourceWakeup) {
+            clvCliWakeupClear(clvCliNetworkEventWakeupHandle(&app->network));
+        }
+        int eventResult = handleEvents(app);
+        if (eventResult != 0) {
+            return eventResult < 0 ? eventResult : 0;
+        }
+
+        if ((sources & ClvCliEventLoopSourceInput) || !app->isInteractive) {
+            int inputResult = handleInputOrScript(app);
+            if (inputResult != 0) {
+                return inputResult < 0 ? inputResult : 0;
+            }
+        }
+
+        if ((sources & ClvCliEventLoopSourceControl) && handleControl(app) != 0) {
+            return 0;
+        }
+
+        size_t timeUntilUpdate = app->options.useJson
+            ? SIZE_MAX
+            : clvCliRenderTimeUntilDue(&app->render, clvCliClockNowNs());
+        if (app->hasScript) {
+            size_t timeUntilScript
+                = clvCliScriptTimeUntilUpdate(&app->script, monotonicTimeMsNow());
+            if (timeUntilScript < timeUntilUpdate) {
+                timeUntilUpdate = timeUntilScript;
+            }
+        }
+        if (timeUntilUpdate != SIZE_MAX) {
+            clvCliEventLoopArmTimer(loop, timeUntilUpdate);
+        }
+    }
+
+    return 0;
+}
+
+int main(int argc, char** argv)
+{
+    g_clog.log = clog_console;
+    g_clog.level = CLOG_TYPE_VERBOSE;
+
+    signal(SIGINT, interruptHandler);
+
+    static App app;
+    if (parseArguments(&app.options, argc, argv) < 0) {
+        return -1;
+    }
+
+    app.log.config = &g_clog;
+    app.log.constantPrefix = "app";
+
+    ClvCliNetworkOptions networkOptions;
+    networkOptions.secretIndex = app.options.secretIndex;
+    networkOptions.host = app.options.host;
+    networkOptions.guisePort = app.options.guisePort;
+    networkOptions.conclavePort = app.options.conclavePort;
+    networkOptions.swarmCount = app.options.swarmCount;
+    networkOptions.shardCount = app.options.shardCount;
+    networkOptions.shouldPinShards = app.options.shouldPinShards;
+    networkOptions.usePolling = app.options.usePolling;
+    networkOptions.reportLatency = app.options.reportLatency;
+    networkOptions.resendIntervalMs = app.options.resendIntervalMs;
+    networkOptions.frameBudget = (ClvCliTimeNs)app.options.frameBudgetUs * 1000u;
+    networkOptions.imprintOctetsPerClient = app.options.imprintKib * 1024u;
+    networkOptions.trace = 0;
+    app.traceRing = 0;
+    if (app.options.traceFilename != 0) {
+        if (clvCliTraceInit(&app.trace) < 0) {
+            return -1;
+        }
+        networkOptions.trace = &app.trace;
+        app.traceRing = clvCliTraceAddThread(&app.trace, "repl");
+    }
+
+    if (clvCliNetworkInit(&app.network, &networkOptions, app.log) < 0) {
+        return -1;
+    }
+
+    // Without a terminal, a process started with a control socket is only driven through it
+    app.hasScript = app.options.scriptFilename != 0 || app.options.useStdinScript;
+    app.isInteractive
+        = !app.hasScript && (app.options.controlPath == 0 || isatty(STDIN_FILENO));
+    if (app.isInteractive) {
+        redlineEditInit(&app.edit);
+        drawPrompt(&app.edit);
+    } else if (app.hasScript) {
+        FILE* file = app.options.useStdinScript ? stdin : fopen(app.options.scriptFilename, "r");
+        if (file == 0) {
+            printf("could not open script '%s'\n", app.options.scriptFilename);
+            return -1;
+        }
+        int scriptResult = clvCliScriptInitFromFile(&app.script, file, app.log);
+        if (file != stdin) {
+            fclose(file);
+        }
+        if (scriptResult < 0) {
+            clvCliScriptDestroy(&app.script);
+            return scriptResult;
+        }
+    }
+
+    clvCliOutChainInit(&app.output);
+    app.commandOutput = 0;
+    app.commandStream = 0;
+    app.usageOctets = 0;
+    // Measured once, so the stream of every command has room for the usage that clash writes
+    if (writeUsage(&app, &app.output) < 0) {
+        return -1;
+    }
+    clvCliOutChainClear(&app.output);
+
+    app.textOut = app.options.useJson ? stderr : stdout;
+    if (app.options.useJson) {
+        if (clvCliJsonWriterInit(&app.json, stdout) < 0) {
+            return -1;
+        }
+    } else if (clvCliRenderInit(&app.render, stdout, app.options.framesPerSecond) < 0) {
+        return -1;
+    }
+
+    if (app.options.controlPath != 0) {
+        // A control client that goes away is noticed as a failed write instead
+        signal(SIGPIPE, SIG_IGN);
+        if (clvCliControlInit(&app.control, app.options.controlPath, app.log) < 0) {
+            return -1;
+        }
+    }
+
+    app.secret = "working";
+    app.lastCommandSequence = 0;
+    clvCliInFlightInit(&app.inFlight);
+    tc_mem_clear_type(&app.status);
+    if (clvCliRoomCacheInit(&app.roomCache) < 0) {
+        return -1;
+    }
+    clvCliRoomListDiffInit(&app.roomListDiff);
+    app.isWatchingRooms = false;
+    tc_mem_clear_type(&app.roomListAll);
+
+    if (clvCliNetworkStart(&app.network) < 0) {
+        return -1;
+    }
+
+    int result;
+    ClvCliEventLoop loop;
+    if (clvCliNetworkEventWakeupHandle(&app.network) >= 0 && clvCliEventLoopInit(&loop) >= 0) {
+        result = runEventLoop(&app, &loop);
+        clvCliEventLoopDestroy(&loop);
+        if (result == CLV_CLI_EVENT_LOOP_NOT_WAITABLE) {
+            result = runPollingLoop(&app);
+        }
+    } else {
+        result = runPollingLoop(&app);
+    }
+
+    clvCliNetworkStop(&app.network);
+
+    if (app.options.traceFilename != 0) {
+        if (clvCliTraceWrite(&app.trace, app.options.traceFilename) >= 0) {
+            fprintf(app.textOut, "trace written to '%s'\n", app.options.traceFilename);
+        }
+        clvCliTraceDestroy(&app.trace);
+    }
+
+    if (app.isInteractive) {
+        redlineEditClose(&app.edit);
+    } else if (app.hasScript) {
+        clvCliScriptDestroy(&app.script);
+    }
+    if (app.options.controlPath != 0) {
+        clvCliControlDestroy(&app.control);
+    }
+
+    if (!app.options.useJson) {
+        clvCliRenderFlush(&app.render, clvCliClockNowNs());
+    }
+
+    if (app.options.reportLatency) {
+        if (app.options.useJson) {
+            ClvCliEvent event;
+            event.type = ClvCliEventTypeWakeLatency;
+            event.time = clvCliClockNowNs();
+            event.journalSequence = 0;
+            event.data.wakeLatency = app.network.wakeLatency;
+            clvCliEventJsonWrite(&app.json, &event);
+        } else {
+            char description[64];
+            formatLatencyDescription(&app, "total", description, sizeof(description));
+            clvCliWakeLatencyReport(&app.network.wakeLatency, description, clvCliClockNowNs());
+        }
+    }
+    if (app.options.useJson) {
+        clvCliJsonWriterDestroy(&app.json);
+    } else {
+        clvCliRenderDestroy(&app.render);
+    }
+
+    clvCliOutChainDestroy(&app.output);
+    clvCliRoomCacheDestroy(&app.roomCache);
+    clvCliNetworkDestroy(&app.network);
+
+    return result;
 }
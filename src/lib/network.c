@@ -0,0 +1,1197 @@
+/*----------------------------------------------------------------------------------------------------------
+ *  Copyright (c) Peter Bjorklund. All rights reserved. https://github.com/piot/conclave-client-cli
+ *  Licensed under the MIT License. See LICENSE in the project root for license information.
+ *--------------------------------------------------------------------------------------------------------*/
+#define _POSIX_C_SOURCE 200809L
+#include <conclave-client-cli/network.h>
+#include <signal.h>
+
+/// How often the counters and histograms of the swarm shards are merged
+static const MonotonicTimeMs swarmMergeIntervalMs = 1000;
+
+static const ClvCliTimeNs latencyReportIntervalNs = 5000000000u;
+
+/// How long to wait for responses after a load run before reporting
+/// The swarm shards copy their counters once a second, so it is at least twice that.
+static const MonotonicTimeMs loadReportDelayMs = 2000;
+
+static const size_t defaultImprintOctets = 128 * 1024;
+
+/// Reads the secret and starts to log in the guise client (or all clients in the swarm)
+/// @param self network
+/// @param options what to connect to
+/// @param log logging
+/// @return negative on error
+int clvCliNetworkInit(ClvCliNetwork* self, const ClvCliNetworkOptions* options, Clog log)
+{
+    self->options = *options;
+    self->log = log;
+    self->conclaveClientLog.config = log.config;
+    self->conclaveClientLog.constantPrefix = "clvClient";
+    self->hasStartedConclave = false;
+    self->hasAddedConclaveToEventLoop = false;
+    self->lastPublishedPingResponseVersion = 0;
+    self->lastPublishedRoomCreateVersion = 0;
+    self->lastPublishedRoomListVersion = 0;
+    self->lastSwarmMergeAt = 0;
+    self->lastForwardedCommandSequence = 0;
+    self->lastExecutedCommandSequence = 0;
+    self->nextCommandSequence = 1;
+    self->droppedEventCount = 0;
+    self->coalescedCount = 0;
+    self->traceRing = 0;
+    clvCliJournalInit(&self->journal);
+    self->shouldQuit = 0;
+    self->hasStopped = 0;
+    self->stoppedResult = 0;
+    self->isLoadReportPending = false;
+    self->loadReportAt = 0;
+    self->isWatchingRooms = false;
+    self->roomWatchIntervalMs = 0;
+    self->nextRoomWatchAt = 0;
+    tc_mem_clear_type(&self->lastPublishedStatus);
+
+    if (clvCliLoadInit(&self->load, 1) < 0) {
+        return -1;
+    }
+
+    clvCliRequestLatencyInit(&self->requestLatency);
+    clvCliWakeLatencyInit(&self->wakeLatency, clvCliClockNowNs());
+    self->arrivalCount = 0;
+    if (clvCliPerfInit(&self->perf, options->frameBudget, clvCliClockNowNs()) < 0) {
+        return -1;
+    }
+
+    if (clvCliSpscRingInit(&self->commands, sizeof(ClvCliCommand), 256) < 0
+        || clvCliSpscRingInit(&self->events, sizeof(ClvCliEvent), 1024) < 0) {
+        return -1;
+    }
+
+
+    self->hasEventLoop = !options->usePolling && clvCliEventLoopInit(&self->eventLoop) >= 0;
+    if (self->hasEventLoop) {
+        self->commandWakeupHandle = clvCliWakeupCreate();
+        self->eventWakeupHandle = clvCliWakeupCreate();
+        if (clvCliEventLoopAdd(&self->eventLoop, self->commandWakeupHandle,
+                ClvCliEventLoopSourceWakeup, 0)
+            < 0) {
+            return -1;
+        }
+    } else {
+        self->commandWakeupHandle = -1;
+        self->eventWakeupHandle = -1;
+    }
+
+    if (options->swarmCount > 0) {
+        ClvCliSwarmShardsOptions shardsOptions;
+        shardsOptions.shardCount = options->shardCount;
+        shardsOptions.shouldPin = options->shouldPinShards;
+        shardsOptions.clientCount = options->swarmCount;
+        shardsOptions.firstSecretIndex = options->secretIndex;
+        shardsOptions.guiseHost = options->host;
+        shardsOptions.guisePort = options->guisePort;
+        shardsOptions.conclaveHost = options->host;
+        shardsOptions.conclavePort = options->conclavePort;
+        shardsOptions.usePolling = options->usePolling;
+        shardsOptions.resendIntervalMs = options->resendIntervalMs;
+        shardsOptions.imprintOctetsPerClient = options->imprintOctetsPerClient;
+        shardsOptions.trace = options->trace;
+        clvCliSwarmReportInit(&self->swarmReport);
+        if (clvCliOwnerConvergenceInit(&self->ownerConvergence) < 0) {
+            return -1;
+        }
+
+        return clvCliSwarmShardsInit(&self->swarm, &shardsOptions, self->commandWakeupHandle, log);
+    }
+
+    size_t imprintOctets = options->imprintOctetsPerClient > 0 ? options->imprintOctetsPerClient
+                                                               : defaultImprintOctets;
+    imprintDefaultSetupInit(&self->imprint, imprintOctets);
+    if (clvCliImprintCounterInit(
+            &self->imprintCounter, &self->imprint.slabAllocator.info, imprintOctets, 1)
+        < 0) {
+        return -1;
+    }
+
+    guiseClientUdpReadSecret(&self->guiseSecret, options->secretIndex);
+    guiseClientUdpInit(
+        &self->guiseClient, 0, options->host, options->guisePort, &self->guiseSecret);
+    if (self->hasEventLoop) {
+        return clvCliEventLoopAdd(
+            &self->eventLoop, self->guiseClient.udpClient.handle, ClvCliEventLoopSourceSocket, 0);
+    }
+
+    return 0;
+}
+
+void clvCliNetworkDestroy(ClvCliNetwork* self)
+{
+    const ClvCliEvent* event;
+    while ((event = clvCliNetworkEventBegin(self)) != 0) {
+        clvCliEventFreePayload(event);
+        clvCliNetworkEventEnd(self);
+    }
+
+    if (self->hasEventLoop) {
+        clvCliEventLoopDestroy(&self->eventLoop);
+        clvCliWakeupDestroy(self->commandWakeupHandle);
+        clvCliWakeupDestroy(self->eventWakeupHandle);
+    }
+    if (self->options.swarmCount > 0) {
+        clvCliSwarmShardsDestroy(&self->swarm);
+        clvCliOwnerConvergenceDestroy(&self->ownerConvergence);
+    } else {
+        clvCliImprintCounterDestroy(&self->imprintCounter);
+    }
+    clvCliLoadDestroy(&self->load);
+    clvCliPerfDestroy(&self->perf);
+    clvCliJournalDestroy(&self->journal);
+    clvCliSpscRingDestroy(&self->commands);
+    clvCliSpscRingDestroy(&self->events);
+}
+
+static ClvCliEvent* eventBegin(ClvCliNetwork* self, ClvCliEventType type)
+{
+    ClvCliEvent* event = (ClvCliEvent*)clvCliSpscRingWriteBegin(&self->events);
+    if (event == 0) {
+        self->droppedEventCount++;
+        return 0;
+    }
+    event->type = type;
+    event->time = clvCliClockNowNs();
+    event->journalSequence = 0;
+
+    return event;
+}
+
+static void eventEnd(ClvCliNetwork* self)
+{
+    clvCliSpscRingWriteEnd(&self->events);
+    clvCliWakeupSignal(self->eventWakeupHandle);
+}
+
+static bool isLoggedIn(const ClvCliNetwork* self)
+{
+    return self->hasStartedConclave
+        && self->conclaveClient.state == ClvClientStateLoggedIn;
+}
+
+/// Gets the status of the swarm shards, or of the single client
+/// @param self network
+/// @param status status to fill in
+/// @return negative if a swarm shard has stopped with an error
+static int getStatus(const ClvCliNetwork* self, ClvCliNetworkStatus* status)
+{
+    status->commandSequence = self->lastExecutedCommandSequence;
+    status->pendingMask = 0;
+
+    if (self->options.swarmCount > 0) {
+        uint64_t shardsSequence;
+        int result = clvCliSwarmShardsStatus(
+            &self->swarm, &shardsSequence, &status->pendingMask, &status->isLoggedIn);
+        if (result < 0) {
+            return result;
+        }
+        // Commands that are handled by the coordinator (state, stats) are never seen by the shards
+        if (shardsSequence < self->lastForwardedCommandSequence) {
+            status->commandSequence = shardsSequence;
+        }
+        status->hasStartedConclave = true;
+        return 0;
+    }
+
+    status->hasStartedConclave = self->hasStartedConclave;
+    status->isLoggedIn = isLoggedIn(self);
+    for (size_t i = 0; i < ClvCliRequestTypeCount; ++i) {
+        if (clvCliRequestLatencyIsPending(&self->requestLatency, (ClvCliRequestType)i)) {
+            status->pendingMask |= (uint8_t)(1 << i);
+        }
+    }
+
+    return 0;
+}
+
+static int publishStatusIfChanged(ClvCliNetwork* self)
+{
+    ClvCliNetworkStatus status;
+    int result = getStatus(self, &status);
+    if (result < 0) {
+        return result;
+    }
+
+    if (status.commandSequence == self->lastPublishedStatus.commandSequence
+        && status.hasStartedConclave == self->lastPublishedStatus.hasStartedConclave
+        && status.isLoggedIn == self->lastPublishedStatus.isLoggedIn
+        && status.pendingMask == self->lastPublishedStatus.pendingMask) {
+        return 0;
+    }
+
+    ClvCliEvent* event = eventBegin(self, ClvCliEventTypeStatus);
+    if (event == 0) {
+        return 0;
+    }
+    event->data.status = status;
+    self->lastPublishedStatus = status;
+    eventEnd(self);
+
+    return 0;
+}
+
+static void publishState(ClvCliNetwork* self)
+{
+    ClvCliEvent* event = eventBegin(self, ClvCliEventTypeState);
+    if (event == 0) {
+        return;
+    }
+
+    ClvCliNetworkState* state = &event->data.state;
+    tc_mem_clear_type(state);
+    state->hasStartedConclave = self->hasStartedConclave;
+    if (self->hasStartedConclave) {
+        state->clientState = (uint8_t)self->conclaveClient.state;
+    }
+    if (self->options.swarmCount > 0) {
+        const ClvCliSwarmReport* swarm = &self->swarmReport;
+        state->swarmClientCount = swarm->clientCount;
+        for (size_t i = 0; i < 3; ++i) {
+            state->swarmPhaseCounts[i] = swarm->phaseCounts[i];
+        }
+        state->pingResponseCount = swarm->pingResponseCount;
+        state->roomCreateCount = swarm->roomCreateCount;
+        state->roomListCount = swarm->roomListCount;
+    }
+
+    eventEnd(self);
+}
+
+static void publishStats(ClvCliNetwork* self)
+{
+    ClvCliNetworkStats* stats = tc_malloc_type(ClvCliNetworkStats);
+    if (stats == 0) {
+        return;
+    }
+
+    stats->swarmClientCount = self->options.swarmCount;
+    for (size_t i = 0; i < ClvCliRequestTypeCount; ++i) {
+        stats->histograms[i] = self->options.swarmCount > 0 ? self->swarmReport.latencies[i]
+                                                            : self->requestLatency.histograms[i];
+    }
+    stats->unmatchedCount
+        = self->options.swarmCount > 0 ? 0 : self->requestLatency.unmatchedCount;
+    stats->lostCount = self->options.swarmCount > 0 ? 0 : self->requestLatency.lostCount;
+    stats->journalCount = clvCliJournalCount(&self->journal);
+    stats->journalDroppedCount = self->journal.droppedCount;
+    stats->coalescedCount
+        = self->options.swarmCount > 0 ? self->swarmReport.coalescedCount : self->coalescedCount;
+    stats->droppedEventCount = self->droppedEventCount;
+    if (self->options.swarmCount > 0) {
+        clvCliOwnerConvergenceReportGet(&self->ownerConvergence, &stats->ownerConvergence);
+        stats->ownerConvergence.droppedCount += self->swarmReport.droppedOwnerObservationCount;
+    } else {
+        tc_mem_clear_type(&stats->ownerConvergence);
+    }
+
+    ClvCliEvent* event = eventBegin(self, ClvCliEventTypeStats);
+    if (event == 0) {
+        tc_free(stats);
+        return;
+    }
+    event->data.stats = stats;
+    eventEnd(self);
+}
+
+/// Sets the frame budget if requested and publishes the frame histograms
+static void publishPerf(ClvCliNetwork* self, const ClvCliCommand* command)
+{
+    if (command->data.perf.shouldSetBudget) {
+        self->perf.budget = command->data.perf.budget;
+    }
+
+    ClvCliPerfReport* report = tc_malloc_type(ClvCliPerfReport);
+    if (report == 0) {
+        return;
+    }
+    clvCliPerfReportGet(&self->perf, report, clvCliClockNowNs());
+
+    ClvCliEvent* event = eventBegin(self, ClvCliEventTypePerf);
+    if (event == 0) {
+        tc_free(report);
+        return;
+    }
+    event->data.perf = report;
+    eventEnd(self);
+}
+
+/// Ends a phase of the frame, and records it as a span if tracing
+/// @param self network
+/// @param phase phase
+/// @param name name of the trace span, must be a string literal
+/// @param startedAt from clvCliPerfMarkNow() when the phase started
+static void phaseEnd(
+    ClvCliNetwork* self, ClvCliPerfPhase phase, const char* name, ClvCliPerfMark startedAt)
+{
+    ClvCliTimeNs endedAt = clvCliPerfPhaseEnd(&self->perf, phase, startedAt);
+    clvCliTraceAdd(self->traceRing, name, startedAt.wall, endedAt);
+}
+
+static bool loadSend(void* _self, size_t index, const ClvCliLoadOptions* options)
+{
+    (void)index;
+
+    ClvCliNetwork* self = (ClvCliNetwork*)_self;
+    if (!self->hasStartedConclave) {
+        return false;
+    }
+
+    ClvClient* conclaveClient = &self->conclaveClient;
+    switch (options->type) {
+        case ClvCliRequestTypePing:
+            clvClientPing(conclaveClient, 0, false);
+            break;
+        case ClvCliRequestTypeRoomJoin:
+            clvClientJoinRoom(conclaveClient, &options->roomJoin);
+            break;
+        case ClvCliRequestTypeRoomList:
+            clvClientListRooms(conclaveClient, &options->roomList);
+            break;
+        case ClvCliRequestTypeRoomCreate:
+        case ClvCliRequestTypeCount:
+            return false;
+    }
+
+    return true;
+}
+
+static void scheduleLoadReport(ClvCliNetwork* self, const ClvCliCommand* command)
+{
+    MonotonicTimeMs now = monotonicTimeMsNow();
+    if (command->type == ClvCliCommandTypeLoadStop) {
+        self->isLoadReportPending = true;
+        self->loadReportAt = now + loadReportDelayMs;
+    } else if (command->data.load.durationMs > 0) {
+        self->isLoadReportPending = true;
+        self->loadReportAt
+            = now + (MonotonicTimeMs)command->data.load.durationMs + loadReportDelayMs;
+    } else {
+        self->isLoadReportPending = false;
+    }
+}
+
+/// Replaces the swarm report with the latest counters and histograms of all shards
+static void mergeSwarmReport(ClvCliNetwork* self)
+{
+    clvCliSwarmReportInit(&self->swarmReport);
+    clvCliSwarmShardsMerge(&self->swarm, &self->swarmReport);
+}
+
+static void publishLoadReportIfDue(ClvCliNetwork* self, MonotonicTimeMs now)
+{
+    if (!self->isLoadReportPending || now < self->loadReportAt) {
+        return;
+    }
+    self->isLoadReportPending = false;
+
+    ClvCliLoadReport* report = tc_malloc_type(ClvCliLoadReport);
+    if (report == 0) {
+        return;
+    }
+    if (self->options.swarmCount > 0) {
+        mergeSwarmReport(self);
+        *report = self->swarmReport.load;
+    } else {
+        clvCliLoadReportGet(&self->load, report, clvCliClockNowNs());
+    }
+
+    ClvCliEvent* event = eventBegin(self, ClvCliEventTypeLoadReport);
+    if (event == 0) {
+        tc_free(report);
+        return;
+    }
+    event->data.loadReport = report;
+    eventEnd(self);
+}
+
+/// Publishes the churn counters of the swarm, as last copied by the shards
+static void publishChurnReport(ClvCliNetwork* self)
+{
+    ClvCliChurnReport* report = tc_malloc_type(ClvCliChurnReport);
+    if (report == 0) {
+        return;
+    }
+    if (self->options.swarmCount > 0) {
+        mergeSwarmReport(self);
+        *report = self->swarmReport.churn;
+    } else {
+        clvCliChurnReportInit(report);
+    }
+
+    ClvCliEvent* event = eventBegin(self, ClvCliEventTypeChurnReport);
+    if (event == 0) {
+        tc_free(report);
+        return;
+    }
+    event->data.churnReport = report;
+    eventEnd(self);
+}
+
+/// Publishes the simulation counters of the swarm, as last copied by the shards
+static void publishSimulateReport(ClvCliNetwork* self)
+{
+    ClvCliSimulateReport* report = tc_malloc_type(ClvCliSimulateReport);
+    if (report == 0) {
+        return;
+    }
+    if (self->options.swarmCount > 0) {
+        mergeSwarmReport(self);
+        *report = self->swarmReport.simulate;
+    } else {
+        clvCliSimulateReportInit(report);
+    }
+
+    ClvCliEvent* event = eventBegin(self, ClvCliEventTypeSimulateReport);
+    if (event == 0) {
+        tc_free(report);
+        return;
+    }
+    event->data.simulateReport = report;
+    eventEnd(self);
+}
+
+/// Publishes the allocations of the conclave clients, for a swarm as last merged from the shards
+static void publishMemReport(ClvCliNetwork* self)
+{
+    ClvCliImprintReport* report = tc_malloc_type(ClvCliImprintReport);
+    if (report == 0) {
+        return;
+    }
+    *report = self->options.swarmCount > 0 ? self->swarmReport.imprint
+                                            : self->imprintCounter.report;
+
+    ClvCliEvent* event = eventBegin(self, ClvCliEventTypeMemReport);
+    if (event == 0) {
+        tc_free(report);
+        return;
+    }
+    event->data.memReport = report;
+    eventEnd(self);
+}
+
+/// @return false if a swarm shard has no room for more commands, nothing is executed then
+static bool executeCommand(ClvCliNetwork* self, const ClvCliCommand* command)
+{
+    // Commands are executed in order, so the ones for the coordinator wait as well
+    if (self->options.swarmCount > 0 && !clvCliSwarmShardsHasRoom(&self->swarm)) {
+        return false;
+    }
+    self->lastExecutedCommandSequence = command->sequence;
+
+    if (command->type == ClvCliCommandTypeLoadStart
+        || command->type == ClvCliCommandTypeLoadStop) {
+        scheduleLoadReport(self, command);
+    }
+
+    if (command->type == ClvCliCommandTypeState) {
+        publishState(self);
+        return true;
+    }
+    if (command->type == ClvCliCommandTypeStats) {
+        publishStats(self);
+        return true;
+    }
+    if (command->type == ClvCliCommandTypePerf) {
+        publishPerf(self, command);
+        return true;
+    }
+    if (command->type == ClvCliCommandTypeChurnReport) {
+        publishChurnReport(self);
+        return true;
+    }
+    if (command->type == ClvCliCommandTypeSimulateReport) {
+        publishSimulateReport(self);
+        return true;
+    }
+    if (command->type == ClvCliCommandTypeMem) {
+        publishMemReport(self);
+        return true;
+    }
+
+    if (self->options.swarmCount > 0) {
+        clvCliSwarmShardsSend(&self->swarm, command);
+        self->lastForwardedCommandSequence = command->sequence;
+        return true;
+    }
+
+    if (!self->hasStartedConclave) {
+        CLOG_C_WARN(&self->log, "conclave not started yet, command ignored")
+        return true;
+    }
+
+    ClvCliTimeNs now = clvCliClockNowNs();
+    ClvClient* conclaveClient = &self->conclaveClient;
+
+    switch (command->type) {
+        case ClvCliCommandTypePing:
+            clvCliRequestLatencySent(
+                &self->requestLatency, ClvCliRequestTypePing, now, command->sequence);
+            clvClientPing(conclaveClient, command->data.ping.knowledge,
+                command->data.ping.hasConnectionToOwner);
+            break;
+        case ClvCliCommandTypeRoomCreate:
+            clvCliRequestLatencySent(
+                &self->requestLatency, ClvCliRequestTypeRoomCreate, now, command->sequence);
+            clvClientCreateRoom(&self->conclaveClient, &command->data.roomCreate);
+            break;
+        case ClvCliCommandTypeRoomJoin:
+            clvCliRequestLatencySent(
+                &self->requestLatency, ClvCliRequestTypeRoomJoin, now, command->sequence);
+            clvClientJoinRoom(conclaveClient, &command->data.roomJoin);
+            break;
+        case ClvCliCommandTypeRoomList:
+            clvCliRequestLatencySent(
+                &self->requestLatency, ClvCliRequestTypeRoomList, now, command->sequence);
+            clvClientListRooms(conclaveClient, &command->data.roomList);
+            break;
+        case ClvCliCommandTypeRoomWatch:
+            self->isWatchingRooms = true;
+            self->roomWatch = command->data.roomWatch.roomList;
+            self->roomWatchIntervalMs = command->data.roomWatch.intervalMs;
+            self->nextRoomWatchAt = monotonicTimeMsNow();
+            break;
+        case ClvCliCommandTypeRoomUnwatch:
+            self->isWatchingRooms = false;
+            break;
+        case ClvCliCommandTypeLoadStart:
+            clvCliLoadStart(&self->load, &command->data.load, now);
+            break;
+        case ClvCliCommandTypeLoadStop:
+            clvCliLoadStop(&self->load, now);
+            break;
+        case ClvCliCommandTypeChurnStart:
+        case ClvCliCommandTypeChurnStop:
+        case ClvCliCommandTypeSimulateStart:
+        case ClvCliCommandTypeSimulateStop:
+        case ClvCliCommandTypeSimulateInject:
+            CLOG_C_WARN(&self->log, "only for the swarm, command ignored")
+            break;
+        case ClvCliCommandTypeState:
+        case ClvCliCommandTypeStats:
+        case ClvCliCommandTypePerf:
+        case ClvCliCommandTypeChurnReport:
+        case ClvCliCommandTypeSimulateReport:
+        case ClvCliCommandTypeMem:
+            break;
+    }
+
+    return true;
+}
+
+static void executeCommands(ClvCliNetwork* self)
+{
+    ClvCliPerfMark startedAt = clvCliPerfMarkNow();
+    const ClvCliCommand* command;
+    while ((command = (const ClvCliCommand*)clvCliSpscRingReadBegin(&self->commands)) != 0) {
+        if (!executeCommand(self, command)) {
+            // Executed again when a shard has caught up and wakes up the coordinator
+            break;
+        }
+        clvCliSpscRingReadEnd(&self->commands);
+    }
+    phaseEnd(self, ClvCliPerfPhaseCommands, "executeCommands", startedAt);
+}
+
+/// Counts the responses that were overwritten in the client before they were seen
+/// @param self network
+/// @param version version of the client
+/// @param lastVersion version when last seen
+static void countCoalesced(ClvCliNetwork* self, uint8_t version, uint8_t lastVersion)
+{
+    uint8_t delta = (uint8_t)(version - lastVersion);
+    if (delta > 1) {
+        self->coalescedCount += (uint64_t)(delta - 1);
+    }
+}
+
+/// Records the response in the load generator, if it is measuring that type
+/// @return true if the response was caused by the load generator and should not be shown
+static bool loadReceived(ClvCliNetwork* self, ClvCliRequestType type, ClvCliTimeNs now)
+{
+    if (!clvCliLoadIsMeasuring(&self->load, type)) {
+        return false;
+    }
+    clvCliLoadReceived(&self->load, 0, now);
+
+    return true;
+}
+
+static uint64_t journalPingResponse(ClvCliNetwork* self, ClvCliTimeNs now)
+{
+    const ClvClient* conclaveClient = &self->conclaveClient;
+    ClvCliJournalEntry* entry = clvCliJournalAppendBegin(&self->journal);
+    if (entry == 0) {
+        return 0;
+    }
+    const ClvSerializePingResponseOptions* pingResponse = &conclaveClient->pingResponseOptions;
+    entry->time = now;
+    entry->type = ClvCliJournalEntryTypePingResponse;
+    entry->version = conclaveClient->pingResponseOptionsVersion;
+    entry->count = pingResponse->roomInfo.memberCount;
+    entry->index = pingResponse->roomInfo.indexOfOwner;
+    entry->roomId = conclaveClient->mainRoomId;
+    entry->term = pingResponse->term;
+    entry->roomVersion = pingResponse->version;
+
+    return clvCliJournalAppendEnd(&self->journal);
+}
+
+static uint64_t journalRoomCreated(ClvCliNetwork* self, ClvCliTimeNs now)
+{
+    const ClvClient* conclaveClient = &self->conclaveClient;
+    ClvCliJournalEntry* entry = clvCliJournalAppendBegin(&self->journal);
+    if (entry == 0) {
+        return 0;
+    }
+    tc_mem_clear_type(entry);
+    entry->time = now;
+    entry->type = ClvCliJournalEntryTypeRoomCreated;
+    entry->version = conclaveClient->roomCreateVersion;
+    entry->index = conclaveClient->roomConnectionIndex;
+    entry->roomId = conclaveClient->mainRoomId;
+
+    return clvCliJournalAppendEnd(&self->journal);
+}
+
+static uint64_t journalRoomList(ClvCliNetwork* self, ClvCliTimeNs now)
+{
+    const ClvClient* conclaveClient = &self->conclaveClient;
+    ClvCliJournalEntry* entry = clvCliJournalAppendBegin(&self->journal);
+    if (entry == 0) {
+        return 0;
+    }
+    tc_mem_clear_type(entry);
+    entry->time = now;
+    entry->type = ClvCliJournalEntryTypeRoomList;
+    entry->version = conclaveClient->listRoomsOptionsVersion;
+    entry->count = (uint8_t)conclaveClient->listRoomsResponseOptions.roomInfoCount;
+
+    return clvCliJournalAppendEnd(&self->journal);
+}
+
+/// Journals and publishes an event for every client version that has changed since last update
+/// Responses to the load generator are journaled, but not published.
+/// Matches a response to the oldest request of the same type, and tells the REPL thread that
+/// the request with that correlation id is done
+static void requestReceived(ClvCliNetwork* self, ClvCliRequestType type, ClvCliTimeNs now)
+{
+    ClvCliTimeNs roundTrip;
+    uint64_t correlationId
+        = clvCliRequestLatencyReceived(&self->requestLatency, type, now, &roundTrip);
+    if (correlationId == 0) {
+        return;
+    }
+
+    ClvCliEvent* event = eventBegin(self, ClvCliEventTypeRequestDone);
+    if (event != 0) {
+        event->data.requestDone.correlationId = correlationId;
+        event->data.requestDone.roundTrip = roundTrip;
+        event->data.requestDone.type = (uint8_t)type;
+        event->data.requestDone.isLost = false;
+        eventEnd(self);
+    }
+}
+
+/// Tells the REPL thread about the requests that have not been answered within the timeout
+/// If the event queue is full, the request is still done on the REPL thread when the status
+/// says that nothing of its type is pending.
+static void expireRequests(ClvCliNetwork* self, ClvCliTimeNs now)
+{
+    ClvCliTimeNs timeout = (ClvCliTimeNs)CLV_CLI_REQUEST_LATENCY_TIMEOUT_MS * 1000000u;
+    for (size_t i = 0; i < ClvCliRequestTypeCount; ++i) {
+        uint64_t correlationId;
+        while (clvCliRequestLatencyExpire(
+            &self->requestLatency, (ClvCliRequestType)i, now, timeout, &correlationId)) {
+            if (correlationId == 0) {
+                continue;
+            }
+            ClvCliEvent* event = eventBegin(self, ClvCliEventTypeRequestDone);
+            if (event != 0) {
+                event->data.requestDone.correlationId = correlationId;
+                event->data.requestDone.roundTrip = timeout;
+                event->data.requestDone.type = (uint8_t)i;
+                event->data.requestDone.isLost = true;
+                eventEnd(self);
+            }
+        }
+    }
+}
+
+static void publishChangesIfAny(ClvCliNetwork* self)
+{
+    const ClvClient* conclaveClient = &self->conclaveClient;
+    ClvCliTimeNs now = clvCliClockNowNs();
+
+    if (conclaveClient->pingResponseOptionsVersion != self->lastPublishedPingResponseVersion) {
+        countCoalesced(self, conclaveClient->pingResponseOptionsVersion,
+            self->lastPublishedPingResponseVersion);
+        self->lastPublishedPingResponseVersion = conclaveClient->pingResponseOptionsVersion;
+        uint64_t journalSequence = journalPingResponse(self, now);
+        if (!loadReceived(self, ClvCliRequestTypePing, now)) {
+            requestReceived(self, ClvCliRequestTypePing, now);
+            ClvCliEvent* event = eventBegin(self, ClvCliEventTypePingResponse);
+            if (event != 0) {
+                event->journalSequence = journalSequence;
+                event->data.pingResponse = conclaveClient->pingResponseOptions;
+                eventEnd(self);
+            }
+        }
+    }
+
+    if (conclaveClient->roomCreateVersion != self->lastPublishedRoomCreateVersion) {
+        countCoalesced(
+            self, conclaveClient->roomCreateVersion, self->lastPublishedRoomCreateVersion);
+        self->lastPublishedRoomCreateVersion = conclaveClient->roomCreateVersion;
+        uint64_t journalSequence = journalRoomCreated(self, now);
+        if (!loadReceived(self, ClvCliRequestTypeRoomJoin, now)) {
+            // Both room create and room join are answered with the main room of the client
+            if (clvCliRequestLatencyIsPending(&self->requestLatency, ClvCliRequestTypeRoomJoin)) {
+                requestReceived(self, ClvCliRequestTypeRoomJoin, now);
+            } else {
+                requestReceived(self, ClvCliRequestTypeRoomCreate, now);
+            }
+            ClvCliEvent* event = eventBegin(self, ClvCliEventTypeRoomCreated);
+            if (event != 0) {
+                event->journalSequence = journalSequence;
+                event->data.roomCreated.roomId = conclaveClient->mainRoomId;
+                event->data.roomCreated.roomConnectionIndex = conclaveClient->roomConnectionIndex;
+                eventEnd(self);
+            }
+        }
+    }
+
+    if (conclaveClient->listRoomsOptionsVersion != self->lastPublishedRoomListVersion) {
+        countCoalesced(
+            self, conclaveClient->listRoomsOptionsVersion, self->lastPublishedRoomListVersion);
+        self->lastPublishedRoomListVersion = conclaveClient->listRoomsOptionsVersion;
+        uint64_t journalSequence = journalRoomList(self, now);
+        if (loadReceived(self, ClvCliRequestTypeRoomList, now)) {
+            return;
+        }
+        requestReceived(self, ClvCliRequestTypeRoomList, now);
+        ClvSerializeListRoomsResponseOptions* roomList
+            = tc_malloc_type(ClvSerializeListRoomsResponseOptions);
+        ClvCliEvent* event = roomList == 0 ? 0 : eventBegin(self, ClvCliEventTypeRoomList);
+        if (event != 0) {
+            *roomList = conclaveClient->listRoomsResponseOptions;
+            event->journalSequence = journalSequence;
+            event->data.roomList = roomList;
+            eventEnd(self);
+        } else {
+            tc_free(roomList);
+        }
+    }
+}
+
+/// Lists the rooms if the room watch interval has passed
+/// The responses are published like for any other room list request.
+static void sendRoomWatchIfDue(ClvCliNetwork* self, MonotonicTimeMs now)
+{
+    if (!self->isWatchingRooms || now < self->nextRoomWatchAt) {
+        return;
+    }
+    self->nextRoomWatchAt = now + self->roomWatchIntervalMs;
+    clvCliRequestLatencySent(
+        &self->requestLatency, ClvCliRequestTypeRoomList, clvCliClockNowNs(), 0);
+    clvClientListRooms(&self->conclaveClient, &self->roomWatch);
+}
+
+static size_t timeUntilRoomWatch(const ClvCliNetwork* self, MonotonicTimeMs now)
+{
+    if (!self->isWatchingRooms) {
+        return SIZE_MAX;
+    }
+
+    return now >= self->nextRoomWatchAt ? 0 : (size_t)(self->nextRoomWatchAt - now);
+}
+
+static int conclaveSend(void* _self, const uint8_t* data, size_t size)
+{
+    ClvCliNetwork* self = (ClvCliNetwork*)_self;
+
+    return udpClientSend(&self->conclaveSocket, data, size);
+}
+
+/// Reads the next datagram for the conclave client
+/// The client only keeps the latest response of each kind, but it handles each datagram before
+/// it reads the next, so the response of the datagram before is journaled and published here.
+/// The client is then updated once for each wake up, however many datagrams are waiting.
+static int conclaveReceive(void* _self, uint8_t* data, size_t size)
+{
+    ClvCliNetwork* self = (ClvCliNetwork*)_self;
+    publishChangesIfAny(self);
+
+    int octetCount = udpClientReceive(&self->conclaveSocket, data, size);
+    if (octetCount > 0 && self->options.reportLatency
+        && self->arrivalCount < CLV_CLI_NETWORK_MAX_ARRIVALS) {
+        if (clvCliSocketArrivalTime(
+                self->conclaveSocket.handle, &self->arrivals[self->arrivalCount])) {
+            self->arrivalCount++;
+        }
+    }
+
+    return octetCount;
+}
+
+/// Starts the conclave client when the guise client has logged in
+/// The client gets a transport of the network, so the responses can be journaled as they come.
+static int startConclave(ClvCliNetwork* self)
+{
+    CLOG_C_INFO(&self->log, "conclave init")
+    if (udpClientInit(&self->conclaveSocket, self->options.host, self->options.conclavePort)
+        < 0) {
+        CLOG_C_SOFT_ERROR(&self->log, "could not open the conclave socket")
+        return -1;
+    }
+    if (self->options.reportLatency) {
+        clvCliSocketEnableArrivalTime(self->conclaveSocket.handle);
+    }
+
+    DatagramTransport transport;
+    transport.self = self;
+    transport.send = conclaveSend;
+    transport.receive = conclaveReceive;
+    if (clvClientInit(&self->conclaveClient, monotonicTimeMsNow(), &transport,
+            self->guiseClient.guiseClient.mainUserSessionId, &self->imprintCounter.info,
+            self->conclaveClientLog)
+        < 0) {
+        CLOG_C_SOFT_ERROR(&self->log, "could not start the conclave client")
+        return -1;
+    }
+    self->hasStartedConclave = true;
+
+    return 0;
+}
+
+static int updateClients(ClvCliNetwork* self, MonotonicTimeMs now)
+{
+    publishLoadReportIfDue(self, now);
+
+    if (self->options.swarmCount > 0) {
+        clvCliSwarmShardsDrainOwnerObservations(&self->swarm, &self->ownerConvergence);
+        if (now - self->lastSwarmMergeAt >= swarmMergeIntervalMs) {
+            self->lastSwarmMergeAt = now;
+            ClvCliPerfMark mergeStartedAt = clvCliPerfMarkNow();
+            mergeSwarmReport(self);
+            phaseEnd(self, ClvCliPerfPhaseSwarmMerge, "clvCliSwarmShardsMerge", mergeStartedAt);
+        }
+        return 0;
+    }
+
+    ClvCliPerfMark guiseStartedAt = clvCliPerfMarkNow();
+    guiseClientUdpUpdate(&self->guiseClient, now);
+    phaseEnd(self, ClvCliPerfPhaseGuiseUpdate, "guiseClientUdpUpdate", guiseStartedAt);
+    if (!self->hasStartedConclave
+        && self->guiseClient.guiseClient.state == GuiseClientStateLoggedIn) {
+        if (startConclave(self) < 0) {
+            return -1;
+        }
+    }
+    if (self->hasStartedConclave) {
+        ClvCliPerfMark loadStartedAt = clvCliPerfMarkNow();
+        clvCliLoadUpdate(&self->load, loadStartedAt.wall, loadSend, self);
+        phaseEnd(self, ClvCliPerfPhaseLoad, "clvCliLoadUpdate", loadStartedAt);
+        sendRoomWatchIfDue(self, now);
+        // The responses of all but the last datagram are published from conclaveReceive()
+        ClvCliPerfMark updateStartedAt = clvCliPerfMarkNow();
+        int updateResult = clvClientUpdate(&self->conclaveClient, now);
+        phaseEnd(self, ClvCliPerfPhaseConclaveUpdate, "clvClientUpdate", updateStartedAt);
+        if (updateResult < 0) {
+            return updateResult;
+        }
+        ClvCliPerfMark publishStartedAt = clvCliPerfMarkNow();
+        publishChangesIfAny(self);
+        expireRequests(self, publishStartedAt.wall);
+        phaseEnd(self, ClvCliPerfPhasePublish, "publishChangesIfAny", publishStartedAt);
+    }
+
+    return 0;
+}
+
+/// Ends the frame and publishes a warning if it took longer than the budget
+static void frameEnd(ClvCliNetwork* self)
+{
+    ClvCliPerfWarning warning;
+    if (!clvCliPerfFrameEnd(&self->perf, &warning)) {
+        return;
+    }
+
+    ClvCliEvent* event = eventBegin(self, ClvCliEventTypeFrameOverBudget);
+    if (event != 0) {
+        event->data.frameOverBudget = warning;
+        eventEnd(self);
+    }
+}
+
+static void publishWakeLatencyIfNeeded(ClvCliNetwork* self, ClvCliTimeNs now)
+{
+    if (!self->options.reportLatency
+        || now - self->wakeLatency.startedAt < latencyReportIntervalNs) {
+        return;
+    }
+
+    ClvCliEvent* event = eventBegin(self, ClvCliEventTypeWakeLatency);
+    if (event != 0) {
+        event->data.wakeLatency = self->wakeLatency;
+        eventEnd(self);
+    }
+    clvCliWakeLatencyInit(&self->wakeLatency, now);
+}
+
+/// Records the latency of the datagrams received since the frame began
+/// Frames (and wakes) that did not receive anything are not recorded.
+static void recordArrivals(ClvCliNetwork* self)
+{
+    ClvCliTimeNs handledAt = clvCliClockRealtimeNs();
+    for (size_t i = 0; i < self->arrivalCount; ++i) {
+        clvCliWakeLatencyAdd(&self->wakeLatency, self->arrivals[i], handledAt);
+    }
+    self->arrivalCount = 0;
+}
+
+/// Updates the clients with a fixed sleep in between
+/// Used on platforms without epoll, or for comparing against the event loop (`--poll`).
+static int runPollingLoop(ClvCliNetwork* self)
+{
+    while (!__atomic_load_n(&self->shouldQuit, __ATOMIC_ACQUIRE)) {
+        self->wakeLatency.wakeCount++;
+        clvCliPerfFrameBegin(&self->perf);
+        executeCommands(self);
+        int result = updateClients(self, monotonicTimeMsNow());
+        if (result >= 0) {
+            result = publishStatusIfChanged(self);
+        }
+        if (result < 0) {
+            return result;
+        }
+        frameEnd(self);
+        recordArrivals(self);
+        publishWakeLatencyIfNeeded(self, clvCliClockNowNs());
+
+        ClvCliTimeNs sleepStartedAt = clvCliTraceBegin(self->traceRing);
+        clvCliSleepMs(16);
+        clvCliTraceEnd(self->traceRing, "sleep", sleepStartedAt);
+    }
+
+    return 0;
+}
+
+/// Blocks until a datagram is received, a command is sent or it is time to resend
+/// Received responses are handled directly instead of waiting for the next frame.
+static int runEventLoop(ClvCliNetwork* self)
+{
+    ClvCliEventLoop* loop = &self->eventLoop;
+    clvCliEventLoopArmTimer(loop, 0);
+
+    while (!__atomic_load_n(&self->shouldQuit, __ATOMIC_ACQUIRE)) {
+        ClvCliTimeNs waitStartedAt = clvCliTraceBegin(self->traceRing);
+        int sources = clvCliEventLoopWait(loop);
+        clvCliTraceEnd(self->traceRing, "wait", waitStartedAt);
+        if (sources < 0) {
+            return sources;
+        }
+        self->wakeLatency.wakeCount++;
+        clvCliPerfFrameBegin(&self->perf);
+
+        if (sources & ClvCliEventLoopSourceWakeup) {
+            clvCliWakeupClear(self->commandWakeupHandle);
+        }
+        executeCommands(self);
+
+        int result = updateClients(self, monotonicTimeMsNow());
+        if (result >= 0) {
+            result = publishStatusIfChanged(self);
+        }
+        if (result < 0) {
+            return result;
+        }
+        frameEnd(self);
+        recordArrivals(self);
+        publishWakeLatencyIfNeeded(self, clvCliClockNowNs());
+
+        if (self->hasStartedConclave && !self->hasAddedConclaveToEventLoop) {
+            if (clvCliEventLoopAdd(
+                    loop, self->conclaveSocket.handle, ClvCliEventLoopSourceSocket, 0)
+                < 0) {
+                return -1;
+            }
+            self->hasAddedConclaveToEventLoop = true;
+        }
+
+        size_t timeUntilUpdate = clvCliLoadTimeUntilUpdate(&self->load, clvCliClockNowNs());
+        size_t timeUntilWatch = timeUntilRoomWatch(self, monotonicTimeMsNow());
+        if (timeUntilWatch < timeUntilUpdate) {
+            timeUntilUpdate = timeUntilWatch;
+        }
+        size_t resendIntervalMs = self->options.resendIntervalMs;
+        clvCliEventLoopArmTimer(
+            loop, timeUntilUpdate < resendIntervalMs ? timeUntilUpdate : resendIntervalMs);
+    }
+
+    return 0;
+}
+
+static void* networkThread(void* _self)
+{
+    ClvCliNetwork* self = (ClvCliNetwork*)_self;
+
+    self->traceRing = clvCliTraceAddThread(self->options.trace, "network");
+    int result = self->hasEventLoop ? runEventLoop(self) : runPollingLoop(self);
+
+    // Not an event, as the event ring can be full when the thread stops
+    self->stoppedResult = result;
+    __atomic_store_n(&self->hasStopped, 1, __ATOMIC_RELEASE);
+    clvCliWakeupSignal(self->eventWakeupHandle);
+
+    return 0;
+}
+
+/// Starts the network thread, and the swarm shard threads if any
+/// SIGINT is blocked on the network thread, so it is always handled by the REPL thread.
+/// @param self network
+/// @return negative on error
+int clvCliNetworkStart(ClvCliNetwork* self)
+{
+    if (self->options.swarmCount > 0 && clvCliSwarmShardsStart(&self->swarm) < 0) {
+        return -1;
+    }
+
+    sigset_t blocked;
+    sigset_t previous;
+    sigemptyset(&blocked);
+    sigaddset(&blocked, SIGINT);
+    pthread_sigmask(SIG_BLOCK, &blocked, &previous);
+
+    int result = pthread_create(&self->thread, 0, networkThread, self);
+
+    pthread_sigmask(SIG_SETMASK, &previous, 0);
+
+    if (result != 0) {
+        CLOG_C_SOFT_ERROR(&self->log, "could not start network thread: %d", result)
+        return -1;
+    }
+
+    return 0;
+}
+
+/// Asks the network thread to stop and waits for it
+/// @param self network
+void clvCliNetworkStop(ClvCliNetwork* self)
+{
+    __atomic_store_n(&self->shouldQuit, 1, __ATOMIC_RELEASE);
+    clvCliWakeupSignal(self->commandWakeupHandle);
+    pthread_join(self->thread, 0);
+
+    if (self->options.swarmCount > 0) {
+        clvCliSwarmShardsStop(&self->swarm);
+    }
+}
+
+/// Reserves a command to send to the network thread (REPL thread only)
+/// @param self network
+/// @param type command type
+/// @return command to fill in, or NULL if too many commands are queued
+ClvCliCommand* clvCliNetworkCommandBegin(ClvCliNetwork* self, ClvCliCommandType type)
+{
+    ClvCliCommand* command = (ClvCliCommand*)clvCliSpscRingWriteBegin(&self->commands);
+    if (command == 0) {
+        CLOG_C_WARN(&self->log, "too many commands queued")
+        return 0;
+    }
+    command->type = type;
+    command->sequence = self->nextCommandSequence;
+
+    return command;
+}
+
+/// Sends the command reserved by clvCliNetworkCommandBegin() (REPL thread only)
+/// @param self network
+/// @return sequence number of the command, reported back in ClvCliNetworkStatus
+uint64_t clvCliNetworkCommandEnd(ClvCliNetwork* self)
+{
+    clvCliSpscRingWriteEnd(&self->commands);
+    clvCliWakeupSignal(self->commandWakeupHandle);
+
+    return self->nextCommandSequence++;
+}
+
+/// Gets the oldest event published by the network thread (REPL thread only)
+/// @param self network
+/// @return event or NULL if there are no more events
+const ClvCliEvent* clvCliNetworkEventBegin(ClvCliNetwork* self)
+{
+    return (const ClvCliEvent*)clvCliSpscRingReadBegin(&self->events);
+}
+
+void clvCliNetworkEventEnd(ClvCliNetwork* self)
+{
+    clvCliSpscRingReadEnd(&self->events);
+}
+
+/// Frees the report or room list that the network thread allocated for the event, if any
+/// @param event event from clvCliNetworkEventBegin()
+void clvCliEventFreePayload(const ClvCliEvent* event)
+{
+    switch (event->type) {
+        case ClvCliEventTypeRoomList:
+            tc_free(event->data.roomList);
+            break;
+        case ClvCliEventTypeStats:
+            tc_free(event->data.stats);
+            break;
+        case ClvCliEventTypeLoadReport:
+            tc_free(event->data.loadReport);
+            break;
+        case ClvCliEventTypePerf:
+            tc_free(event->data.perf);
+            break;
+        case ClvCliEventTypeChurnReport:
+            tc_free(event->data.churnReport);
+            break;
+        case ClvCliEventTypeSimulateReport:
+            tc_free(event->data.simulateReport);
+            break;
+        case ClvCliEventTypeMemReport:
+            tc_free(event->data.memReport);
+            break;
+        case ClvCliEventTypePingResponse:
+        case ClvCliEventTypeRoomCreated:
+        case ClvCliEventTypeState:
+        case ClvCliEventTypeStatus:
+        case ClvCliEventTypeWakeLatency:
+        case ClvCliEventTypeFrameOverBudget:
+        case ClvCliEventTypeRequestDone:
+            break;
+    }
+}
+
+/// Handle that is signalled when events are published
+/// @param self network
+/// @return handle to add to the REPL event loop, negative if not available
+int clvCliNetworkEventWakeupHandle(const ClvCliNetwork* self)
+{
+    return self->eventWakeupHandle;
+}
+
+/// Checks if the network thread has stopped (REPL thread only)
+/// Events are published before the thread stops, so the events that were published before the
+/// check returned true must be handled before the stop is.
+/// @param self network
+/// @param result set to the result of the network thread, negative if it stopped with an error
+/// @return true if the network thread has stopped
+bool clvCliNetworkHasStopped(const ClvCliNetwork* self, int* result)
+{
+    if (!__atomic_load_n(&self->hasStopped, __ATOMIC_ACQUIRE)) {
+        return false;
+    }
+    *result = self->stoppedResult;
+
+    return true;
+}
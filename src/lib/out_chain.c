@@ -0,0 +1,139 @@
+/*----------------------------------------------------------------------------------------------------------
+ *  Copyright (c) Peter Bjorklund. All rights reserved. https://github.com/piot/conclave-client-cli
+ *  Licensed under the MIT License. See LICENSE in the project root for license information.
+ *--------------------------------------------------------------------------------------------------------*/
+#include <clog/clog.h>
+#include <conclave-client-cli/out_chain.h>
+#include <tiny-libc/tiny_libc.h>
+
+void clvCliOutChainInit(ClvCliOutChain* self)
+{
+    self->first = 0;
+    self->current = 0;
+    self->chunkCount = 0;
+    self->octetCount = 0;
+    self->peakOctets = 0;
+}
+
+void clvCliOutChainDestroy(ClvCliOutChain* self)
+{
+    ClvCliOutChunk* chunk = self->first;
+    while (chunk != 0) {
+        ClvCliOutChunk* next = chunk->next;
+        tc_free(chunk->octets);
+        tc_free(chunk);
+        chunk = next;
+    }
+    self->first = 0;
+    self->current = 0;
+    self->chunkCount = 0;
+    self->octetCount = 0;
+}
+
+/// Starts a new output, the chunks are kept
+/// @param self chain
+void clvCliOutChainClear(ClvCliOutChain* self)
+{
+    for (ClvCliOutChunk* chunk = self->first; chunk != 0; chunk = chunk->next) {
+        chunk->count = 0;
+    }
+    self->current = 0;
+    self->octetCount = 0;
+}
+
+static ClvCliOutChunk* appendChunk(ClvCliOutChain* self, ClvCliOutChunk* last, size_t minimumOctets)
+{
+    size_t capacity = last == 0 ? CLV_CLI_OUT_CHAIN_FIRST_CHUNK_OCTETS : last->capacity * 2;
+    if (capacity > CLV_CLI_OUT_CHAIN_MAX_CHUNK_OCTETS) {
+        capacity = CLV_CLI_OUT_CHAIN_MAX_CHUNK_OCTETS;
+    }
+    if (capacity < minimumOctets) {
+        capacity = minimumOctets;
+    }
+
+    ClvCliOutChunk* chunk = tc_malloc_type(ClvCliOutChunk);
+    uint8_t* octets = tc_malloc_type_count(uint8_t, capacity);
+    if (chunk == 0 || octets == 0) {
+        CLOG_SOFT_ERROR("could not allocate output chunk of %zu octets", capacity)
+        tc_free(chunk);
+        tc_free(octets);
+        return 0;
+    }
+    chunk->next = 0;
+    chunk->octets = octets;
+    chunk->capacity = capacity;
+    chunk->count = 0;
+    if (last == 0) {
+        self->first = chunk;
+    } else {
+        last->next = chunk;
+    }
+    self->chunkCount++;
+
+    return chunk;
+}
+
+/// Sets up a stream on the free end of the current chunk, or on a following chunk if it has less
+/// than minimumOctets left. Nothing else may be reserved until the stream is committed.
+/// @param self chain
+/// @param stream target stream
+/// @param minimumOctets octets that the stream must have room for
+/// @return negative if no chunk could be allocated
+int clvCliOutChainReserve(ClvCliOutChain* self, FldOutStream* stream, size_t minimumOctets)
+{
+    ClvCliOutChunk* chunk = self->current != 0 ? self->current : self->first;
+    ClvCliOutChunk* last = 0;
+    while (chunk != 0 && chunk->capacity - chunk->count < minimumOctets) {
+        last = chunk;
+        chunk = chunk->next;
+    }
+    if (chunk == 0) {
+        while (last != 0 && last->next != 0) {
+            last = last->next;
+        }
+        chunk = appendChunk(self, last, minimumOctets);
+        if (chunk == 0) {
+            return -1;
+        }
+    }
+
+    self->current = chunk;
+    fldOutStreamInit(stream, chunk->octets + chunk->count, chunk->capacity - chunk->count);
+
+    return 0;
+}
+
+/// Adds what was written to a reserved stream to the output
+/// @param self chain
+/// @param stream stream from clvCliOutChainReserve()
+void clvCliOutChainCommit(ClvCliOutChain* self, const FldOutStream* stream)
+{
+    self->current->count += stream->pos;
+    self->octetCount += stream->pos;
+    if (self->octetCount > self->peakOctets) {
+        self->peakOctets = self->octetCount;
+    }
+}
+
+/// Writes the output, chunk by chunk
+/// @param self chain
+/// @param fp target file
+void clvCliOutChainWrite(const ClvCliOutChain* self, FILE* fp)
+{
+    for (const ClvCliOutChunk* chunk = self->first; chunk != 0; chunk = chunk->next) {
+        if (chunk->count > 0) {
+            fwrite(chunk->octets, 1, chunk->count, fp);
+        }
+    }
+}
+
+/// @return octets in all chunks
+size_t clvCliOutChainCapacity(const ClvCliOutChain* self)
+{
+    size_t octetCount = 0;
+    for (const ClvCliOutChunk* chunk = self->first; chunk != 0; chunk = chunk->next) {
+        octetCount += chunk->capacity;
+    }
+
+    return octetCount;
+}
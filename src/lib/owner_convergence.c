@@ -0,0 +1,128 @@
+/*----------------------------------------------------------------------------------------------------------
+ *  Copyright (c) Peter Bjorklund. All rights reserved. https://github.com/piot/conclave-client-cli
+ *  Licensed under the MIT License. See LICENSE in the project root for license information.
+ *--------------------------------------------------------------------------------------------------------*/
+#include <clog/clog.h>
+#include <conclave-client-cli/owner_convergence.h>
+#include <tiny-libc/tiny_libc.h>
+
+int clvCliOwnerConvergenceInit(ClvCliOwnerConvergence* self)
+{
+    self->rooms = tc_malloc_type_count(
+        ClvCliOwnerConvergenceRoom, CLV_CLI_OWNER_CONVERGENCE_ROOM_CAPACITY);
+    if (self->rooms == 0) {
+        CLOG_SOFT_ERROR("could not allocate owner convergence rooms")
+        return -1;
+    }
+    tc_mem_clear_type_n(self->rooms, CLV_CLI_OWNER_CONVERGENCE_ROOM_CAPACITY);
+    tc_mem_clear_type(&self->report);
+    clvCliHistogramInit(&self->report.convergenceLatencies);
+
+    return 0;
+}
+
+void clvCliOwnerConvergenceDestroy(ClvCliOwnerConvergence* self)
+{
+    tc_free(self->rooms);
+    self->rooms = 0;
+}
+
+/// Finds the room, or the free slot where it should be added
+/// @return the slot, or NULL if the table is full
+static ClvCliOwnerConvergenceRoom* findSlot(ClvCliOwnerConvergence* self, ClvSerializeRoomId roomId)
+{
+    size_t mask = CLV_CLI_OWNER_CONVERGENCE_ROOM_CAPACITY - 1;
+    size_t index = (size_t)(roomId * 2654435761u) & mask;
+    for (size_t i = 0; i < CLV_CLI_OWNER_CONVERGENCE_ROOM_CAPACITY; ++i) {
+        ClvCliOwnerConvergenceRoom* room = &self->rooms[(index + i) & mask];
+        if (room->roomId == roomId || room->roomId == 0) {
+            return room;
+        }
+    }
+
+    return 0;
+}
+
+static void startEpoch(ClvCliOwnerConvergence* self, ClvCliOwnerConvergenceRoom* room,
+    const ClvCliOwnerObservation* observation, bool isMigration)
+{
+    if (room->isMigration && !room->isConverged) {
+        self->report.supersededCount++;
+    }
+    room->term = observation->term;
+    room->owner = observation->owner;
+    room->firstSeenAt = observation->time;
+    room->lastSeenAt = observation->time;
+    room->observedCount = 0;
+    room->isMigration = isMigration;
+    room->isConverged = false;
+    if (isMigration) {
+        self->report.migrationCount++;
+    }
+}
+
+/// Adds a term or owner that a client has seen for its room
+/// The member count of the latest observation is used, so members that leave the room during
+/// a migration are not waited for.
+/// @param self owner convergence
+/// @param observation what the client saw and when
+void clvCliOwnerConvergenceAdd(
+    ClvCliOwnerConvergence* self, const ClvCliOwnerObservation* observation)
+{
+    if (observation->roomId == 0) {
+        return;
+    }
+    ClvCliOwnerConvergenceRoom* room = findSlot(self, observation->roomId);
+    if (room == 0) {
+        self->report.droppedCount++;
+        return;
+    }
+
+    if (room->roomId == 0) {
+        room->roomId = observation->roomId;
+        room->isMigration = false;
+        self->report.roomCount++;
+        startEpoch(self, room, observation, false);
+    } else if (observation->term < room->term) {
+        self->report.staleCount++;
+        return;
+    } else if (observation->term != room->term || observation->owner != room->owner) {
+        startEpoch(self, room, observation, true);
+    }
+
+    if (observation->time < room->firstSeenAt) {
+        room->firstSeenAt = observation->time;
+    }
+    if (observation->time > room->lastSeenAt) {
+        room->lastSeenAt = observation->time;
+    }
+    room->memberCount = observation->memberCount;
+    if (room->observedCount < UINT8_MAX) {
+        room->observedCount++;
+    }
+    if (room->isConverged || room->observedCount < room->memberCount) {
+        return;
+    }
+    room->isConverged = true;
+    if (room->isMigration) {
+        self->report.convergedCount++;
+        clvCliHistogramAdd(
+            &self->report.convergenceLatencies, (room->lastSeenAt - room->firstSeenAt) / 1000);
+    }
+}
+
+/// Gets the result so far, with the number of migrations that have not converged yet
+/// @param self owner convergence
+/// @param report target report
+void clvCliOwnerConvergenceReportGet(
+    const ClvCliOwnerConvergence* self, ClvCliOwnerConvergenceReport* report)
+{
+    *report = self->report;
+    report->pendingCount = 0;
+    for (size_t i = 0; i < CLV_CLI_OWNER_CONVERGENCE_ROOM_CAPACITY; ++i) {
+        const ClvCliOwnerConvergenceRoom* room = &self->rooms[i];
+        if (room->roomId != 0 && room->isMigration && !room->isConverged) {
+            report->pendingCount++;
+        }
+    }
+}
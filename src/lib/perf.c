@@ -0,0 +1,177 @@
+/*----------------------------------------------------------------------------------------------------------
+ *  Copyright (c) Peter Bjorklund. All rights reserved. https://github.com/piot/conclave-client-cli
+ *  Licensed under the MIT License. See LICENSE in the project root for license information.
+ *--------------------------------------------------------------------------------------------------------*/
+#include <clog/clog.h>
+#include <conclave-client-cli/perf.h>
+#include <tiny-libc/tiny_libc.h>
+
+static const ClvCliTimeNs windowDuration = 10000000000u;
+static const ClvCliTimeNs warningInterval = 1000000000u;
+
+static void windowInit(ClvCliPerfWindow* self)
+{
+    for (size_t i = 0; i <= ClvCliPerfPhaseCount; ++i) {
+        clvCliHistogramInit(&self->wall[i]);
+        clvCliHistogramInit(&self->cpu[i]);
+    }
+    self->frameCount = 0;
+    self->overBudgetCount = 0;
+}
+
+static void windowMerge(ClvCliPerfWindow* self, const ClvCliPerfWindow* other)
+{
+    for (size_t i = 0; i <= ClvCliPerfPhaseCount; ++i) {
+        clvCliHistogramMerge(&self->wall[i], &other->wall[i]);
+        clvCliHistogramMerge(&self->cpu[i], &other->cpu[i]);
+    }
+    self->frameCount += other->frameCount;
+    self->overBudgetCount += other->overBudgetCount;
+}
+
+/// Initializes the frame timing
+/// @param self perf
+/// @param budget wall time that a frame may take before a warning is published, zero for never
+/// @param now current time
+/// @return negative on error
+int clvCliPerfInit(ClvCliPerf* self, ClvCliTimeNs budget, ClvCliTimeNs now)
+{
+    self->windows = tc_malloc_type_count(ClvCliPerfWindow, 2);
+    if (self->windows == 0) {
+        CLOG_SOFT_ERROR("could not allocate frame histograms")
+        return -1;
+    }
+    windowInit(&self->windows[0]);
+    windowInit(&self->windows[1]);
+    self->currentWindow = 0;
+    self->windowStartedAt[0] = now;
+    self->windowStartedAt[1] = now;
+    self->budget = budget;
+    self->lastWarningAt = 0;
+    self->overBudgetSinceWarning = 0;
+    self->totalFrameCount = 0;
+    self->totalOverBudgetCount = 0;
+    tc_mem_clear_type(&self->frame);
+
+    return 0;
+}
+
+void clvCliPerfDestroy(ClvCliPerf* self)
+{
+    tc_free(self->windows);
+    self->windows = 0;
+}
+
+ClvCliPerfMark clvCliPerfMarkNow(void)
+{
+    ClvCliPerfMark mark;
+    mark.wall = clvCliClockNowNs();
+    mark.cpu = clvCliClockThreadCpuNs();
+
+    return mark;
+}
+
+/// Starts a frame, directly after the thread has woken up
+void clvCliPerfFrameBegin(ClvCliPerf* self)
+{
+    tc_mem_clear_type(&self->frame);
+    self->frame.startedAt = clvCliPerfMarkNow();
+}
+
+/// Adds the time since startedAt to a phase of the current frame
+/// A phase can be ended more than once in a frame, e.g. once for each received datagram.
+/// @param self perf
+/// @param phase phase
+/// @param startedAt from clvCliPerfMarkNow() when the phase started
+/// @return the wall time when the phase ended
+ClvCliTimeNs clvCliPerfPhaseEnd(ClvCliPerf* self, ClvCliPerfPhase phase, ClvCliPerfMark startedAt)
+{
+    ClvCliPerfMark now = clvCliPerfMarkNow();
+    self->frame.wall[phase] += now.wall - startedAt.wall;
+    self->frame.cpu[phase] += now.cpu - startedAt.cpu;
+
+    return now.wall;
+}
+
+/// Ends the frame and adds it to the histograms
+/// Warnings are rate limited to one a second, the frames over budget in between are counted.
+/// @param self perf
+/// @param warning filled in if a warning should be published
+/// @return true if the frame was over budget and a warning should be published
+bool clvCliPerfFrameEnd(ClvCliPerf* self, ClvCliPerfWarning* warning)
+{
+    ClvCliPerfMark now = clvCliPerfMarkNow();
+    ClvCliPerfFrame* frame = &self->frame;
+    frame->wall[CLV_CLI_PERF_FRAME] = now.wall - frame->startedAt.wall;
+    frame->cpu[CLV_CLI_PERF_FRAME] = now.cpu - frame->startedAt.cpu;
+
+    if (now.wall - self->windowStartedAt[self->currentWindow] >= windowDuration) {
+        self->currentWindow ^= 1;
+        windowInit(&self->windows[self->currentWindow]);
+        self->windowStartedAt[self->currentWindow] = now.wall;
+    }
+
+    ClvCliPerfWindow* window = &self->windows[self->currentWindow];
+    for (size_t i = 0; i <= ClvCliPerfPhaseCount; ++i) {
+        clvCliHistogramAdd(&window->wall[i], frame->wall[i] / 1000);
+        clvCliHistogramAdd(&window->cpu[i], frame->cpu[i] / 1000);
+    }
+    window->frameCount++;
+    self->totalFrameCount++;
+
+    if (self->budget == 0 || frame->wall[CLV_CLI_PERF_FRAME] <= self->budget) {
+        return false;
+    }
+
+    window->overBudgetCount++;
+    self->totalOverBudgetCount++;
+    self->overBudgetSinceWarning++;
+    if (now.wall - self->lastWarningAt < warningInterval) {
+        return false;
+    }
+
+    warning->frame = *frame;
+    warning->budget = self->budget;
+    warning->overBudgetCount = self->overBudgetSinceWarning;
+    self->overBudgetSinceWarning = 0;
+    self->lastWarningAt = now.wall;
+
+    return true;
+}
+
+/// Merges the rolling histograms
+/// @param self perf
+/// @param report target
+/// @param now current time
+void clvCliPerfReportGet(const ClvCliPerf* self, ClvCliPerfReport* report, ClvCliTimeNs now)
+{
+    size_t previousWindow = self->currentWindow ^ 1;
+    report->window = self->windows[previousWindow];
+    windowMerge(&report->window, &self->windows[self->currentWindow]);
+    report->windowDuration = now - self->windowStartedAt[previousWindow];
+    report->budget = self->budget;
+    report->totalFrameCount = self->totalFrameCount;
+    report->totalOverBudgetCount = self->totalOverBudgetCount;
+}
+
+const char* clvCliPerfPhaseToString(ClvCliPerfPhase phase)
+{
+    switch (phase) {
+        case ClvCliPerfPhaseCommands:
+            return "commands";
+        case ClvCliPerfPhaseGuiseUpdate:
+            return "guise update";
+        case ClvCliPerfPhaseConclaveUpdate:
+            return "conclave update";
+        case ClvCliPerfPhasePublish:
+            return "publish";
+        case ClvCliPerfPhaseLoad:
+            return "load";
+        case ClvCliPerfPhaseSwarmMerge:
+            return "swarm merge";
+        case ClvCliPerfPhaseCount:
+            return "frame";
+    }
+
+    return "unknown";
+}
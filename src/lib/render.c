@@ -0,0 +1,173 @@
+/*----------------------------------------------------------------------------------------------------------
+ *  Copyright (c) Peter Bjorklund. All rights reserved. https://github.com/piot/conclave-client-cli
+ *  Licensed under the MIT License. See LICENSE in the project root for license information.
+ *--------------------------------------------------------------------------------------------------------*/
+#include <clog/clog.h>
+#include <conclave-client-cli/render.h>
+#include <stdarg.h>
+#include <string.h>
+#include <tiny-libc/tiny_libc.h>
+
+/// Initializes the render stage
+/// @param self render
+/// @param fp where the frames are written, usually stdout
+/// @param framesPerSecond maximum number of frames a second, zero for no limit
+/// @return negative on error
+int clvCliRenderInit(ClvCliRender* self, FILE* fp, size_t framesPerSecond)
+{
+    self->octets = tc_malloc_type_count(char, CLV_CLI_RENDER_CAPACITY);
+    if (self->octets == 0) {
+        return -1;
+    }
+    self->pos = 0;
+    self->entryCount = 0;
+    self->entryStart = 0;
+    self->frameInterval = framesPerSecond == 0 ? 0 : 1000000000u / framesPerSecond;
+    self->lastFlushAt = 0;
+    self->fp = fp;
+    self->frameCount = 0;
+    self->coalescedCount = 0;
+
+    return 0;
+}
+
+void clvCliRenderDestroy(ClvCliRender* self)
+{
+    tc_free(self->octets);
+    self->octets = 0;
+}
+
+/// Starts the text of an update
+/// If the frame is full it is written directly, without waiting for the frame interval. That
+/// only happens with hundreds of different updates in one frame.
+/// @param self render
+void clvCliRenderEntryBegin(ClvCliRender* self)
+{
+    if (self->pos + CLV_CLI_RENDER_MAX_ENTRY_OCTETS > CLV_CLI_RENDER_CAPACITY
+        || self->entryCount == CLV_CLI_RENDER_MAX_ENTRY_COUNT) {
+        clvCliRenderFlush(self, self->lastFlushAt);
+    }
+    self->entryStart = self->pos;
+}
+
+/// Adds formatted text to the current update, text that does not fit the entry is cut
+/// @param self render
+/// @param format printf format
+void clvCliRenderWritef(ClvCliRender* self, const char* format, ...)
+{
+    size_t maxOctetCount = self->entryStart + CLV_CLI_RENDER_MAX_ENTRY_OCTETS - self->pos;
+
+    va_list args;
+    va_start(args, format);
+    int octetCount = vsnprintf(self->octets + self->pos, maxOctetCount, format, args);
+    va_end(args);
+
+    if (octetCount < 0) {
+        return;
+    }
+    self->pos += (size_t)octetCount < maxOctetCount ? (size_t)octetCount : maxOctetCount - 1;
+}
+
+void clvCliRenderWrite(ClvCliRender* self, const char* text)
+{
+    clvCliRenderWritef(self, "%s", text);
+}
+
+/// Ends the text of an update
+/// An update that is identical to the one before it in the same frame is removed and counted.
+/// @param self render
+void clvCliRenderEntryEnd(ClvCliRender* self)
+{
+    size_t octetCount = self->pos - self->entryStart;
+    if (self->entryCount > 0) {
+        ClvCliRenderEntry* previous = &self->entries[self->entryCount - 1];
+        if (previous->octetCount == octetCount
+            && memcmp(self->octets + previous->offset, self->octets + self->entryStart, octetCount)
+                == 0) {
+            previous->repeatCount++;
+            self->coalescedCount++;
+            self->pos = self->entryStart;
+            return;
+        }
+    }
+
+    ClvCliRenderEntry* entry = &self->entries[self->entryCount++];
+    entry->offset = self->entryStart;
+    entry->octetCount = octetCount;
+    entry->repeatCount = 1;
+}
+
+/// Checks if there is a frame to write, and the frame interval has passed
+bool clvCliRenderIsDue(const ClvCliRender* self, ClvCliTimeNs now)
+{
+    return self->entryCount > 0 && now - self->lastFlushAt >= self->frameInterval;
+}
+
+/// Milliseconds until the frame can be written
+/// @return SIZE_MAX if there is nothing to write
+size_t clvCliRenderTimeUntilDue(const ClvCliRender* self, ClvCliTimeNs now)
+{
+    if (self->entryCount == 0) {
+        return SIZE_MAX;
+    }
+    ClvCliTimeNs elapsed = now - self->lastFlushAt;
+    if (elapsed >= self->frameInterval) {
+        return 0;
+    }
+
+    return (size_t)((self->frameInterval - elapsed + 999999u) / 1000000u);
+}
+
+static size_t writeOctets(ClvCliRender* self, const char* octets, size_t octetCount)
+{
+    return octetCount == 0 ? 0 : fwrite(octets, 1, octetCount, self->fp);
+}
+
+/// Writes the frame, repeated updates get the count after their first line
+/// The text is written where it was collected, and only the repeat counts are written from
+/// elsewhere, so the frame can fill the whole buffer.
+/// @param self render
+/// @param now current time
+void clvCliRenderFlush(ClvCliRender* self, ClvCliTimeNs now)
+{
+    if (self->entryCount == 0) {
+        return;
+    }
+
+    size_t octetCount = 0;
+    size_t written = 0;
+    size_t runStart = self->entries[0].offset;
+    for (size_t i = 0; i < self->entryCount; ++i) {
+        const ClvCliRenderEntry* entry = &self->entries[i];
+        if (entry->repeatCount == 1) {
+            continue;
+        }
+        const char* text = self->octets + entry->offset;
+        const char* newline = (const char*)memchr(text, '\n', entry->octetCount);
+        if (newline == 0) {
+            continue;
+        }
+        size_t lineEnd = (size_t)(newline - self->octets);
+        octetCount += lineEnd - runStart;
+        written += writeOctets(self, self->octets + runStart, lineEnd - runStart);
+
+        char suffix[24];
+        int suffixCount = snprintf(suffix, sizeof(suffix), " x%zu", entry->repeatCount);
+        if (suffixCount > 0) {
+            octetCount += (size_t)suffixCount;
+            written += writeOctets(self, suffix, (size_t)suffixCount);
+        }
+        runStart = lineEnd;
+    }
+    octetCount += self->pos - runStart;
+    written += writeOctets(self, self->octets + runStart, self->pos - runStart);
+    if (written != octetCount) {
+        CLOG_SOFT_ERROR("render: could only write %zu of %zu octets", written, octetCount)
+    }
+    fflush(self->fp);
+
+    self->pos = 0;
+    self->entryCount = 0;
+    self->lastFlushAt = now;
+    self->frameCount++;
+}
@@ -0,0 +1,158 @@
+/*----------------------------------------------------------------------------------------------------------
+ *  Copyright (c) Peter Bjorklund. All rights reserved. https://github.com/piot/conclave-client-cli
+ *  Licensed under the MIT License. See LICENSE in the project root for license information.
+ *--------------------------------------------------------------------------------------------------------*/
+#include <conclave-client-cli/request_latency.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <tiny-libc/tiny_libc.h>
+
+void clvCliRequestLatencyInit(ClvCliRequestLatency* self)
+{
+    for (size_t i = 0; i < ClvCliRequestTypeCount; ++i) {
+        self->pending[i].readIndex = 0;
+        self->pending[i].count = 0;
+        clvCliHistogramInit(&self->histograms[i]);
+    }
+    self->unmatchedCount = 0;
+    self->lostCount = 0;
+}
+
+/// Remembers when a request was sent
+/// If too many requests are in flight, the oldest one is forgotten.
+/// @param self request latency
+/// @param type the request type
+/// @param now time when the request was sent
+/// @param correlationId command sequence that the request was sent for
+void clvCliRequestLatencySent(ClvCliRequestLatency* self, ClvCliRequestType type, ClvCliTimeNs now,
+    uint64_t correlationId)
+{
+    ClvCliPendingRequests* pending = &self->pending[type];
+    if (pending->count == CLV_CLI_REQUEST_LATENCY_MAX_PENDING) {
+        pending->readIndex = (pending->readIndex + 1) % CLV_CLI_REQUEST_LATENCY_MAX_PENDING;
+        pending->count--;
+        self->unmatchedCount++;
+    }
+
+    size_t writeIndex = (pending->readIndex + pending->count) % CLV_CLI_REQUEST_LATENCY_MAX_PENDING;
+    pending->sentAt[writeIndex] = now;
+    pending->correlationIds[writeIndex] = correlationId;
+    pending->count++;
+}
+
+bool clvCliRequestLatencyIsPending(const ClvCliRequestLatency* self, ClvCliRequestType type)
+{
+    return self->pending[type].count > 0;
+}
+
+/// Matches a response to the oldest request of the same type and records the round trip time
+/// @param self request latency
+/// @param type the request type
+/// @param now time when the response was noticed
+/// @param roundTrip set to the round trip time if matched
+/// @return correlation id of the matched request, zero if no request was pending
+uint64_t clvCliRequestLatencyReceived(ClvCliRequestLatency* self, ClvCliRequestType type,
+    ClvCliTimeNs now, ClvCliTimeNs* roundTrip)
+{
+    ClvCliPendingRequests* pending = &self->pending[type];
+    if (pending->count == 0) {
+        self->unmatchedCount++;
+        return 0;
+    }
+
+    ClvCliTimeNs sentAt = pending->sentAt[pending->readIndex];
+    uint64_t correlationId = pending->correlationIds[pending->readIndex];
+    pending->readIndex = (pending->readIndex + 1) % CLV_CLI_REQUEST_LATENCY_MAX_PENDING;
+    pending->count--;
+
+    *roundTrip = now - sentAt;
+    clvCliHistogramAdd(&self->histograms[type], *roundTrip / 1000);
+
+    return correlationId;
+}
+
+/// Forgets the oldest request of a type if it has not been answered within the timeout
+/// Responses are matched in order, so without this a lost response would keep the type pending
+/// and every later response would be matched to the request before it.
+/// @param self request latency
+/// @param type the request type
+/// @param now current time
+/// @param timeout time after which a request is lost
+/// @param correlationId set to the correlation id of the lost request
+/// @return true if a request was lost, call again until false
+bool clvCliRequestLatencyExpire(ClvCliRequestLatency* self, ClvCliRequestType type,
+    ClvCliTimeNs now, ClvCliTimeNs timeout, uint64_t* correlationId)
+{
+    ClvCliPendingRequests* pending = &self->pending[type];
+    if (pending->count == 0 || now - pending->sentAt[pending->readIndex] < timeout) {
+        return false;
+    }
+
+    *correlationId = pending->correlationIds[pending->readIndex];
+    pending->readIndex = (pending->readIndex + 1) % CLV_CLI_REQUEST_LATENCY_MAX_PENDING;
+    pending->count--;
+    self->lostCount++;
+
+    return true;
+}
+
+const char* clvCliRequestTypeToString(ClvCliRequestType type)
+{
+    switch (type) {
+        case ClvCliRequestTypePing:
+            return "ping";
+        case ClvCliRequestTypeRoomCreate:
+            return "room create";
+        case ClvCliRequestTypeRoomJoin:
+            return "room join";
+        case ClvCliRequestTypeRoomList:
+            return "room list";
+        case ClvCliRequestTypeCount:
+            break;
+    }
+
+    return "unknown";
+}
+
+/// Parses the request type names used by scripts and commands
+/// @param name `ping`, `roomcreate`, `roomjoin` or `roomlist`
+/// @param type the parsed type
+/// @return negative if unknown
+int clvCliRequestTypeFromString(const char* name, ClvCliRequestType* type)
+{
+    if (tc_str_equal(name, "ping")) {
+        *type = ClvCliRequestTypePing;
+    } else if (tc_str_equal(name, "roomcreate")) {
+        *type = ClvCliRequestTypeRoomCreate;
+    } else if (tc_str_equal(name, "roomjoin")) {
+        *type = ClvCliRequestTypeRoomJoin;
+    } else if (tc_str_equal(name, "roomlist")) {
+        *type = ClvCliRequestTypeRoomList;
+    } else {
+        return -1;
+    }
+
+    return 0;
+}
+
+/// Formats count and percentiles of a histogram with microsecond values as milliseconds
+/// @param histogram histogram
+/// @param name name to prefix the line with
+/// @param target where to write the line
+/// @param maxOctetCount size of target
+/// @return same as snprintf()
+int clvCliHistogramFormat(
+    const ClvCliHistogram* histogram, const char* name, char* target, size_t maxOctetCount)
+{
+    if (histogram->count == 0) {
+        return snprintf(target, maxOctetCount, "%12s: -\n", name);
+    }
+
+    return snprintf(target, maxOctetCount,
+        "%12s: n:%" PRIu64 " p50:%.3f p90:%.3f p99:%.3f p99.9:%.3f max:%.3f ms\n", name,
+        histogram->count, (double)clvCliHistogramPercentile(histogram, 50.0) / 1000.0,
+        (double)clvCliHistogramPercentile(histogram, 90.0) / 1000.0,
+        (double)clvCliHistogramPercentile(histogram, 99.0) / 1000.0,
+        (double)clvCliHistogramPercentile(histogram, 99.9) / 1000.0,
+        (double)histogram->max / 1000.0);
+}
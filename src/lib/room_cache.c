@@ -0,0 +1,319 @@
+/*----------------------------------------------------------------------------------------------------------
+ *  Copyright (c) Peter Bjorklund. All rights reserved. https://github.com/piot/conclave-client-cli
+ *  Licensed under the MIT License. See LICENSE in the project root for license information.
+ *--------------------------------------------------------------------------------------------------------*/
+#include <clog/clog.h>
+#include <conclave-client-cli/room_cache.h>
+#include <string.h>
+#include <tiny-libc/tiny_libc.h>
+
+int clvCliRoomCacheInit(ClvCliRoomCache* self)
+{
+    tc_mem_clear_type(self);
+    self->entries = tc_malloc_type_count(ClvCliRoomCacheEntry, CLV_CLI_ROOM_CACHE_CAPACITY);
+    bool isAllocated = self->entries != 0;
+    for (size_t i = 0; i < ClvCliRoomCacheIndexCount; ++i) {
+        self->indexes[i] = tc_malloc_type_count(uint16_t, CLV_CLI_ROOM_CACHE_CAPACITY);
+        isAllocated = isAllocated && self->indexes[i] != 0;
+    }
+    if (!isAllocated) {
+        CLOG_SOFT_ERROR("could not allocate room cache")
+        clvCliRoomCacheDestroy(self);
+        return -1;
+    }
+
+    return 0;
+}
+
+void clvCliRoomCacheDestroy(ClvCliRoomCache* self)
+{
+    tc_free(self->entries);
+    self->entries = 0;
+    for (size_t i = 0; i < ClvCliRoomCacheIndexCount; ++i) {
+        tc_free(self->indexes[i]);
+        self->indexes[i] = 0;
+    }
+    self->count = 0;
+}
+
+uint8_t clvCliRoomCacheFreeSlots(const ClvSerializeRoomInfo* roomInfo)
+{
+    return roomInfo->maxMemberCount > roomInfo->memberCount
+        ? (uint8_t)(roomInfo->maxMemberCount - roomInfo->memberCount)
+        : 0;
+}
+
+static int compareRoomIds(ClvSerializeRoomId a, ClvSerializeRoomId b)
+{
+    return a < b ? -1 : (a > b ? 1 : 0);
+}
+
+/// Orders two rooms by the key of an index
+/// The room id is part of every key, so no two rooms in the cache are equal.
+static int compareRooms(
+    ClvCliRoomCacheIndex index, const ClvSerializeRoomInfo* a, const ClvSerializeRoomInfo* b)
+{
+    switch (index) {
+        case ClvCliRoomCacheIndexRoomId:
+            break;
+        case ClvCliRoomCacheIndexApplicationId:
+            if (a->applicationId != b->applicationId) {
+                return a->applicationId < b->applicationId ? -1 : 1;
+            }
+            break;
+        case ClvCliRoomCacheIndexFreeSlots: {
+            uint8_t freeA = clvCliRoomCacheFreeSlots(a);
+            uint8_t freeB = clvCliRoomCacheFreeSlots(b);
+            if (freeA != freeB) {
+                return freeA > freeB ? -1 : 1;
+            }
+        } break;
+        case ClvCliRoomCacheIndexName: {
+            int result = strncmp(a->roomName, b->roomName, sizeof(a->roomName));
+            if (result != 0) {
+                return result;
+            }
+        } break;
+        case ClvCliRoomCacheIndexCount:
+            break;
+    }
+
+    return compareRoomIds(a->roomId, b->roomId);
+}
+
+/// Finds the first position in an index that is not ordered before the key
+/// @param self room cache
+/// @param index index to search
+/// @param key room to compare with
+/// @param length number of entry indices in the index
+/// @return position in the index
+static size_t lowerBound(const ClvCliRoomCache* self, ClvCliRoomCacheIndex index,
+    const ClvSerializeRoomInfo* key, size_t length)
+{
+    const uint16_t* entryIndices = self->indexes[index];
+    size_t low = 0;
+    size_t high = length;
+    while (low < high) {
+        size_t middle = low + (high - low) / 2;
+        if (compareRooms(index, &self->entries[entryIndices[middle]].roomInfo, key) < 0) {
+            low = middle + 1;
+        } else {
+            high = middle;
+        }
+    }
+
+    return low;
+}
+
+static void indexInsert(
+    ClvCliRoomCache* self, ClvCliRoomCacheIndex index, uint16_t entryIndex, size_t length)
+{
+    uint16_t* entryIndices = self->indexes[index];
+    size_t position = lowerBound(self, index, &self->entries[entryIndex].roomInfo, length);
+    memmove(&entryIndices[position + 1], &entryIndices[position],
+        (length - position) * sizeof(entryIndices[0]));
+    entryIndices[position] = entryIndex;
+}
+
+/// Removes an entry from an index, the entry must still have the key it was inserted with
+static void indexRemove(
+    ClvCliRoomCache* self, ClvCliRoomCacheIndex index, uint16_t entryIndex, size_t length)
+{
+    uint16_t* entryIndices = self->indexes[index];
+    size_t position = lowerBound(self, index, &self->entries[entryIndex].roomInfo, length);
+    memmove(&entryIndices[position], &entryIndices[position + 1],
+        (length - position - 1) * sizeof(entryIndices[0]));
+}
+
+/// Points an index to an entry that has been moved
+/// The old entry must still have the same room, so it can be found in the index.
+static void indexMoved(ClvCliRoomCache* self, ClvCliRoomCacheIndex index, uint16_t entryIndex)
+{
+    uint16_t* entryIndices = self->indexes[index];
+    entryIndices[lowerBound(self, index, &self->entries[entryIndex].roomInfo, self->count)]
+        = entryIndex;
+}
+
+/// Evicts the room that was seen longest ago
+static void evictOldest(ClvCliRoomCache* self)
+{
+    uint16_t oldest = 0;
+    for (size_t i = 1; i < self->count; ++i) {
+        if (self->entries[i].lastSeenAt < self->entries[oldest].lastSeenAt) {
+            oldest = (uint16_t)i;
+        }
+    }
+
+    for (size_t i = 0; i < ClvCliRoomCacheIndexCount; ++i) {
+        indexRemove(self, (ClvCliRoomCacheIndex)i, oldest, self->count);
+    }
+    self->count--;
+    self->evictedCount++;
+
+    uint16_t last = (uint16_t)self->count;
+    if (oldest == last) {
+        return;
+    }
+    self->entries[oldest] = self->entries[last];
+    for (size_t i = 0; i < ClvCliRoomCacheIndexCount; ++i) {
+        indexMoved(self, (ClvCliRoomCacheIndex)i, oldest);
+    }
+}
+
+static void mergeRoom(ClvCliRoomCache* self, const ClvSerializeRoomInfo* roomInfo, ClvCliTimeNs now)
+{
+    const ClvCliRoomCacheEntry* existing = clvCliRoomCacheFind(self, roomInfo->roomId);
+    if (existing != 0) {
+        uint16_t entryIndex = (uint16_t)(existing - self->entries);
+        // The room id index keeps its position, the other keys can have changed
+        for (size_t i = ClvCliRoomCacheIndexApplicationId; i < ClvCliRoomCacheIndexCount; ++i) {
+            indexRemove(self, (ClvCliRoomCacheIndex)i, entryIndex, self->count);
+        }
+        ClvCliRoomCacheEntry* entry = &self->entries[entryIndex];
+        entry->roomInfo = *roomInfo;
+        entry->lastSeenAt = now;
+        for (size_t i = ClvCliRoomCacheIndexApplicationId; i < ClvCliRoomCacheIndexCount; ++i) {
+            indexInsert(self, (ClvCliRoomCacheIndex)i, entryIndex, self->count - 1);
+        }
+        return;
+    }
+
+    if (self->count == CLV_CLI_ROOM_CACHE_CAPACITY) {
+        evictOldest(self);
+    }
+
+    uint16_t entryIndex = (uint16_t)self->count;
+    ClvCliRoomCacheEntry* entry = &self->entries[entryIndex];
+    entry->roomInfo = *roomInfo;
+    entry->firstSeenAt = now;
+    entry->lastSeenAt = now;
+    for (size_t i = 0; i < ClvCliRoomCacheIndexCount; ++i) {
+        indexInsert(self, (ClvCliRoomCacheIndex)i, entryIndex, self->count);
+    }
+    self->count++;
+}
+
+/// Adds the rooms of a room list response, or updates them if they are already cached
+/// Rooms that are not in the response are kept, since a response only has some of the rooms.
+/// @param self room cache
+/// @param roomList room list response
+/// @param now time when the response was received
+void clvCliRoomCacheMerge(
+    ClvCliRoomCache* self, const ClvSerializeListRoomsResponseOptions* roomList, ClvCliTimeNs now)
+{
+    for (size_t i = 0; i < roomList->roomInfoCount; ++i) {
+        mergeRoom(self, &roomList->roomInfos[i], now);
+    }
+    self->mergeCount++;
+}
+
+/// Finds a room
+/// @param self room cache
+/// @param roomId room to find
+/// @return the room, or NULL if it has not been seen in a room list response
+const ClvCliRoomCacheEntry* clvCliRoomCacheFind(
+    const ClvCliRoomCache* self, ClvSerializeRoomId roomId)
+{
+    ClvSerializeRoomInfo key;
+    tc_mem_clear_type(&key);
+    key.roomId = roomId;
+    size_t position = lowerBound(self, ClvCliRoomCacheIndexRoomId, &key, self->count);
+    if (position == self->count) {
+        return 0;
+    }
+    const ClvCliRoomCacheEntry* entry
+        = &self->entries[self->indexes[ClvCliRoomCacheIndexRoomId][position]];
+
+    return entry->roomInfo.roomId == roomId ? entry : 0;
+}
+
+static bool hasNamePrefix(const ClvSerializeRoomInfo* roomInfo, const char* prefix, size_t length)
+{
+    return length <= sizeof(roomInfo->roomName) && strncmp(roomInfo->roomName, prefix, length) == 0;
+}
+
+static bool matches(const ClvCliRoomCacheEntry* entry, const ClvCliRoomCacheQuery* query,
+    size_t namePrefixLength, ClvCliTimeNs now)
+{
+    const ClvSerializeRoomInfo* roomInfo = &entry->roomInfo;
+    if (query->hasApplicationId && roomInfo->applicationId != query->applicationId) {
+        return false;
+    }
+    if (clvCliRoomCacheFreeSlots(roomInfo) < query->minimumFreeSlots) {
+        return false;
+    }
+    if (query->maximumAge != 0 && now - entry->lastSeenAt > query->maximumAge) {
+        return false;
+    }
+
+    return hasNamePrefix(roomInfo, query->namePrefix, namePrefixLength);
+}
+
+/// Finds the rooms that match a query
+/// Only the part of the order index that can match is visited: the rooms with the name prefix
+/// for the name order, the rooms of the application for the application order and the rooms with
+/// enough free slots for the free slots order.
+/// @param self room cache
+/// @param query rooms to find
+/// @param order index to use, the results are in its order
+/// @param now time to compare last seen against
+/// @param results the found rooms, valid until the next merge
+/// @param maxCount maximum number of results
+/// @return number of results
+size_t clvCliRoomCacheQuery(const ClvCliRoomCache* self, const ClvCliRoomCacheQuery* query,
+    ClvCliRoomCacheIndex order, ClvCliTimeNs now, const ClvCliRoomCacheEntry** results,
+    size_t maxCount)
+{
+    const char* namePrefix = query->namePrefix == 0 ? "" : query->namePrefix;
+    size_t namePrefixLength = tc_strlen(namePrefix);
+    ClvCliRoomCacheQuery filter = *query;
+    filter.namePrefix = namePrefix;
+
+    ClvSerializeRoomInfo key;
+    tc_mem_clear_type(&key);
+    size_t position = 0;
+    switch (order) {
+        case ClvCliRoomCacheIndexRoomId:
+            break;
+        case ClvCliRoomCacheIndexApplicationId:
+            if (query->hasApplicationId) {
+                key.applicationId = query->applicationId;
+                position = lowerBound(self, order, &key, self->count);
+            }
+            break;
+        case ClvCliRoomCacheIndexFreeSlots:
+            break;
+        case ClvCliRoomCacheIndexName:
+            if (namePrefixLength < sizeof(key.roomName)) {
+                tc_strcpy(key.roomName, sizeof(key.roomName), namePrefix);
+                position = lowerBound(self, order, &key, self->count);
+            }
+            break;
+        case ClvCliRoomCacheIndexCount:
+            return 0;
+    }
+
+    const uint16_t* entryIndices = self->indexes[order];
+    size_t resultCount = 0;
+    for (; position < self->count && resultCount < maxCount; ++position) {
+        const ClvCliRoomCacheEntry* entry = &self->entries[entryIndices[position]];
+        const ClvSerializeRoomInfo* roomInfo = &entry->roomInfo;
+        if (order == ClvCliRoomCacheIndexApplicationId && query->hasApplicationId
+            && roomInfo->applicationId != query->applicationId) {
+            break;
+        }
+        if (order == ClvCliRoomCacheIndexFreeSlots
+            && clvCliRoomCacheFreeSlots(roomInfo) < query->minimumFreeSlots) {
+            break;
+        }
+        if (order == ClvCliRoomCacheIndexName
+            && !hasNamePrefix(roomInfo, namePrefix, namePrefixLength)) {
+            break;
+        }
+        if (matches(entry, &filter, namePrefixLength, now)) {
+            results[resultCount++] = entry;
+        }
+    }
+
+    return resultCount;
+}
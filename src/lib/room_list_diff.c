@@ -0,0 +1,100 @@
+/*----------------------------------------------------------------------------------------------------------
+ *  Copyright (c) Peter Bjorklund. All rights reserved. https://github.com/piot/conclave-client-cli
+ *  Licensed under the MIT License. See LICENSE in the project root for license information.
+ *--------------------------------------------------------------------------------------------------------*/
+#include <conclave-client-cli/room_list_diff.h>
+#include <stdlib.h>
+#include <string.h>
+
+void clvCliRoomListDiffInit(ClvCliRoomListDiff* self)
+{
+    self->count = 0;
+}
+
+static int compareRoomIds(const void* _a, const void* _b)
+{
+    const ClvSerializeRoomInfo* a = (const ClvSerializeRoomInfo*)_a;
+    const ClvSerializeRoomInfo* b = (const ClvSerializeRoomInfo*)_b;
+
+    return a->roomId < b->roomId ? -1 : (a->roomId > b->roomId ? 1 : 0);
+}
+
+static uint8_t changedMask(const ClvSerializeRoomInfo* before, const ClvSerializeRoomInfo* after)
+{
+    uint8_t mask = 0;
+    if (before->memberCount != after->memberCount) {
+        mask |= CLV_CLI_ROOM_CHANGED_MEMBERS;
+    }
+    if (before->ownerUserId != after->ownerUserId) {
+        mask |= CLV_CLI_ROOM_CHANGED_OWNER;
+    }
+    if (before->externalStateOctetCount != after->externalStateOctetCount) {
+        mask |= CLV_CLI_ROOM_CHANGED_STATE;
+    }
+    if (before->maxMemberCount != after->maxMemberCount
+        || before->applicationId != after->applicationId
+        || strncmp(before->roomName, after->roomName, sizeof(before->roomName)) != 0) {
+        mask |= CLV_CLI_ROOM_CHANGED_OTHER;
+    }
+
+    return mask;
+}
+
+/// Compares a room list with the previous one, and keeps it for the next time
+/// @param self room list diff
+/// @param roomList the new room list
+/// @param changes target changes, in room id order
+/// @param maxChanges size of changes, the changes that do not fit are not returned
+/// @return number of changes
+size_t clvCliRoomListDiffUpdate(ClvCliRoomListDiff* self,
+    const ClvSerializeListRoomsResponseOptions* roomList, ClvCliRoomChange* changes,
+    size_t maxChanges)
+{
+    ClvSerializeRoomInfo rooms[CLV_CLI_ROOM_LIST_DIFF_CAPACITY];
+    size_t count = roomList->roomInfoCount < CLV_CLI_ROOM_LIST_DIFF_CAPACITY
+        ? roomList->roomInfoCount
+        : CLV_CLI_ROOM_LIST_DIFF_CAPACITY;
+    for (size_t i = 0; i < count; ++i) {
+        rooms[i] = roomList->roomInfos[i];
+    }
+    qsort(rooms, count, sizeof(rooms[0]), compareRoomIds);
+
+    size_t changeCount = 0;
+    size_t before = 0;
+    size_t after = 0;
+    while ((before < self->count || after < count) && changeCount < maxChanges) {
+        ClvCliRoomChange* change = &changes[changeCount];
+        int order = before == self->count
+            ? 1
+            : (after == count ? -1 : compareRoomIds(&self->rooms[before], &rooms[after]));
+        if (order < 0) {
+            change->type = ClvCliRoomChangeTypeRemoved;
+            change->changedMask = 0;
+            change->roomInfo = self->rooms[before++];
+            changeCount++;
+        } else if (order > 0) {
+            change->type = ClvCliRoomChangeTypeAdded;
+            change->changedMask = 0;
+            change->roomInfo = rooms[after++];
+            changeCount++;
+        } else {
+            uint8_t mask = changedMask(&self->rooms[before], &rooms[after]);
+            if (mask != 0) {
+                change->type = ClvCliRoomChangeTypeChanged;
+                change->changedMask = mask;
+                change->roomInfo = rooms[after];
+                change->previous = self->rooms[before];
+                changeCount++;
+            }
+            before++;
+            after++;
+        }
+    }
+
+    for (size_t i = 0; i < count; ++i) {
+        self->rooms[i] = rooms[i];
+    }
+    self->count = count;
+
+    return changeCount;
+}
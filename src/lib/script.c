@@ -0,0 +1,407 @@
+/*----------------------------------------------------------------------------------------------------------
+ *  Copyright (c) Peter Bjorklund. All rights reserved. https://github.com/piot/conclave-client-cli
+ *  Licensed under the MIT License. See LICENSE in the project root for license information.
+ *--------------------------------------------------------------------------------------------------------*/
+#include <conclave-client-cli/script.h>
+#include <stdlib.h>
+#include <string.h>
+#include <tiny-libc/tiny_libc.h>
+
+/// Used if a `wait` has no explicit timeout
+static const size_t defaultWaitTimeoutMs = 5000;
+
+/// Maximum number of commands executed in one update, so received datagrams are still handled
+static const size_t maxCommandsPerUpdate = 256;
+
+static bool isSpace(char c)
+{
+    return c == ' ' || c == '\t' || c == '\r';
+}
+
+static bool isDigit(char c)
+{
+    return c >= '0' && c <= '9';
+}
+
+/// A `#` starts a comment at the start of the line or after a space, unless it is followed by
+/// a digit, as in the `#12` form of a correlation id
+static bool isCommentStart(const char* line, const char* p)
+{
+    return *p == '#' && (p == line || isSpace(p[-1])) && !isDigit(p[1]);
+}
+
+static char* trim(char* line)
+{
+    while (isSpace(*line)) {
+        line++;
+    }
+
+    char* comment = line;
+    while (*comment != '\0' && !isCommentStart(line, comment)) {
+        comment++;
+    }
+    *comment = '\0';
+
+    char* end = comment;
+    while (end > line && isSpace(end[-1])) {
+        end--;
+    }
+    *end = '\0';
+
+    return line;
+}
+
+static char* nextWord(char** cursor)
+{
+    char* word = *cursor;
+    while (isSpace(*word)) {
+        word++;
+    }
+    char* end = word;
+    while (*end != '\0' && !isSpace(*end)) {
+        end++;
+    }
+    if (*end != '\0') {
+        *end++ = '\0';
+    }
+    *cursor = end;
+
+    return word;
+}
+
+/// Parses durations like `50ms`, `2s` or `50` (milliseconds)
+static int parseDuration(const char* word, size_t* milliseconds)
+{
+    char* suffix;
+    long value = strtol(word, &suffix, 10);
+    if (suffix == word || value < 0) {
+        return -1;
+    }
+
+    if (tc_str_equal(suffix, "s")) {
+        *milliseconds = (size_t)value * 1000;
+    } else if (tc_str_equal(suffix, "ms") || *suffix == '\0') {
+        *milliseconds = (size_t)value;
+    } else {
+        return -1;
+    }
+
+    return 0;
+}
+
+static int parseWait(ClvCliScriptInstruction* instruction, char* arguments)
+{
+    const char* what = nextWord(&arguments);
+    const char* timeout = nextWord(&arguments);
+
+    ClvCliRequestType type;
+    if (tc_str_equal(what, "login")) {
+        instruction->op = ClvCliScriptOpWaitLogin;
+    } else if (clvCliRequestTypeFromString(what, &type) == 0) {
+        instruction->op = ClvCliScriptOpWaitResponse;
+        instruction->value = type;
+    } else {
+        return -1;
+    }
+
+    instruction->timeoutMs = defaultWaitTimeoutMs;
+    if (*timeout != '\0') {
+        return parseDuration(timeout, &instruction->timeoutMs);
+    }
+
+    return 0;
+}
+
+/// Parses `await <id>|last|all [timeout]`, the id can be written as `#12`
+static int parseAwait(ClvCliScriptInstruction* instruction, char* arguments)
+{
+    const char* what = nextWord(&arguments);
+    const char* timeout = nextWord(&arguments);
+
+    instruction->op = ClvCliScriptOpAwait;
+    if (tc_str_equal(what, "all")) {
+        instruction->value = CLV_CLI_SCRIPT_AWAIT_ALL;
+    } else if (tc_str_equal(what, "last")) {
+        instruction->value = CLV_CLI_SCRIPT_AWAIT_LAST;
+    } else {
+        const char* digits = *what == '#' ? what + 1 : what;
+        char* end;
+        long long value = strtoll(digits, &end, 10);
+        if (end == digits || *end != '\0' || value <= 0) {
+            return -1;
+        }
+        instruction->value = (size_t)value;
+    }
+
+    instruction->timeoutMs = defaultWaitTimeoutMs;
+    if (*timeout != '\0') {
+        return parseDuration(timeout, &instruction->timeoutMs);
+    }
+
+    return 0;
+}
+
+static int parseLine(ClvCliScriptInstruction* instruction, char* line)
+{
+    char* arguments = line;
+    const char* keyword = nextWord(&arguments);
+
+    if (tc_str_equal(keyword, "sleep")) {
+        instruction->op = ClvCliScriptOpSleep;
+        return parseDuration(nextWord(&arguments), &instruction->value);
+    }
+
+    if (tc_str_equal(keyword, "wait")) {
+        return parseWait(instruction, arguments);
+    }
+
+    if (tc_str_equal(keyword, "await")) {
+        return parseAwait(instruction, arguments);
+    }
+
+    if (tc_str_equal(keyword, "repeat")) {
+        instruction->op = ClvCliScriptOpRepeat;
+        const char* count = nextWord(&arguments);
+        const char* brace = nextWord(&arguments);
+        char* end;
+        long value = strtol(count, &end, 10);
+        if (end == count || *end != '\0' || value < 0 || !tc_str_equal(brace, "{")) {
+            return -1;
+        }
+        instruction->value = (size_t)value;
+        return 0;
+    }
+
+    if (tc_str_equal(keyword, "}")) {
+        instruction->op = ClvCliScriptOpEnd;
+        return 0;
+    }
+
+    // Everything else is passed on as is, so restore the separator that nextWord() removed
+    if (*arguments != '\0') {
+        arguments[-1] = ' ';
+    }
+    instruction->op = ClvCliScriptOpCommand;
+
+    return 0;
+}
+
+/// Parses the script
+/// @param self script
+/// @param text script source, ownership is taken over and it is freed with tc_free()
+/// @param log logging
+/// @return negative on syntax error
+int clvCliScriptInit(ClvCliScript* self, char* text, Clog log)
+{
+    self->text = text;
+    self->log = log;
+    self->programCounter = 0;
+    self->depth = 0;
+    self->isBlocked = false;
+    self->blockedUntil = 0;
+    self->instructionCount = 0;
+
+    size_t lineCount = 1;
+    for (const char* p = text; *p != '\0'; ++p) {
+        lineCount += *p == '\n';
+    }
+
+    self->instructions = tc_malloc_type_count(ClvCliScriptInstruction, lineCount);
+
+    size_t openRepeats[CLV_CLI_SCRIPT_MAX_DEPTH];
+    size_t openCount = 0;
+
+    char* cursor = text;
+    for (size_t lineNumber = 1; cursor != 0; ++lineNumber) {
+        char* line = cursor;
+        char* newline = strchr(cursor, '\n');
+        if (newline != 0) {
+            *newline = '\0';
+            cursor = newline + 1;
+        } else {
+            cursor = 0;
+        }
+
+        line = trim(line);
+        if (*line == '\0') {
+            continue;
+        }
+
+        ClvCliScriptInstruction* instruction = &self->instructions[self->instructionCount];
+        instruction->line = line;
+        instruction->lineNumber = lineNumber;
+        instruction->value = 0;
+        instruction->timeoutMs = 0;
+        instruction->jumpIndex = 0;
+
+        if (parseLine(instruction, line) < 0) {
+            CLOG_C_SOFT_ERROR(&self->log, "script line %zu: could not parse '%s'", lineNumber, line)
+            return -1;
+        }
+
+        if (instruction->op == ClvCliScriptOpRepeat) {
+            if (openCount == CLV_CLI_SCRIPT_MAX_DEPTH) {
+                CLOG_C_SOFT_ERROR(&self->log, "script line %zu: repeat nested too deep", lineNumber)
+                return -2;
+            }
+            openRepeats[openCount++] = self->instructionCount;
+        } else if (instruction->op == ClvCliScriptOpEnd) {
+            if (openCount == 0) {
+                CLOG_C_SOFT_ERROR(&self->log, "script line %zu: '}' without repeat", lineNumber)
+                return -3;
+            }
+            size_t repeatIndex = openRepeats[--openCount];
+            instruction->jumpIndex = repeatIndex;
+            self->instructions[repeatIndex].jumpIndex = self->instructionCount + 1;
+        }
+
+        self->instructionCount++;
+    }
+
+    if (openCount != 0) {
+        CLOG_C_SOFT_ERROR(&self->log, "script: repeat is missing its '}'")
+        return -4;
+    }
+
+    return 0;
+}
+
+/// Reads the whole file (or stdin) and parses it as a script
+/// @param self script
+/// @param file file to read until end of file
+/// @param log logging
+/// @return negative on error
+int clvCliScriptInitFromFile(ClvCliScript* self, FILE* file, Clog log)
+{
+    size_t capacity = 4096;
+    size_t octetCount = 0;
+    char* text = tc_malloc_type_count(char, capacity);
+
+    while (true) {
+        if (octetCount + 1 == capacity) {
+            capacity *= 2;
+            char* grown = tc_malloc_type_count(char, capacity);
+            tc_memcpy_octets(grown, text, octetCount);
+            tc_free(text);
+            text = grown;
+        }
+        size_t octetsRead = fread(text + octetCount, 1, capacity - 1 - octetCount, file);
+        if (octetsRead == 0) {
+            break;
+        }
+        octetCount += octetsRead;
+    }
+    text[octetCount] = '\0';
+
+    return clvCliScriptInit(self, text, log);
+}
+
+void clvCliScriptDestroy(ClvCliScript* self)
+{
+    tc_free(self->instructions);
+    tc_free(self->text);
+    self->instructions = 0;
+    self->text = 0;
+}
+
+/// Executes the script until it is blocked by `sleep`, `wait` or `await`
+/// @param self script
+/// @param host the application to execute the commands in
+/// @param now current time
+/// @return 1 when the script is done, 0 if it is not, negative if a wait timed out
+int clvCliScriptUpdate(ClvCliScript* self, const ClvCliScriptHost* host, MonotonicTimeMs now)
+{
+    size_t commandCount = 0;
+
+    while (self->programCounter < self->instructionCount) {
+        const ClvCliScriptInstruction* instruction = &self->instructions[self->programCounter];
+
+        switch (instruction->op) {
+            case ClvCliScriptOpCommand:
+                if (commandCount == maxCommandsPerUpdate) {
+                    return 0;
+                }
+                commandCount++;
+                self->programCounter++;
+                if (host->execute(host->self, instruction->line)) {
+                    self->programCounter = self->instructionCount;
+                }
+                break;
+            case ClvCliScriptOpSleep:
+                if (!self->isBlocked) {
+                    self->isBlocked = true;
+                    self->blockedUntil = now + (MonotonicTimeMs)instruction->value;
+                }
+                if (now < self->blockedUntil) {
+                    return 0;
+                }
+                self->isBlocked = false;
+                self->programCounter++;
+                break;
+            case ClvCliScriptOpWaitResponse:
+            case ClvCliScriptOpWaitLogin:
+            case ClvCliScriptOpAwait: {
+                bool isDone;
+                if (instruction->op == ClvCliScriptOpWaitLogin) {
+                    isDone = host->isLoggedIn(host->self);
+                } else if (instruction->op == ClvCliScriptOpAwait) {
+                    isDone = !host->isAwaiting(host->self, instruction->value);
+                } else {
+                    isDone = !host->isPending(host->self, (ClvCliRequestType)instruction->value);
+                }
+                if (!isDone) {
+                    if (!self->isBlocked) {
+                        self->isBlocked = true;
+                        self->blockedUntil = now + (MonotonicTimeMs)instruction->timeoutMs;
+                    }
+                    if (now >= self->blockedUntil) {
+                        CLOG_C_SOFT_ERROR(&self->log, "script line %zu: '%s' timed out",
+                            instruction->lineNumber, instruction->line)
+                        return -1;
+                    }
+                    return 0;
+                }
+                if (instruction->op == ClvCliScriptOpAwait) {
+                    host->awaited(host->self, instruction->value);
+                }
+                self->isBlocked = false;
+                self->programCounter++;
+            } break;
+            case ClvCliScriptOpRepeat:
+                if (instruction->value == 0) {
+                    self->programCounter = instruction->jumpIndex;
+                    break;
+                }
+                self->repeatsLeft[self->depth++] = instruction->value;
+                self->programCounter++;
+                break;
+            case ClvCliScriptOpEnd:
+                if (--self->repeatsLeft[self->depth - 1] > 0) {
+                    self->programCounter = instruction->jumpIndex + 1;
+                } else {
+                    self->depth--;
+                    self->programCounter++;
+                }
+                break;
+        }
+    }
+
+    return 1;
+}
+
+/// How long the application can wait before the script needs to be updated again
+/// @param self script
+/// @param now current time
+/// @return milliseconds
+size_t clvCliScriptTimeUntilUpdate(const ClvCliScript* self, MonotonicTimeMs now)
+{
+    if (self->programCounter >= self->instructionCount) {
+        return SIZE_MAX;
+    }
+
+    if (!self->isBlocked) {
+        return 0;
+    }
+
+    return now >= self->blockedUntil ? 0 : (size_t)(self->blockedUntil - now);
+}
@@ -0,0 +1,370 @@
+/*----------------------------------------------------------------------------------------------------------
+ *  Copyright (c) Peter Bjorklund. All rights reserved. https://github.com/piot/conclave-client-cli
+ *  Licensed under the MIT License. See LICENSE in the project root for license information.
+ *--------------------------------------------------------------------------------------------------------*/
+#include <clog/clog.h>
+#include <conclave-client-cli/simulate.h>
+#include <tiny-libc/tiny_libc.h>
+
+static const ClvCliTimeNs nanosecondsPerMs = 1000000;
+
+/// The clients are checked at most this often
+static const ClvCliTimeNs tickDuration = 5000000;
+
+static const uint8_t faultFlags
+    = CLV_CLI_SIMULATE_LAGGING | CLV_CLI_SIMULATE_DISCONNECTED | CLV_CLI_SIMULATE_SILENT;
+
+int clvCliSimulateInit(ClvCliSimulate* self, size_t clientCount)
+{
+    self->clientCount = clientCount;
+    self->isRunning = false;
+    self->startedAt = 0;
+    self->stoppedAt = 0;
+    self->faultAt = 0;
+    self->speedPercent = 100;
+    self->flags = tc_malloc_type_count(uint8_t, clientCount);
+    self->dueAt = tc_malloc_type_count(ClvCliTimeNs, clientCount);
+    self->lagStartTicks = tc_malloc_type_count(uint64_t, clientCount);
+    self->terms = tc_malloc_type_count(ClvSerializeTerm, clientCount);
+    self->owners = tc_malloc_type_count(ClvSerializeUserId, clientCount);
+    if (!self->flags || !self->dueAt || !self->lagStartTicks || !self->terms || !self->owners) {
+        CLOG_SOFT_ERROR("could not allocate simulation for %zu clients", clientCount)
+        clvCliSimulateDestroy(self);
+        return -1;
+    }
+    tc_mem_clear_type_n(self->flags, clientCount);
+    clvCliSimulateReportInit(&self->report);
+
+    return 0;
+}
+
+void clvCliSimulateDestroy(ClvCliSimulate* self)
+{
+    tc_free(self->flags);
+    tc_free(self->dueAt);
+    tc_free(self->lagStartTicks);
+    tc_free(self->terms);
+    tc_free(self->owners);
+    self->flags = 0;
+    self->dueAt = 0;
+    self->lagStartTicks = 0;
+    self->terms = 0;
+    self->owners = 0;
+    self->clientCount = 0;
+}
+
+/// xorshift64*
+static uint64_t nextRandom(ClvCliSimulate* self)
+{
+    uint64_t x = self->random;
+    x ^= x >> 12;
+    x ^= x << 25;
+    x ^= x >> 27;
+    self->random = x;
+
+    return x * 0x2545F4914F6CDD1Dull;
+}
+
+/// The tick that a client without lag has reached
+static uint64_t ticksAt(const ClvCliSimulate* self, ClvCliTimeNs now)
+{
+    if (now <= self->startedAt) {
+        return 0;
+    }
+
+    return (now - self->startedAt) * self->options.ticksPerSecond / 1000000000u;
+}
+
+static uint64_t knowledge(const ClvCliSimulate* self, size_t index, uint64_t ticks)
+{
+    if ((self->flags[index] & CLV_CLI_SIMULATE_LAGGING) == 0) {
+        return ticks;
+    }
+    uint64_t lagStart = self->lagStartTicks[index];
+
+    return lagStart + (ticks - lagStart) * self->speedPercent / 100u;
+}
+
+/// Starts the simulation and the pings on all clients, without faults
+/// The first pings are spread out over one ping interval.
+/// @param self simulate
+/// @param options tick rate and ping interval
+/// @param now current time
+void clvCliSimulateStart(
+    ClvCliSimulate* self, const ClvCliSimulateOptions* options, ClvCliTimeNs now)
+{
+    if (options->ticksPerSecond == 0 || options->pingIntervalMs == 0 || self->clientCount == 0) {
+        return;
+    }
+
+    self->options = *options;
+    self->startedAt = now;
+    self->stoppedAt = 0;
+    self->faultAt = 0;
+    self->speedPercent = 100;
+    self->isRunning = true;
+    self->nextUpdateAt = now;
+    self->random = (now ^ 0x9E3779B97F4A7C15ull) | 1;
+
+    clvCliSimulateReportInit(&self->report);
+    self->report.ticksPerSecond = options->ticksPerSecond;
+
+    ClvCliTimeNs interval = options->pingIntervalMs * nanosecondsPerMs;
+    for (size_t i = 0; i < self->clientCount; ++i) {
+        self->flags[i] = 0;
+        self->dueAt[i] = now + interval * i / self->clientCount;
+    }
+}
+
+/// Stops pinging, the ping responses that are still on their way are measured
+/// @param self simulate
+/// @param now current time
+void clvCliSimulateStop(ClvCliSimulate* self, ClvCliTimeNs now)
+{
+    if (!self->isRunning) {
+        return;
+    }
+    self->isRunning = false;
+    self->stoppedAt = now;
+}
+
+static void injectInClient(ClvCliSimulate* self, size_t index,
+    const ClvCliSimulateInjectOptions* options, uint64_t ticks, ClvCliTimeNs now)
+{
+    if (options->fault == ClvCliSimulateFaultHeal) {
+        if (self->flags[index] & CLV_CLI_SIMULATE_SILENT) {
+            self->dueAt[index] = now;
+        }
+        self->flags[index] &= (uint8_t)~faultFlags;
+        return;
+    }
+
+    if (options->ownersOnly && (self->flags[index] & CLV_CLI_SIMULATE_OWNER) == 0) {
+        return;
+    }
+    if (nextRandom(self) % 100u >= options->percent) {
+        return;
+    }
+
+    switch (options->fault) {
+        case ClvCliSimulateFaultLag:
+            if ((self->flags[index] & CLV_CLI_SIMULATE_LAGGING) == 0) {
+                self->lagStartTicks[index] = ticks;
+            }
+            self->flags[index] |= CLV_CLI_SIMULATE_LAGGING;
+            break;
+        case ClvCliSimulateFaultDisconnect:
+            self->flags[index] |= CLV_CLI_SIMULATE_DISCONNECTED;
+            break;
+        case ClvCliSimulateFaultSilent:
+            self->flags[index] |= CLV_CLI_SIMULATE_SILENT;
+            break;
+        case ClvCliSimulateFaultHeal:
+            break;
+    }
+}
+
+/// Injects a fault in a random part of the clients, or heals all of them
+/// The clients that are in a room and still pinging start to wait for a new owner.
+/// @param self simulate
+/// @param options fault, how many and which clients
+/// @param now current time
+void clvCliSimulateInject(
+    ClvCliSimulate* self, const ClvCliSimulateInjectOptions* options, ClvCliTimeNs now)
+{
+    if (!self->isRunning) {
+        return;
+    }
+    if (options->fault == ClvCliSimulateFaultLag) {
+        self->speedPercent = options->speedPercent;
+    }
+    self->faultAt = now;
+
+    uint64_t ticks = ticksAt(self, now);
+    for (size_t i = 0; i < self->clientCount; ++i) {
+        injectInClient(self, i, options, ticks, now);
+        uint8_t flags = self->flags[i];
+        if ((flags & CLV_CLI_SIMULATE_HAS_ROOM_INFO) && (flags & CLV_CLI_SIMULATE_SILENT) == 0) {
+            self->flags[i] |= CLV_CLI_SIMULATE_AWAITING_MIGRATION;
+        } else {
+            self->flags[i] &= (uint8_t)~CLV_CLI_SIMULATE_AWAITING_MIGRATION;
+        }
+    }
+}
+
+/// Sends the pings that are due, with the tick that each client has reached
+/// @param self simulate
+/// @param now current time
+/// @param ping sends a ping from a client
+/// @param pingSelf passed to ping
+void clvCliSimulateUpdate(
+    ClvCliSimulate* self, ClvCliTimeNs now, ClvCliSimulatePingFn ping, void* pingSelf)
+{
+    if (!self->isRunning || now < self->nextUpdateAt) {
+        return;
+    }
+    self->nextUpdateAt = now + tickDuration;
+
+    ClvCliTimeNs interval = self->options.pingIntervalMs * nanosecondsPerMs;
+    uint64_t ticks = ticksAt(self, now);
+    for (size_t i = 0; i < self->clientCount; ++i) {
+        if (now < self->dueAt[i] || (self->flags[i] & CLV_CLI_SIMULATE_SILENT)) {
+            continue;
+        }
+        bool hasConnectionToOwner = (self->flags[i] & CLV_CLI_SIMULATE_DISCONNECTED) == 0;
+        if (ping(pingSelf, i, knowledge(self, i, ticks), hasConnectionToOwner)) {
+            self->report.pingCount++;
+        }
+        self->dueAt[i] += interval;
+        if (self->dueAt[i] <= now) {
+            self->dueAt[i] = now + interval;
+        }
+    }
+}
+
+/// Records changes of the term and owner of the room of a client
+/// @param self simulate
+/// @param index client index
+/// @param pingResponse the last ping response of the client
+/// @param userId user id of the client
+/// @param now current time
+void clvCliSimulatePingReceived(ClvCliSimulate* self, size_t index,
+    const ClvSerializePingResponseOptions* pingResponse, ClvSerializeUserId userId,
+    ClvCliTimeNs now)
+{
+    if (self->startedAt == 0) {
+        return;
+    }
+    self->report.responseCount++;
+
+    const ClvSerializeRoomInfoInPing* roomInfo = &pingResponse->roomInfo;
+    ClvSerializeUserId owner = 0;
+    if (roomInfo->indexOfOwner < roomInfo->memberCount) {
+        owner = roomInfo->members[roomInfo->indexOfOwner];
+    }
+
+    uint8_t flags = self->flags[index];
+    if (flags & CLV_CLI_SIMULATE_HAS_ROOM_INFO) {
+        bool hasTermChanged = pingResponse->term != self->terms[index];
+        bool hasOwnerChanged = owner != self->owners[index];
+        if (hasTermChanged) {
+            self->report.termChangeCount++;
+        }
+        if (hasOwnerChanged) {
+            self->report.ownerChangeCount++;
+        }
+        if ((hasTermChanged || hasOwnerChanged) && (flags & CLV_CLI_SIMULATE_AWAITING_MIGRATION)) {
+            flags &= (uint8_t)~CLV_CLI_SIMULATE_AWAITING_MIGRATION;
+            clvCliHistogramAdd(&self->report.migrationLatencies, (now - self->faultAt) / 1000);
+        }
+    }
+
+    self->terms[index] = pingResponse->term;
+    self->owners[index] = owner;
+    flags |= CLV_CLI_SIMULATE_HAS_ROOM_INFO;
+    if (owner != 0 && owner == userId) {
+        flags |= CLV_CLI_SIMULATE_OWNER;
+    } else {
+        flags &= (uint8_t)~CLV_CLI_SIMULATE_OWNER;
+    }
+    self->flags[index] = flags;
+}
+
+/// Milliseconds until the pings should be checked again
+/// @param self simulate
+/// @param now current time
+/// @return milliseconds, SIZE_MAX if not running
+size_t clvCliSimulateTimeUntilUpdate(const ClvCliSimulate* self, ClvCliTimeNs now)
+{
+    if (!self->isRunning) {
+        return SIZE_MAX;
+    }
+    if (self->nextUpdateAt <= now) {
+        return 0;
+    }
+
+    return (size_t)((self->nextUpdateAt - now + nanosecondsPerMs - 1) / nanosecondsPerMs);
+}
+
+/// Gets the result so far, with the number of clients that have each fault
+/// @param self simulate
+/// @param report target report
+/// @param now current time
+void clvCliSimulateReportGet(
+    const ClvCliSimulate* self, ClvCliSimulateReport* report, ClvCliTimeNs now)
+{
+    *report = self->report;
+    if (self->startedAt == 0) {
+        report->elapsed = 0;
+        return;
+    }
+    report->elapsed = (self->isRunning ? now : self->stoppedAt) - self->startedAt;
+
+    for (size_t i = 0; i < self->clientCount; ++i) {
+        uint8_t flags = self->flags[i];
+        report->laggingCount += (flags & CLV_CLI_SIMULATE_LAGGING) ? 1 : 0;
+        report->disconnectedCount += (flags & CLV_CLI_SIMULATE_DISCONNECTED) ? 1 : 0;
+        report->silentCount += (flags & CLV_CLI_SIMULATE_SILENT) ? 1 : 0;
+        report->ownerCount += (flags & CLV_CLI_SIMULATE_OWNER) ? 1 : 0;
+        report->awaitingMigrationCount += (flags & CLV_CLI_SIMULATE_AWAITING_MIGRATION) ? 1 : 0;
+    }
+}
+
+size_t clvCliSimulateBytesPerClient(void)
+{
+    return sizeof(uint8_t) + sizeof(ClvCliTimeNs) + sizeof(uint64_t) + sizeof(ClvSerializeTerm)
+        + sizeof(ClvSerializeUserId);
+}
+
+const char* clvCliSimulateFaultToString(ClvCliSimulateFault fault)
+{
+    switch (fault) {
+        case ClvCliSimulateFaultLag:
+            return "lag";
+        case ClvCliSimulateFaultDisconnect:
+            return "disconnect";
+        case ClvCliSimulateFaultSilent:
+            return "silent";
+        case ClvCliSimulateFaultHeal:
+            return "heal";
+    }
+
+    return "unknown";
+}
+
+void clvCliSimulateReportInit(ClvCliSimulateReport* self)
+{
+    self->ticksPerSecond = 0;
+    self->elapsed = 0;
+    self->pingCount = 0;
+    self->responseCount = 0;
+    self->termChangeCount = 0;
+    self->ownerChangeCount = 0;
+    self->laggingCount = 0;
+    self->disconnectedCount = 0;
+    self->silentCount = 0;
+    self->ownerCount = 0;
+    self->awaitingMigrationCount = 0;
+    clvCliHistogramInit(&self->migrationLatencies);
+}
+
+void clvCliSimulateReportMerge(ClvCliSimulateReport* self, const ClvCliSimulateReport* other)
+{
+    if (other->ticksPerSecond == 0) {
+        return;
+    }
+    self->ticksPerSecond = other->ticksPerSecond;
+    if (other->elapsed > self->elapsed) {
+        self->elapsed = other->elapsed;
+    }
+    self->pingCount += other->pingCount;
+    self->responseCount += other->responseCount;
+    self->termChangeCount += other->termChangeCount;
+    self->ownerChangeCount += other->ownerChangeCount;
+    self->laggingCount += other->laggingCount;
+    self->disconnectedCount += other->disconnectedCount;
+    self->silentCount += other->silentCount;
+    self->ownerCount += other->ownerCount;
+    self->awaitingMigrationCount += other->awaitingMigrationCount;
+    clvCliHistogramMerge(&self->migrationLatencies, &other->migrationLatencies);
+}
@@ -0,0 +1,80 @@
+/*----------------------------------------------------------------------------------------------------------
+ *  Copyright (c) Peter Bjorklund. All rights reserved. https://github.com/piot/conclave-client-cli
+ *  Licensed under the MIT License. See LICENSE in the project root for license information.
+ *--------------------------------------------------------------------------------------------------------*/
+#include <clog/clog.h>
+#include <conclave-client-cli/spsc_ring.h>
+#include <tiny-libc/tiny_libc.h>
+
+/// Initializes the ring buffer
+/// @param self ring buffer
+/// @param slotOctetCount size of each item
+/// @param capacity maximum number of items, must be a power of two
+/// @return negative on error
+int clvCliSpscRingInit(ClvCliSpscRing* self, size_t slotOctetCount, size_t capacity)
+{
+    CLOG_ASSERT(capacity > 0 && (capacity & (capacity - 1)) == 0,
+        "capacity must be a power of two %zu", capacity)
+
+    self->slots = tc_malloc_type_count(uint8_t, slotOctetCount * capacity);
+    if (self->slots == 0) {
+        return -1;
+    }
+    self->slotOctetCount = slotOctetCount;
+    self->capacity = capacity;
+    self->mask = capacity - 1;
+    self->writeIndex = 0;
+    self->cachedReadIndex = 0;
+    self->readIndex = 0;
+    self->cachedWriteIndex = 0;
+
+    return 0;
+}
+
+void clvCliSpscRingDestroy(ClvCliSpscRing* self)
+{
+    tc_free(self->slots);
+    self->slots = 0;
+}
+
+/// Gets the next free slot (producer only)
+/// @param self ring buffer
+/// @return the slot to fill in, or NULL if the ring is full
+void* clvCliSpscRingWriteBegin(ClvCliSpscRing* self)
+{
+    if (self->writeIndex - self->cachedReadIndex == self->capacity) {
+        self->cachedReadIndex = __atomic_load_n(&self->readIndex, __ATOMIC_ACQUIRE);
+        if (self->writeIndex - self->cachedReadIndex == self->capacity) {
+            return 0;
+        }
+    }
+
+    return self->slots + (self->writeIndex & self->mask) * self->slotOctetCount;
+}
+
+/// Publishes the slot returned by clvCliSpscRingWriteBegin() to the consumer (producer only)
+void clvCliSpscRingWriteEnd(ClvCliSpscRing* self)
+{
+    __atomic_store_n(&self->writeIndex, self->writeIndex + 1, __ATOMIC_RELEASE);
+}
+
+/// Gets the oldest item (consumer only)
+/// @param self ring buffer
+/// @return the item, or NULL if the ring is empty
+const void* clvCliSpscRingReadBegin(ClvCliSpscRing* self)
+{
+    if (self->readIndex == self->cachedWriteIndex) {
+        self->cachedWriteIndex = __atomic_load_n(&self->writeIndex, __ATOMIC_ACQUIRE);
+        if (self->readIndex == self->cachedWriteIndex) {
+            return 0;
+        }
+    }
+
+    return self->slots + (self->readIndex & self->mask) * self->slotOctetCount;
+}
+
+/// Releases the item returned by clvCliSpscRingReadBegin() back to the producer (consumer only)
+void clvCliSpscRingReadEnd(ClvCliSpscRing* self)
+{
+    __atomic_store_n(&self->readIndex, self->readIndex + 1, __ATOMIC_RELEASE);
+}
@@ -0,0 +1,791 @@
+/*----------------------------------------------------------------------------------------------------------
+ *  Copyright (c) Peter Bjorklund. All rights reserved. https://github.com/piot/conclave-client-cli
+ *  Licensed under the MIT License. See LICENSE in the project root for license information.
+ *--------------------------------------------------------------------------------------------------------*/
+#define _POSIX_C_SOURCE 200809L
+#include <conclave-client-cli/event_loop.h>
+#include <conclave-client-cli/swarm.h>
+#include <unistd.h>
+
+/// Slab allocator budget for each conclave client in the swarm
+static const size_t defaultImprintOctetsPerClient = 16 * 1024;
+
+/// Allocates and starts to log in all clients in the swarm
+/// @param self swarm
+/// @param clientCount number of simulated users
+/// @param firstSecretIndex the guise secret index of the first user, the rest follow in sequence
+/// @param guiseHost host of the guise server
+/// @param guisePort port of the guise server
+/// @param conclaveHost host of the conclave server
+/// @param conclavePort port of the conclave server
+/// @param log logging
+/// @return negative on error
+int clvCliSwarmInit(ClvCliSwarm* self, size_t clientCount, size_t firstSecretIndex,
+    const char* guiseHost, uint16_t guisePort, const char* conclaveHost, uint16_t conclavePort,
+    size_t imprintOctetsPerClient, Clog log)
+{
+    self->clientCount = clientCount;
+    self->conclaveHost = conclaveHost;
+    self->conclavePort = conclavePort;
+    self->eventLoop = 0;
+    self->log = log;
+    self->clvClientUdpLog.config = log.config;
+    self->clvClientUdpLog.constantPrefix = "swarmClvClientUdp";
+    tc_mem_clear_type(&self->load);
+    tc_mem_clear_type(&self->churn);
+    tc_mem_clear_type(&self->simulate);
+    tc_mem_clear_type(&self->imprintCounter);
+    self->hasImprint = false;
+
+    self->secrets = tc_malloc_type_count(GuiseClientUdpSecret, clientCount);
+    self->guiseClients = tc_malloc_type_count(GuiseClientUdp, clientCount);
+    self->clvClients = tc_malloc_type_count(ClvClientUdp, clientCount);
+    self->phases = tc_malloc_type_count(uint8_t, clientCount);
+    self->clientStates = tc_malloc_type_count(uint8_t, clientCount);
+    self->lastPingResponseVersions = tc_malloc_type_count(uint8_t, clientCount);
+    self->lastRoomCreateVersions = tc_malloc_type_count(uint8_t, clientCount);
+    self->lastRoomListVersions = tc_malloc_type_count(uint8_t, clientCount);
+    self->observedRoomIds = tc_malloc_type_count(ClvSerializeRoomId, clientCount);
+    self->observedTerms = tc_malloc_type_count(ClvSerializeTerm, clientCount);
+    self->observedOwners = tc_malloc_type_count(ClvSerializeUserId, clientCount);
+    bool hasAllocatedSentAt = true;
+    for (size_t i = 0; i < ClvCliRequestTypeCount; ++i) {
+        self->sentAt[i] = tc_malloc_type_count(ClvCliTimeNs, clientCount);
+        hasAllocatedSentAt = hasAllocatedSentAt && self->sentAt[i] != 0;
+    }
+
+    if (!self->secrets || !self->guiseClients || !self->clvClients || !self->phases
+        || !self->clientStates || !self->lastPingResponseVersions || !self->lastRoomCreateVersions
+        || !self->lastRoomListVersions || !self->observedRoomIds || !self->observedTerms
+        || !self->observedOwners || !hasAllocatedSentAt) {
+        CLOG_C_SOFT_ERROR(&self->log, "could not allocate swarm of %zu clients", clientCount)
+        self->clientCount = 0; // no sockets to close
+        clvCliSwarmDestroy(self);
+        return -1;
+    }
+
+    for (size_t i = 0; i < clientCount; ++i) {
+        self->guiseClients[i].udpClient.handle = -1;
+        self->clvClients[i].udpClient.handle = -1;
+    }
+
+    tc_mem_clear_type_n(self->phases, clientCount);
+    tc_mem_clear_type_n(self->clientStates, clientCount);
+    tc_mem_clear_type_n(self->lastPingResponseVersions, clientCount);
+    tc_mem_clear_type_n(self->lastRoomCreateVersions, clientCount);
+    tc_mem_clear_type_n(self->lastRoomListVersions, clientCount);
+    tc_mem_clear_type_n(self->observedRoomIds, clientCount);
+    tc_mem_clear_type_n(self->observedTerms, clientCount);
+    tc_mem_clear_type_n(self->observedOwners, clientCount);
+    for (size_t i = 0; i < ClvCliRequestTypeCount; ++i) {
+        tc_mem_clear_type_n(self->sentAt[i], clientCount);
+        clvCliHistogramInit(&self->latencies[i]);
+        self->pendingCounts[i] = 0;
+    }
+    self->loggedInCount = 0;
+    self->ownerObservations = 0;
+    self->droppedOwnerObservationCount = 0;
+
+    tc_mem_clear_type_n(self->phaseCounts, 3);
+    self->phaseCounts[ClvCliSwarmPhaseLoggingIn] = clientCount;
+    self->pingResponseCount = 0;
+    self->roomCreateCount = 0;
+    self->roomListCount = 0;
+    self->coalescedCount = 0;
+
+    if (clvCliLoadInit(&self->load, clientCount) < 0
+        || clvCliChurnInit(&self->churn, clientCount) < 0
+        || clvCliSimulateInit(&self->simulate, clientCount) < 0) {
+        clvCliSwarmDestroy(self);
+        return -1;
+    }
+
+    size_t imprintOctets = (imprintOctetsPerClient > 0 ? imprintOctetsPerClient
+                                                       : defaultImprintOctetsPerClient)
+        * clientCount;
+    if (imprintDefaultSetupInit(&self->imprint, imprintOctets) < 0) {
+        CLOG_C_SOFT_ERROR(&self->log, "could not set up %zu imprint octets", imprintOctets)
+        clvCliSwarmDestroy(self);
+        return -1;
+    }
+    self->hasImprint = true;
+    if (clvCliImprintCounterInit(
+            &self->imprintCounter, &self->imprint.slabAllocator.info, imprintOctets, clientCount)
+        < 0) {
+        clvCliSwarmDestroy(self);
+        return -1;
+    }
+
+    for (size_t i = 0; i < clientCount; ++i) {
+        guiseClientUdpReadSecret(&self->secrets[i], firstSecretIndex + i);
+        if (guiseClientUdpInit(&self->guiseClients[i], 0, guiseHost, guisePort, &self->secrets[i])
+            < 0) {
+            CLOG_C_SOFT_ERROR(&self->log, "could not start guise client %zu", i)
+            self->guiseClients[i].udpClient.handle = -1;
+            self->phases[i] = ClvCliSwarmPhaseFailed;
+            self->phaseCounts[ClvCliSwarmPhaseLoggingIn]--;
+            self->phaseCounts[ClvCliSwarmPhaseFailed]++;
+        }
+    }
+
+    CLOG_C_INFO(&self->log, "swarm of %zu clients (%zu octets each)", clientCount,
+        clvCliSwarmBytesPerClient())
+
+    return 0;
+}
+
+static void closeSocket(int handle)
+{
+    if (handle >= 0) {
+        close(handle);
+    }
+}
+
+/// Closes the sockets of all clients and frees the swarm, also after a failed clvCliSwarmInit()
+/// @param self swarm
+void clvCliSwarmDestroy(ClvCliSwarm* self)
+{
+    for (size_t i = 0; i < self->clientCount; ++i) {
+        closeSocket(self->guiseClients[i].udpClient.handle);
+        closeSocket(self->clvClients[i].udpClient.handle);
+    }
+
+    tc_free(self->secrets);
+    tc_free(self->guiseClients);
+    tc_free(self->clvClients);
+    tc_free(self->phases);
+    tc_free(self->clientStates);
+    tc_free(self->lastPingResponseVersions);
+    tc_free(self->lastRoomCreateVersions);
+    tc_free(self->lastRoomListVersions);
+    tc_free(self->observedRoomIds);
+    tc_free(self->observedTerms);
+    tc_free(self->observedOwners);
+    clvCliLoadDestroy(&self->load);
+    clvCliChurnDestroy(&self->churn);
+    clvCliSimulateDestroy(&self->simulate);
+    clvCliImprintCounterDestroy(&self->imprintCounter);
+    if (self->hasImprint) {
+        // The conclave clients have no destroy of their own, their allocations go with the slabs
+        imprintDefaultSetupDestroy(&self->imprint);
+        self->hasImprint = false;
+    }
+    for (size_t i = 0; i < ClvCliRequestTypeCount; ++i) {
+        tc_free(self->sentAt[i]);
+    }
+    self->clientCount = 0;
+}
+
+/// Registers the sockets of all clients, so only clients with received datagrams are updated
+/// @param self swarm
+/// @param eventLoop event loop
+/// @return negative on error
+int clvCliSwarmAddToEventLoop(ClvCliSwarm* self, ClvCliEventLoop* eventLoop)
+{
+    self->eventLoop = eventLoop;
+    for (size_t i = 0; i < self->clientCount; ++i) {
+        if (self->phases[i] == ClvCliSwarmPhaseFailed) {
+            continue;
+        }
+        if (clvCliEventLoopAdd(eventLoop, self->guiseClients[i].udpClient.handle,
+                ClvCliEventLoopSourceSocket, (uint32_t)i)
+            < 0) {
+            return -1;
+        }
+        if (self->phases[i] == ClvCliSwarmPhaseConclave
+            && clvCliEventLoopAdd(eventLoop, self->clvClients[i].udpClient.handle,
+                   ClvCliEventLoopSourceSocket, (uint32_t)i)
+                < 0) {
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+static void setPhase(ClvCliSwarm* self, size_t index, ClvCliSwarmPhase phase)
+{
+    if (phase == ClvCliSwarmPhaseFailed) {
+        if (self->phases[index] == ClvCliSwarmPhaseConclave
+            && self->clientStates[index] == ClvClientStateLoggedIn) {
+            self->loggedInCount--;
+        }
+        for (size_t i = 0; i < ClvCliRequestTypeCount; ++i) {
+            if (self->sentAt[i][index] != 0) {
+                self->sentAt[i][index] = 0;
+                self->pendingCounts[i]--;
+            }
+        }
+    }
+    self->phaseCounts[self->phases[index]]--;
+    self->phaseCounts[phase]++;
+    self->phases[index] = (uint8_t)phase;
+}
+
+static int startConclave(ClvCliSwarm* self, size_t index)
+{
+    const GuiseClientUdp* guiseClient = &self->guiseClients[index];
+    ClvClientUdp* clvClient = &self->clvClients[index];
+
+    int result = clvClientUdpInit(clvClient, self->conclaveHost, self->conclavePort,
+        guiseClient->guiseClient.mainUserSessionId, monotonicTimeMsNow(),
+        &self->imprintCounter.info, self->clvClientUdpLog);
+    if (result < 0) {
+        CLOG_C_SOFT_ERROR(&self->log, "could not start conclave client %zu", index)
+        clvClient->udpClient.handle = -1;
+        setPhase(self, index, ClvCliSwarmPhaseFailed);
+        return result;
+    }
+
+    setPhase(self, index, ClvCliSwarmPhaseConclave);
+    self->clientStates[index] = (uint8_t)clvClient->conclaveClient.state;
+    if (self->clientStates[index] == ClvClientStateLoggedIn) {
+        self->loggedInCount++;
+    }
+
+    if (self->eventLoop != 0) {
+        return clvCliEventLoopAdd(self->eventLoop, clvClient->udpClient.handle,
+            ClvCliEventLoopSourceSocket, (uint32_t)index);
+    }
+
+    return 0;
+}
+
+static void requestSent(ClvCliSwarm* self, ClvCliRequestType type, size_t index, ClvCliTimeNs now)
+{
+    if (self->sentAt[type][index] == 0) {
+        self->sentAt[type][index] = now;
+        self->pendingCounts[type]++;
+    }
+}
+
+static void responseReceived(
+    ClvCliSwarm* self, ClvCliRequestType type, size_t index, ClvCliTimeNs now)
+{
+    ClvCliTimeNs sentAt = self->sentAt[type][index];
+    if (sentAt == 0) {
+        return;
+    }
+    self->sentAt[type][index] = 0;
+    self->pendingCounts[type]--;
+    clvCliHistogramAdd(&self->latencies[type], (now - sentAt) / 1000);
+}
+
+/// Number of responses since the version was last seen
+/// Only the last response is kept by the client, so all but one are counted as coalesced. The
+/// inbox of a client holds a few datagrams, so the 8-bit version can not wrap between two updates.
+static size_t responseCount(ClvCliSwarm* self, uint8_t version, uint8_t* lastVersion)
+{
+    uint8_t delta = (uint8_t)(version - *lastVersion);
+    *lastVersion = version;
+    self->coalescedCount += (uint64_t)(delta - 1);
+
+    return delta;
+}
+
+static void loadReceived(
+    ClvCliSwarm* self, ClvCliRequestType type, size_t index, size_t count, ClvCliTimeNs now)
+{
+    if (!clvCliLoadIsMeasuring(&self->load, type)) {
+        return;
+    }
+    for (size_t i = 0; i < count; ++i) {
+        clvCliLoadReceived(&self->load, index, now);
+    }
+}
+
+/// Passes on a new room, term or owner in the ping response to the coordinator
+static void observeOwner(ClvCliSwarm* self, size_t index, const ClvClient* client, ClvCliTimeNs now)
+{
+    if (self->ownerObservations == 0) {
+        return;
+    }
+
+    const ClvSerializePingResponseOptions* pingResponse = &client->pingResponseOptions;
+    const ClvSerializeRoomInfoInPing* roomInfo = &pingResponse->roomInfo;
+    ClvSerializeUserId owner = 0;
+    if (roomInfo->indexOfOwner < roomInfo->memberCount) {
+        owner = roomInfo->members[roomInfo->indexOfOwner];
+    }
+    if (client->mainRoomId == self->observedRoomIds[index]
+        && pingResponse->term == self->observedTerms[index]
+        && owner == self->observedOwners[index]) {
+        return;
+    }
+    self->observedRoomIds[index] = client->mainRoomId;
+    self->observedTerms[index] = pingResponse->term;
+    self->observedOwners[index] = owner;
+
+    ClvCliOwnerObservation* observation
+        = (ClvCliOwnerObservation*)clvCliSpscRingWriteBegin(self->ownerObservations);
+    if (observation == 0) {
+        self->droppedOwnerObservationCount++;
+        return;
+    }
+    observation->time = now;
+    observation->term = pingResponse->term;
+    observation->owner = owner;
+    observation->roomId = client->mainRoomId;
+    observation->memberCount = roomInfo->memberCount;
+    clvCliSpscRingWriteEnd(self->ownerObservations);
+}
+
+static void countChanges(ClvCliSwarm* self, size_t index)
+{
+    const ClvClient* client = &self->clvClients[index].conclaveClient;
+
+    uint8_t clientState = (uint8_t)client->state;
+    if (clientState != self->clientStates[index]) {
+        if (clientState == ClvClientStateLoggedIn) {
+            self->loggedInCount++;
+        } else if (self->clientStates[index] == ClvClientStateLoggedIn) {
+            self->loggedInCount--;
+        }
+        self->clientStates[index] = clientState;
+    }
+
+    if (client->pingResponseOptionsVersion == self->lastPingResponseVersions[index]
+        && client->roomCreateVersion == self->lastRoomCreateVersions[index]
+        && client->listRoomsOptionsVersion == self->lastRoomListVersions[index]) {
+        return;
+    }
+
+    ClvCliTimeNs now = clvCliClockNowNs();
+
+    if (client->pingResponseOptionsVersion != self->lastPingResponseVersions[index]) {
+        size_t count = responseCount(
+            self, client->pingResponseOptionsVersion, &self->lastPingResponseVersions[index]);
+        self->pingResponseCount += count;
+        responseReceived(self, ClvCliRequestTypePing, index, now);
+        loadReceived(self, ClvCliRequestTypePing, index, count, now);
+        clvCliChurnPingReceived(&self->churn, index, &client->pingResponseOptions.roomInfo,
+            self->secrets[index].userId, now);
+        clvCliSimulatePingReceived(&self->simulate, index, &client->pingResponseOptions,
+            self->secrets[index].userId, now);
+        observeOwner(self, index, client, now);
+    }
+    if (client->roomCreateVersion != self->lastRoomCreateVersions[index]) {
+        size_t count
+            = responseCount(self, client->roomCreateVersion, &self->lastRoomCreateVersions[index]);
+        self->roomCreateCount += count;
+        // Both room create and room join are answered with the main room of the client
+        if (self->sentAt[ClvCliRequestTypeRoomJoin][index] != 0) {
+            responseReceived(self, ClvCliRequestTypeRoomJoin, index, now);
+        } else {
+            responseReceived(self, ClvCliRequestTypeRoomCreate, index, now);
+        }
+        loadReceived(self, ClvCliRequestTypeRoomJoin, index, count, now);
+        clvCliChurnJoinReceived(&self->churn, index, client->mainRoomId, now);
+    }
+    if (client->listRoomsOptionsVersion != self->lastRoomListVersions[index]) {
+        size_t count = responseCount(
+            self, client->listRoomsOptionsVersion, &self->lastRoomListVersions[index]);
+        self->roomListCount += count;
+        responseReceived(self, ClvCliRequestTypeRoomList, index, now);
+        loadReceived(self, ClvCliRequestTypeRoomList, index, count, now);
+        clvCliChurnRoomListReceived(&self->churn, index, &client->listRoomsResponseOptions, now);
+    }
+}
+
+/// Updates a single client, e.g. when a datagram has been received on its socket
+/// @param self swarm
+/// @param index client index
+/// @param now current time
+/// @return negative on error
+int clvCliSwarmUpdateClient(ClvCliSwarm* self, size_t index, MonotonicTimeMs now)
+{
+    switch ((ClvCliSwarmPhase)self->phases[index]) {
+        case ClvCliSwarmPhaseLoggingIn: {
+            GuiseClientUdp* guiseClient = &self->guiseClients[index];
+            guiseClientUdpUpdate(guiseClient, now);
+            if (guiseClient->guiseClient.state == GuiseClientStateLoggedIn) {
+                return startConclave(self, index);
+            }
+        } break;
+        case ClvCliSwarmPhaseConclave: {
+            guiseClientUdpUpdate(&self->guiseClients[index], now);
+            int result = clvClientUdpUpdate(&self->clvClients[index], now);
+            if (result < 0) {
+                CLOG_C_WARN(&self->log, "client %zu failed: %d", index, result)
+                setPhase(self, index, ClvCliSwarmPhaseFailed);
+                return 0;
+            }
+            countChanges(self, index);
+        } break;
+        case ClvCliSwarmPhaseFailed:
+            break;
+    }
+
+    return 0;
+}
+
+/// Updates all clients in the swarm
+/// @param self swarm
+/// @param now current time
+/// @return negative on error
+int clvCliSwarmUpdate(ClvCliSwarm* self, MonotonicTimeMs now)
+{
+    for (size_t i = 0; i < self->clientCount; ++i) {
+        int result = clvCliSwarmUpdateClient(self, i, now);
+        if (result < 0) {
+            return result;
+        }
+    }
+
+    return 0;
+}
+
+/// Memory needed for each client, not counting the slab allocator
+/// @return octet count
+size_t clvCliSwarmBytesPerClient(void)
+{
+    return sizeof(GuiseClientUdpSecret) + sizeof(GuiseClientUdp) + sizeof(ClvClientUdp)
+        + 5 * sizeof(uint8_t) + clvCliLoadBytesPerClient()
+        + sizeof(ClvSerializeRoomId) + sizeof(ClvSerializeTerm) + sizeof(ClvSerializeUserId)
+        + clvCliChurnBytesPerClient() + clvCliSimulateBytesPerClient();
+}
+
+/// Sends a ping from all clients that are connected to conclave
+/// @param self swarm
+/// @param knowledge simulation tick ID
+/// @param hasConnectionToOwner if the clients have a connection to the room owner
+/// @return number of clients that sent the ping
+size_t clvCliSwarmPing(ClvCliSwarm* self, uint64_t knowledge, bool hasConnectionToOwner)
+{
+    size_t count = 0;
+    ClvCliTimeNs now = clvCliClockNowNs();
+    for (size_t i = 0; i < self->clientCount; ++i) {
+        if (self->phases[i] != ClvCliSwarmPhaseConclave) {
+            continue;
+        }
+        clvClientPing(&self->clvClients[i].conclaveClient, knowledge, hasConnectionToOwner);
+        requestSent(self, ClvCliRequestTypePing, i, now);
+        count++;
+    }
+
+    return count;
+}
+
+/// Every client that is connected to conclave creates its own room
+/// @param self swarm
+/// @param options room to create
+/// @return number of clients that sent the request
+size_t clvCliSwarmCreateRoom(ClvCliSwarm* self, const ClvSerializeRoomCreateOptions* options)
+{
+    size_t count = 0;
+    ClvCliTimeNs now = clvCliClockNowNs();
+    for (size_t i = 0; i < self->clientCount; ++i) {
+        if (self->phases[i] != ClvCliSwarmPhaseConclave) {
+            continue;
+        }
+        clvClientUdpCreateRoom(&self->clvClients[i], options);
+        requestSent(self, ClvCliRequestTypeRoomCreate, i, now);
+        count++;
+    }
+
+    return count;
+}
+
+/// All clients that are connected to conclave join the same room
+/// @param self swarm
+/// @param options room to join
+/// @return number of clients that sent the request
+size_t clvCliSwarmJoinRoom(ClvCliSwarm* self, const ClvSerializeRoomJoinOptions* options)
+{
+    size_t count = 0;
+    ClvCliTimeNs now = clvCliClockNowNs();
+    for (size_t i = 0; i < self->clientCount; ++i) {
+        if (self->phases[i] != ClvCliSwarmPhaseConclave) {
+            continue;
+        }
+        clvClientJoinRoom(&self->clvClients[i].conclaveClient, options);
+        requestSent(self, ClvCliRequestTypeRoomJoin, i, now);
+        count++;
+    }
+
+    return count;
+}
+
+/// All clients that are connected to conclave request the room list
+/// @param self swarm
+/// @param options list rooms filter
+/// @return number of clients that sent the request
+size_t clvCliSwarmListRooms(ClvCliSwarm* self, const ClvSerializeListRoomsOptions* options)
+{
+    size_t count = 0;
+    ClvCliTimeNs now = clvCliClockNowNs();
+    for (size_t i = 0; i < self->clientCount; ++i) {
+        if (self->phases[i] != ClvCliSwarmPhaseConclave) {
+            continue;
+        }
+        clvClientListRooms(&self->clvClients[i].conclaveClient, options);
+        requestSent(self, ClvCliRequestTypeRoomList, i, now);
+        count++;
+    }
+
+    return count;
+}
+
+/// Checks if any of the clients is waiting for a response
+/// @param self swarm
+/// @param type request type
+/// @return true if at least one client has not received the response yet
+bool clvCliSwarmIsPending(const ClvCliSwarm* self, ClvCliRequestType type)
+{
+    return self->pendingCounts[type] > 0;
+}
+
+/// Checks if all clients (that have not failed) are logged in to conclave
+/// @param self swarm
+/// @return true if logged in
+bool clvCliSwarmIsLoggedIn(const ClvCliSwarm* self)
+{
+    return self->phaseCounts[ClvCliSwarmPhaseLoggingIn] == 0
+        && self->loggedInCount == self->phaseCounts[ClvCliSwarmPhaseConclave];
+}
+
+static bool loadSend(void* _self, size_t index, const ClvCliLoadOptions* options)
+{
+    ClvCliSwarm* self = (ClvCliSwarm*)_self;
+    if (self->phases[index] != ClvCliSwarmPhaseConclave) {
+        return false;
+    }
+
+    ClvClient* client = &self->clvClients[index].conclaveClient;
+    switch (options->type) {
+        case ClvCliRequestTypePing:
+            clvClientPing(client, 0, false);
+            break;
+        case ClvCliRequestTypeRoomJoin:
+            clvClientJoinRoom(client, &options->roomJoin);
+            break;
+        case ClvCliRequestTypeRoomList:
+            clvClientListRooms(client, &options->roomList);
+            break;
+        case ClvCliRequestTypeRoomCreate:
+        case ClvCliRequestTypeCount:
+            return false;
+    }
+
+    return true;
+}
+
+/// Starts an open loop load run on all clients
+/// @param self swarm
+/// @param options what and how often to send
+void clvCliSwarmLoadStart(ClvCliSwarm* self, const ClvCliLoadOptions* options)
+{
+    clvCliLoadStart(&self->load, options, clvCliClockNowNs());
+}
+
+void clvCliSwarmLoadStop(ClvCliSwarm* self)
+{
+    clvCliLoadStop(&self->load, clvCliClockNowNs());
+}
+
+/// Sends the load requests that are due
+/// @param self swarm
+void clvCliSwarmLoadUpdate(ClvCliSwarm* self)
+{
+    clvCliLoadUpdate(&self->load, clvCliClockNowNs(), loadSend, self);
+}
+
+size_t clvCliSwarmLoadTimeUntilUpdate(const ClvCliSwarm* self)
+{
+    return clvCliLoadTimeUntilUpdate(&self->load, clvCliClockNowNs());
+}
+
+/// Checks if a client can send requests on its own, without queueing them until logged in
+static bool canSend(const ClvCliSwarm* self, size_t index)
+{
+    return self->phases[index] == ClvCliSwarmPhaseConclave
+        && self->clientStates[index] == ClvClientStateLoggedIn;
+}
+
+static bool churnListRooms(void* _self, size_t index, const ClvSerializeListRoomsOptions* options)
+{
+    ClvCliSwarm* self = (ClvCliSwarm*)_self;
+    if (!canSend(self, index)) {
+        return false;
+    }
+    clvClientListRooms(&self->clvClients[index].conclaveClient, options);
+
+    return true;
+}
+
+static bool churnJoinRoom(void* _self, size_t index, ClvSerializeRoomId roomId)
+{
+    ClvCliSwarm* self = (ClvCliSwarm*)_self;
+    if (!canSend(self, index)) {
+        return false;
+    }
+    ClvSerializeRoomJoinOptions options;
+    options.roomIdToJoin = roomId;
+    clvClientJoinRoom(&self->clvClients[index].conclaveClient, &options);
+
+    return true;
+}
+
+static bool churnPing(void* _self, size_t index)
+{
+    ClvCliSwarm* self = (ClvCliSwarm*)_self;
+    if (!canSend(self, index)) {
+        return false;
+    }
+    clvClientPing(&self->clvClients[index].conclaveClient, 0, true);
+
+    return true;
+}
+
+static const ClvSerializeListRoomsResponseOptions* churnLastRoomList(void* _self, size_t index)
+{
+    const ClvCliSwarm* self = (const ClvCliSwarm*)_self;
+
+    return &self->clvClients[index].conclaveClient.listRoomsResponseOptions;
+}
+
+/// Starts to move all clients between rooms
+/// @param self swarm
+/// @param options join rate, dwell time and which rooms to list
+void clvCliSwarmChurnStart(ClvCliSwarm* self, const ClvCliChurnOptions* options)
+{
+    clvCliChurnStart(&self->churn, options, clvCliClockNowNs());
+}
+
+void clvCliSwarmChurnStop(ClvCliSwarm* self)
+{
+    clvCliChurnStop(&self->churn, clvCliClockNowNs());
+}
+
+/// Sends the churn requests that are due
+/// @param self swarm
+void clvCliSwarmChurnUpdate(ClvCliSwarm* self)
+{
+    ClvCliChurnClients clients;
+    clients.self = self;
+    clients.listRooms = churnListRooms;
+    clients.joinRoom = churnJoinRoom;
+    clients.ping = churnPing;
+    clients.lastRoomList = churnLastRoomList;
+    clvCliChurnUpdate(&self->churn, clvCliClockNowNs(), &clients);
+}
+
+size_t clvCliSwarmChurnTimeUntilUpdate(const ClvCliSwarm* self)
+{
+    return clvCliChurnTimeUntilUpdate(&self->churn, clvCliClockNowNs());
+}
+
+static bool simulatePing(void* _self, size_t index, uint64_t knowledge, bool hasConnectionToOwner)
+{
+    ClvCliSwarm* self = (ClvCliSwarm*)_self;
+    if (!canSend(self, index)) {
+        return false;
+    }
+    clvClientPing(&self->clvClients[index].conclaveClient, knowledge, hasConnectionToOwner);
+
+    return true;
+}
+
+/// Starts the game tick simulation on all clients
+/// @param self swarm
+/// @param options tick rate and ping interval
+void clvCliSwarmSimulateStart(ClvCliSwarm* self, const ClvCliSimulateOptions* options)
+{
+    clvCliSimulateStart(&self->simulate, options, clvCliClockNowNs());
+}
+
+void clvCliSwarmSimulateStop(ClvCliSwarm* self)
+{
+    clvCliSimulateStop(&self->simulate, clvCliClockNowNs());
+}
+
+/// Injects a fault in a part of the simulated clients
+/// @param self swarm
+/// @param options fault, how many and which clients
+void clvCliSwarmSimulateInject(ClvCliSwarm* self, const ClvCliSimulateInjectOptions* options)
+{
+    clvCliSimulateInject(&self->simulate, options, clvCliClockNowNs());
+}
+
+/// Sends the simulation pings that are due
+/// @param self swarm
+void clvCliSwarmSimulateUpdate(ClvCliSwarm* self)
+{
+    clvCliSimulateUpdate(&self->simulate, clvCliClockNowNs(), simulatePing, self);
+}
+
+size_t clvCliSwarmSimulateTimeUntilUpdate(const ClvCliSwarm* self)
+{
+    return clvCliSimulateTimeUntilUpdate(&self->simulate, clvCliClockNowNs());
+}
+
+void clvCliSwarmReportInit(ClvCliSwarmReport* self)
+{
+    self->clientCount = 0;
+    tc_mem_clear_type_n(self->phaseCounts, 3);
+    self->pingResponseCount = 0;
+    self->roomCreateCount = 0;
+    self->roomListCount = 0;
+    self->coalescedCount = 0;
+    self->droppedOwnerObservationCount = 0;
+    for (size_t i = 0; i < ClvCliRequestTypeCount; ++i) {
+        clvCliHistogramInit(&self->latencies[i]);
+    }
+    clvCliLoadReportInit(&self->load);
+    clvCliChurnReportInit(&self->churn);
+    clvCliSimulateReportInit(&self->simulate);
+    clvCliImprintReportInit(&self->imprint);
+}
+
+/// Adds the counters and round trip times of a swarm to the report
+/// @param self report
+/// @param swarm swarm
+void clvCliSwarmReportAdd(ClvCliSwarmReport* self, const ClvCliSwarm* swarm)
+{
+    self->clientCount += swarm->clientCount;
+    for (size_t i = 0; i < 3; ++i) {
+        self->phaseCounts[i] += swarm->phaseCounts[i];
+    }
+    self->pingResponseCount += swarm->pingResponseCount;
+    self->roomCreateCount += swarm->roomCreateCount;
+    self->roomListCount += swarm->roomListCount;
+    self->coalescedCount += swarm->coalescedCount;
+    self->droppedOwnerObservationCount += swarm->droppedOwnerObservationCount;
+    for (size_t i = 0; i < ClvCliRequestTypeCount; ++i) {
+        clvCliHistogramMerge(&self->latencies[i], &swarm->latencies[i]);
+    }
+
+    ClvCliLoadReport load;
+    clvCliLoadReportGet(&swarm->load, &load, clvCliClockNowNs());
+    clvCliLoadReportMerge(&self->load, &load);
+
+    ClvCliChurnReport churn;
+    clvCliChurnReportGet(&swarm->churn, &churn, clvCliClockNowNs());
+    clvCliChurnReportMerge(&self->churn, &churn);
+
+    ClvCliSimulateReport simulate;
+    clvCliSimulateReportGet(&swarm->simulate, &simulate, clvCliClockNowNs());
+    clvCliSimulateReportMerge(&self->simulate, &simulate);
+
+    clvCliImprintReportMerge(&self->imprint, &swarm->imprintCounter.report);
+}
+
+void clvCliSwarmReportMerge(ClvCliSwarmReport* self, const ClvCliSwarmReport* other)
+{
+    self->clientCount += other->clientCount;
+    for (size_t i = 0; i < 3; ++i) {
+        self->phaseCounts[i] += other->phaseCounts[i];
+    }
+    self->pingResponseCount += other->pingResponseCount;
+    self->roomCreateCount += other->roomCreateCount;
+    self->roomListCount += other->roomListCount;
+    self->coalescedCount += other->coalescedCount;
+    self->droppedOwnerObservationCount += other->droppedOwnerObservationCount;
+    for (size_t i = 0; i < ClvCliRequestTypeCount; ++i) {
+        clvCliHistogramMerge(&self->latencies[i], &other->latencies[i]);
+    }
+    clvCliLoadReportMerge(&self->load, &other->load);
+    clvCliChurnReportMerge(&self->churn, &other->churn);
+    clvCliSimulateReportMerge(&self->simulate, &other->simulate);
+    clvCliImprintReportMerge(&self->imprint, &other->imprint);
+}
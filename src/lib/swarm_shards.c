@@ -0,0 +1,585 @@
+/*----------------------------------------------------------------------------------------------------------
+ *  Copyright (c) Peter Bjorklund. All rights reserved. https://github.com/piot/conclave-client-cli
+ *  Licensed under the MIT License. See LICENSE in the project root for license information.
+ *--------------------------------------------------------------------------------------------------------*/
+#if defined TORNADO_OS_LINUX
+#define _GNU_SOURCE // pthread_attr_setaffinity_np()
+#include <sched.h>
+#else
+#define _POSIX_C_SOURCE 200809L
+#endif
+#include <conclave-client-cli/swarm_shards.h>
+#include <signal.h>
+#include <stdio.h>
+#include <unistd.h>
+
+/// How often the shards copy their counters and histograms for the coordinator
+static const MonotonicTimeMs reportIntervalMs = 1000;
+
+/// Owner changes that can be waiting for the coordinator, in each shard
+static const size_t ownerObservationCapacity = 4096;
+
+static size_t onlineCpuCount(void)
+{
+    long count = sysconf(_SC_NPROCESSORS_ONLN);
+
+    return count > 0 ? (size_t)count : 1;
+}
+
+/// Finds the CPUs that the shard threads run on
+/// Starts from the CPUs that the process is allowed to run on, which taskset or a container can
+/// restrict, and leaves the first of them to the coordinator (network) and REPL threads when
+/// there is more than one.
+/// @param cpus set to the CPU indices
+/// @return CPU count, at least one
+static size_t findShardCpus(int cpus[CLV_CLI_SWARM_SHARDS_MAX_CPU_COUNT])
+{
+    size_t count = 0;
+#if defined TORNADO_OS_LINUX
+    cpu_set_t allowed;
+    if (sched_getaffinity(0, sizeof(allowed), &allowed) == 0) {
+        bool isCoordinatorCpu = CPU_COUNT(&allowed) > 1;
+        for (size_t cpu = 0;
+             cpu < (size_t)CPU_SETSIZE && count < CLV_CLI_SWARM_SHARDS_MAX_CPU_COUNT; ++cpu) {
+            if (!CPU_ISSET(cpu, &allowed)) {
+                continue;
+            }
+            if (isCoordinatorCpu) {
+                isCoordinatorCpu = false;
+                continue;
+            }
+            cpus[count++] = (int)cpu;
+        }
+    }
+#endif
+    if (count == 0) {
+        size_t onlineCount = onlineCpuCount();
+        for (; count < onlineCount && count < CLV_CLI_SWARM_SHARDS_MAX_CPU_COUNT; ++count) {
+            cpus[count] = (int)count;
+        }
+    }
+
+    return count;
+}
+
+static void shardDestroy(ClvCliSwarmShard* self)
+{
+    if (self->hasEventLoop) {
+        clvCliEventLoopDestroy(&self->eventLoop);
+        clvCliWakeupDestroy(self->commandWakeupHandle);
+    }
+    clvCliSwarmDestroy(&self->swarm);
+    clvCliSpscRingDestroy(&self->commands);
+    clvCliSpscRingDestroy(&self->ownerObservations);
+    pthread_mutex_destroy(&self->reportMutex);
+}
+
+/// Initializes a shard, and frees everything again if it fails
+/// @return negative on error
+static int shardInit(ClvCliSwarmShard* self, size_t index, int cpuIndex, size_t clientCount,
+    const ClvCliSwarmShardsOptions* options, size_t firstClientIndex, int coordinatorWakeupHandle,
+    Clog log)
+{
+    self->index = index;
+    self->cpuIndex = cpuIndex;
+    self->resendIntervalMs = options->resendIntervalMs;
+    self->lastFullUpdateAt = 0;
+    self->lastReportAt = 0;
+    self->coordinatorWakeupHandle = coordinatorWakeupHandle;
+    self->executedCommandSequence = 0;
+    self->status = 0;
+    self->shouldQuit = 0;
+    self->result = 0;
+    self->hasStarted = false;
+    self->trace = options->trace;
+    self->traceRing = 0;
+    self->log = log;
+    self->hasEventLoop = false;
+    self->commandWakeupHandle = -1;
+    clvCliSwarmReportInit(&self->report);
+
+    if (clvCliSpscRingInit(&self->commands, sizeof(ClvCliCommand), 64) < 0) {
+        return -1;
+    }
+    if (clvCliSpscRingInit(
+            &self->ownerObservations, sizeof(ClvCliOwnerObservation), ownerObservationCapacity)
+        < 0) {
+        clvCliSpscRingDestroy(&self->commands);
+        return -1;
+    }
+
+    if (clvCliSwarmInit(&self->swarm, clientCount, options->firstSecretIndex + firstClientIndex,
+            options->guiseHost, options->guisePort, options->conclaveHost, options->conclavePort,
+            options->imprintOctetsPerClient, log)
+        < 0) {
+        clvCliSpscRingDestroy(&self->ownerObservations);
+        clvCliSpscRingDestroy(&self->commands);
+        return -1;
+    }
+    self->swarm.ownerObservations = &self->ownerObservations;
+    clvCliSwarmReportAdd(&self->report, &self->swarm);
+    pthread_mutex_init(&self->reportMutex, 0);
+
+    self->hasEventLoop = !options->usePolling && clvCliEventLoopInit(&self->eventLoop) >= 0;
+    if (self->hasEventLoop) {
+        self->commandWakeupHandle = clvCliWakeupCreate();
+        if (clvCliEventLoopAdd(
+                &self->eventLoop, self->commandWakeupHandle, ClvCliEventLoopSourceWakeup, 0)
+                < 0
+            || clvCliSwarmAddToEventLoop(&self->swarm, &self->eventLoop) < 0) {
+            shardDestroy(self);
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+static void shardExecuteCommand(ClvCliSwarmShard* self, const ClvCliCommand* command)
+{
+    switch (command->type) {
+        case ClvCliCommandTypePing:
+            clvCliSwarmPing(&self->swarm, command->data.ping.knowledge,
+                command->data.ping.hasConnectionToOwner);
+            break;
+        case ClvCliCommandTypeRoomCreate:
+            clvCliSwarmCreateRoom(&self->swarm, &command->data.roomCreate);
+            break;
+        case ClvCliCommandTypeRoomJoin:
+            clvCliSwarmJoinRoom(&self->swarm, &command->data.roomJoin);
+            break;
+        case ClvCliCommandTypeRoomList:
+            clvCliSwarmListRooms(&self->swarm, &command->data.roomList);
+            break;
+        case ClvCliCommandTypeLoadStart:
+            clvCliSwarmLoadStart(&self->swarm, &command->data.load);
+            break;
+        case ClvCliCommandTypeLoadStop:
+            clvCliSwarmLoadStop(&self->swarm);
+            break;
+        case ClvCliCommandTypeChurnStart:
+            clvCliSwarmChurnStart(&self->swarm, &command->data.churn);
+            break;
+        case ClvCliCommandTypeChurnStop:
+            clvCliSwarmChurnStop(&self->swarm);
+            break;
+        case ClvCliCommandTypeSimulateStart:
+            clvCliSwarmSimulateStart(&self->swarm, &command->data.simulate);
+            break;
+        case ClvCliCommandTypeSimulateStop:
+            clvCliSwarmSimulateStop(&self->swarm);
+            break;
+        case ClvCliCommandTypeSimulateInject:
+            clvCliSwarmSimulateInject(&self->swarm, &command->data.simulateInject);
+            break;
+        case ClvCliCommandTypeRoomWatch:
+        case ClvCliCommandTypeRoomUnwatch:
+        case ClvCliCommandTypeState:
+        case ClvCliCommandTypeStats:
+        case ClvCliCommandTypePerf:
+        case ClvCliCommandTypeChurnReport:
+        case ClvCliCommandTypeSimulateReport:
+        case ClvCliCommandTypeMem:
+            break;
+    }
+}
+
+/// Executes all queued commands
+/// @param self shard
+/// @return the sequence of the last executed command, zero if none
+static uint64_t shardExecuteCommands(ClvCliSwarmShard* self)
+{
+    ClvCliTimeNs startedAt = clvCliTraceBegin(self->traceRing);
+    uint64_t lastSequence = 0;
+    const ClvCliCommand* command;
+    while ((command = (const ClvCliCommand*)clvCliSpscRingReadBegin(&self->commands)) != 0) {
+        shardExecuteCommand(self, command);
+        lastSequence = command->sequence;
+        clvCliSpscRingReadEnd(&self->commands);
+    }
+    clvCliTraceEnd(self->traceRing, "executeCommands", startedAt);
+
+    return lastSequence;
+}
+
+/// Publishes the pending and logged in status, waking the coordinator if it has changed
+/// The command sequence is stored after the status, so the coordinator never sees a command as
+/// executed without the requests it sent.
+static void shardPublishStatus(ClvCliSwarmShard* self, uint64_t executedSequence)
+{
+    uint8_t status = clvCliSwarmIsLoggedIn(&self->swarm) ? CLV_CLI_SWARM_SHARD_LOGGED_IN : 0;
+    for (size_t i = 0; i < ClvCliRequestTypeCount; ++i) {
+        if (clvCliSwarmIsPending(&self->swarm, (ClvCliRequestType)i)) {
+            status |= (uint8_t)(1 << i);
+        }
+    }
+
+    if (status == self->status && executedSequence == 0) {
+        return;
+    }
+
+    __atomic_store_n(&self->status, status, __ATOMIC_RELEASE);
+    if (executedSequence != 0) {
+        __atomic_store_n(&self->executedCommandSequence, executedSequence, __ATOMIC_RELEASE);
+    }
+    clvCliWakeupSignal(self->coordinatorWakeupHandle);
+}
+
+static void shardReportIfNeeded(ClvCliSwarmShard* self, MonotonicTimeMs now)
+{
+    if (now - self->lastReportAt < reportIntervalMs) {
+        return;
+    }
+    self->lastReportAt = now;
+
+    pthread_mutex_lock(&self->reportMutex);
+    clvCliSwarmReportInit(&self->report);
+    clvCliSwarmReportAdd(&self->report, &self->swarm);
+    pthread_mutex_unlock(&self->reportMutex);
+}
+
+static int shardUpdate(ClvCliSwarmShard* self, uint64_t executedSequence)
+{
+    ClvCliEventLoop* loop = &self->eventLoop;
+    clvCliSwarmLoadUpdate(&self->swarm);
+    clvCliSwarmChurnUpdate(&self->swarm);
+    clvCliSwarmSimulateUpdate(&self->swarm);
+
+    MonotonicTimeMs now = monotonicTimeMsNow();
+    bool isResendDue = now - self->lastFullUpdateAt >= (MonotonicTimeMs)self->resendIntervalMs;
+
+    int result = 0;
+    ClvCliTimeNs startedAt = clvCliTraceBegin(self->traceRing);
+    if (self->hasEventLoop && !isResendDue) {
+        for (size_t i = 0; i < loop->readySocketCount && result >= 0; ++i) {
+            result = clvCliSwarmUpdateClient(&self->swarm, loop->readySocketIndices[i], now);
+        }
+        clvCliTraceEnd(self->traceRing, "clvCliSwarmUpdateClient", startedAt);
+    } else {
+        result = clvCliSwarmUpdate(&self->swarm, now);
+        self->lastFullUpdateAt = now;
+        clvCliTraceEnd(self->traceRing, "clvCliSwarmUpdate", startedAt);
+    }
+    if (result < 0) {
+        return result;
+    }
+
+    shardPublishStatus(self, executedSequence);
+    shardReportIfNeeded(self, now);
+
+    return 0;
+}
+
+/// Milliseconds until the load generator, the churn or the simulation has something to send,
+/// at most the resend interval
+static size_t shardTimeUntilUpdate(const ClvCliSwarmShard* self)
+{
+    size_t times[3] = { clvCliSwarmLoadTimeUntilUpdate(&self->swarm),
+        clvCliSwarmChurnTimeUntilUpdate(&self->swarm),
+        clvCliSwarmSimulateTimeUntilUpdate(&self->swarm) };
+    size_t timeUntilUpdate = self->resendIntervalMs;
+    for (size_t i = 0; i < 3; ++i) {
+        if (times[i] < timeUntilUpdate) {
+            timeUntilUpdate = times[i];
+        }
+    }
+
+    return timeUntilUpdate;
+}
+
+static int shardRun(ClvCliSwarmShard* self)
+{
+    if (self->hasEventLoop) {
+        clvCliEventLoopArmTimer(&self->eventLoop, 0);
+    }
+
+    while (!__atomic_load_n(&self->shouldQuit, __ATOMIC_ACQUIRE)) {
+        if (self->hasEventLoop) {
+            ClvCliTimeNs waitStartedAt = clvCliTraceBegin(self->traceRing);
+            int sources = clvCliEventLoopWait(&self->eventLoop);
+            clvCliTraceEnd(self->traceRing, "wait", waitStartedAt);
+            if (sources < 0) {
+                return sources;
+            }
+            if (sources & ClvCliEventLoopSourceWakeup) {
+                clvCliWakeupClear(self->commandWakeupHandle);
+            }
+        }
+
+        uint64_t executedSequence = shardExecuteCommands(self);
+        int result = shardUpdate(self, executedSequence);
+        if (result < 0) {
+            return result;
+        }
+
+        if (self->hasEventLoop) {
+            clvCliEventLoopArmTimer(&self->eventLoop, shardTimeUntilUpdate(self));
+        } else {
+            ClvCliTimeNs sleepStartedAt = clvCliTraceBegin(self->traceRing);
+            clvCliSleepMs(16);
+            clvCliTraceEnd(self->traceRing, "sleep", sleepStartedAt);
+        }
+    }
+
+    return 0;
+}
+
+static void* shardThread(void* _self)
+{
+    ClvCliSwarmShard* self = (ClvCliSwarmShard*)_self;
+
+    char threadName[CLV_CLI_TRACE_THREAD_NAME_OCTETS];
+    snprintf(threadName, sizeof(threadName), "shard %zu", self->index);
+    self->traceRing = clvCliTraceAddThread(self->trace, threadName);
+    int result = shardRun(self);
+    if (result < 0) {
+        CLOG_C_SOFT_ERROR(&self->log, "swarm shard %zu stopped: %d", self->index, result)
+    }
+    __atomic_store_n(&self->result, result, __ATOMIC_RELEASE);
+    clvCliWakeupSignal(self->coordinatorWakeupHandle);
+
+    return 0;
+}
+
+/// Sets the core in the attributes that the thread is created with, so it never runs anywhere else
+static void pinThread(const ClvCliSwarmShard* self, pthread_attr_t* attributes)
+{
+#if defined TORNADO_OS_LINUX
+    if (self->cpuIndex < 0) {
+        return;
+    }
+    cpu_set_t cpus;
+    CPU_ZERO(&cpus);
+    CPU_SET((size_t)self->cpuIndex, &cpus);
+    int result = pthread_attr_setaffinity_np(attributes, sizeof(cpus), &cpus);
+    if (result != 0) {
+        CLOG_C_WARN(&self->log, "could not pin shard %zu to cpu %d: %d", self->index,
+            self->cpuIndex, result)
+    }
+#else
+    (void)self;
+    (void)attributes;
+#endif
+}
+
+/// Splits the swarm into shards of (almost) the same size
+/// The shards are pinned to the CPUs that the process may run on, except one that is left for
+/// the coordinator. Nothing is left to destroy if it fails.
+/// @param self shards
+/// @param options swarm and shard settings
+/// @param coordinatorWakeupHandle signalled when the status of a shard has changed
+/// @param log logging
+/// @return negative on error
+int clvCliSwarmShardsInit(ClvCliSwarmShards* self, const ClvCliSwarmShardsOptions* options,
+    int coordinatorWakeupHandle, Clog log)
+{
+    int cpus[CLV_CLI_SWARM_SHARDS_MAX_CPU_COUNT];
+    size_t cpuCount = findShardCpus(cpus);
+    size_t shardCount = options->shardCount > 0 ? options->shardCount : cpuCount;
+    if (shardCount > options->clientCount) {
+        shardCount = options->clientCount;
+    }
+
+    self->log = log;
+    self->clientCount = options->clientCount;
+    self->shardCount = 0;
+    self->shards = tc_malloc_type_count(ClvCliSwarmShard*, shardCount);
+    if (self->shards == 0) {
+        return -1;
+    }
+
+    size_t firstClientIndex = 0;
+    for (size_t i = 0; i < shardCount; ++i) {
+        size_t clientCount = options->clientCount / shardCount
+            + (i < options->clientCount % shardCount ? 1 : 0);
+        ClvCliSwarmShard* shard = tc_malloc_type(ClvCliSwarmShard);
+        if (shard == 0) {
+            clvCliSwarmShardsDestroy(self);
+            return -1;
+        }
+        int cpuIndex = options->shouldPin ? cpus[i % cpuCount] : -1;
+        if (shardInit(shard, i, cpuIndex, clientCount, options, firstClientIndex,
+                coordinatorWakeupHandle, log)
+            < 0) {
+            tc_free(shard);
+            clvCliSwarmShardsDestroy(self);
+            return -1;
+        }
+        self->shards[i] = shard;
+        self->shardCount++;
+        firstClientIndex += clientCount;
+    }
+
+    CLOG_C_INFO(&self->log, "swarm of %zu clients in %zu shards on %zu cpus",
+        options->clientCount, shardCount, options->shouldPin ? cpuCount : 0)
+
+    return 0;
+}
+
+void clvCliSwarmShardsDestroy(ClvCliSwarmShards* self)
+{
+    for (size_t i = 0; i < self->shardCount; ++i) {
+        shardDestroy(self->shards[i]);
+        tc_free(self->shards[i]);
+    }
+    tc_free(self->shards);
+    self->shards = 0;
+    self->shardCount = 0;
+}
+
+/// Starts a worker thread for each shard, pinned to a core of its own if possible
+/// If a thread can not be started, the threads that were started are stopped again.
+/// @param self shards
+/// @return negative on error
+int clvCliSwarmShardsStart(ClvCliSwarmShards* self)
+{
+    sigset_t blocked;
+    sigset_t previous;
+    sigemptyset(&blocked);
+    sigaddset(&blocked, SIGINT);
+    pthread_sigmask(SIG_BLOCK, &blocked, &previous);
+
+    int result = 0;
+    for (size_t i = 0; i < self->shardCount; ++i) {
+        ClvCliSwarmShard* shard = self->shards[i];
+        pthread_attr_t attributes;
+        pthread_attr_init(&attributes);
+        pinThread(shard, &attributes);
+        int createResult = pthread_create(&shard->thread, &attributes, shardThread, shard);
+        pthread_attr_destroy(&attributes);
+        if (createResult != 0) {
+            CLOG_C_SOFT_ERROR(&self->log, "could not start shard %zu: %d", i, createResult)
+            result = -1;
+            break;
+        }
+        shard->hasStarted = true;
+    }
+
+    pthread_sigmask(SIG_SETMASK, &previous, 0);
+
+    if (result < 0) {
+        clvCliSwarmShardsStop(self);
+    }
+
+    return result;
+}
+
+void clvCliSwarmShardsStop(ClvCliSwarmShards* self)
+{
+    for (size_t i = 0; i < self->shardCount; ++i) {
+        ClvCliSwarmShard* shard = self->shards[i];
+        __atomic_store_n(&shard->shouldQuit, 1, __ATOMIC_RELEASE);
+        clvCliWakeupSignal(shard->commandWakeupHandle);
+    }
+    for (size_t i = 0; i < self->shardCount; ++i) {
+        ClvCliSwarmShard* shard = self->shards[i];
+        if (shard->hasStarted) {
+            pthread_join(shard->thread, 0);
+            shard->hasStarted = false;
+        }
+    }
+}
+
+/// Checks that every shard has room for another command (coordinator thread only)
+/// The coordinator is the only writer, so the room is still there when the command is sent.
+/// @param self shards
+/// @return true if clvCliSwarmShardsSend() reaches all shards
+bool clvCliSwarmShardsHasRoom(ClvCliSwarmShards* self)
+{
+    for (size_t i = 0; i < self->shardCount; ++i) {
+        if (clvCliSpscRingWriteBegin(&self->shards[i]->commands) == 0) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+/// Sends the command to all shards (coordinator thread only)
+/// Check clvCliSwarmShardsHasRoom() first, a shard that is full drops the command.
+/// @param self shards
+/// @param command command
+/// @return number of shards that received the command
+size_t clvCliSwarmShardsSend(ClvCliSwarmShards* self, const ClvCliCommand* command)
+{
+    size_t count = 0;
+    for (size_t i = 0; i < self->shardCount; ++i) {
+        ClvCliSwarmShard* shard = self->shards[i];
+        ClvCliCommand* target = (ClvCliCommand*)clvCliSpscRingWriteBegin(&shard->commands);
+        if (target == 0) {
+            CLOG_C_WARN(&self->log, "shard %zu is busy, command dropped", i)
+            continue;
+        }
+        *target = *command;
+        clvCliSpscRingWriteEnd(&shard->commands);
+        clvCliWakeupSignal(shard->commandWakeupHandle);
+        count++;
+    }
+
+    return count;
+}
+
+/// Merges the latest counters and histograms from all shards (at most a second old)
+/// @param self shards
+/// @param target report to merge into
+void clvCliSwarmShardsMerge(const ClvCliSwarmShards* self, ClvCliSwarmReport* target)
+{
+    for (size_t i = 0; i < self->shardCount; ++i) {
+        ClvCliSwarmShard* shard = self->shards[i];
+        pthread_mutex_lock(&shard->reportMutex);
+        clvCliSwarmReportMerge(target, &shard->report);
+        pthread_mutex_unlock(&shard->reportMutex);
+    }
+}
+
+/// Moves the owner changes that the clients of all shards have seen to the convergence tracker
+/// @param self shards
+/// @param target owner convergence
+void clvCliSwarmShardsDrainOwnerObservations(
+    ClvCliSwarmShards* self, ClvCliOwnerConvergence* target)
+{
+    for (size_t i = 0; i < self->shardCount; ++i) {
+        ClvCliSpscRing* ring = &self->shards[i]->ownerObservations;
+        const ClvCliOwnerObservation* observation;
+        while ((observation = (const ClvCliOwnerObservation*)clvCliSpscRingReadBegin(ring)) != 0) {
+            clvCliOwnerConvergenceAdd(target, observation);
+            clvCliSpscRingReadEnd(ring);
+        }
+    }
+}
+
+/// Combines the status of all shards
+/// @param self shards
+/// @param executedCommandSequence the last command that all shards have executed
+/// @param pendingMask request types that any shard is waiting for
+/// @param isLoggedIn true if all shards are logged in
+/// @return negative if a shard has stopped with an error
+int clvCliSwarmShardsStatus(const ClvCliSwarmShards* self, uint64_t* executedCommandSequence,
+    uint8_t* pendingMask, bool* isLoggedIn)
+{
+    uint64_t sequence = UINT64_MAX;
+    uint8_t pending = 0;
+    bool loggedIn = true;
+
+    for (size_t i = 0; i < self->shardCount; ++i) {
+        ClvCliSwarmShard* shard = self->shards[i];
+        int result = __atomic_load_n(&shard->result, __ATOMIC_ACQUIRE);
+        if (result < 0) {
+            return result;
+        }
+        uint64_t shardSequence
+            = __atomic_load_n(&shard->executedCommandSequence, __ATOMIC_ACQUIRE);
+        uint8_t status = __atomic_load_n(&shard->status, __ATOMIC_ACQUIRE);
+        if (shardSequence < sequence) {
+            sequence = shardSequence;
+        }
+        pending |= (uint8_t)(status & ~CLV_CLI_SWARM_SHARD_LOGGED_IN);
+        loggedIn = loggedIn && (status & CLV_CLI_SWARM_SHARD_LOGGED_IN) != 0;
+    }
+
+    *executedCommandSequence = self->shardCount > 0 ? sequence : 0;
+    *pendingMask = pending;
+    *isLoggedIn = loggedIn;
+
+    return 0;
+}
@@ -0,0 +1,134 @@
+/*----------------------------------------------------------------------------------------------------------
+ *  Copyright (c) Peter Bjorklund. All rights reserved. https://github.com/piot/conclave-client-cli
+ *  Licensed under the MIT License. See LICENSE in the project root for license information.
+ *--------------------------------------------------------------------------------------------------------*/
+#include <clog/clog.h>
+#include <conclave-client-cli/json_writer.h>
+#include <conclave-client-cli/trace.h>
+#include <stdio.h>
+#include <tiny-libc/tiny_libc.h>
+
+int clvCliTraceInit(ClvCliTrace* self)
+{
+    self->ringCount = 0;
+    if (pthread_mutex_init(&self->mutex, 0) != 0) {
+        return -1;
+    }
+
+    return 0;
+}
+
+void clvCliTraceDestroy(ClvCliTrace* self)
+{
+    for (size_t i = 0; i < self->ringCount; ++i) {
+        tc_free(self->rings[i]->spans);
+        tc_free(self->rings[i]);
+    }
+    self->ringCount = 0;
+    pthread_mutex_destroy(&self->mutex);
+}
+
+/// Creates the ring of the calling thread (any thread)
+/// @param self trace, or zero if tracing is disabled
+/// @param threadName shown as the name of the track
+/// @return ring to pass to clvCliTraceEnd(), zero if tracing is disabled or on error
+ClvCliTraceRing* clvCliTraceAddThread(ClvCliTrace* self, const char* threadName)
+{
+    if (self == 0) {
+        return 0;
+    }
+
+    ClvCliTraceRing* ring = tc_malloc_type(ClvCliTraceRing);
+    if (ring == 0) {
+        return 0;
+    }
+    ring->spans = tc_malloc_type_count(ClvCliTraceSpan, CLV_CLI_TRACE_RING_CAPACITY);
+    if (ring->spans == 0) {
+        tc_free(ring);
+        return 0;
+    }
+    ring->writeCount = 0;
+    snprintf(ring->threadName, CLV_CLI_TRACE_THREAD_NAME_OCTETS, "%s", threadName);
+
+    pthread_mutex_lock(&self->mutex);
+    if (self->ringCount == CLV_CLI_TRACE_MAX_THREAD_COUNT) {
+        pthread_mutex_unlock(&self->mutex);
+        CLOG_SOFT_ERROR("trace: too many threads, '%s' is not traced", threadName)
+        tc_free(ring->spans);
+        tc_free(ring);
+        return 0;
+    }
+    ring->threadId = (uint32_t)self->ringCount + 1;
+    self->rings[self->ringCount++] = ring;
+    pthread_mutex_unlock(&self->mutex);
+
+    return ring;
+}
+
+static void writeThreadName(ClvCliJsonWriter* writer, const ClvCliTraceRing* ring)
+{
+    clvCliJsonWriterObjectBegin(writer, 0);
+    clvCliJsonWriterString(writer, "name", "thread_name");
+    clvCliJsonWriterString(writer, "ph", "M");
+    clvCliJsonWriterUInt64(writer, "pid", 1);
+    clvCliJsonWriterUInt64(writer, "tid", ring->threadId);
+    clvCliJsonWriterObjectBegin(writer, "args");
+    clvCliJsonWriterString(writer, "name", ring->threadName);
+    clvCliJsonWriterObjectEnd(writer);
+    clvCliJsonWriterObjectEnd(writer);
+}
+
+/// Writes all spans as complete ("X") events, with microsecond timestamps
+static void writeSpans(ClvCliJsonWriter* writer, const ClvCliTraceRing* ring)
+{
+    uint64_t first = ring->writeCount > CLV_CLI_TRACE_RING_CAPACITY
+        ? ring->writeCount - CLV_CLI_TRACE_RING_CAPACITY
+        : 0;
+    for (uint64_t i = first; i < ring->writeCount; ++i) {
+        const ClvCliTraceSpan* span = &ring->spans[i % CLV_CLI_TRACE_RING_CAPACITY];
+        clvCliJsonWriterObjectBegin(writer, 0);
+        clvCliJsonWriterString(writer, "name", span->name);
+        clvCliJsonWriterString(writer, "ph", "X");
+        clvCliJsonWriterDouble(writer, "ts", (double)span->startedAt / 1000.0);
+        clvCliJsonWriterDouble(writer, "dur", (double)span->duration / 1000.0);
+        clvCliJsonWriterUInt64(writer, "pid", 1);
+        clvCliJsonWriterUInt64(writer, "tid", ring->threadId);
+        clvCliJsonWriterObjectEnd(writer);
+    }
+}
+
+/// Writes the spans of all threads in the Chrome trace event format (Perfetto, chrome://tracing)
+/// All threads that record spans must have stopped.
+/// @param self trace
+/// @param filename file to write
+/// @return negative on error
+int clvCliTraceWrite(const ClvCliTrace* self, const char* filename)
+{
+    FILE* fp = fopen(filename, "w");
+    if (fp == 0) {
+        CLOG_SOFT_ERROR("trace: could not open '%s'", filename)
+        return -1;
+    }
+
+    ClvCliJsonWriter writer;
+    if (clvCliJsonWriterInit(&writer, fp) < 0) {
+        fclose(fp);
+        return -2;
+    }
+
+    clvCliJsonWriterObjectBegin(&writer, 0);
+    clvCliJsonWriterString(&writer, "displayTimeUnit", "ns");
+    clvCliJsonWriterArrayBegin(&writer, "traceEvents");
+    for (size_t i = 0; i < self->ringCount; ++i) {
+        writeThreadName(&writer, self->rings[i]);
+        writeSpans(&writer, self->rings[i]);
+    }
+    clvCliJsonWriterArrayEnd(&writer);
+    clvCliJsonWriterObjectEnd(&writer);
+    clvCliJsonWriterLineEnd(&writer);
+
+    clvCliJsonWriterDestroy(&writer);
+    fclose(fp);
+
+    return 0;
+}
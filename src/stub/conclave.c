@@ -0,0 +1,319 @@
+/*----------------------------------------------------------------------------------------------------------
+ *  Copyright (c) Peter Bjorklund. All rights reserved. https://github.com/piot/conclave-client-cli
+ *  Licensed under the MIT License. See LICENSE in the project root for license information.
+ *--------------------------------------------------------------------------------------------------------*/
+#include <conclave-serialize/commands.h>
+#include <conclave-serialize/serialize.h>
+#include <conclave-serialize/server_in.h>
+#include <conclave-serialize/server_out.h>
+#include <conclave-stub-server/conclave.h>
+#include <conclave-stub-server/guise.h>
+#include <flood/in_stream.h>
+#include <inttypes.h>
+#include <tiny-libc/tiny_libc.h>
+
+int clvStubConclaveInit(ClvStubConclave* self, const ClvStubGuise* guise, size_t roomCapacity,
+    MonotonicTimeMs ownerTimeoutMs, Clog log)
+{
+    self->guise = guise;
+    self->log = log;
+    self->roomCount = 0;
+    self->roomCapacity = roomCapacity;
+    self->ownerTimeoutMs = ownerTimeoutMs;
+    self->rooms = tc_malloc_type_count(ClvStubRoom, roomCapacity);
+    self->userRoomIndex = tc_malloc_type_count(size_t, guise->userCapacity);
+    if (self->rooms == 0 || self->userRoomIndex == 0) {
+        CLOG_C_SOFT_ERROR(&self->log, "could not allocate %zu rooms", roomCapacity)
+        return -1;
+    }
+    tc_mem_clear_type_n(self->userRoomIndex, guise->userCapacity);
+
+    return 0;
+}
+
+void clvStubConclaveDestroy(ClvStubConclave* self)
+{
+    tc_free(self->rooms);
+    tc_free(self->userRoomIndex);
+}
+
+static void removeMember(ClvStubRoom* room, size_t userIndex)
+{
+    for (size_t i = 0; i < room->memberCount; ++i) {
+        if (room->members[i].userIndex != userIndex) {
+            continue;
+        }
+        room->members[i] = room->members[--room->memberCount];
+        if (room->indexOfOwner == i || room->indexOfOwner >= room->memberCount) {
+            room->indexOfOwner = 0;
+            room->term++;
+        }
+        room->version++;
+        return;
+    }
+}
+
+/// Adds the user to the room, leaving the previous room if needed
+/// @return the member index (room connection index), or negative if the room is full
+static int addMember(ClvStubConclave* self, size_t roomIndex, size_t userIndex, MonotonicTimeMs now)
+{
+    ClvStubRoom* room = &self->rooms[roomIndex];
+    size_t previousRoomIndex = self->userRoomIndex[userIndex];
+    if (previousRoomIndex == roomIndex + 1) {
+        for (size_t i = 0; i < room->memberCount; ++i) {
+            if (room->members[i].userIndex == userIndex) {
+                return (int)i;
+            }
+        }
+    }
+    if (previousRoomIndex != 0) {
+        removeMember(&self->rooms[previousRoomIndex - 1], userIndex);
+    }
+    self->userRoomIndex[userIndex] = 0;
+
+    if (room->memberCount == room->maxMemberCount || room->memberCount == CLV_STUB_ROOM_MAX_MEMBERS) {
+        return -1;
+    }
+
+    ClvStubMember* member = &room->members[room->memberCount];
+    member->userIndex = userIndex;
+    member->knowledge = 0;
+    member->hasConnectionToOwner = true;
+    member->lastPingAt = now;
+    room->version++;
+    self->userRoomIndex[userIndex] = roomIndex + 1;
+
+    return (int)room->memberCount++;
+}
+
+/// Moves the ownership to the member with most knowledge if the owner has stopped pinging
+static void electOwnerIfNeeded(ClvStubConclave* self, ClvStubRoom* room, MonotonicTimeMs now)
+{
+    const ClvStubMember* owner = &room->members[room->indexOfOwner];
+    if (now - owner->lastPingAt < self->ownerTimeoutMs) {
+        return;
+    }
+
+    size_t bestIndex = room->indexOfOwner;
+    for (size_t i = 0; i < room->memberCount; ++i) {
+        const ClvStubMember* member = &room->members[i];
+        if (now - member->lastPingAt >= self->ownerTimeoutMs) {
+            continue;
+        }
+        if (bestIndex == room->indexOfOwner
+            || member->knowledge > room->members[bestIndex].knowledge) {
+            bestIndex = i;
+        }
+    }
+
+    if (bestIndex != room->indexOfOwner) {
+        room->indexOfOwner = bestIndex;
+        room->term++;
+        room->version++;
+        CLOG_C_DEBUG(&self->log, "room %u has new owner %zu, term %" PRIu64, room->id, bestIndex,
+            room->term)
+    }
+}
+
+static void fillRoomInfo(const ClvStubConclave* self, const ClvStubRoom* room, ClvSerializeRoomInfo* info)
+{
+    info->roomId = room->id;
+    tc_strcpy(info->roomName, sizeof(info->roomName), room->name);
+    info->ownerUserId = room->memberCount == 0
+        ? 0
+        : self->guise->users[room->members[room->indexOfOwner].userIndex].userId;
+    info->memberCount = (uint8_t)room->memberCount;
+    info->maxMemberCount = room->maxMemberCount;
+    info->externalStateOctetCount = 0;
+    info->applicationId = room->applicationId;
+    info->applicationVersion = room->applicationVersion;
+}
+
+static int onRoomCreate(ClvStubConclave* self, size_t userIndex,
+    const ClvSerializeRoomCreateOptions* options, MonotonicTimeMs now, FldOutStream* response)
+{
+    if (self->roomCount == self->roomCapacity) {
+        CLOG_C_WARN(&self->log, "out of rooms (%zu)", self->roomCapacity)
+        return -1;
+    }
+
+    size_t roomIndex = self->roomCount++;
+    ClvStubRoom* room = &self->rooms[roomIndex];
+    room->id = (ClvSerializeRoomId)(roomIndex + 1);
+    tc_strcpy(room->name, sizeof(room->name), options->name);
+    room->applicationId = options->applicationId;
+    room->applicationVersion = options->applicationVersion;
+    room->maxMemberCount = options->maxNumberOfPlayers;
+    room->memberCount = 0;
+    room->indexOfOwner = 0;
+    room->term = 1;
+    room->version = 0;
+
+    int connectionIndex = addMember(self, roomIndex, userIndex, now);
+    if (connectionIndex < 0) {
+        return connectionIndex;
+    }
+
+    return clvSerializeServerOutRoomCreate(
+        response, room->id, (ClvSerializeRoomConnectionIndex)connectionIndex);
+}
+
+static int onRoomJoin(ClvStubConclave* self, size_t userIndex,
+    const ClvSerializeRoomJoinOptions* options, MonotonicTimeMs now, FldOutStream* response)
+{
+    size_t roomIndex = (size_t)options->roomIdToJoin - 1;
+    if (options->roomIdToJoin == 0 || roomIndex >= self->roomCount) {
+        CLOG_C_WARN(&self->log, "no room %u", options->roomIdToJoin)
+        return -1;
+    }
+
+    int connectionIndex = addMember(self, roomIndex, userIndex, now);
+    if (connectionIndex < 0) {
+        CLOG_C_WARN(&self->log, "room %u is full", options->roomIdToJoin)
+        return connectionIndex;
+    }
+
+    return clvSerializeServerOutRoomJoin(response, options->roomIdToJoin,
+        (ClvSerializeRoomConnectionIndex)connectionIndex);
+}
+
+static int onListRooms(
+    ClvStubConclave* self, const ClvSerializeListRoomsOptions* options, FldOutStream* response)
+{
+    static ClvSerializeListRoomsResponseOptions list;
+    const size_t maxRoomInfoCount = sizeof(list.roomInfos) / sizeof(list.roomInfos[0]);
+
+    list.roomInfoCount = 0;
+    for (size_t i = 0; i < self->roomCount && list.roomInfoCount < options->maximumCount
+         && list.roomInfoCount < maxRoomInfoCount;
+         ++i) {
+        const ClvStubRoom* room = &self->rooms[i];
+        if (room->applicationId != options->applicationId || room->memberCount == 0) {
+            continue;
+        }
+        fillRoomInfo(self, room, &list.roomInfos[list.roomInfoCount++]);
+    }
+
+    return clvSerializeServerOutListRooms(response, &list);
+}
+
+static int onPing(ClvStubConclave* self, size_t userIndex, ClvSerializeKnowledge knowledge,
+    bool hasConnectionToOwner, MonotonicTimeMs now, FldOutStream* response)
+{
+    ClvSerializePingResponseOptions ping;
+    ping.term = 0;
+    ping.version = 0;
+    ping.roomInfo.memberCount = 0;
+    ping.roomInfo.indexOfOwner = 0;
+
+    size_t roomIndex = self->userRoomIndex[userIndex];
+    if (roomIndex != 0) {
+        ClvStubRoom* room = &self->rooms[roomIndex - 1];
+        for (size_t i = 0; i < room->memberCount; ++i) {
+            ClvStubMember* member = &room->members[i];
+            if (member->userIndex == userIndex) {
+                member->knowledge = knowledge;
+                member->hasConnectionToOwner = hasConnectionToOwner;
+                member->lastPingAt = now;
+            }
+        }
+        electOwnerIfNeeded(self, room, now);
+
+        const size_t maxMemberCount
+            = sizeof(ping.roomInfo.members) / sizeof(ping.roomInfo.members[0]);
+        ping.term = room->term;
+        ping.version = room->version;
+        ping.roomInfo.indexOfOwner = (uint8_t)room->indexOfOwner;
+        for (size_t i = 0; i < room->memberCount && i < maxMemberCount; ++i) {
+            ping.roomInfo.members[i] = self->guise->users[room->members[i].userIndex].userId;
+            ping.roomInfo.memberCount++;
+        }
+    }
+
+    return clvSerializeServerOutPing(response, &ping);
+}
+
+static int findUser(const ClvStubConclave* self, ClvSerializeUserSessionId userSessionId)
+{
+    int userIndex = clvStubGuiseFindUser(self->guise, userSessionId);
+    if (userIndex < 0) {
+        CLOG_C_WARN(&self->log, "unknown user session %" PRIX64, userSessionId)
+    }
+
+    return userIndex;
+}
+
+/// Handles a datagram received on the conclave port
+/// @param self conclave
+/// @param data datagram
+/// @param octetCount size of datagram
+/// @param now current time
+/// @param response where the response is written
+/// @return negative on error
+int clvStubConclaveFeed(ClvStubConclave* self, const uint8_t* data, size_t octetCount,
+    MonotonicTimeMs now, FldOutStream* response)
+{
+    FldInStream inStream;
+    fldInStreamInit(&inStream, data, octetCount);
+
+    uint8_t cmd;
+    clvSerializeReadCommand(&inStream, &cmd, "stub conclave");
+
+    ClvSerializeUserSessionId userSessionId;
+
+    switch (cmd) {
+        case clvSerializeCmdLogin: {
+            if (clvSerializeServerInLogin(&inStream, &userSessionId) < 0
+                || findUser(self, userSessionId) < 0) {
+                return -1;
+            }
+            return clvSerializeServerOutLogin(response, userSessionId);
+        }
+        case clvSerializeCmdRoomCreate: {
+            ClvSerializeRoomCreateOptions options;
+            if (clvSerializeServerInRoomCreate(&inStream, &userSessionId, &options) < 0) {
+                return -1;
+            }
+            int userIndex = findUser(self, userSessionId);
+            if (userIndex < 0) {
+                return userIndex;
+            }
+            return onRoomCreate(self, (size_t)userIndex, &options, now, response);
+        }
+        case clvSerializeCmdRoomJoin: {
+            ClvSerializeRoomJoinOptions options;
+            if (clvSerializeServerInRoomJoin(&inStream, &userSessionId, &options) < 0) {
+                return -1;
+            }
+            int userIndex = findUser(self, userSessionId);
+            if (userIndex < 0) {
+                return userIndex;
+            }
+            return onRoomJoin(self, (size_t)userIndex, &options, now, response);
+        }
+        case clvSerializeCmdListRooms: {
+            ClvSerializeListRoomsOptions options;
+            if (clvSerializeServerInListRooms(&inStream, &userSessionId, &options) < 0
+                || findUser(self, userSessionId) < 0) {
+                return -1;
+            }
+            return onListRooms(self, &options, response);
+        }
+        case clvSerializeCmdPing: {
+            ClvSerializeKnowledge knowledge;
+            bool hasConnectionToOwner;
+            if (clvSerializeServerInPing(&inStream, &userSessionId, &knowledge, &hasConnectionToOwner)
+                < 0) {
+                return -1;
+            }
+            int userIndex = findUser(self, userSessionId);
+            if (userIndex < 0) {
+                return userIndex;
+            }
+            return onPing(self, (size_t)userIndex, knowledge, hasConnectionToOwner, now, response);
+        }
+        default:
+            CLOG_C_SOFT_ERROR(&self->log, "unknown conclave command %02X", cmd)
+            return -1;
+    }
+}
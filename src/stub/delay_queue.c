@@ -0,0 +1,87 @@
+/*----------------------------------------------------------------------------------------------------------
+ *  Copyright (c) Peter Bjorklund. All rights reserved. https://github.com/piot/conclave-client-cli
+ *  Licensed under the MIT License. See LICENSE in the project root for license information.
+ *--------------------------------------------------------------------------------------------------------*/
+#include <conclave-stub-server/delay_queue.h>
+#include <tiny-libc/tiny_libc.h>
+
+int clvStubDelayQueueInit(ClvStubDelayQueue* self, size_t capacity)
+{
+    self->datagrams = tc_malloc_type_count(ClvStubDelayedDatagram, capacity);
+    self->count = 0;
+    self->capacity = capacity;
+    self->overflowCount = 0;
+
+    return self->datagrams == 0 ? -1 : 0;
+}
+
+void clvStubDelayQueueDestroy(ClvStubDelayQueue* self)
+{
+    tc_free(self->datagrams);
+    self->datagrams = 0;
+}
+
+static void swap(ClvStubDelayQueue* self, size_t a, size_t b)
+{
+    ClvStubDelayedDatagram temp = self->datagrams[a];
+    self->datagrams[a] = self->datagrams[b];
+    self->datagrams[b] = temp;
+}
+
+/// Reserves a datagram that should be sent at the specified time
+/// The caller fills in the socket, address and octets before any other queue operation.
+/// @param self delay queue
+/// @param sendAt when to send the datagram
+/// @return the datagram to fill in, or NULL if the queue is full
+ClvStubDelayedDatagram* clvStubDelayQueuePush(ClvStubDelayQueue* self, ClvCliTimeNs sendAt)
+{
+    if (self->count == self->capacity) {
+        self->overflowCount++;
+        return 0;
+    }
+
+    size_t index = self->count++;
+    self->datagrams[index].sendAt = sendAt;
+    while (index > 0) {
+        size_t parent = (index - 1) / 2;
+        if (self->datagrams[parent].sendAt <= self->datagrams[index].sendAt) {
+            break;
+        }
+        swap(self, parent, index);
+        index = parent;
+    }
+
+    return &self->datagrams[index];
+}
+
+const ClvStubDelayedDatagram* clvStubDelayQueuePeek(const ClvStubDelayQueue* self)
+{
+    return self->count == 0 ? 0 : &self->datagrams[0];
+}
+
+void clvStubDelayQueuePop(ClvStubDelayQueue* self)
+{
+    if (self->count == 0) {
+        return;
+    }
+
+    self->datagrams[0] = self->datagrams[--self->count];
+    size_t index = 0;
+    while (true) {
+        size_t smallest = index;
+        size_t left = index * 2 + 1;
+        size_t right = left + 1;
+        if (left < self->count && self->datagrams[left].sendAt < self->datagrams[smallest].sendAt) {
+            smallest = left;
+        }
+        if (right < self->count
+            && self->datagrams[right].sendAt < self->datagrams[smallest].sendAt) {
+            smallest = right;
+        }
+        if (smallest == index) {
+            break;
+        }
+        swap(self, index, smallest);
+        index = smallest;
+    }
+}
@@ -0,0 +1,136 @@
+/*----------------------------------------------------------------------------------------------------------
+ *  Copyright (c) Peter Bjorklund. All rights reserved. https://github.com/piot/conclave-client-cli
+ *  Licensed under the MIT License. See LICENSE in the project root for license information.
+ *--------------------------------------------------------------------------------------------------------*/
+#include <conclave-stub-server/guise.h>
+#include <flood/in_stream.h>
+#include <guise-serialize/commands.h>
+#include <guise-serialize/serialize.h>
+#include <guise-serialize/server_in.h>
+#include <guise-serialize/server_out.h>
+#include <inttypes.h>
+#include <tiny-libc/tiny_libc.h>
+
+int clvStubGuiseInit(ClvStubGuise* self, size_t userCapacity, Clog log)
+{
+    self->log = log;
+    self->userCount = 0;
+    self->userCapacity = userCapacity;
+    self->lookupCapacity = 1;
+    while (self->lookupCapacity < userCapacity * 2) {
+        self->lookupCapacity *= 2;
+    }
+
+    self->users = tc_malloc_type_count(ClvStubGuiseUser, userCapacity);
+    self->userIndexLookup = tc_malloc_type_count(uint32_t, self->lookupCapacity);
+    if (self->users == 0 || self->userIndexLookup == 0) {
+        CLOG_C_SOFT_ERROR(&self->log, "could not allocate %zu users", userCapacity)
+        return -1;
+    }
+    tc_mem_clear_type_n(self->userIndexLookup, self->lookupCapacity);
+
+    return 0;
+}
+
+void clvStubGuiseDestroy(ClvStubGuise* self)
+{
+    tc_free(self->users);
+    tc_free(self->userIndexLookup);
+}
+
+static size_t lookupSlot(const ClvStubGuise* self, GuiseSerializeUserId userId)
+{
+    size_t mask = self->lookupCapacity - 1;
+    size_t slot = (size_t)(userId * 0x9E3779B97F4A7C15u) & mask;
+
+    while (self->userIndexLookup[slot] != 0
+        && self->users[self->userIndexLookup[slot] - 1].userId != userId) {
+        slot = (slot + 1) & mask;
+    }
+
+    return slot;
+}
+
+/// Finds the user, or creates it, so that resent logins get the same user session
+static int findOrCreateUser(ClvStubGuise* self, GuiseSerializeUserId userId)
+{
+    size_t slot = lookupSlot(self, userId);
+    if (self->userIndexLookup[slot] != 0) {
+        return (int)self->userIndexLookup[slot] - 1;
+    }
+
+    if (self->userCount == self->userCapacity) {
+        CLOG_C_WARN(&self->log, "out of users (%zu)", self->userCapacity)
+        return -1;
+    }
+
+    size_t index = self->userCount++;
+    ClvStubGuiseUser* user = &self->users[index];
+    user->userId = userId;
+    user->userSessionId = ((GuiseSerializeUserSessionId)index << 32) | (userId & 0xffffffff);
+    self->userIndexLookup[slot] = (uint32_t)index + 1;
+
+    CLOG_C_VERBOSE(&self->log, "user %" PRIX64 " logged in", userId)
+
+    return (int)index;
+}
+
+/// Finds the user that the user session was handed out to
+/// @param self guise
+/// @param userSessionId user session
+/// @return user index or negative if the session is not known
+int clvStubGuiseFindUser(const ClvStubGuise* self, GuiseSerializeUserSessionId userSessionId)
+{
+    size_t index = (size_t)(userSessionId >> 32);
+    if (index >= self->userCount || self->users[index].userSessionId != userSessionId) {
+        return -1;
+    }
+
+    return (int)index;
+}
+
+/// Handles a datagram received on the guise port
+/// @param self guise
+/// @param data datagram
+/// @param octetCount size of datagram
+/// @param response where the response is written
+/// @return negative on error
+int clvStubGuiseFeed(
+    ClvStubGuise* self, const uint8_t* data, size_t octetCount, FldOutStream* response)
+{
+    FldInStream inStream;
+    fldInStreamInit(&inStream, data, octetCount);
+
+    uint8_t cmd;
+    guiseSerializeReadCommand(&inStream, &cmd, "stub guise");
+
+    switch (cmd) {
+        case guiseSerializeCmdChallenge: {
+            GuiseSerializeClientNonce nonce;
+            if (guiseSerializeServerInChallenge(&inStream, &nonce) < 0) {
+                return -1;
+            }
+            GuiseSerializeServerChallenge challenge = nonce ^ 0x5A5A5A5A5A5A5A5Au;
+            return guiseSerializeServerOutChallenge(response, nonce, challenge);
+        }
+        case guiseSerializeCmdLogin: {
+            GuiseSerializeClientNonce nonce;
+            GuiseSerializeServerChallenge challenge;
+            GuiseSerializeUserId userId;
+            GuiseSerializePasswordHashWithChallenge passwordHash;
+            if (guiseSerializeServerInLogin(&inStream, &nonce, &challenge, &userId, &passwordHash)
+                < 0) {
+                return -1;
+            }
+            int index = findOrCreateUser(self, userId);
+            if (index < 0) {
+                return index;
+            }
+            return guiseSerializeServerOutLogin(
+                response, nonce, self->users[index].userSessionId);
+        }
+        default:
+            CLOG_C_SOFT_ERROR(&self->log, "unknown guise command %02X", cmd)
+            return -1;
+    }
+}
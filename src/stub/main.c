@@ -0,0 +1,307 @@
+/*----------------------------------------------------------------------------------------------------------
+ *  Copyright (c) Peter Bjorklund. All rights reserved. https://github.com/piot/conclave-client-cli
+ *  Licensed under the MIT License. See LICENSE in the project root for license information.
+ *--------------------------------------------------------------------------------------------------------*/
+#define _POSIX_C_SOURCE 200809L
+#include <arpa/inet.h>
+#include <clog/clog.h>
+#include <clog/console.h>
+#include <conclave-client-cli/clock.h>
+#include <conclave-stub-server/conclave.h>
+#include <conclave-stub-server/delay_queue.h>
+#include <conclave-stub-server/guise.h>
+#include <errno.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/socket.h>
+#include <tiny-libc/tiny_libc.h>
+#include <unistd.h>
+
+clog_config g_clog;
+
+static volatile sig_atomic_t g_quit = 0;
+
+static void interruptHandler(int sig)
+{
+    (void)sig;
+
+    g_quit = 1;
+}
+
+typedef struct StubOptions {
+    uint16_t guisePort;
+    uint16_t conclavePort;
+    size_t delayMs;
+    size_t jitterMs;
+    unsigned int lossPercent;
+    uint64_t seed;
+    size_t userCapacity;
+    size_t roomCapacity;
+    MonotonicTimeMs ownerTimeoutMs;
+} StubOptions;
+
+typedef struct Stub {
+    int guiseSocket;
+    int conclaveSocket;
+    ClvStubGuise guise;
+    ClvStubConclave conclave;
+    ClvStubDelayQueue delayQueue;
+    StubOptions options;
+    uint64_t random;
+    size_t receivedCount;
+    size_t sentCount;
+    size_t droppedCount;
+    Clog log;
+} Stub;
+
+static int parseArguments(StubOptions* options, int argc, char** argv)
+{
+    options->guisePort = 27004;
+    options->conclavePort = 27003;
+    options->delayMs = 0;
+    options->jitterMs = 0;
+    options->lossPercent = 0;
+    options->seed = 1;
+    options->userCapacity = 16 * 1024;
+    options->roomCapacity = 4 * 1024;
+    options->ownerTimeoutMs = 1500;
+
+    for (int i = 1; i < argc; ++i) {
+        const char* arg = argv[i];
+        if (i + 1 >= argc) {
+            printf("missing value for '%s'\n", arg);
+            return -1;
+        }
+        long value = atol(argv[++i]);
+        if (value < 0) {
+            printf("negative value for '%s'\n", arg);
+            return -1;
+        }
+        if (tc_str_equal(arg, "--guise-port")) {
+            options->guisePort = (uint16_t)value;
+        } else if (tc_str_equal(arg, "--conclave-port")) {
+            options->conclavePort = (uint16_t)value;
+        } else if (tc_str_equal(arg, "--delay")) {
+            options->delayMs = (size_t)value;
+        } else if (tc_str_equal(arg, "--jitter")) {
+            options->jitterMs = (size_t)value;
+        } else if (tc_str_equal(arg, "--loss")) {
+            options->lossPercent = (unsigned int)value;
+        } else if (tc_str_equal(arg, "--seed")) {
+            options->seed = (uint64_t)value;
+        } else if (tc_str_equal(arg, "--users")) {
+            options->userCapacity = (size_t)value;
+        } else if (tc_str_equal(arg, "--rooms")) {
+            options->roomCapacity = (size_t)value;
+        } else if (tc_str_equal(arg, "--owner-timeout")) {
+            options->ownerTimeoutMs = (MonotonicTimeMs)value;
+        } else {
+            printf("unknown option '%s'\n", arg);
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+/// xorshift64, so runs with the same seed drop the same responses
+static uint64_t nextRandom(Stub* self)
+{
+    self->random ^= self->random << 13;
+    self->random ^= self->random >> 7;
+    self->random ^= self->random << 17;
+
+    return self->random;
+}
+
+static int openSocket(uint16_t port)
+{
+    int handle = socket(AF_INET, SOCK_DGRAM, 0);
+    if (handle < 0) {
+        CLOG_SOFT_ERROR("could not create socket: %d", errno)
+        return -1;
+    }
+
+    struct sockaddr_in address;
+    tc_mem_clear_type(&address);
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_ANY);
+    address.sin_port = htons(port);
+
+    if (bind(handle, (const struct sockaddr*)&address, sizeof(address)) < 0) {
+        CLOG_SOFT_ERROR("could not bind port %d: %d", port, errno)
+        close(handle);
+        return -2;
+    }
+
+    return handle;
+}
+
+/// Queues the response, or drops it to simulate packet loss
+static void scheduleResponse(Stub* self, int socketHandle, const struct sockaddr_in* address,
+    const FldOutStream* response, ClvCliTimeNs now)
+{
+    if (self->options.lossPercent > 0 && nextRandom(self) % 100 < self->options.lossPercent) {
+        self->droppedCount++;
+        return;
+    }
+
+    size_t delayMs = self->options.delayMs;
+    if (self->options.jitterMs > 0) {
+        delayMs += (size_t)(nextRandom(self) % (self->options.jitterMs + 1));
+    }
+
+    ClvStubDelayedDatagram* datagram
+        = clvStubDelayQueuePush(&self->delayQueue, now + (ClvCliTimeNs)delayMs * 1000000u);
+    if (datagram == 0) {
+        self->droppedCount++;
+        return;
+    }
+    datagram->socketHandle = socketHandle;
+    datagram->address = *address;
+    tc_memcpy_octets(datagram->octets, response->octets, response->pos);
+    datagram->octetCount = response->pos;
+}
+
+static void sendDueResponses(Stub* self, ClvCliTimeNs now)
+{
+    const ClvStubDelayedDatagram* datagram;
+    while ((datagram = clvStubDelayQueuePeek(&self->delayQueue)) != 0 && datagram->sendAt <= now) {
+        ssize_t result = sendto(datagram->socketHandle, datagram->octets, datagram->octetCount, 0,
+            (const struct sockaddr*)&datagram->address, sizeof(datagram->address));
+        if (result < 0) {
+            CLOG_C_WARN(&self->log, "could not send: %d", errno)
+        } else {
+            self->sentCount++;
+        }
+        clvStubDelayQueuePop(&self->delayQueue);
+    }
+}
+
+static void receive(Stub* self, int socketHandle, bool isGuise)
+{
+    uint8_t buf[CLV_STUB_DATAGRAM_MAX_OCTETS];
+    struct sockaddr_in address;
+    socklen_t addressSize = sizeof(address);
+
+    ssize_t octetCount = recvfrom(
+        socketHandle, buf, sizeof(buf), 0, (struct sockaddr*)&address, &addressSize);
+    if (octetCount <= 0) {
+        return;
+    }
+    self->receivedCount++;
+
+    uint8_t responseBuf[CLV_STUB_DATAGRAM_MAX_OCTETS];
+    FldOutStream response;
+    fldOutStreamInit(&response, responseBuf, sizeof(responseBuf));
+
+    int result = isGuise
+        ? clvStubGuiseFeed(&self->guise, buf, (size_t)octetCount, &response)
+        : clvStubConclaveFeed(
+            &self->conclave, buf, (size_t)octetCount, monotonicTimeMsNow(), &response);
+    if (result < 0 || response.pos == 0) {
+        return;
+    }
+
+    scheduleResponse(self, socketHandle, &address, &response, clvCliClockNowNs());
+}
+
+static int timeUntilNextResponseMs(const Stub* self, ClvCliTimeNs now)
+{
+    const ClvStubDelayedDatagram* datagram = clvStubDelayQueuePeek(&self->delayQueue);
+    if (datagram == 0) {
+        return 1000;
+    }
+    if (datagram->sendAt <= now) {
+        return 0;
+    }
+
+    return (int)((datagram->sendAt - now + 999999u) / 1000000u);
+}
+
+int main(int argc, char** argv)
+{
+    g_clog.log = clog_console;
+    g_clog.level = CLOG_TYPE_VERBOSE;
+
+    signal(SIGINT, interruptHandler);
+
+    static Stub stub;
+    if (parseArguments(&stub.options, argc, argv) < 0) {
+        printf("usage: conclave-stub-server [--guise-port 27004] [--conclave-port 27003] "
+               "[--delay ms] [--jitter ms] [--loss percent] [--seed n] [--users n] [--rooms n] "
+               "[--owner-timeout ms]\n");
+        return -1;
+    }
+
+    stub.log.config = &g_clog;
+    stub.log.constantPrefix = "stub";
+    stub.random = stub.options.seed == 0 ? 1 : stub.options.seed;
+    stub.receivedCount = 0;
+    stub.sentCount = 0;
+    stub.droppedCount = 0;
+
+    Clog guiseLog;
+    guiseLog.config = &g_clog;
+    guiseLog.constantPrefix = "stubGuise";
+
+    Clog conclaveLog;
+    conclaveLog.config = &g_clog;
+    conclaveLog.constantPrefix = "stubConclave";
+
+    if (clvStubGuiseInit(&stub.guise, stub.options.userCapacity, guiseLog) < 0
+        || clvStubConclaveInit(&stub.conclave, &stub.guise, stub.options.roomCapacity,
+               stub.options.ownerTimeoutMs, conclaveLog)
+            < 0
+        || clvStubDelayQueueInit(&stub.delayQueue, 64 * 1024) < 0) {
+        return -1;
+    }
+
+    stub.guiseSocket = openSocket(stub.options.guisePort);
+    stub.conclaveSocket = openSocket(stub.options.conclavePort);
+    if (stub.guiseSocket < 0 || stub.conclaveSocket < 0) {
+        return -1;
+    }
+
+    CLOG_C_INFO(&stub.log, "listening on guise:%d conclave:%d delay:%zu+-%zu ms loss:%u%%",
+        stub.options.guisePort, stub.options.conclavePort, stub.options.delayMs,
+        stub.options.jitterMs, stub.options.lossPercent)
+
+    struct pollfd handles[2];
+    handles[0].fd = stub.guiseSocket;
+    handles[0].events = POLLIN;
+    handles[1].fd = stub.conclaveSocket;
+    handles[1].events = POLLIN;
+
+    while (!g_quit) {
+        int readyCount
+            = poll(handles, 2, timeUntilNextResponseMs(&stub, clvCliClockNowNs()));
+        if (readyCount < 0 && errno != EINTR) {
+            CLOG_C_SOFT_ERROR(&stub.log, "poll failed: %d", errno)
+            break;
+        }
+        if (readyCount > 0) {
+            if (handles[0].revents & POLLIN) {
+                receive(&stub, stub.guiseSocket, true);
+            }
+            if (handles[1].revents & POLLIN) {
+                receive(&stub, stub.conclaveSocket, false);
+            }
+        }
+        sendDueResponses(&stub, clvCliClockNowNs());
+    }
+
+    CLOG_C_INFO(&stub.log, "received:%zu sent:%zu dropped:%zu", stub.receivedCount,
+        stub.sentCount, stub.droppedCount)
+
+    close(stub.guiseSocket);
+    close(stub.conclaveSocket);
+    clvStubDelayQueueDestroy(&stub.delayQueue);
+    clvStubConclaveDestroy(&stub.conclave);
+    clvStubGuiseDestroy(&stub.guise);
+
+    return 0;
+}
@@ -0,0 +1,18 @@
+/*----------------------------------------------------------------------------------------------------------
+ *  Copyright (c) Peter Bjorklund. All rights reserved. https://github.com/piot/conclave-client-cli
+ *  Licensed under the MIT License. See LICENSE in the project root for license information.
+ *--------------------------------------------------------------------------------------------------------*/
+#ifndef CONCLAVE_CLIENT_CLI_TEST_CHECK_H
+#define CONCLAVE_CLIENT_CLI_TEST_CHECK_H
+
+#include <stdio.h>
+#include <stdlib.h>
+
+/// Like assert(), but also checked in release builds, where NDEBUG is defined
+#define CLV_CLI_TEST_CHECK(condition)                                                              \
+    if (!(condition)) {                                                                            \
+        fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #condition);              \
+        exit(1);                                                                                   \
+    }
+
+#endif
@@ -0,0 +1,41 @@
+/*----------------------------------------------------------------------------------------------------------
+ *  Copyright (c) Peter Bjorklund. All rights reserved. https://github.com/piot/conclave-client-cli
+ *  Licensed under the MIT License. See LICENSE in the project root for license information.
+ *--------------------------------------------------------------------------------------------------------*/
+#include "check.h"
+#include <conclave-stub-server/delay_queue.h>
+
+/// Datagrams come out in send time order, whatever order they were pushed in
+static void testOrder(void)
+{
+    ClvStubDelayQueue queue;
+    CLV_CLI_TEST_CHECK(clvStubDelayQueueInit(&queue, 8) == 0)
+    CLV_CLI_TEST_CHECK(clvStubDelayQueuePeek(&queue) == 0)
+
+    static const ClvCliTimeNs sendTimes[] = { 50, 10, 80, 30, 70, 20, 60, 40 };
+    for (size_t i = 0; i < sizeof(sendTimes) / sizeof(sendTimes[0]); ++i) {
+        ClvStubDelayedDatagram* datagram = clvStubDelayQueuePush(&queue, sendTimes[i]);
+        CLV_CLI_TEST_CHECK(datagram != 0)
+        datagram->octetCount = i;
+    }
+    CLV_CLI_TEST_CHECK(clvStubDelayQueuePush(&queue, 90) == 0)
+    CLV_CLI_TEST_CHECK(queue.overflowCount == 1)
+
+    for (ClvCliTimeNs expected = 10; expected <= 80; expected += 10) {
+        const ClvStubDelayedDatagram* datagram = clvStubDelayQueuePeek(&queue);
+        CLV_CLI_TEST_CHECK(datagram != 0)
+        CLV_CLI_TEST_CHECK(datagram->sendAt == expected)
+        CLV_CLI_TEST_CHECK(sendTimes[datagram->octetCount] == expected)
+        clvStubDelayQueuePop(&queue);
+    }
+    CLV_CLI_TEST_CHECK(clvStubDelayQueuePeek(&queue) == 0)
+
+    clvStubDelayQueueDestroy(&queue);
+}
+
+int main(void)
+{
+    testOrder();
+
+    return 0;
+}
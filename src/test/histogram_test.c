@@ -0,0 +1,54 @@
+/*----------------------------------------------------------------------------------------------------------
+ *  Copyright (c) Peter Bjorklund. All rights reserved. https://github.com/piot/conclave-client-cli
+ *  Licensed under the MIT License. See LICENSE in the project root for license information.
+ *--------------------------------------------------------------------------------------------------------*/
+#include "check.h"
+#include <conclave-client-cli/histogram.h>
+#include <stdbool.h>
+
+/// @return true if value is within the relative error of the buckets from expected
+static bool isClose(uint64_t value, uint64_t expected)
+{
+    uint64_t difference = value > expected ? value - expected : expected - value;
+
+    return difference * 32 <= expected;
+}
+
+static void testPercentiles(void)
+{
+    static ClvCliHistogram histogram;
+    clvCliHistogramInit(&histogram);
+    CLV_CLI_TEST_CHECK(clvCliHistogramPercentile(&histogram, 50.0) == 0)
+    CLV_CLI_TEST_CHECK(clvCliHistogramMean(&histogram) == 0)
+
+    for (uint64_t value = 1; value <= 100000; ++value) {
+        clvCliHistogramAdd(&histogram, value);
+    }
+    CLV_CLI_TEST_CHECK(histogram.count == 100000)
+    CLV_CLI_TEST_CHECK(histogram.min == 1)
+    CLV_CLI_TEST_CHECK(histogram.max == 100000)
+    CLV_CLI_TEST_CHECK(clvCliHistogramMean(&histogram) == 50000)
+    CLV_CLI_TEST_CHECK(isClose(clvCliHistogramPercentile(&histogram, 50.0), 50000))
+    CLV_CLI_TEST_CHECK(isClose(clvCliHistogramPercentile(&histogram, 99.0), 99000))
+    CLV_CLI_TEST_CHECK(clvCliHistogramPercentile(&histogram, 100.0) == 100000)
+
+    // Small values have a bucket each
+    static ClvCliHistogram small;
+    clvCliHistogramInit(&small);
+    clvCliHistogramAdd(&small, 3);
+    clvCliHistogramAdd(&small, 7);
+    CLV_CLI_TEST_CHECK(clvCliHistogramPercentile(&small, 50.0) == 3)
+    CLV_CLI_TEST_CHECK(clvCliHistogramPercentile(&small, 100.0) == 7)
+
+    clvCliHistogramMerge(&histogram, &small);
+    CLV_CLI_TEST_CHECK(histogram.count == 100002)
+    CLV_CLI_TEST_CHECK(histogram.min == 1)
+    CLV_CLI_TEST_CHECK(histogram.max == 100000)
+}
+
+int main(void)
+{
+    testPercentiles();
+
+    return 0;
+}
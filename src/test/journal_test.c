@@ -0,0 +1,49 @@
+/*----------------------------------------------------------------------------------------------------------
+ *  Copyright (c) Peter Bjorklund. All rights reserved. https://github.com/piot/conclave-client-cli
+ *  Licensed under the MIT License. See LICENSE in the project root for license information.
+ *--------------------------------------------------------------------------------------------------------*/
+#include "check.h"
+#include <clog/clog.h>
+#include <clog/console.h>
+#include <conclave-client-cli/journal.h>
+
+clog_config g_clog;
+
+/// Entries keep their sequence number and address when the journal grows past a chunk
+static void testAppend(void)
+{
+    ClvCliJournal journal;
+    clvCliJournalInit(&journal);
+    CLV_CLI_TEST_CHECK(clvCliJournalCount(&journal) == 0)
+
+    const ClvCliJournalEntry* firstEntry = 0;
+    uint64_t entryCount = CLV_CLI_JOURNAL_CHUNK_ENTRY_COUNT + 1;
+    for (uint64_t i = 1; i <= entryCount; ++i) {
+        ClvCliJournalEntry* entry = clvCliJournalAppendBegin(&journal);
+        CLV_CLI_TEST_CHECK(entry != 0)
+        entry->time = i * 10;
+        entry->type = ClvCliJournalEntryTypePingResponse;
+        CLV_CLI_TEST_CHECK(clvCliJournalAppendEnd(&journal) == i)
+        if (i == 1) {
+            firstEntry = entry;
+        }
+    }
+
+    CLV_CLI_TEST_CHECK(journal.chunkCount == 2)
+    CLV_CLI_TEST_CHECK(clvCliJournalCount(&journal) == entryCount)
+    CLV_CLI_TEST_CHECK(clvCliJournalGet(&journal, 1) == firstEntry)
+    CLV_CLI_TEST_CHECK(clvCliJournalGet(&journal, entryCount)->time == entryCount * 10)
+    CLV_CLI_TEST_CHECK(journal.droppedCount == 0)
+
+    clvCliJournalDestroy(&journal);
+}
+
+int main(void)
+{
+    g_clog.log = clog_console;
+    g_clog.level = CLOG_TYPE_WARN;
+
+    testAppend();
+
+    return 0;
+}
@@ -0,0 +1,110 @@
+/*----------------------------------------------------------------------------------------------------------
+ *  Copyright (c) Peter Bjorklund. All rights reserved. https://github.com/piot/conclave-client-cli
+ *  Licensed under the MIT License. See LICENSE in the project root for license information.
+ *--------------------------------------------------------------------------------------------------------*/
+#include "check.h"
+#include <clog/clog.h>
+#include <clog/console.h>
+#include <conclave-client-cli/json_writer.h>
+#include <stdbool.h>
+#include <string.h>
+
+clog_config g_clog;
+
+/// @return true if the buffered output is exactly expected
+static bool isWritten(const ClvCliJsonWriter* writer, const char* expected)
+{
+    size_t length = strlen(expected);
+
+    return writer->pos == length && memcmp(writer->octets, expected, length) == 0;
+}
+
+static void testLine(void)
+{
+    FILE* fp = tmpfile();
+    CLV_CLI_TEST_CHECK(fp != 0)
+    ClvCliJsonWriter writer;
+    CLV_CLI_TEST_CHECK(clvCliJsonWriterInit(&writer, fp) == 0)
+
+    clvCliJsonWriterObjectBegin(&writer, 0);
+    clvCliJsonWriterString(&writer, "name", "a\"b\n");
+    clvCliJsonWriterUInt64(&writer, "count", 42);
+    clvCliJsonWriterInt64(&writer, "delta", -7);
+    clvCliJsonWriterDouble(&writer, "ms", 1.5);
+    clvCliJsonWriterArrayBegin(&writer, "flags");
+    clvCliJsonWriterBool(&writer, 0, true);
+    clvCliJsonWriterBool(&writer, 0, false);
+    clvCliJsonWriterArrayEnd(&writer);
+    clvCliJsonWriterObjectEnd(&writer);
+    clvCliJsonWriterLineEnd(&writer);
+    CLV_CLI_TEST_CHECK(isWritten(&writer,
+        "{\"name\":\"a\\\"b\\u000a\",\"count\":42,\"delta\":-7,\"ms\":1.500,"
+        "\"flags\":[true,false]}\n"))
+    CLV_CLI_TEST_CHECK(writer.lineCount == 1)
+
+    // The next line starts without a comma
+    clvCliJsonWriterObjectBegin(&writer, 0);
+    clvCliJsonWriterObjectEnd(&writer);
+    clvCliJsonWriterLineEnd(&writer);
+    size_t octetCount = writer.pos;
+
+    clvCliJsonWriterFlush(&writer);
+    CLV_CLI_TEST_CHECK(writer.pos == 0)
+    CLV_CLI_TEST_CHECK(ftell(fp) == (long)octetCount)
+
+    clvCliJsonWriterDestroy(&writer);
+    fclose(fp);
+}
+
+typedef struct Collected {
+    char octets[64];
+    size_t count;
+    size_t writeCount;
+} Collected;
+
+static void collect(void* _self, const char* octets, size_t count)
+{
+    Collected* self = (Collected*)_self;
+    CLV_CLI_TEST_CHECK(self->count + count <= sizeof(self->octets))
+    memcpy(self->octets + self->count, octets, count);
+    self->count += count;
+    self->writeCount++;
+}
+
+static void testOutput(void)
+{
+    Collected collected;
+    collected.count = 0;
+    collected.writeCount = 0;
+    ClvCliJsonWriterOutput output;
+    output.self = &collected;
+    output.write = collect;
+    ClvCliJsonWriter writer;
+    CLV_CLI_TEST_CHECK(clvCliJsonWriterInitOutput(&writer, &output) == 0)
+
+    clvCliJsonWriterObjectBegin(&writer, 0);
+    clvCliJsonWriterUInt64(&writer, "id", 7);
+    clvCliJsonWriterObjectEnd(&writer);
+    clvCliJsonWriterLineEnd(&writer);
+    CLV_CLI_TEST_CHECK(collected.writeCount == 0)
+
+    // The buffered lines are handed over at once
+    clvCliJsonWriterFlush(&writer);
+    CLV_CLI_TEST_CHECK(collected.writeCount == 1)
+    CLV_CLI_TEST_CHECK(collected.count == 9 && memcmp(collected.octets, "{\"id\":7}\n", 9) == 0)
+    CLV_CLI_TEST_CHECK(writer.pos == 0)
+
+    clvCliJsonWriterDestroy(&writer);
+    CLV_CLI_TEST_CHECK(collected.writeCount == 1)
+}
+
+int main(void)
+{
+    g_clog.log = clog_console;
+    g_clog.level = CLOG_TYPE_WARN;
+
+    testLine();
+    testOutput();
+
+    return 0;
+}
@@ -0,0 +1,73 @@
+/*----------------------------------------------------------------------------------------------------------
+ *  Copyright (c) Peter Bjorklund. All rights reserved. https://github.com/piot/conclave-client-cli
+ *  Licensed under the MIT License. See LICENSE in the project root for license information.
+ *--------------------------------------------------------------------------------------------------------*/
+#include "check.h"
+#include <clog/clog.h>
+#include <clog/console.h>
+#include <conclave-client-cli/out_chain.h>
+
+clog_config g_clog;
+
+/// Reserves, fills in and commits a stream of octetCount octets, all set to value
+static void writeOctets(ClvCliOutChain* chain, size_t octetCount, uint8_t value)
+{
+    FldOutStream stream;
+    CLV_CLI_TEST_CHECK(clvCliOutChainReserve(chain, &stream, octetCount) == 0)
+    for (size_t i = 0; i < octetCount; ++i) {
+        CLV_CLI_TEST_CHECK(fldOutStreamWriteUInt8(&stream, value) == 0)
+    }
+    clvCliOutChainCommit(chain, &stream);
+}
+
+/// Chunks double up to the maximum, and a reservation that does not fit in the current chunk
+/// continues in a following chunk without moving what was already written
+static void testGrowth(void)
+{
+    ClvCliOutChain chain;
+    clvCliOutChainInit(&chain);
+
+    writeOctets(&chain, 1000, 1);
+    CLV_CLI_TEST_CHECK(chain.chunkCount == 1)
+    CLV_CLI_TEST_CHECK(chain.first->capacity == CLV_CLI_OUT_CHAIN_FIRST_CHUNK_OCTETS)
+    const uint8_t* firstOctets = chain.first->octets;
+
+    writeOctets(&chain, CLV_CLI_OUT_CHAIN_FIRST_CHUNK_OCTETS, 2);
+    CLV_CLI_TEST_CHECK(chain.chunkCount == 2)
+    CLV_CLI_TEST_CHECK(chain.first->octets == firstOctets)
+    CLV_CLI_TEST_CHECK(chain.first->count == 1000)
+    CLV_CLI_TEST_CHECK(chain.first->next->capacity == CLV_CLI_OUT_CHAIN_FIRST_CHUNK_OCTETS * 2)
+    CLV_CLI_TEST_CHECK(chain.first->next->octets[0] == 2)
+    CLV_CLI_TEST_CHECK(chain.octetCount == 1000 + CLV_CLI_OUT_CHAIN_FIRST_CHUNK_OCTETS)
+
+    // A reservation above the maximum chunk size gets a chunk of its own size
+    size_t hugeOctets = CLV_CLI_OUT_CHAIN_MAX_CHUNK_OCTETS + 1;
+    writeOctets(&chain, hugeOctets, 3);
+    CLV_CLI_TEST_CHECK(chain.chunkCount == 3)
+    CLV_CLI_TEST_CHECK(chain.current->capacity == hugeOctets)
+    size_t peakOctets = chain.octetCount;
+    CLV_CLI_TEST_CHECK(chain.peakOctets == peakOctets)
+
+    // Clear keeps the chunks, and the next output starts in the first chunk again
+    size_t capacity = clvCliOutChainCapacity(&chain);
+    clvCliOutChainClear(&chain);
+    CLV_CLI_TEST_CHECK(chain.octetCount == 0)
+    writeOctets(&chain, 10, 4);
+    CLV_CLI_TEST_CHECK(chain.current == chain.first)
+    CLV_CLI_TEST_CHECK(chain.first->octets[0] == 4)
+    CLV_CLI_TEST_CHECK(clvCliOutChainCapacity(&chain) == capacity)
+    CLV_CLI_TEST_CHECK(chain.peakOctets == peakOctets)
+
+    clvCliOutChainDestroy(&chain);
+    CLV_CLI_TEST_CHECK(chain.first == 0)
+}
+
+int main(void)
+{
+    g_clog.log = clog_console;
+    g_clog.level = CLOG_TYPE_WARN;
+
+    testGrowth();
+
+    return 0;
+}
@@ -0,0 +1,94 @@
+/*----------------------------------------------------------------------------------------------------------
+ *  Copyright (c) Peter Bjorklund. All rights reserved. https://github.com/piot/conclave-client-cli
+ *  Licensed under the MIT License. See LICENSE in the project root for license information.
+ *--------------------------------------------------------------------------------------------------------*/
+#include "check.h"
+#include <clog/clog.h>
+#include <clog/console.h>
+#include <conclave-client-cli/owner_convergence.h>
+
+clog_config g_clog;
+
+static void observe(ClvCliOwnerConvergence* convergence, ClvCliTimeNs time, ClvSerializeTerm term,
+    ClvSerializeUserId owner)
+{
+    ClvCliOwnerObservation observation;
+    observation.time = time;
+    observation.term = term;
+    observation.owner = owner;
+    observation.roomId = 1;
+    observation.memberCount = 3;
+    clvCliOwnerConvergenceAdd(convergence, &observation);
+}
+
+/// The shards are drained one at a time, so a later shard can add an earlier observation
+static void testOutOfOrder(void)
+{
+    static ClvCliOwnerConvergence convergence;
+    CLV_CLI_TEST_CHECK(clvCliOwnerConvergenceInit(&convergence) == 0)
+
+    // The first term and owner of a room is not a migration
+    observe(&convergence, 100000, 1, 10);
+    observe(&convergence, 110000, 1, 10);
+    observe(&convergence, 120000, 1, 10);
+    CLV_CLI_TEST_CHECK(convergence.report.migrationCount == 0)
+    CLV_CLI_TEST_CHECK(convergence.report.convergenceLatencies.count == 0)
+
+    observe(&convergence, 2000000, 2, 20);
+    observe(&convergence, 1500000, 2, 20);
+    observe(&convergence, 1800000, 2, 20);
+
+    ClvCliOwnerConvergenceReport report;
+    clvCliOwnerConvergenceReportGet(&convergence, &report);
+    CLV_CLI_TEST_CHECK(report.roomCount == 1)
+    CLV_CLI_TEST_CHECK(report.migrationCount == 1)
+    CLV_CLI_TEST_CHECK(report.convergedCount == 1)
+    CLV_CLI_TEST_CHECK(report.pendingCount == 0)
+    CLV_CLI_TEST_CHECK(report.convergenceLatencies.count == 1)
+    CLV_CLI_TEST_CHECK(report.convergenceLatencies.max == 500)
+
+    clvCliOwnerConvergenceDestroy(&convergence);
+}
+
+/// A newer term before all members agree supersedes the migration, and an older term is stale
+static void testSupersededAndStale(void)
+{
+    static ClvCliOwnerConvergence convergence;
+    CLV_CLI_TEST_CHECK(clvCliOwnerConvergenceInit(&convergence) == 0)
+
+    observe(&convergence, 1000, 1, 10);
+    observe(&convergence, 2000, 2, 20);
+    observe(&convergence, 3000, 3, 30);
+    CLV_CLI_TEST_CHECK(convergence.report.migrationCount == 2)
+    CLV_CLI_TEST_CHECK(convergence.report.supersededCount == 1)
+
+    observe(&convergence, 2500, 2, 20);
+    CLV_CLI_TEST_CHECK(convergence.report.staleCount == 1)
+
+    ClvCliOwnerConvergenceReport report;
+    clvCliOwnerConvergenceReportGet(&convergence, &report);
+    CLV_CLI_TEST_CHECK(report.pendingCount == 1)
+    CLV_CLI_TEST_CHECK(report.convergedCount == 0)
+
+    // The stale observation is not counted as one of the members that agree
+    observe(&convergence, 3100, 3, 30);
+    clvCliOwnerConvergenceReportGet(&convergence, &report);
+    CLV_CLI_TEST_CHECK(report.pendingCount == 1)
+    observe(&convergence, 3200, 3, 30);
+    clvCliOwnerConvergenceReportGet(&convergence, &report);
+    CLV_CLI_TEST_CHECK(report.pendingCount == 0)
+    CLV_CLI_TEST_CHECK(report.convergedCount == 1)
+
+    clvCliOwnerConvergenceDestroy(&convergence);
+}
+
+int main(void)
+{
+    g_clog.log = clog_console;
+    g_clog.level = CLOG_TYPE_WARN;
+
+    testOutOfOrder();
+    testSupersededAndStale();
+
+    return 0;
+}
@@ -0,0 +1,107 @@
+/*----------------------------------------------------------------------------------------------------------
+ *  Copyright (c) Peter Bjorklund. All rights reserved. https://github.com/piot/conclave-client-cli
+ *  Licensed under the MIT License. See LICENSE in the project root for license information.
+ *--------------------------------------------------------------------------------------------------------*/
+#include "check.h"
+#include <clog/clog.h>
+#include <clog/console.h>
+#include <conclave-client-cli/render.h>
+#include <string.h>
+
+clog_config g_clog;
+
+/// Reads back everything that has been written to fp
+/// @return octet count
+static size_t readBack(FILE* fp, char* target, size_t maxOctetCount)
+{
+    rewind(fp);
+    size_t octetCount = fread(target, 1, maxOctetCount, fp);
+    rewind(fp);
+
+    return octetCount;
+}
+
+static void writeEntry(ClvCliRender* render, const char* text)
+{
+    clvCliRenderEntryBegin(render);
+    clvCliRenderWrite(render, text);
+    clvCliRenderEntryEnd(render);
+}
+
+/// The second and third update are the same as the first, and shown as a count on its first line
+static void testRepeat(void)
+{
+    FILE* fp = tmpfile();
+    CLV_CLI_TEST_CHECK(fp != 0)
+    ClvCliRender render;
+    CLV_CLI_TEST_CHECK(clvCliRenderInit(&render, fp, 0) == 0)
+
+    writeEntry(&render, "first\n");
+    writeEntry(&render, "room 1\nmembers 2\n");
+    writeEntry(&render, "room 1\nmembers 2\n");
+    writeEntry(&render, "room 1\nmembers 2\n");
+    writeEntry(&render, "last\n");
+    CLV_CLI_TEST_CHECK(render.coalescedCount == 2)
+    clvCliRenderFlush(&render, 1);
+
+    static const char expected[] = "first\nroom 1 x3\nmembers 2\nlast\n";
+    char output[64];
+    size_t octetCount = readBack(fp, output, sizeof(output));
+    CLV_CLI_TEST_CHECK(octetCount == sizeof(expected) - 1)
+    CLV_CLI_TEST_CHECK(memcmp(output, expected, octetCount) == 0)
+    CLV_CLI_TEST_CHECK(render.frameCount == 1)
+
+    clvCliRenderDestroy(&render);
+    fclose(fp);
+}
+
+/// A frame can use the whole buffer, with the largest entry written last
+static void testFull(void)
+{
+    FILE* fp = tmpfile();
+    CLV_CLI_TEST_CHECK(fp != 0)
+    ClvCliRender render;
+    CLV_CLI_TEST_CHECK(clvCliRenderInit(&render, fp, 0) == 0)
+
+    static char text[CLV_CLI_RENDER_MAX_ENTRY_OCTETS];
+    size_t entryOctetCount = 1000;
+    size_t entryCount
+        = (CLV_CLI_RENDER_CAPACITY - CLV_CLI_RENDER_MAX_ENTRY_OCTETS) / entryOctetCount;
+    size_t totalOctetCount = 0;
+    for (size_t i = 0; i < entryCount; ++i) {
+        memset(text, 'a' + (int)(i % 26), entryOctetCount - 1);
+        text[entryOctetCount - 1] = '\n';
+        text[entryOctetCount] = '\0';
+        writeEntry(&render, text);
+        totalOctetCount += entryOctetCount;
+    }
+
+    size_t lastOctetCount = CLV_CLI_RENDER_MAX_ENTRY_OCTETS - 1024;
+    memset(text, 'z', lastOctetCount - 1);
+    text[lastOctetCount - 1] = '\n';
+    text[lastOctetCount] = '\0';
+    writeEntry(&render, text);
+    totalOctetCount += lastOctetCount;
+    CLV_CLI_TEST_CHECK(render.frameCount == 0)
+    CLV_CLI_TEST_CHECK(render.pos == totalOctetCount)
+
+    clvCliRenderFlush(&render, 1);
+    static char output[CLV_CLI_RENDER_CAPACITY + 1];
+    size_t octetCount = readBack(fp, output, sizeof(output));
+    CLV_CLI_TEST_CHECK(octetCount == totalOctetCount)
+    CLV_CLI_TEST_CHECK(output[0] == 'a' && output[octetCount - 2] == 'z')
+
+    clvCliRenderDestroy(&render);
+    fclose(fp);
+}
+
+int main(void)
+{
+    g_clog.log = clog_console;
+    g_clog.level = CLOG_TYPE_WARN;
+
+    testRepeat();
+    testFull();
+
+    return 0;
+}
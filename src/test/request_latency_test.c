@@ -0,0 +1,55 @@
+/*----------------------------------------------------------------------------------------------------------
+ *  Copyright (c) Peter Bjorklund. All rights reserved. https://github.com/piot/conclave-client-cli
+ *  Licensed under the MIT License. See LICENSE in the project root for license information.
+ *--------------------------------------------------------------------------------------------------------*/
+#include "check.h"
+#include <conclave-client-cli/request_latency.h>
+
+static const ClvCliTimeNs timeout = 1000;
+
+/// A lost response no longer keeps the type pending, and the next response is matched to the
+/// request that it answers
+static void testExpire(void)
+{
+    static ClvCliRequestLatency latency;
+    clvCliRequestLatencyInit(&latency);
+
+    clvCliRequestLatencySent(&latency, ClvCliRequestTypePing, 100, 1);
+    clvCliRequestLatencySent(&latency, ClvCliRequestTypePing, 200, 2);
+    CLV_CLI_TEST_CHECK(clvCliRequestLatencyIsPending(&latency, ClvCliRequestTypePing))
+
+    uint64_t correlationId = 0;
+    CLV_CLI_TEST_CHECK(
+        !clvCliRequestLatencyExpire(&latency, ClvCliRequestTypePing, 1099, timeout, &correlationId))
+    CLV_CLI_TEST_CHECK(
+        clvCliRequestLatencyExpire(&latency, ClvCliRequestTypePing, 1100, timeout, &correlationId))
+    CLV_CLI_TEST_CHECK(correlationId == 1)
+    CLV_CLI_TEST_CHECK(
+        !clvCliRequestLatencyExpire(&latency, ClvCliRequestTypePing, 1100, timeout, &correlationId))
+    CLV_CLI_TEST_CHECK(latency.lostCount == 1)
+    CLV_CLI_TEST_CHECK(clvCliRequestLatencyIsPending(&latency, ClvCliRequestTypePing))
+
+    ClvCliTimeNs roundTrip;
+    CLV_CLI_TEST_CHECK(
+        clvCliRequestLatencyReceived(&latency, ClvCliRequestTypePing, 1150, &roundTrip) == 2)
+    CLV_CLI_TEST_CHECK(roundTrip == 950)
+    CLV_CLI_TEST_CHECK(!clvCliRequestLatencyIsPending(&latency, ClvCliRequestTypePing))
+
+    // Only the type of the lost request is affected
+    clvCliRequestLatencySent(&latency, ClvCliRequestTypeRoomList, 2000, 3);
+    CLV_CLI_TEST_CHECK(
+        !clvCliRequestLatencyExpire(&latency, ClvCliRequestTypePing, 5000, timeout, &correlationId))
+    CLV_CLI_TEST_CHECK(clvCliRequestLatencyExpire(
+        &latency, ClvCliRequestTypeRoomList, 5000, timeout, &correlationId))
+    CLV_CLI_TEST_CHECK(correlationId == 3)
+    CLV_CLI_TEST_CHECK(!clvCliRequestLatencyIsPending(&latency, ClvCliRequestTypeRoomList))
+    CLV_CLI_TEST_CHECK(latency.lostCount == 2)
+    CLV_CLI_TEST_CHECK(latency.unmatchedCount == 0)
+}
+
+int main(void)
+{
+    testExpire();
+
+    return 0;
+}
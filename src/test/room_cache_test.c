@@ -0,0 +1,116 @@
+/*----------------------------------------------------------------------------------------------------------
+ *  Copyright (c) Peter Bjorklund. All rights reserved. https://github.com/piot/conclave-client-cli
+ *  Licensed under the MIT License. See LICENSE in the project root for license information.
+ *--------------------------------------------------------------------------------------------------------*/
+#include "check.h"
+#include <clog/clog.h>
+#include <clog/console.h>
+#include <conclave-client-cli/room_cache.h>
+#include <tiny-libc/tiny_libc.h>
+
+clog_config g_clog;
+
+static void addRoom(ClvSerializeListRoomsResponseOptions* roomList, ClvSerializeRoomId roomId,
+    const char* name, ClvSerializeApplicationId applicationId, uint8_t memberCount)
+{
+    ClvSerializeRoomInfo* roomInfo = &roomList->roomInfos[roomList->roomInfoCount++];
+    tc_mem_clear_type(roomInfo);
+    roomInfo->roomId = roomId;
+    tc_strcpy(roomInfo->roomName, sizeof(roomInfo->roomName), name);
+    roomInfo->applicationId = applicationId;
+    roomInfo->memberCount = memberCount;
+    roomInfo->maxMemberCount = 8;
+}
+
+/// Responses are merged, and every index finds the rooms in its own order
+static void testMergeAndQuery(void)
+{
+    ClvCliRoomCache cache;
+    CLV_CLI_TEST_CHECK(clvCliRoomCacheInit(&cache) == 0)
+
+    ClvSerializeListRoomsResponseOptions roomList;
+    roomList.roomInfoCount = 0;
+    addRoom(&roomList, 3, "beta", 42, 6);
+    addRoom(&roomList, 1, "alpha", 42, 2);
+    addRoom(&roomList, 2, "alps", 7, 1);
+    clvCliRoomCacheMerge(&cache, &roomList, 1000);
+
+    // A response only has some rooms, so room 1 is kept when it is not listed
+    roomList.roomInfoCount = 0;
+    addRoom(&roomList, 3, "beta", 42, 1);
+    clvCliRoomCacheMerge(&cache, &roomList, 2000);
+    CLV_CLI_TEST_CHECK(cache.count == 3)
+    CLV_CLI_TEST_CHECK(cache.mergeCount == 2)
+
+    const ClvCliRoomCacheEntry* entry = clvCliRoomCacheFind(&cache, 3);
+    CLV_CLI_TEST_CHECK(entry != 0)
+    CLV_CLI_TEST_CHECK(entry->roomInfo.memberCount == 1)
+    CLV_CLI_TEST_CHECK(entry->firstSeenAt == 1000 && entry->lastSeenAt == 2000)
+    CLV_CLI_TEST_CHECK(clvCliRoomCacheFind(&cache, 4) == 0)
+
+    const ClvCliRoomCacheEntry* results[8];
+    ClvCliRoomCacheQuery query;
+    tc_mem_clear_type(&query);
+
+    query.namePrefix = "alp";
+    size_t count
+        = clvCliRoomCacheQuery(&cache, &query, ClvCliRoomCacheIndexName, 2000, results, 8);
+    CLV_CLI_TEST_CHECK(count == 2)
+    CLV_CLI_TEST_CHECK(results[0]->roomInfo.roomId == 1 && results[1]->roomInfo.roomId == 2)
+
+    query.namePrefix = 0;
+    query.hasApplicationId = true;
+    query.applicationId = 42;
+    count = clvCliRoomCacheQuery(
+        &cache, &query, ClvCliRoomCacheIndexApplicationId, 2000, results, 8);
+    CLV_CLI_TEST_CHECK(count == 2)
+    CLV_CLI_TEST_CHECK(results[0]->roomInfo.roomId == 1 && results[1]->roomInfo.roomId == 3)
+
+    // Most free slots first, the update of room 3 has moved it in the index
+    query.hasApplicationId = false;
+    query.minimumFreeSlots = 6;
+    count = clvCliRoomCacheQuery(&cache, &query, ClvCliRoomCacheIndexFreeSlots, 2000, results, 8);
+    CLV_CLI_TEST_CHECK(count == 3)
+    CLV_CLI_TEST_CHECK(results[0]->roomInfo.roomId == 2 && results[1]->roomInfo.roomId == 3)
+    CLV_CLI_TEST_CHECK(results[2]->roomInfo.roomId == 1)
+
+    query.minimumFreeSlots = 0;
+    query.maximumAge = 500;
+    count = clvCliRoomCacheQuery(&cache, &query, ClvCliRoomCacheIndexRoomId, 2000, results, 8);
+    CLV_CLI_TEST_CHECK(count == 1)
+    CLV_CLI_TEST_CHECK(results[0]->roomInfo.roomId == 3)
+
+    clvCliRoomCacheDestroy(&cache);
+}
+
+/// The room that was seen longest ago is evicted when the cache is full
+static void testEviction(void)
+{
+    ClvCliRoomCache cache;
+    CLV_CLI_TEST_CHECK(clvCliRoomCacheInit(&cache) == 0)
+
+    ClvSerializeListRoomsResponseOptions roomList;
+    for (ClvCliTimeNs time = 1; time <= CLV_CLI_ROOM_CACHE_CAPACITY + 1; ++time) {
+        roomList.roomInfoCount = 0;
+        addRoom(&roomList, (ClvSerializeRoomId)time, "room", 42, 0);
+        clvCliRoomCacheMerge(&cache, &roomList, time);
+    }
+    CLV_CLI_TEST_CHECK(cache.count == CLV_CLI_ROOM_CACHE_CAPACITY)
+    CLV_CLI_TEST_CHECK(cache.evictedCount == 1)
+    CLV_CLI_TEST_CHECK(clvCliRoomCacheFind(&cache, 1) == 0)
+    CLV_CLI_TEST_CHECK(clvCliRoomCacheFind(&cache, 2) != 0)
+    CLV_CLI_TEST_CHECK(clvCliRoomCacheFind(&cache, CLV_CLI_ROOM_CACHE_CAPACITY + 1) != 0)
+
+    clvCliRoomCacheDestroy(&cache);
+}
+
+int main(void)
+{
+    g_clog.log = clog_console;
+    g_clog.level = CLOG_TYPE_WARN;
+
+    testMergeAndQuery();
+    testEviction();
+
+    return 0;
+}
@@ -0,0 +1,78 @@
+/*----------------------------------------------------------------------------------------------------------
+ *  Copyright (c) Peter Bjorklund. All rights reserved. https://github.com/piot/conclave-client-cli
+ *  Licensed under the MIT License. See LICENSE in the project root for license information.
+ *--------------------------------------------------------------------------------------------------------*/
+#include "check.h"
+#include <conclave-client-cli/room_list_diff.h>
+#include <tiny-libc/tiny_libc.h>
+
+static void addRoom(ClvSerializeListRoomsResponseOptions* roomList, ClvSerializeRoomId roomId,
+    uint8_t memberCount, ClvSerializeUserId ownerUserId)
+{
+    ClvSerializeRoomInfo* roomInfo = &roomList->roomInfos[roomList->roomInfoCount++];
+    tc_mem_clear_type(roomInfo);
+    roomInfo->roomId = roomId;
+    roomInfo->memberCount = memberCount;
+    roomInfo->maxMemberCount = 8;
+    roomInfo->ownerUserId = ownerUserId;
+}
+
+/// Rooms are added, removed and changed in room id order, whatever order the list is in
+static void testChanges(void)
+{
+    ClvCliRoomListDiff diff;
+    clvCliRoomListDiffInit(&diff);
+    ClvCliRoomChange changes[CLV_CLI_ROOM_LIST_DIFF_CAPACITY];
+
+    ClvSerializeListRoomsResponseOptions roomList;
+    roomList.roomInfoCount = 0;
+    addRoom(&roomList, 3, 1, 30);
+    addRoom(&roomList, 1, 1, 10);
+    addRoom(&roomList, 2, 1, 20);
+    size_t changeCount
+        = clvCliRoomListDiffUpdate(&diff, &roomList, changes, CLV_CLI_ROOM_LIST_DIFF_CAPACITY);
+    CLV_CLI_TEST_CHECK(changeCount == 3)
+    for (size_t i = 0; i < changeCount; ++i) {
+        CLV_CLI_TEST_CHECK(changes[i].type == ClvCliRoomChangeTypeAdded)
+        CLV_CLI_TEST_CHECK(changes[i].roomInfo.roomId == i + 1)
+    }
+
+    // The same list has no changes
+    changeCount
+        = clvCliRoomListDiffUpdate(&diff, &roomList, changes, CLV_CLI_ROOM_LIST_DIFF_CAPACITY);
+    CLV_CLI_TEST_CHECK(changeCount == 0)
+
+    roomList.roomInfoCount = 0;
+    addRoom(&roomList, 4, 1, 40);
+    addRoom(&roomList, 3, 2, 31);
+    addRoom(&roomList, 1, 1, 10);
+    changeCount
+        = clvCliRoomListDiffUpdate(&diff, &roomList, changes, CLV_CLI_ROOM_LIST_DIFF_CAPACITY);
+    CLV_CLI_TEST_CHECK(changeCount == 3)
+
+    CLV_CLI_TEST_CHECK(changes[0].type == ClvCliRoomChangeTypeRemoved)
+    CLV_CLI_TEST_CHECK(changes[0].roomInfo.roomId == 2)
+
+    CLV_CLI_TEST_CHECK(changes[1].type == ClvCliRoomChangeTypeChanged)
+    CLV_CLI_TEST_CHECK(changes[1].roomInfo.roomId == 3)
+    CLV_CLI_TEST_CHECK(
+        changes[1].changedMask == (CLV_CLI_ROOM_CHANGED_MEMBERS | CLV_CLI_ROOM_CHANGED_OWNER))
+    CLV_CLI_TEST_CHECK(changes[1].previous.memberCount == 1)
+    CLV_CLI_TEST_CHECK(changes[1].roomInfo.memberCount == 2)
+
+    CLV_CLI_TEST_CHECK(changes[2].type == ClvCliRoomChangeTypeAdded)
+    CLV_CLI_TEST_CHECK(changes[2].roomInfo.roomId == 4)
+
+    // Changes that do not fit are not returned, but the list is still kept
+    roomList.roomInfoCount = 0;
+    changeCount = clvCliRoomListDiffUpdate(&diff, &roomList, changes, 1);
+    CLV_CLI_TEST_CHECK(changeCount == 1)
+    CLV_CLI_TEST_CHECK(diff.count == 0)
+}
+
+int main(void)
+{
+    testChanges();
+
+    return 0;
+}
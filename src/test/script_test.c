@@ -0,0 +1,64 @@
+/*----------------------------------------------------------------------------------------------------------
+ *  Copyright (c) Peter Bjorklund. All rights reserved. https://github.com/piot/conclave-client-cli
+ *  Licensed under the MIT License. See LICENSE in the project root for license information.
+ *--------------------------------------------------------------------------------------------------------*/
+#include "check.h"
+#include <clog/clog.h>
+#include <clog/console.h>
+#include <conclave-client-cli/script.h>
+#include <tiny-libc/tiny_libc.h>
+
+clog_config g_clog;
+
+/// @return a copy of the text that the script can take over
+static char* scriptText(const char* text)
+{
+    size_t octetCount = tc_strlen(text) + 1;
+    char* copy = tc_malloc_type_count(char, octetCount);
+    tc_memcpy_octets(copy, text, octetCount);
+
+    return copy;
+}
+
+/// `#` followed by a digit is a correlation id, not a comment
+static void testAwaitId(void)
+{
+    Clog log;
+    log.config = &g_clog;
+    log.constantPrefix = "script";
+
+    ClvCliScript script;
+    CLV_CLI_TEST_CHECK(clvCliScriptInit(&script,
+                           scriptText("# setup\n"
+                                      "ping\n"
+                                      "await #12 2s # the ping\n"
+                                      "room create a#b #no comment\n"),
+                           log)
+        == 0)
+    CLV_CLI_TEST_CHECK(script.instructionCount == 3)
+
+    const ClvCliScriptInstruction* await = &script.instructions[1];
+    CLV_CLI_TEST_CHECK(await->op == ClvCliScriptOpAwait)
+    CLV_CLI_TEST_CHECK(await->value == 12)
+    CLV_CLI_TEST_CHECK(await->timeoutMs == 2000)
+    CLV_CLI_TEST_CHECK(await->lineNumber == 3)
+
+    const ClvCliScriptInstruction* command = &script.instructions[2];
+    CLV_CLI_TEST_CHECK(command->op == ClvCliScriptOpCommand)
+    CLV_CLI_TEST_CHECK(tc_str_equal(command->line, "room create a#b"))
+
+    clvCliScriptDestroy(&script);
+
+    CLV_CLI_TEST_CHECK(clvCliScriptInit(&script, scriptText("await # 12\n"), log) < 0)
+    clvCliScriptDestroy(&script);
+}
+
+int main(void)
+{
+    g_clog.log = clog_console;
+    g_clog.level = CLOG_TYPE_WARN;
+
+    testAwaitId();
+
+    return 0;
+}
@@ -0,0 +1,64 @@
+/*----------------------------------------------------------------------------------------------------------
+ *  Copyright (c) Peter Bjorklund. All rights reserved. https://github.com/piot/conclave-client-cli
+ *  Licensed under the MIT License. See LICENSE in the project root for license information.
+ *--------------------------------------------------------------------------------------------------------*/
+#include "check.h"
+#include <clog/clog.h>
+#include <clog/console.h>
+#include <conclave-client-cli/spsc_ring.h>
+
+clog_config g_clog;
+
+/// The indices keep counting past the capacity, so the slots are reused in order and full and
+/// empty are still told apart after many laps
+static void testWrapAround(void)
+{
+    ClvCliSpscRing ring;
+    CLV_CLI_TEST_CHECK(clvCliSpscRingInit(&ring, sizeof(uint32_t), 4) == 0)
+    CLV_CLI_TEST_CHECK(clvCliSpscRingReadBegin(&ring) == 0)
+
+    uint32_t written = 0;
+    uint32_t read = 0;
+    for (size_t lap = 0; lap < 10; ++lap) {
+        // Three items, so every lap starts at a different slot
+        for (size_t i = 0; i < 3; ++i) {
+            uint32_t* slot = (uint32_t*)clvCliSpscRingWriteBegin(&ring);
+            CLV_CLI_TEST_CHECK(slot != 0)
+            *slot = written++;
+            clvCliSpscRingWriteEnd(&ring);
+        }
+        for (size_t i = 0; i < 3; ++i) {
+            const uint32_t* item = (const uint32_t*)clvCliSpscRingReadBegin(&ring);
+            CLV_CLI_TEST_CHECK(item != 0)
+            CLV_CLI_TEST_CHECK(*item == read)
+            read++;
+            clvCliSpscRingReadEnd(&ring);
+        }
+        CLV_CLI_TEST_CHECK(clvCliSpscRingReadBegin(&ring) == 0)
+    }
+
+    // Full after capacity items, and a slot is free again as soon as one is read
+    for (size_t i = 0; i < 4; ++i) {
+        uint32_t* slot = (uint32_t*)clvCliSpscRingWriteBegin(&ring);
+        CLV_CLI_TEST_CHECK(slot != 0)
+        *slot = written++;
+        clvCliSpscRingWriteEnd(&ring);
+    }
+    CLV_CLI_TEST_CHECK(clvCliSpscRingWriteBegin(&ring) == 0)
+    const uint32_t* oldest = (const uint32_t*)clvCliSpscRingReadBegin(&ring);
+    CLV_CLI_TEST_CHECK(oldest != 0 && *oldest == read)
+    clvCliSpscRingReadEnd(&ring);
+    CLV_CLI_TEST_CHECK(clvCliSpscRingWriteBegin(&ring) != 0)
+
+    clvCliSpscRingDestroy(&ring);
+}
+
+int main(void)
+{
+    g_clog.log = clog_console;
+    g_clog.level = CLOG_TYPE_WARN;
+
+    testWrapAround();
+
+    return 0;
+}